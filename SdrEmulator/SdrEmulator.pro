@@ -0,0 +1,45 @@
+#-------------------------------------------------
+#
+# Local device protocol emulators and plugin ingest harness
+#
+#-------------------------------------------------
+
+#Project common
+include(../application/pebbleqt.pri)
+
+#Same anchor as SdrGarage, see SdrGarage.pro
+QMAKE_LFLAGS += -rpath @loader_path/sdrgaragelib
+
+INCLUDEPATH += ../pebblelib
+DEPENDPATH += ../pebblelib
+
+QT       += core network
+
+QT       -= gui
+
+TARGET = SdrEmulator
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+#SynthGen and ALawCompression, plugins the harness loads use the same library
+LIBS += -L$${PWD}/../pebblelib/$${LIB_DIR} -lpebblelib
+
+SOURCES += main.cpp \
+    emulator.cpp \
+    emulatorlink.cpp \
+    rtltcpemulator.cpp \
+    metisemulator.cpp \
+    sdripemulator.cpp \
+    dspserveremulator.cpp \
+    ingestharness.cpp
+
+HEADERS += \
+    emulator.h \
+    emulatorlink.h \
+    rtltcpemulator.h \
+    metisemulator.h \
+    sdripemulator.h \
+    dspserveremulator.h \
+    ingestharness.h
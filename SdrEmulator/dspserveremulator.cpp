@@ -0,0 +1,160 @@
+#include "dspserveremulator.h"
+#include <QtEndian>
+
+DspServerEmulator::DspServerEmulator(const EmulatorOptions &_options, QObject *_parent) :
+	Emulator(_options, false, _parent)
+{
+	m_socket = NULL;
+	m_spectrumWidth = 2048;
+	m_spectrumFrames = 0;
+	m_frequency = 10000000;
+	m_mode = 6; //AM
+	m_lowFilter = -2000;
+	m_highFilter = 2000;
+	connect(&m_server, &QTcpServer::newConnection, this, &DspServerEmulator::newConnection);
+	connect(&m_spectrumTimer, &QTimer::timeout, this, &DspServerEmulator::sendSpectrum);
+}
+
+bool DspServerEmulator::listen()
+{
+	m_server.setMaxPendingConnections(1);
+	return m_server.listen(QHostAddress::AnyIPv4, m_port);
+}
+
+void DspServerEmulator::newConnection()
+{
+	QTcpSocket *socket = m_server.nextPendingConnection();
+	if (m_socket != NULL) {
+		socket->close();
+		socket->deleteLater();
+		return;
+	}
+	m_socket = socket;
+	m_command.clear();
+	connect(m_socket, &QTcpSocket::readyRead, this, &DspServerEmulator::newData);
+	connect(m_socket, &QTcpSocket::disconnected, this, &DspServerEmulator::closeConnection);
+}
+
+void DspServerEmulator::closeConnection()
+{
+	stopStream();
+	m_spectrumTimer.stop();
+	m_socket->deleteLater();
+	m_socket = NULL;
+}
+
+void DspServerEmulator::newData()
+{
+	m_command.append(m_socket->readAll());
+	while (m_command.size() >= c_commandSize) {
+		//Text up to the first NUL
+		QString command = QString::fromLatin1(m_command.constData(), qstrnlen(m_command.constData(), c_commandSize));
+		m_command.remove(0, c_commandSize);
+		processCommand(command.trimmed());
+	}
+}
+
+void DspServerEmulator::processCommand(QString _command)
+{
+	QStringList args = _command.split(' ', QString::SkipEmptyParts);
+	if (args.isEmpty())
+		return;
+	QString cmd = args[0].toLower();
+
+	if (cmd == "startaudiostream") {
+		startStream(c_audioSampleRate, c_audioPacketSize);
+	} else if (cmd == "stopaudiostream") {
+		stopStream();
+		m_spectrumTimer.stop();
+	} else if (cmd == "setfps" && args.count() >= 3) {
+		//Width, frames per second
+		m_spectrumWidth = qBound(1, args[1].toInt(), 65535);
+		int fps = qBound(1, args[2].toInt(), 100);
+		m_spectrumTimer.start(1000 / fps);
+	} else if (cmd == "getspectrum" && args.count() >= 2) {
+		m_spectrumWidth = qBound(1, args[1].toInt(), 65535);
+		sendSpectrum();
+	} else if (cmd == "setfrequency" && args.count() >= 2) {
+		m_frequency = args[1].toLongLong();
+	} else if (cmd == "setmode" && args.count() >= 2) {
+		m_mode = args[1].toInt();
+	} else if (cmd == "setfilter" && args.count() >= 3) {
+		m_lowFilter = args[1].toInt();
+		m_highFilter = args[2].toInt();
+	} else if (cmd == "q-version") {
+		sendAnswer("q-version:20130609;-master");
+	} else if (cmd == "q-protocol3") {
+		sendAnswer("q-protocol3:Y");
+	} else if (cmd == "q-master") {
+		sendAnswer("q-master:master");
+	} else if (cmd == "q-loffset") {
+		sendAnswer("q-loffset:9000.000000;");
+	} else if (cmd.startsWith("q-cantx")) {
+		sendAnswer("q-cantx:N");
+	} else if (cmd == "q-rtpport") {
+		sendAnswer("q-rtpport:5004;");
+	} else if (cmd == "q-server") {
+		sendAnswer("q-server:EMULATOR P");
+	} else if (cmd == "q-info") {
+		sendAnswer(QString("q-info:s;0;f;%1;m;%2;z;0;l;%3;r;%4;")
+			.arg(m_frequency).arg(m_mode).arg(m_lowFilter).arg(m_highFilter));
+	}
+}
+
+//Answer length is 2 ASCII digits in the common header, 99 max
+void DspServerEmulator::sendAnswer(QString _answer)
+{
+	QByteArray text = _answer.toLatin1().left(99);
+	QByteArray packet;
+	packet.append((char)AnswerData);
+	packet.append(QByteArray::number(text.size()).rightJustified(2, '0'));
+	packet.append(text);
+	m_link->send(packet);
+}
+
+void DspServerEmulator::producePacket()
+{
+	//Common header (type, version, sub version), big endian length, ALAW mono
+	QByteArray packet(5 + c_audioPacketSize, 0);
+	quint8 *p = (quint8 *)packet.data();
+	p[0] = AudioData;
+	p[1] = 2;
+	p[2] = 1;
+	qToBigEndian<quint16>(c_audioPacketSize, &p[3]);
+	generate(m_audio, IQF_CPXFLOAT, c_audioPacketSize);
+	for (quint32 i = 0; i < c_audioPacketSize; i++)
+		p[5 + i] = m_alaw.LinearToALaw((qint16)(m_audio[i * 2] * 32767.0f));
+	m_link->send(packet);
+}
+
+void DspServerEmulator::sendSpectrum()
+{
+	//Common header, then big endian width, meter, sub rx meter, sample rate and LO offset
+	QByteArray packet(15 + m_spectrumWidth, 0);
+	quint8 *p = (quint8 *)packet.data();
+	p[0] = SpectrumData;
+	p[1] = 2;
+	p[2] = 1;
+	qToBigEndian<quint16>(m_spectrumWidth, &p[3]);
+	qToBigEndian<qint16>(-80, &p[5]);
+	qToBigEndian<qint16>(-80, &p[7]);
+	qToBigEndian<quint32>(c_spectrumSampleRate, &p[9]);
+	qToBigEndian<quint16>(9000, &p[13]);
+	//Bins are -dBm, a slowly moving noise floor around -120 with a few signals on top
+	quint8 *bins = &p[15];
+	for (quint32 i = 0; i < m_spectrumWidth; i++)
+		bins[i] = 118 + ((i * 7 + m_spectrumFrames) % 5);
+	quint32 center = m_spectrumWidth / 2;
+	bins[center + m_spectrumWidth / 10] = 60;
+	bins[center - m_spectrumWidth / 5] = 70;
+	bins[center + (m_spectrumWidth * 3) / 10] = 80;
+	m_spectrumFrames++;
+	m_link->send(packet);
+}
+
+void DspServerEmulator::deliver(const QByteArray &_packet)
+{
+	if (m_socket == NULL)
+		return;
+	m_socket->write(_packet);
+}
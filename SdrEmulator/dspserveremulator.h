@@ -0,0 +1,64 @@
+#ifndef DSPSERVEREMULATOR_H
+#define DSPSERVEREMULATOR_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include "emulator.h"
+#include "alawcompression.h"
+
+/*
+	ghpsdr3 dspserver, what Ghpsdr3Device connects to
+
+	Commands are 64 byte NUL padded text.  q- queries are answered with the same strings a master dspserver
+	sends, set commands that show up in q-info are remembered and the rest are accepted and ignored.
+	startAudioStream starts 8k ALAW audio in 2000 byte packets, setfps starts spectrum frames at the requested
+	width and rate.  Everything goes down the one TCP stream in order, answers included.
+*/
+class DspServerEmulator : public Emulator
+{
+	Q_OBJECT
+public:
+	DspServerEmulator(const EmulatorOptions &_options, QObject *_parent = NULL);
+
+	bool listen();
+
+protected:
+	void producePacket();
+	void deliver(const QByteArray &_packet);
+
+private slots:
+	void newConnection();
+	void newData();
+	void closeConnection();
+	void sendSpectrum();
+
+private:
+	enum PacketType {SpectrumData = 0, AudioData = 1, AnswerData = 4};
+	static const quint32 c_audioSampleRate = 8000;
+	static const quint32 c_audioPacketSize = 2000;
+	static const int c_commandSize = 64;
+	static const quint16 c_spectrumSampleRate = 48000;
+
+	void processCommand(QString _command);
+	void sendAnswer(QString _answer);
+
+	QTcpServer m_server;
+	QTcpSocket *m_socket;
+	QByteArray m_command; //Bytes of a command we haven't got all of yet
+	ALawCompression m_alaw;
+	float m_audio[c_audioPacketSize * 2];
+
+	QTimer m_spectrumTimer;
+	quint16 m_spectrumWidth;
+	quint32 m_spectrumFrames;
+
+	//For q-info
+	qint64 m_frequency;
+	int m_mode;
+	int m_lowFilter;
+	int m_highFilter;
+};
+
+#endif // DSPSERVEREMULATOR_H
@@ -0,0 +1,141 @@
+#include "emulator.h"
+#include "rtltcpemulator.h"
+#include "metisemulator.h"
+#include "sdripemulator.h"
+#include "dspserveremulator.h"
+#include <QTextStream>
+
+EmulatorOptions::EmulatorOptions()
+{
+	port = 0;
+	seed = 1;
+}
+
+QStringList Emulator::protocols()
+{
+	return QStringList()<<"rtltcp"<<"metis"<<"sdrip"<<"dspserver";
+}
+
+quint16 Emulator::defaultPort(QString _protocol)
+{
+	if (_protocol == "rtltcp")
+		return 1234;
+	else if (_protocol == "metis")
+		return 1024;
+	else if (_protocol == "sdrip")
+		return 50000;
+	else if (_protocol == "dspserver")
+		return 8000;
+	return 0;
+}
+
+Emulator *Emulator::create(const EmulatorOptions &_options, QObject *_parent)
+{
+	if (_options.protocol == "rtltcp")
+		return new RtlTcpEmulator(_options, _parent);
+	else if (_options.protocol == "metis")
+		return new MetisEmulator(_options, _parent);
+	else if (_options.protocol == "sdrip")
+		return new SdrIpEmulator(_options, _parent);
+	else if (_options.protocol == "dspserver")
+		return new DspServerEmulator(_options, _parent);
+	return NULL;
+}
+
+Emulator::Emulator(const EmulatorOptions &_options, bool _datagrams, QObject *_parent) : QObject(_parent)
+{
+	m_options = _options;
+	m_port = m_options.port != 0 ? m_options.port : defaultPort(m_options.protocol);
+	m_link = new EmulatorLink(m_options.impairments, _datagrams, m_options.seed,
+		[this](const QByteArray &_packet) {deliver(_packet);});
+	m_synthGen = NULL;
+	m_streaming = false;
+	m_sampleRate = 0;
+	m_samplesPerPacket = 0;
+	m_packetsProduced = 0;
+	m_lagResets = 0;
+	m_serverDrops = 0;
+
+	//Link has to be polled even when we're not streaming, held packets still go out
+	m_paceTimer.setTimerType(Qt::PreciseTimer);
+	connect(&m_paceTimer, &QTimer::timeout, this, &Emulator::paceTimeout);
+	m_paceTimer.start(c_paceMs);
+	connect(&m_statsTimer, &QTimer::timeout, this, &Emulator::reportStats);
+	m_statsTimer.start(1000);
+}
+
+Emulator::~Emulator()
+{
+	delete m_link;
+	if (m_synthGen != NULL)
+		delete m_synthGen;
+}
+
+void Emulator::startStream(quint32 _sampleRate, quint32 _samplesPerPacket)
+{
+	if (m_synthGen == NULL || _sampleRate != m_sampleRate) {
+		if (m_synthGen != NULL)
+			delete m_synthGen;
+		m_synthGen = new SynthGen(_sampleRate, m_options.seed);
+		//A few modulated carriers over a low noise floor, placed relative to the rate so every rate looks alike
+		double fs = _sampleRate;
+		QVector<SynthCarrier> carriers;
+		carriers.append({SynthCarrier::MOD_AM, 0.1 * fs, -30, 1000, 0.8});
+		carriers.append({SynthCarrier::MOD_FM, -0.2 * fs, -40, 800, qMin(5000.0, 0.02 * fs)});
+		carriers.append({SynthCarrier::MOD_CW, 0.3 * fs, -50, 20, 0});
+		carriers.append({SynthCarrier::MOD_SWEEP, -0.35 * fs, -60, 1, 0.1 * fs});
+		m_synthGen->setCarriers(carriers);
+		m_synthGen->setNoise(-70, SynthGen::c_offDb, 0);
+	}
+	m_sampleRate = _sampleRate;
+	m_samplesPerPacket = _samplesPerPacket;
+	m_packetsProduced = 0;
+	m_link->reset();
+	m_streamTimer.start();
+	m_streaming = true;
+}
+
+void Emulator::stopStream()
+{
+	m_streaming = false;
+	m_link->reset();
+}
+
+void Emulator::generate(void *_out, IQSampleFormat _format, quint32 _numSamples)
+{
+	m_synthGen->generate(_out, _format, _numSamples);
+}
+
+void Emulator::paceTimeout()
+{
+	if (m_streaming) {
+		double packetsPerNs = (double)m_sampleRate / m_samplesPerPacket / 1.0e9;
+		quint64 due = m_streamTimer.nsecsElapsed() * packetsPerNs;
+		quint64 maxLag = c_maxLagMs * 1000000.0 * packetsPerNs + 1;
+		if (due > m_packetsProduced + maxLag) {
+			//We couldn't keep up, don't make it worse by sending a huge burst
+			m_lagResets++;
+			m_packetsProduced = due;
+		}
+		//producePacket() can stop the stream
+		while (m_streaming && m_packetsProduced < due) {
+			producePacket();
+			m_packetsProduced++;
+		}
+	}
+	m_link->poll();
+}
+
+QString Emulator::statsString()
+{
+	return QString("Emulator %1 rate %2 sps, sent %3, delivered %4 (%5 bytes), lost %6, reordered %7, server drops %8, lag resets %9")
+		.arg(m_options.protocol).arg(m_streaming ? m_sampleRate : 0)
+		.arg(m_link->packetsSent()).arg(m_link->packetsDelivered()).arg(m_link->bytesDelivered())
+		.arg(m_link->packetsLost()).arg(m_link->packetsReordered()).arg(m_serverDrops).arg(m_lagResets);
+}
+
+//One line a second on stdout, IngestHarness reads it from the emulator process
+void Emulator::reportStats()
+{
+	QTextStream(stdout) << statsString() << "\n";
+}
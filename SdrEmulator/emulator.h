@@ -0,0 +1,86 @@
+#ifndef EMULATOR_H
+#define EMULATOR_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QStringList>
+#include "synthgen.h"
+#include "emulatorlink.h"
+
+struct EmulatorOptions
+{
+	EmulatorOptions();
+
+	QString protocol;	//One of Emulator::protocols()
+	quint16 port;		//0 for the protocol's usual port
+	quint64 seed;		//SynthGen and EmulatorLink seed
+	Impairments impairments;
+};
+
+/*
+	Base for the local device emulators, each one speaks one network protocol a Pebble device plugin connects to
+
+	Subclasses handle their protocol's connect and command traffic and call startStream() when the client starts
+	data.  The pacing timer then calls producePacket() as packets come due at the stream's sample rate, and the
+	subclass builds each packet from synthetic IQ (SynthGen) and hands it to m_link.  m_link applies the
+	impairments and calls deliver() when a packet is released to the network.
+	If the emulator itself falls more than c_maxLagMs behind it skips ahead and counts a lag reset, any
+	lag resets in the stats mean the emulator, not the device plugin, was the bottleneck.
+*/
+class Emulator : public QObject
+{
+	Q_OBJECT
+public:
+	static QStringList protocols();
+	static quint16 defaultPort(QString _protocol);
+	//NULL for an unknown protocol
+	static Emulator *create(const EmulatorOptions &_options, QObject *_parent = NULL);
+
+	Emulator(const EmulatorOptions &_options, bool _datagrams, QObject *_parent = NULL);
+	virtual ~Emulator();
+
+	virtual bool listen() = 0;
+	quint16 port() const {return m_port;}
+	QString statsString();
+
+protected:
+	void startStream(quint32 _sampleRate, quint32 _samplesPerPacket);
+	void stopStream();
+	bool isStreaming() const {return m_streaming;}
+	quint32 sampleRate() const {return m_sampleRate;}
+
+	//Called for every packet that comes due, build it and m_link->send() it
+	virtual void producePacket() = 0;
+	//Called for every packet m_link releases to the network
+	virtual void deliver(const QByteArray &_packet) = 0;
+	//Next _numSamples of the scenario, see SynthGen::generate()
+	void generate(void *_out, IQSampleFormat _format, quint32 _numSamples);
+
+	EmulatorOptions m_options;
+	quint16 m_port;
+	EmulatorLink *m_link;
+	quint64 m_serverDrops; //Packets the emulated server threw away because the client wasn't reading
+
+private slots:
+	void paceTimeout();
+	void reportStats();
+
+private:
+	static const int c_paceMs = 1;
+	static const int c_maxLagMs = 100;
+
+	SynthGen *m_synthGen;
+
+	QTimer m_paceTimer;
+	QTimer m_statsTimer;
+	QElapsedTimer m_streamTimer;
+	bool m_streaming;
+	quint32 m_sampleRate;
+	quint32 m_samplesPerPacket;
+	quint64 m_packetsProduced; //Since startStream()
+	quint64 m_lagResets;
+};
+
+#endif // EMULATOR_H
@@ -0,0 +1,120 @@
+#include "emulatorlink.h"
+
+Impairments::Impairments()
+{
+	lossPercent = 0;
+	reorderPercent = 0;
+	reorderDepth = 4;
+	jitterMs = 0;
+	burstPackets = 0;
+}
+
+bool Impairments::isClean() const
+{
+	return lossPercent <= 0 && reorderPercent <= 0 && jitterMs <= 0 && burstPackets <= 1;
+}
+
+EmulatorLink::EmulatorLink(const Impairments &_impairments, bool _datagrams, quint64 _seed, Deliver _deliver)
+{
+	m_impairments = _impairments;
+	m_datagrams = _datagrams;
+	//xorshift state must never be 0
+	m_rng = _seed ^ 0x9e3779b97f4a7c15ULL;
+	if (m_rng == 0)
+		m_rng = 1;
+	m_deliver = _deliver;
+	m_timer.start();
+	reset();
+	m_packetsSent = 0;
+	m_packetsDelivered = 0;
+	m_packetsLost = 0;
+	m_packetsReordered = 0;
+	m_bytesDelivered = 0;
+}
+
+void EmulatorLink::reset()
+{
+	m_lastDue = 0;
+	m_reordered.clear();
+	m_delayed.clear();
+	m_burst.clear();
+}
+
+quint64 EmulatorLink::nextRandom()
+{
+	m_rng ^= m_rng >> 12;
+	m_rng ^= m_rng << 25;
+	m_rng ^= m_rng >> 27;
+	return m_rng * 2685821657736338717ULL;
+}
+
+double EmulatorLink::nextUniform()
+{
+	return (nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+void EmulatorLink::send(const QByteArray &_packet)
+{
+	m_packetsSent++;
+	if (m_datagrams) {
+		if (m_impairments.lossPercent > 0 && nextUniform() * 100.0 < m_impairments.lossPercent) {
+			m_packetsLost++;
+			return;
+		}
+		if (m_impairments.reorderPercent > 0 && m_impairments.reorderDepth > 0 &&
+				nextUniform() * 100.0 < m_impairments.reorderPercent) {
+			Pending late;
+			late.packet = _packet;
+			late.due = m_impairments.reorderDepth;
+			m_reordered.append(late);
+			m_packetsReordered++;
+			return;
+		}
+	}
+	delay(_packet);
+
+	//Held back packets go out after reorderDepth packets that were sent after them
+	int i = 0;
+	while (i < m_reordered.count()) {
+		if (--m_reordered[i].due <= 0)
+			delay(m_reordered.takeAt(i).packet);
+		else
+			i++;
+	}
+}
+
+void EmulatorLink::delay(const QByteArray &_packet)
+{
+	Pending pending;
+	pending.packet = _packet;
+	pending.due = m_timer.nsecsElapsed();
+	if (m_impairments.jitterMs > 0)
+		pending.due += nextUniform() * m_impairments.jitterMs * 1000000.0;
+	if (pending.due < m_lastDue)
+		pending.due = m_lastDue;
+	m_lastDue = pending.due;
+	m_delayed.enqueue(pending);
+}
+
+void EmulatorLink::poll()
+{
+	qint64 now = m_timer.nsecsElapsed();
+	while (!m_delayed.isEmpty() && m_delayed.head().due <= now) {
+		QByteArray packet = m_delayed.dequeue().packet;
+		if (m_impairments.burstPackets > 1) {
+			m_burst.append(packet);
+			if ((quint32)m_burst.count() < m_impairments.burstPackets)
+				continue;
+			foreach (const QByteArray &held, m_burst) {
+				m_packetsDelivered++;
+				m_bytesDelivered += held.size();
+				m_deliver(held);
+			}
+			m_burst.clear();
+		} else {
+			m_packetsDelivered++;
+			m_bytesDelivered += packet.size();
+			m_deliver(packet);
+		}
+	}
+}
@@ -0,0 +1,78 @@
+#ifndef EMULATORLINK_H
+#define EMULATORLINK_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include <QByteArray>
+#include <QQueue>
+#include <QList>
+#include <QElapsedTimer>
+#include <functional>
+
+//Network impairments applied by EmulatorLink, all off by default
+struct Impairments
+{
+	Impairments();
+	bool isClean() const;
+
+	double lossPercent;		//Datagrams dropped
+	double reorderPercent;	//Datagrams held back and delivered reorderDepth packets late
+	quint32 reorderDepth;
+	double jitterMs;		//Random extra delay 0 to jitterMs per packet, order is preserved
+	quint32 burstPackets;	//Packets are held and delivered back to back in groups of burstPackets, 0 or 1 is off
+};
+
+/*
+	Sits between an emulator and its socket and delivers packets the way a bad network would
+
+	Emulators call send() when a packet is due and poll() from their pacing timer, poll() hands released
+	packets to the deliver callback.  Loss and reordering only apply to datagram links, a TCP stream can't lose
+	or reorder bytes, it can only stall.  Jitter and bursts apply to both.
+	Same seed and impairments always drop and reorder the same packets.
+*/
+class EmulatorLink
+{
+public:
+	typedef std::function<void(const QByteArray &)> Deliver;
+
+	EmulatorLink(const Impairments &_impairments, bool _datagrams, quint64 _seed, Deliver _deliver);
+
+	void send(const QByteArray &_packet);
+	void poll();
+	//Throws away anything held, for stream stop and restart
+	void reset();
+
+	quint64 packetsSent() const {return m_packetsSent;}
+	quint64 packetsDelivered() const {return m_packetsDelivered;}
+	quint64 packetsLost() const {return m_packetsLost;}
+	quint64 packetsReordered() const {return m_packetsReordered;}
+	quint64 bytesDelivered() const {return m_bytesDelivered;}
+
+private:
+	struct Pending {
+		QByteArray packet;
+		qint64 due;		//Release time in ns, or packets left to wait for reordered packets
+	};
+
+	quint64 nextRandom();
+	double nextUniform(); //[0,1)
+	void delay(const QByteArray &_packet);
+
+	Impairments m_impairments;
+	bool m_datagrams;
+	quint64 m_rng;
+	Deliver m_deliver;
+
+	QElapsedTimer m_timer;
+	qint64 m_lastDue; //Jitter never reorders, each packet is due no earlier than the last
+	QList<Pending> m_reordered;
+	QQueue<Pending> m_delayed;
+	QList<QByteArray> m_burst;
+
+	quint64 m_packetsSent;
+	quint64 m_packetsDelivered;
+	quint64 m_packetsLost;
+	quint64 m_packetsReordered;
+	quint64 m_bytesDelivered;
+};
+
+#endif // EMULATORLINK_H
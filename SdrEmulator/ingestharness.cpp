@@ -0,0 +1,376 @@
+#include "ingestharness.h"
+#include "deviceinterfacebase.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QPluginLoader>
+#include <QRegularExpression>
+#include <QTextStream>
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace std::placeholders; //For _1, _2 arguments
+
+IngestHarness::IngestHarness(const EmulatorOptions &_options, quint32 _sampleRate, int _seconds, QObject *_parent) :
+	QObject(_parent)
+{
+	m_options = _options;
+	if (m_options.port == 0)
+		m_options.port = Emulator::defaultPort(m_options.protocol);
+	m_sampleRate = _sampleRate;
+	m_seconds = _seconds;
+	m_setup = deviceSetup();
+
+	m_device = NULL;
+	m_deviceRunning = false;
+	m_progressTicks = 0;
+	m_lastSamples = 0;
+	m_warmSamples = 0;
+	m_warmNs = 0;
+	m_warmCpuSecs = 0;
+	m_samples = 0;
+	m_blocks = 0;
+	m_droppedSamples = 0;
+	m_gapSamples = 0;
+	m_bandscopeFrames = 0;
+	m_nextSampleCounter = 0;
+	m_firstBlock = true;
+
+	m_emulator.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+	connect(&m_emulator, &QProcess::readyReadStandardOutput, this, &IngestHarness::emulatorOutput);
+	connect(&m_emulator, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(emulatorFinished()));
+	m_emulatorTimer.setSingleShot(true);
+	connect(&m_emulatorTimer, &QTimer::timeout, this, &IngestHarness::emulatorTimeout);
+	connect(&m_progressTimer, &QTimer::timeout, this, &IngestHarness::reportProgress);
+}
+
+IngestHarness::~IngestHarness()
+{
+	stopDevice();
+	if (m_emulator.state() != QProcess::NotRunning) {
+		m_emulator.kill();
+		m_emulator.waitForFinished(1000);
+	}
+}
+
+//Plugin, device number and the settings that point it at the emulator
+IngestHarness::DeviceSetup IngestHarness::deviceSetup()
+{
+	DeviceSetup setup;
+	setup.audio = false;
+	if (m_options.protocol == "rtltcp") {
+		setup.pluginFile = "rtl2832sdrDevice";
+		setup.deviceNumber = 1; //RTL_TCP
+		setup.sampleRate = m_sampleRate != 0 ? m_sampleRate : 3200000;
+		setup.settings["IPAddr"] = "127.0.0.1";
+		setup.settings["Port"] = m_options.port;
+	} else if (m_options.protocol == "metis") {
+		setup.pluginFile = "HPSDRDevice";
+		setup.deviceNumber = 0;
+		setup.sampleRate = m_sampleRate != 0 ? m_sampleRate : 384000;
+		setup.settings["Discovery"] = 2; //USE_METIS
+		setup.settings["MetisAddress"] = "127.0.0.1";
+		setup.settings["MetisPort"] = m_options.port;
+	} else if (m_options.protocol == "sdrip") {
+		setup.pluginFile = "RFSpaceDevice";
+		setup.deviceNumber = 1; //SDR_IP
+		setup.sampleRate = m_sampleRate != 0 ? m_sampleRate : 2000000;
+		setup.settings["AutoDiscover"] = false;
+		setup.settings["DeviceAddress"] = "127.0.0.1";
+		setup.settings["DevicePort"] = m_options.port;
+	} else if (m_options.protocol == "dspserver") {
+		setup.pluginFile = "Ghpsdr3Device";
+		setup.deviceNumber = 0;
+		setup.sampleRate = 8000; //Server demodulates, audio rate is fixed
+		setup.audio = true;
+		setup.settings["DeviceAddress"] = "127.0.0.1";
+		setup.settings["DevicePort"] = m_options.port;
+	}
+	if (!setup.audio)
+		setup.settings["DeviceSampleRate"] = setup.sampleRate;
+	return setup;
+}
+
+bool IngestHarness::start()
+{
+	if (m_setup.pluginFile.isEmpty()) {
+		print("Unknown protocol " + m_options.protocol);
+		return false;
+	}
+	const Impairments &imp = m_options.impairments;
+	QStringList args;
+	args << "--emulate" << m_options.protocol
+		<< "--port" << QString::number(m_options.port)
+		<< "--seed" << QString::number(m_options.seed)
+		<< "--loss" << QString::number(imp.lossPercent)
+		<< "--reorder" << QString::number(imp.reorderPercent)
+		<< "--reorder-depth" << QString::number(imp.reorderDepth)
+		<< "--jitter" << QString::number(imp.jitterMs)
+		<< "--burst" << QString::number(imp.burstPackets);
+	m_emulator.start(QCoreApplication::applicationFilePath(), args);
+	if (!m_emulator.waitForStarted()) {
+		print("Could not start emulator " + m_emulator.errorString());
+		return false;
+	}
+	//Device starts when the emulator says it's listening
+	m_emulatorTimer.start(c_emulatorTimeoutMs);
+	return true;
+}
+
+void IngestHarness::emulatorOutput()
+{
+	m_emulatorOutput.append(m_emulator.readAllStandardOutput());
+	int eol;
+	while ((eol = m_emulatorOutput.indexOf('\n')) >= 0) {
+		QString line = QString::fromLatin1(m_emulatorOutput.left(eol)).trimmed();
+		m_emulatorOutput.remove(0, eol + 1);
+		if (line.contains("listening") && m_emulatorTimer.isActive()) {
+			m_emulatorTimer.stop();
+			print(line);
+			if (!startDevice())
+				exitWith(1);
+		} else if (line.startsWith("Emulator")) {
+			m_emulatorStats = line;
+		}
+	}
+}
+
+void IngestHarness::emulatorFinished()
+{
+	if (m_emulatorTimer.isActive() || m_deviceRunning) {
+		m_emulatorTimer.stop();
+		print("Emulator exited");
+		exitWith(1);
+	}
+}
+
+void IngestHarness::emulatorTimeout()
+{
+	print("Emulator didn't start listening");
+	exitWith(1);
+}
+
+//Same directory the receiver finds plugins and PebbleData in, see Plugins::findPlugins()
+QDir IngestHarness::appDir()
+{
+	QDir dir = QDir(qApp->applicationDirPath());
+#if defined(Q_OS_WIN)
+	if (dir.dirName().toLower() == "debug" || dir.dirName().toLower() == "release")
+		dir.cdUp();
+#elif defined(Q_OS_MAC)
+	if (dir.dirName() == "MacOS") {
+		dir.cdUp();
+		dir.cdUp();
+		dir.cdUp();
+	}
+#endif
+	return dir;
+}
+
+//Plugin starts from the user's settings but writes to the copy, set before the plugin constructs its QSettings
+bool IngestHarness::copySettings()
+{
+	if (!m_settingsDir.isValid()) {
+		print("Could not create a settings directory " + m_settingsDir.errorString());
+		return false;
+	}
+	QDir dataDir = appDir();
+	if (dataDir.cd("PebbleData")) {
+		foreach (QString fileName, dataDir.entryList(QStringList() << "*.ini", QDir::Files))
+			QFile::copy(dataDir.absoluteFilePath(fileName), m_settingsDir.filePath(fileName));
+	}
+	qputenv(DeviceInterfaceBase::c_settingsPathEnv, QFile::encodeName(m_settingsDir.path()));
+	return true;
+}
+
+DeviceInterface2 *IngestHarness::loadPlugin(QString _pluginFile)
+{
+	QDir pluginsDir = appDir();
+	pluginsDir.cd("plugins");
+
+	//File names have platform prefixes and suffixes, libHPSDRDevice.so, HPSDRDevice.dll ...
+	foreach (QString fileName, pluginsDir.entryList(QDir::Files)) {
+		if (!QFileInfo(fileName).baseName().contains(_pluginFile, Qt::CaseInsensitive))
+			continue;
+		QPluginLoader loader(pluginsDir.absoluteFilePath(fileName));
+		QObject *plugin = loader.instance();
+		if (plugin == NULL) {
+			print(loader.errorString());
+			continue;
+		}
+		DeviceInterface2 *device = qobject_cast<DeviceInterface2 *>(plugin);
+		if (device != NULL)
+			return device;
+	}
+	print("No " + _pluginFile + " plugin in " + pluginsDir.absolutePath());
+	return NULL;
+}
+
+bool IngestHarness::startDevice()
+{
+	if (!copySettings())
+		return false;
+	m_device = loadPlugin(m_setup.pluginFile);
+	if (m_device == NULL)
+		return false;
+
+	m_device->set(DeviceInterface::Key_DeviceNumber, m_setup.deviceNumber);
+	//Only the scratch copy is changed, see copySettings()
+	foreach (QString key, m_setup.settings.keys())
+		m_device->set(DeviceInterface::Key_Setting, key, m_setup.settings.value(key));
+	m_device->command(DeviceInterface::Cmd_ReadSettings, 0);
+
+	m_device->initialize2(std::bind(&IngestHarness::processIQBlock, this, _1),
+						  std::bind(&IngestHarness::processBandscopeData, this, _1, _2),
+						  std::bind(&IngestHarness::processAudioData, this, _1, _2),
+						  c_framesPerBuffer);
+
+	print(QString("%1 %2 at %3 sps, %4 seconds")
+		.arg(m_device->get(DeviceInterface::Key_PluginName, m_setup.deviceNumber).toString())
+		.arg(m_options.impairments.isClean() ? "clean link" : "impaired link")
+		.arg(m_setup.sampleRate).arg(m_seconds));
+
+	if (!m_device->command(DeviceInterface::Cmd_Connect, 0)) {
+		print("Could not connect to emulator");
+		return false;
+	}
+	m_deviceRunning = true;
+	m_elapsed.start();
+	m_device->command(DeviceInterface::Cmd_Start, 0);
+	m_progressTimer.start(1000);
+	QTimer::singleShot(m_seconds * 1000, this, SLOT(finish()));
+	return true;
+}
+
+void IngestHarness::stopDevice()
+{
+	if (m_device == NULL)
+		return;
+	if (m_deviceRunning) {
+		m_deviceRunning = false;
+		m_device->command(DeviceInterface::Cmd_Stop, 0);
+		m_device->command(DeviceInterface::Cmd_Disconnect, 0);
+	}
+	m_device = NULL;
+}
+
+void IngestHarness::reportProgress()
+{
+	m_progressTicks++;
+	qint64 samples = m_samples.load();
+	if (m_progressTicks == 1) {
+		m_warmSamples = samples;
+		m_warmNs = m_elapsed.nsecsElapsed();
+		m_warmCpuSecs = processCpuSecs();
+	}
+	print(QString("%1s %2 sps").arg(m_progressTicks).arg(samples - m_lastSamples));
+	m_lastSamples = samples;
+}
+
+void IngestHarness::finish()
+{
+	if (m_device == NULL)
+		return;
+	m_progressTimer.stop();
+	double secs = (m_elapsed.nsecsElapsed() - m_warmNs) / 1.0e9;
+	double cpuSecs = processCpuSecs() - m_warmCpuSecs;
+	qint64 samples = m_samples.load() - m_warmSamples;
+	QString health = m_device->get(DeviceInterface::Key_DeviceHealthString).toString();
+	stopDevice();
+
+	double rate = secs > 0 ? samples / secs : 0;
+	double percent = m_setup.sampleRate > 0 ? rate * 100.0 / m_setup.sampleRate : 0;
+	double cpuPercent = secs > 0 ? cpuSecs * 100.0 / secs : 0;
+	print(QString("Sustained %1 sps, %2% of %3 sps").arg(rate, 0, 'f', 0).arg(percent, 0, 'f', 1).arg(m_setup.sampleRate));
+	print(QString("CPU %1% of one core").arg(cpuPercent, 0, 'f', 1));
+	if (m_setup.audio)
+		print(QString("Bandscope frames %1").arg(m_bandscopeFrames.load()));
+	else
+		print(QString("Blocks %1, dropped samples %2, sample counter gaps %3")
+			.arg(m_blocks.load()).arg(m_droppedSamples.load()).arg(m_gapSamples.load()));
+	print("Device health: " + health);
+	print(m_emulatorStats);
+
+	//Drops on a clean link are the plugin's, or the emulated server giving up on a client that didn't read
+	bool dropped = m_droppedSamples.load() > 0 || m_gapSamples.load() > 0;
+	QRegularExpressionMatch match = QRegularExpression("server drops (\\d+), lag resets (\\d+)").match(m_emulatorStats);
+	if (match.hasMatch()) {
+		dropped |= match.captured(1).toULongLong() > 0;
+		if (match.captured(2).toULongLong() > 0)
+			print("Emulator couldn't keep up, results aren't valid");
+	}
+	bool pass = percent >= c_passPercent && (!dropped || !m_options.impairments.isClean());
+	print(pass ? "PASS" : "FAIL");
+	exitWith(pass ? 0 : 1);
+}
+
+void IngestHarness::exitWith(int _code)
+{
+	m_progressTimer.stop();
+	stopDevice();
+	if (m_emulator.state() != QProcess::NotRunning) {
+		//Don't report the emulator exit we cause
+		disconnect(&m_emulator, 0, this, 0);
+		m_emulator.kill();
+		m_emulator.waitForFinished(1000);
+	}
+	qApp->exit(_code);
+}
+
+void IngestHarness::print(QString _line)
+{
+	QTextStream(stdout) << _line << "\n";
+}
+
+//User + system CPU seconds for this process, plugin threads included
+double IngestHarness::processCpuSecs()
+{
+#if defined(Q_OS_WIN)
+	FILETIME created, exited, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user))
+		return 0;
+	quint64 k = ((quint64)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+	quint64 u = ((quint64)user.dwHighDateTime << 32) | user.dwLowDateTime;
+	return (k + u) / 1.0e7; //100ns units
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+	return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1.0e6 +
+		usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1.0e6;
+#endif
+}
+
+//Plugin consumer thread
+void IngestHarness::processIQBlock(const IQBlock &_block)
+{
+	if (m_firstBlock || (_block.flags & IQB_DISCONTINUITY)) {
+		m_firstBlock = false;
+	} else if (_block.flags & IQB_DROPPED) {
+		m_droppedSamples += _block.droppedSamples;
+	} else if (_block.sampleCounter > m_nextSampleCounter) {
+		m_gapSamples += _block.sampleCounter - m_nextSampleCounter;
+	}
+	m_nextSampleCounter = _block.sampleCounter + _block.numSamples;
+	m_samples += _block.numSamples;
+	m_blocks++;
+	if (_block.release != NULL)
+		_block.release(_block.owner, _block.handle);
+}
+
+void IngestHarness::processAudioData(CPX *_in, quint16 _numSamples)
+{
+	Q_UNUSED(_in);
+	m_samples += _numSamples;
+	m_blocks++;
+}
+
+void IngestHarness::processBandscopeData(quint8 *_in, quint16 _numPoints)
+{
+	Q_UNUSED(_in);
+	Q_UNUSED(_numPoints);
+	m_bandscopeFrames++;
+}
@@ -0,0 +1,108 @@
+#ifndef INGESTHARNESS_H
+#define INGESTHARNESS_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include <QObject>
+#include <QProcess>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QAtomicInteger>
+#include <QVariantMap>
+#include <QTemporaryDir>
+#include <QDir>
+#include "device_interfaces.h"
+#include "emulator.h"
+
+/*
+	Drives a device plugin against its emulator and reports what the plugin sustained
+
+	The emulator runs as a child process (this executable with --emulate) so the CPU we report is the plugin's
+	and ours, not the emulator's.  The plugin is loaded from the plugins directory, pointed at the emulator with
+	its own settings keys and run through initialize2, Cmd_Connect and Cmd_Start like the receiver would.
+	Plugin reads and writes a scratch copy of PebbleData's .ini files (DeviceInterfaceBase::c_settingsPathEnv),
+	the user's device settings are never written.
+
+	Every second we print the sample rate the plugin delivered, at the end the sustained rate (first second is
+	warm up and not counted), CPU, drops the plugin reported in IQBlocks, gaps in the sample counter, the
+	plugin's health string and the emulator's last stats line.
+	Exit code is 0 if the plugin sustained c_passPercent of the expected rate and, on a clean link, dropped nothing.
+*/
+class IngestHarness : public QObject
+{
+	Q_OBJECT
+public:
+	//_sampleRate 0 for the protocol's max
+	IngestHarness(const EmulatorOptions &_options, quint32 _sampleRate, int _seconds, QObject *_parent = NULL);
+	~IngestHarness();
+
+	//Starts the emulator, false if we can't
+	bool start();
+
+private slots:
+	void emulatorOutput();
+	void emulatorFinished();
+	void emulatorTimeout();
+	void reportProgress();
+	void finish();
+
+private:
+	static const int c_emulatorTimeoutMs = 5000;
+	static const quint32 c_framesPerBuffer = 2048;
+	static constexpr double c_passPercent = 95.0;
+
+	struct DeviceSetup {
+		QString pluginFile;	//TARGET in the plugin's .pro
+		int deviceNumber;
+		QVariantMap settings;
+		quint32 sampleRate; //Rate we expect from the plugin, audio rate for dspserver
+		bool audio;			//Device delivers demodulated audio, not IQ
+	};
+
+	static double processCpuSecs();
+	static QDir appDir();
+	bool copySettings();
+	DeviceSetup deviceSetup();
+	DeviceInterface2 *loadPlugin(QString _pluginFile);
+	bool startDevice();
+	void stopDevice();
+	void exitWith(int _code);
+	void print(QString _line);
+
+	void processIQBlock(const IQBlock &_block);
+	void processAudioData(CPX *_in, quint16 _numSamples);
+	void processBandscopeData(quint8 *_in, quint16 _numPoints);
+
+	EmulatorOptions m_options;
+	quint32 m_sampleRate;
+	int m_seconds;
+	DeviceSetup m_setup;
+
+	QProcess m_emulator;
+	QByteArray m_emulatorOutput; //Partial line
+	QString m_emulatorStats; //Last stats line
+	QTimer m_emulatorTimer;
+
+	DeviceInterface2 *m_device;
+	bool m_deviceRunning;
+	QTemporaryDir m_settingsDir; //Scratch PebbleData the plugin uses, removed when we exit
+
+	QTimer m_progressTimer;
+	QElapsedTimer m_elapsed;
+	int m_progressTicks;
+	qint64 m_lastSamples;
+	//Sustained rate and CPU are measured from the end of the first second
+	qint64 m_warmSamples;
+	qint64 m_warmNs;
+	double m_warmCpuSecs;
+
+	//Written in plugin threads
+	QAtomicInteger<qint64> m_samples;
+	QAtomicInteger<qint64> m_blocks;
+	QAtomicInteger<qint64> m_droppedSamples;	//IQB_DROPPED
+	QAtomicInteger<qint64> m_gapSamples;		//sampleCounter jumps the plugin didn't flag
+	QAtomicInteger<qint64> m_bandscopeFrames;
+	quint64 m_nextSampleCounter;
+	bool m_firstBlock;
+};
+
+#endif // INGESTHARNESS_H
@@ -0,0 +1,136 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include "emulator.h"
+#include "ingestharness.h"
+#include "fastmath.h"
+
+/*
+	SdrEmulator --emulate <protocol> [impairments]
+		Runs a local server for a network device plugin to connect to, see Emulator
+	SdrEmulator --harness <protocol> [--rate sps] [--seconds n] [impairments]
+		Runs the protocol's emulator and drives its device plugin against it, see IngestHarness
+	SdrEmulator --selftest
+		Checks pebblelib's FastMath against libm, exits 1 if any error is over its documented bound
+
+	Protocols: rtltcp (RTL2832 TCP), metis (HPSDR), sdrip (RFSpace SDR-IP), dspserver (ghpsdr3)
+*/
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	app.setApplicationName("SdrEmulator");
+	app.setApplicationVersion("0.0.1");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("SDR Emulator - local device protocol emulators and plugin ingest harness.\n"
+		"Protocols: " + Emulator::protocols().join(", "));
+	parser.addHelpOption();
+	parser.addVersionOption();
+
+	QCommandLineOption emulateArg(QStringList() << "e" << "emulate",
+		QCoreApplication::translate("main", "Run the emulator for protocol"),
+		QCoreApplication::translate("main", "protocol"));
+	parser.addOption(emulateArg);
+
+	QCommandLineOption harnessArg(QStringList() << "t" << "harness",
+		QCoreApplication::translate("main", "Test the protocol's device plugin against its emulator"),
+		QCoreApplication::translate("main", "protocol"));
+	parser.addOption(harnessArg);
+
+	QCommandLineOption portArg(QStringList() << "p" << "port",
+		QCoreApplication::translate("main", "Server port (default is the protocol's usual port)"),
+		QCoreApplication::translate("main", "port"),
+		"0");
+	parser.addOption(portArg);
+
+	QCommandLineOption seedArg(QStringList() << "seed",
+		QCoreApplication::translate("main", "Signal and impairment seed (default 1)"),
+		QCoreApplication::translate("main", "seed"),
+		"1");
+	parser.addOption(seedArg);
+
+	QCommandLineOption lossArg(QStringList() << "loss",
+		QCoreApplication::translate("main", "Percent of datagrams lost"),
+		QCoreApplication::translate("main", "percent"),
+		"0");
+	parser.addOption(lossArg);
+
+	QCommandLineOption reorderArg(QStringList() << "reorder",
+		QCoreApplication::translate("main", "Percent of datagrams delivered late"),
+		QCoreApplication::translate("main", "percent"),
+		"0");
+	parser.addOption(reorderArg);
+
+	QCommandLineOption reorderDepthArg(QStringList() << "reorder-depth",
+		QCoreApplication::translate("main", "Packets a late datagram is delivered after (default 4)"),
+		QCoreApplication::translate("main", "packets"),
+		"4");
+	parser.addOption(reorderDepthArg);
+
+	QCommandLineOption jitterArg(QStringList() << "jitter",
+		QCoreApplication::translate("main", "Random delay of up to ms per packet"),
+		QCoreApplication::translate("main", "ms"),
+		"0");
+	parser.addOption(jitterArg);
+
+	QCommandLineOption burstArg(QStringList() << "burst",
+		QCoreApplication::translate("main", "Deliver packets back to back in groups of n"),
+		QCoreApplication::translate("main", "packets"),
+		"0");
+	parser.addOption(burstArg);
+
+	QCommandLineOption rateArg(QStringList() << "r" << "rate",
+		QCoreApplication::translate("main", "Harness sample rate (default is the protocol's max)"),
+		QCoreApplication::translate("main", "sps"),
+		"0");
+	parser.addOption(rateArg);
+
+	QCommandLineOption secondsArg(QStringList() << "s" << "seconds",
+		QCoreApplication::translate("main", "Harness run time (default 10)"),
+		QCoreApplication::translate("main", "seconds"),
+		"10");
+	parser.addOption(secondsArg);
+
+	QCommandLineOption selfTestArg(QStringList() << "selftest",
+		QCoreApplication::translate("main", "Check FastMath error bounds against libm, exit 1 on failure"));
+	parser.addOption(selfTestArg);
+
+	parser.process(app);
+
+	if (parser.isSet(selfTestArg)) {
+		bool isOk = false;
+		QTextStream(stdout) << FastMath::check(&isOk);
+		return isOk ? 0 : 1;
+	}
+
+	EmulatorOptions options;
+	options.port = parser.value(portArg).toUInt();
+	options.seed = parser.value(seedArg).toULongLong();
+	options.impairments.lossPercent = parser.value(lossArg).toDouble();
+	options.impairments.reorderPercent = parser.value(reorderArg).toDouble();
+	options.impairments.reorderDepth = parser.value(reorderDepthArg).toUInt();
+	options.impairments.jitterMs = parser.value(jitterArg).toDouble();
+	options.impairments.burstPackets = parser.value(burstArg).toUInt();
+
+	if (parser.isSet(emulateArg)) {
+		options.protocol = parser.value(emulateArg);
+		Emulator *emulator = Emulator::create(options, &app);
+		if (emulator == NULL)
+			parser.showHelp(1);
+		if (!emulator->listen()) {
+			QTextStream(stderr) << "Emulator " << options.protocol << " can't listen on port " << emulator->port() << "\n";
+			return 1;
+		}
+		//IngestHarness waits for this line
+		QTextStream(stdout) << "Emulator " << options.protocol << " listening on port " << emulator->port() << "\n";
+		return app.exec();
+	} else if (parser.isSet(harnessArg)) {
+		options.protocol = parser.value(harnessArg);
+		IngestHarness harness(options, parser.value(rateArg).toUInt(), qMax(1, parser.value(secondsArg).toInt()));
+		if (!harness.start())
+			return 1;
+		return app.exec();
+	}
+	parser.showHelp(1);
+	return 1;
+}
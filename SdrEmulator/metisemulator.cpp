@@ -0,0 +1,144 @@
+#include "metisemulator.h"
+#include <QtEndian>
+
+MetisEmulator::MetisEmulator(const EmulatorOptions &_options, QObject *_parent) :
+	Emulator(_options, true, _parent)
+{
+	m_clientPort = 0;
+	m_speedRate = 48000;
+	m_sequence = 0;
+	connect(&m_socket, &QUdpSocket::readyRead, this, &MetisEmulator::newDatagrams);
+}
+
+bool MetisEmulator::listen()
+{
+	if (!m_socket.bind(QHostAddress::AnyIPv4, m_port))
+		return false;
+	//Metis at max speed is 3000+ datagrams a second, give the kernel room for a burst
+	m_socket.setSocketOption(QAbstractSocket::SendBufferSizeSocketOption, 4000000);
+	return true;
+}
+
+void MetisEmulator::newDatagrams()
+{
+	QByteArray datagram;
+	QHostAddress sender;
+	quint16 senderPort;
+	while (m_socket.hasPendingDatagrams()) {
+		datagram.resize(m_socket.pendingDatagramSize());
+		m_socket.readDatagram(datagram.data(), datagram.size(), &sender, &senderPort);
+		processDatagram(datagram, sender, senderPort);
+	}
+}
+
+void MetisEmulator::processDatagram(const QByteArray &_datagram, const QHostAddress &_sender, quint16 _senderPort)
+{
+	const quint8 *data = (const quint8 *)_datagram.constData();
+	if (_datagram.size() < 4 || data[0] != 0xEF || data[1] != 0xFE)
+		return;
+
+	switch (data[2]) {
+		case 0x02: {
+			//Discovery, <0xEFFE><0x02 not sending data><MAC><Code Version><Board_ID 0x00 Metis><49 bytes of 0x00>
+			QByteArray response(60, 0);
+			quint8 *r = (quint8 *)response.data();
+			r[0] = 0xEF;
+			r[1] = 0xFE;
+			r[2] = isStreaming() ? 0x03 : 0x02;
+			r[3] = 0x00;
+			r[4] = 0x1c;
+			r[5] = 0xc0;
+			r[6] = 0xa2;
+			r[7] = 0x13;
+			r[8] = 0x6d;
+			r[9] = 26; //2.6
+			r[10] = 0x00;
+			m_socket.writeDatagram(response, _sender, _senderPort);
+			break;
+		}
+		case 0x04:
+			//Start/Stop, bit 0 of command is IQ data
+			if (data[3] & 0x01) {
+				m_clientAddress = _sender;
+				m_clientPort = _senderPort;
+				m_sequence = 0;
+				startStream(m_speedRate, c_samplesPerPacket);
+			} else {
+				stopStream();
+			}
+			break;
+		case 0x01:
+			//EP2 command and control, sequence number, 2 x 512 byte frames
+			if (data[3] != 0x02 || _datagram.size() < (int)c_packetSize)
+				return;
+			processControl(&data[8]);
+			processControl(&data[8 + 512]);
+			break;
+		default:
+			break;
+	}
+}
+
+void MetisEmulator::processControl(const quint8 *_frame)
+{
+	if (_frame[0] != 0x7f || _frame[1] != 0x7f || _frame[2] != 0x7f)
+		return;
+	//C0 address 0 is the config frame, C1 bits 0-1 are speed
+	if ((_frame[3] & 0xfe) != 0)
+		return;
+	quint32 rate = 48000 << (_frame[4] & 0x03);
+	if (rate == m_speedRate)
+		return;
+	m_speedRate = rate;
+	if (isStreaming())
+		startStream(m_speedRate, c_samplesPerPacket);
+}
+
+void MetisEmulator::fillFrame(quint8 *_frame, const float *_iq)
+{
+	_frame[0] = 0x7f;
+	_frame[1] = 0x7f;
+	_frame[2] = 0x7f;
+	//C0 = 0 status, C1-C4 ADC overflow, Mercury, Penelope, Metis versions
+	_frame[3] = 0x00;
+	_frame[4] = 0x00;
+	_frame[5] = 33;
+	_frame[6] = 255; //No Penelope
+	_frame[7] = 26;
+	quint8 *s = &_frame[8];
+	for (quint32 i = 0; i < c_samplesPerFrame * 2; i += 2) {
+		qint32 iValue = _iq[i] * 8388607.0f;
+		qint32 qValue = _iq[i + 1] * 8388607.0f;
+		*s++ = iValue >> 16;
+		*s++ = iValue >> 8;
+		*s++ = iValue;
+		*s++ = qValue >> 16;
+		*s++ = qValue >> 8;
+		*s++ = qValue;
+		*s++ = 0; //Mic
+		*s++ = 0;
+	}
+}
+
+void MetisEmulator::producePacket()
+{
+	QByteArray packet(c_packetSize, 0);
+	quint8 *p = (quint8 *)packet.data();
+	p[0] = 0xEF;
+	p[1] = 0xFE;
+	p[2] = 0x01;
+	p[3] = 0x06;
+	qToBigEndian<quint32>(m_sequence++, &p[4]);
+	generate(m_iq, IQF_CPXFLOAT, c_samplesPerPacket);
+	fillFrame(&p[8], m_iq);
+	fillFrame(&p[8 + 512], &m_iq[c_samplesPerFrame * 2]);
+	m_link->send(packet);
+}
+
+void MetisEmulator::deliver(const QByteArray &_packet)
+{
+	if (m_clientPort == 0)
+		return;
+	if (m_socket.writeDatagram(_packet, m_clientAddress, m_clientPort) < 0)
+		m_serverDrops++;
+}
@@ -0,0 +1,47 @@
+#ifndef METISEMULATOR_H
+#define METISEMULATOR_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include <QUdpSocket>
+#include "emulator.h"
+
+/*
+	HPSDR Metis, what HPSDRDevice connects to with Metis discovery or a fixed Metis address
+
+	Answers discovery, starts and stops on the 0x04 command and picks up the receive speed from C1 of the
+	C0 = 0 frames in the EP2 datagrams the client sends.  IQ goes back to whoever sent the start command as
+	1032 byte EP6 datagrams, two 512 byte frames of 63 24 bit I/Q samples each.
+*/
+class MetisEmulator : public Emulator
+{
+	Q_OBJECT
+public:
+	MetisEmulator(const EmulatorOptions &_options, QObject *_parent = NULL);
+
+	bool listen();
+
+protected:
+	void producePacket();
+	void deliver(const QByteArray &_packet);
+
+private slots:
+	void newDatagrams();
+
+private:
+	static const quint32 c_samplesPerFrame = 63;
+	static const quint32 c_samplesPerPacket = c_samplesPerFrame * 2;
+	static const quint32 c_packetSize = 1032;
+
+	void processDatagram(const QByteArray &_datagram, const QHostAddress &_sender, quint16 _senderPort);
+	void processControl(const quint8 *_frame);
+	void fillFrame(quint8 *_frame, const float *_iq);
+
+	QUdpSocket m_socket;
+	QHostAddress m_clientAddress;
+	quint16 m_clientPort;
+	quint32 m_speedRate; //From the last C1 speed bits
+	quint32 m_sequence;
+	float m_iq[c_samplesPerPacket * 2];
+};
+
+#endif // METISEMULATOR_H
@@ -0,0 +1,87 @@
+#include "rtltcpemulator.h"
+#include <QtEndian>
+
+RtlTcpEmulator::RtlTcpEmulator(const EmulatorOptions &_options, QObject *_parent) :
+	Emulator(_options, false, _parent)
+{
+	m_socket = NULL;
+	m_frequency = 100000000;
+	connect(&m_server, &QTcpServer::newConnection, this, &RtlTcpEmulator::newConnection);
+}
+
+bool RtlTcpEmulator::listen()
+{
+	//One client at a time, same as rtl_tcp
+	m_server.setMaxPendingConnections(1);
+	return m_server.listen(QHostAddress::AnyIPv4, m_port);
+}
+
+void RtlTcpEmulator::newConnection()
+{
+	QTcpSocket *socket = m_server.nextPendingConnection();
+	if (m_socket != NULL) {
+		socket->close();
+		socket->deleteLater();
+		return;
+	}
+	m_socket = socket;
+	m_socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+	connect(m_socket, &QTcpSocket::readyRead, this, &RtlTcpEmulator::newData);
+	connect(m_socket, &QTcpSocket::disconnected, this, &RtlTcpEmulator::closeConnection);
+	m_command.clear();
+
+	//"RTL0", tuner type (5 = R820T) and tuner gain count, big endian
+	char dongleInfo[12] = {'R', 'T', 'L', '0'};
+	qToBigEndian<quint32>(5, (uchar *)&dongleInfo[4]);
+	qToBigEndian<quint32>(29, (uchar *)&dongleInfo[8]);
+	m_socket->write(dongleInfo, sizeof(dongleInfo));
+
+	//rtl_tcp doesn't wait for a start command
+	startStream(c_defaultSampleRate, c_samplesPerPacket);
+}
+
+void RtlTcpEmulator::closeConnection()
+{
+	stopStream();
+	m_socket->deleteLater();
+	m_socket = NULL;
+}
+
+void RtlTcpEmulator::newData()
+{
+	m_command.append(m_socket->readAll());
+	while (m_command.size() >= 5) {
+		quint8 cmd = m_command[0];
+		quint32 param = qFromBigEndian<quint32>((const uchar *)m_command.constData() + 1);
+		m_command.remove(0, 5);
+		switch (cmd) {
+			case CMD_FREQ:
+				m_frequency = param;
+				break;
+			case CMD_SAMPLERATE:
+				if (param > 0 && param <= c_maxSampleRate && param != sampleRate())
+					startStream(param, c_samplesPerPacket);
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+void RtlTcpEmulator::producePacket()
+{
+	QByteArray packet(c_samplesPerPacket * sizeof(CPXU8), 0);
+	generate(packet.data(), IQF_CPXU8, c_samplesPerPacket);
+	m_link->send(packet);
+}
+
+void RtlTcpEmulator::deliver(const QByteArray &_packet)
+{
+	if (m_socket == NULL)
+		return;
+	if (m_socket->bytesToWrite() > (qint64)c_maxQueuedPackets * _packet.size()) {
+		m_serverDrops++;
+		return;
+	}
+	m_socket->write(_packet);
+}
@@ -0,0 +1,46 @@
+#ifndef RTLTCPEMULATOR_H
+#define RTLTCPEMULATOR_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include <QTcpServer>
+#include <QTcpSocket>
+#include "emulator.h"
+
+/*
+	rtl_tcp server, what RTL2832SDRDevice connects to as RTL2832 TCP
+
+	Sends the 12 byte dongle info on connect and then streams 8 bit unsigned I/Q immediately, same as rtl_tcp.
+	5 byte commands (u8 command, big endian u32 param) set frequency and sample rate, the rest are accepted and ignored.
+	rtl_tcp keeps c_maxQueuedPackets buffers for a slow client and drops after that, so do we.
+*/
+class RtlTcpEmulator : public Emulator
+{
+	Q_OBJECT
+public:
+	RtlTcpEmulator(const EmulatorOptions &_options, QObject *_parent = NULL);
+
+	bool listen();
+
+protected:
+	void producePacket();
+	void deliver(const QByteArray &_packet);
+
+private slots:
+	void newConnection();
+	void newData();
+	void closeConnection();
+
+private:
+	enum COMMANDS {CMD_FREQ=0x01, CMD_SAMPLERATE=0x02};
+	static const quint32 c_defaultSampleRate = 2048000;
+	static const quint32 c_maxSampleRate = 3200000;
+	static const quint32 c_samplesPerPacket = 8192; //16K bytes, rtl_tcp's default read size
+	static const int c_maxQueuedPackets = 500; //rtl_tcp llbuf_num
+
+	QTcpServer m_server;
+	QTcpSocket *m_socket;
+	QByteArray m_command; //Bytes of a command we haven't got all of yet
+	quint32 m_frequency;
+};
+
+#endif // RTLTCPEMULATOR_H
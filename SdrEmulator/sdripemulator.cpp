@@ -0,0 +1,167 @@
+#include "sdripemulator.h"
+#include <QtEndian>
+
+SdrIpEmulator::SdrIpEmulator(const EmulatorOptions &_options, QObject *_parent) :
+	Emulator(_options, true, _parent)
+{
+	m_socket = NULL;
+	m_iqSampleRate = c_defaultSampleRate;
+	m_sequence = 0;
+	connect(&m_server, &QTcpServer::newConnection, this, &SdrIpEmulator::newConnection);
+}
+
+bool SdrIpEmulator::listen()
+{
+	m_server.setMaxPendingConnections(1);
+	if (!m_server.listen(QHostAddress::AnyIPv4, m_port))
+		return false;
+	//Data goes out from any port, the client only listens on the control port number
+	if (!m_udpSocket.bind(QHostAddress::AnyIPv4, 0))
+		return false;
+	//2msps is almost 8000 datagrams a second, give the kernel room for a burst
+	m_udpSocket.setSocketOption(QAbstractSocket::SendBufferSizeSocketOption, 4000000);
+	return true;
+}
+
+void SdrIpEmulator::newConnection()
+{
+	QTcpSocket *socket = m_server.nextPendingConnection();
+	if (m_socket != NULL) {
+		socket->close();
+		socket->deleteLater();
+		return;
+	}
+	m_socket = socket;
+	m_clientAddress = QHostAddress(m_socket->peerAddress().toIPv4Address());
+	m_control.clear();
+	connect(m_socket, &QTcpSocket::readyRead, this, &SdrIpEmulator::newData);
+	connect(m_socket, &QTcpSocket::disconnected, this, &SdrIpEmulator::closeConnection);
+}
+
+void SdrIpEmulator::closeConnection()
+{
+	stopStream();
+	m_socket->deleteLater();
+	m_socket = NULL;
+}
+
+void SdrIpEmulator::newData()
+{
+	m_control.append(m_socket->readAll());
+	while (m_control.size() >= 2) {
+		//13 bit length including the 2 header bytes, 3 bit type
+		const quint8 *h = (const quint8 *)m_control.constData();
+		quint16 length = h[0] | ((h[1] & 0x1f) << 8);
+		quint8 type = h[1] >> 5;
+		if (length < 2) {
+			//Nothing sensible to do with a zero length item from a client, resync on whatever comes next
+			m_control.clear();
+			return;
+		}
+		if (m_control.size() < length)
+			return;
+		QByteArray item = m_control.left(length);
+		m_control.remove(0, length);
+		if (length >= 4)
+			processItem(type, qFromLittleEndian<quint16>((const uchar *)item.constData() + 2), item);
+	}
+}
+
+void SdrIpEmulator::processItem(quint8 _type, quint16 _itemCode, const QByteArray &_item)
+{
+	const quint8 *data = (const quint8 *)_item.constData() + 4;
+	int dataLength = _item.size() - 4;
+	QByteArray response;
+
+	if (_type == 0x01) {
+		//Request current value
+		switch (_itemCode) {
+			case 0x0001: //Target name
+				sendResponse(_itemCode, QByteArray("SDR-IP", 7));
+				return;
+			case 0x0002: //Serial number
+				sendResponse(_itemCode, QByteArray("EM000001", 9));
+				return;
+			case 0x0003: //Interface version
+				response.resize(2);
+				qToLittleEndian<quint16>(109, (uchar *)response.data());
+				sendResponse(_itemCode, response);
+				return;
+			case 0x0004: //Boot (0) or firmware (1) version
+				response.resize(3);
+				response[0] = dataLength > 0 ? data[0] : 0;
+				qToLittleEndian<quint16>(response[0] == 0 ? 104 : 107, (uchar *)response.data() + 1);
+				sendResponse(_itemCode, response);
+				return;
+			case 0x0005: //Status, idle or busy
+				sendResponse(_itemCode, QByteArray(1, isStreaming() ? 0x0c : 0x0b));
+				return;
+			default:
+				break;
+		}
+	} else if (_type == 0x00) {
+		//Set, the radio echoes set items back
+		switch (_itemCode) {
+			case 0x0018: //Receiver state, data[1] 0x02 run, 0x01 idle
+				if (dataLength >= 2) {
+					if (data[1] == 0x02) {
+						m_sequence = 0;
+						startStream(m_iqSampleRate, c_samplesPerPacket);
+					} else {
+						stopStream();
+					}
+				}
+				break;
+			case 0x00b8: //IQ output sample rate, data[0] is channel
+				if (dataLength >= 5) {
+					quint32 rate = qFromLittleEndian<quint32>(data + 1);
+					if (rate > 0 && rate <= c_maxSampleRate) {
+						m_iqSampleRate = rate;
+						if (isStreaming())
+							startStream(m_iqSampleRate, c_samplesPerPacket);
+					}
+				}
+				break;
+			default:
+				break;
+		}
+		m_socket->write(_item);
+		return;
+	}
+	//NAK
+	m_socket->write(QByteArray("\x02\x00", 2));
+}
+
+void SdrIpEmulator::sendResponse(quint16 _itemCode, const QByteArray &_data)
+{
+	quint16 length = 4 + _data.size();
+	QByteArray response(4, 0);
+	response[0] = length & 0xff;
+	response[1] = (length >> 8) & 0x1f; //Type 0, response to request
+	qToLittleEndian<quint16>(_itemCode, (uchar *)response.data() + 2);
+	response.append(_data);
+	m_socket->write(response);
+}
+
+void SdrIpEmulator::producePacket()
+{
+	QByteArray packet(4 + c_samplesPerPacket * sizeof(CPX16), 0);
+	quint8 *p = (quint8 *)packet.data();
+	//Data item 0, length 1028
+	p[0] = 0x04;
+	p[1] = 0x84;
+	qToLittleEndian<quint16>(m_sequence, &p[2]);
+	//First datagram is 0, after that 1 to 65535
+	if (++m_sequence == 0)
+		m_sequence = 1;
+	generate(&p[4], IQF_CPX16, c_samplesPerPacket);
+	m_link->send(packet);
+}
+
+void SdrIpEmulator::deliver(const QByteArray &_packet)
+{
+	if (m_socket == NULL)
+		return;
+	if (m_udpSocket.writeDatagram(_packet, m_clientAddress, m_port) < 0)
+		m_serverDrops++;
+}
@@ -0,0 +1,52 @@
+#ifndef SDRIPEMULATOR_H
+#define SDRIPEMULATOR_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QUdpSocket>
+#include "emulator.h"
+
+/*
+	RFSpace SDR-IP, what RFSpaceDevice connects to as SDR-IP
+
+	Control items come in over TCP: set items are echoed back like the real radio, requests for name, serial,
+	interface and firmware versions and status are answered, anything else gets a NAK.
+	Run (item 0x18) starts 16 bit I/Q to the client's address on the control port as 1028 byte UDP data items,
+	256 samples each with a little endian sequence number that skips 0 when it wraps.
+*/
+class SdrIpEmulator : public Emulator
+{
+	Q_OBJECT
+public:
+	SdrIpEmulator(const EmulatorOptions &_options, QObject *_parent = NULL);
+
+	bool listen();
+
+protected:
+	void producePacket();
+	void deliver(const QByteArray &_packet);
+
+private slots:
+	void newConnection();
+	void newData();
+	void closeConnection();
+
+private:
+	static const quint32 c_defaultSampleRate = 196078;
+	static const quint32 c_maxSampleRate = 2000000;
+	static const quint32 c_samplesPerPacket = 256;
+
+	void processItem(quint8 _type, quint16 _itemCode, const QByteArray &_item);
+	void sendResponse(quint16 _itemCode, const QByteArray &_data);
+
+	QTcpServer m_server;
+	QTcpSocket *m_socket;
+	QUdpSocket m_udpSocket;
+	QByteArray m_control; //Control bytes we haven't got a whole item of yet
+	QHostAddress m_clientAddress;
+	quint32 m_iqSampleRate; //Set by item 0xB8
+	quint16 m_sequence;
+};
+
+#endif // SDRIPEMULATOR_H
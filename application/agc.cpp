@@ -15,6 +15,17 @@ Initial Gain: 1
 AGC::AGC(quint32 _sampleRate, quint32 _bufferSize):ProcessStep(_sampleRate,_bufferSize)
 {
 	m_agcDelay = NULL;
+	//Largest sub-block that divides the buffer, buffers are normally a power of 2
+	m_subBlockSamples = SUB_BLOCK_SAMPLES;
+	while (numSamples % m_subBlockSamples != 0)
+		m_subBlockSamples /= 2;
+	m_lookAheadMs = DEFAULT_LOOKAHEAD_MS;
+	m_pendingLookAheadMs.store(-1);
+	m_delaySamples = 0;
+	m_windowBlocks = 0;
+	m_magBufPos = 0;
+	m_peak = -16.0;
+	m_lastGain = 1.0;
 
 
     //cuteSDR
@@ -22,7 +33,17 @@ AGC::AGC(quint32 _sampleRate, quint32 _bufferSize):ProcessStep(_sampleRate,_buff
 	m_threshold = 0;
 	m_slopeFactor = 0;
 	m_decay = 0;
-	m_sampleRate = 100.0; //Trigger init on first call to setup
+	//sampleRate doesn't change in Pebble, a new AGC is built at each power on
+	//Delay line and averager state are set here, not in setParameters() which runs on the UI thread
+	m_sampleRate = sampleRate;
+	for (int i=0; i<MAX_DELAY_BUF; i++) {
+		m_sigDelayBuf[i].real(0.0);
+		m_sigDelayBuf[i].imag(0.0);
+		m_magBuf[i] = -16.0;
+	}
+	m_hangTimer = 0;
+	m_decayAvg = -5.0;
+	m_attackAvg = -5.0;
 
 	uiSliderValueDb = 0;
 	setAgcMode(AGC_OFF, 1);
@@ -83,6 +104,10 @@ void AGC::setAgcMode(AgcMode m, int threshold)
 
 CPX* AGC::processBlock(CPX *pInData)
 {
+	int lookAheadMs = m_pendingLookAheadMs.fetchAndStoreAcquire(-1);
+	if (lookAheadMs >= 0)
+		applyLookAhead(lookAheadMs);
+
 	if (m_agcMode == AGC_OFF) {
         //manual gain just multiply by m_ManualGain
         for(int i=0; i<numSamples; i++)
@@ -93,117 +118,155 @@ CPX* AGC::processBlock(CPX *pInData)
         return out;
     }
 
-    double gain;
-    double mag;
-    CPX delayedin;
-    //m_Mutex.lock();
-    for(int i=0; i<numSamples; i++)
-    {
-        CPX in = pInData[i];	//get latest input sample
-        //Get delayed sample of input signal
-		delayedin = m_sigDelayBuf[m_sigDelayPtr];
-        //put new input sample into signal delay buffer
-		m_sigDelayBuf[m_sigDelayPtr++] = in;
-		if( m_sigDelayPtr >= m_delaySamples)	//deal with delay buffer wrap around
-			m_sigDelayPtr = 0;
-
-        //double dmag = 0.5* log10(  (dsig.real()*dsig.real()+dsig.imag()*dsig.imag())/(MAX_AMPLITUDE*MAX_AMPLITUDE) + 1e-16);	//clamped to -160dBfs
-        //pOutData[i].real(3000*dmag);
-#if 1
-        mag = fabs(in.real());
-        double mim = fabs(in.imag());
-        if(mim>mag)
-            mag = mim;
-        mag = log10( mag + MIN_CONSTANT ) - log10(MAX_AMPLITUDE);		//0==max  -8 is min==-160dB
-#else
-        mag = in.real()*in.real()+in.imag()*in.imag();
-        //mag is power so 0.5 factor takes square root of power
-        mag = 0.5* log10( mag/(MAX_AMPLITUDE*MAX_AMPLITUDE) + 1e-16);	//clamped to -160dBfs
-#endif
-        //pOutData[i].real(3000*mag);
-        //pOutData[i].real(1500*log10( ((delayedin.real()*delayedin.real())+(delayedin.imag()*delayedin.imag()))/(MAX_AMPLITUDE*MAX_AMPLITUDE) + 1e-16););
+	//Block structured version of the cuteSDR algorithm
+	//Input is delayed by the look ahead, m_delaySamples, and the envelope of each sub-block of new input sets the gain
+	//for the delayed sub-block going out.  Peak window, averagers and gain are updated once per sub-block in the
+	//log domain, the gain is ramped across the sub-block.  Time constants are scaled in setParameters() so modes,
+	//threshold and hang time mean the same as they did per sample
+	int n = m_subBlockSamples;
+	int d = m_delaySamples;
+	if (d <= numSamples) {
+		copyCPX(out, m_sigDelayBuf, d);
+		copyCPX(&out[d], pInData, numSamples - d);
+		copyCPX(m_sigDelayBuf, &pInData[numSamples - d], d);
+	} else {
+		copyCPX(out, m_sigDelayBuf, numSamples);
+		memmove(m_sigDelayBuf, &m_sigDelayBuf[numSamples], sizeof(CPX) * (d - numSamples));
+		copyCPX(&m_sigDelayBuf[d - numSamples], pInData, numSamples);
+	}
+
+	double mag;
+	for (int block = 0; block < numSamples; block += n) {
+		//SIMD peak of max(|re|,|im|), one log per sub-block instead of one per sample
+		mag = FastMath::log10(FastMath::maxAbs(&pInData[block], n) + MIN_CONSTANT) - log10(MAX_AMPLITUDE); //0==max  -8 is min==-160dB
 
-        //create a sliding window of 'm_WindowSamples' magnitudes and output the peak value within the sliding window
-		double tmp = m_magBuf[m_magBufPos];	//get oldest mag sample from buffer into tmp
-		m_magBuf[m_magBufPos++] = mag;			//put latest mag sample in buffer;
-		if( m_magBufPos >= m_windowSamples)		//deal with magnitude buffer wrap around
+		//create a sliding window of 'm_windowBlocks' magnitudes and output the peak value within the sliding window
+		double tmp = m_magBuf[m_magBufPos];	//get oldest mag from buffer into tmp
+		m_magBuf[m_magBufPos++] = mag;			//put latest mag in buffer;
+		if( m_magBufPos >= m_windowBlocks)		//deal with magnitude buffer wrap around
 			m_magBufPos = 0;
 		if(mag > m_peak)
-        {
+		{
 			m_peak = mag;	//if new sample is larger than current peak then use it, no need to look at buffer values
-        }
-        else
-        {
+		}
+		else
+		{
 			if(tmp == m_peak)		//tmp is oldest sample pulled out of buffer
-            {	//if oldest sample pulled out was last peak then need to find next highest peak in buffer
+			{	//if oldest sample pulled out was last peak then need to find next highest peak in buffer
 				m_peak = -8.0;		//set to lowest value to find next max peak
-                //search all buffer for maximum value and set as new peak
-				for(int i=0; i<m_windowSamples; i++)
-                {
+				//search all buffer for maximum value and set as new peak
+				for(int i=0; i<m_windowBlocks; i++)
+				{
 					tmp = m_magBuf[i];
 					if(tmp > m_peak)
 						m_peak = tmp;
-                }
-            }
-        }
-
-        //pOutData[i].imag(3000*m_Peak);
+				}
+			}
+		}
 
 		if(m_useHang)
-        {	//using hang timer mode
+		{	//using hang timer mode
 			if(m_peak>m_attackAvg)	//if power is rising (use m_AttackRiseAlpha time constant)
 				m_attackAvg = (1.0-m_attackRiseAlpha)*m_attackAvg + m_attackRiseAlpha*m_peak;
-            else					//else magnitude is falling (use  m_AttackFallAlpha time constant)
+			else					//else magnitude is falling (use  m_AttackFallAlpha time constant)
 				m_attackAvg = (1.0-m_attackFallAlpha)*m_attackAvg + m_attackFallAlpha*m_peak;
 
 			if(m_peak>m_decayAvg)	//if magnitude is rising (use m_DecayRiseAlpha time constant)
-            {
+			{
 				m_decayAvg = (1.0-m_decayRiseAlpha)*m_decayAvg + m_decayRiseAlpha*m_peak;
 				m_hangTimer = 0;	//reset hang timer
-            }
-            else
-            {	//here if decreasing signal
+			}
+			else
+			{	//here if decreasing signal
 				if(m_hangTimer<m_hangTime)
-					m_hangTimer++;	//just inc and hold current m_DecayAve
-                else	//else decay with m_DecayFallAlpha which is RELEASE_TIMECONST
+					m_hangTimer += n;	//just inc and hold current m_DecayAve, hang time is still in samples
+				else	//else decay with m_DecayFallAlpha which is RELEASE_TIMECONST
 					m_decayAvg = (1.0-m_decayFallAlpha)*m_decayAvg + m_decayFallAlpha*m_peak;
-            }
-        }
-        else
-        {	//using exponential decay mode
-            // perform average of magnitude using 2 averagers each with separate rise and fall time constants
+			}
+		}
+		else
+		{	//using exponential decay mode
+			// perform average of magnitude using 2 averagers each with separate rise and fall time constants
 			if(m_peak>m_attackAvg)	//if magnitude is rising (use m_AttackRiseAlpha time constant)
 				m_attackAvg = (1.0-m_attackRiseAlpha)*m_attackAvg + m_attackRiseAlpha*m_peak;
-            else					//else magnitude is falling (use  m_AttackFallAlpha time constant)
+			else					//else magnitude is falling (use  m_AttackFallAlpha time constant)
 				m_attackAvg = (1.0-m_attackFallAlpha)*m_attackAvg + m_attackFallAlpha*m_peak;
 
-            //pOutData[i].imag(3000*m_AttackAve);
 			if(m_peak>m_decayAvg)	//if magnitude is rising (use m_DecayRiseAlpha time constant)
 				m_decayAvg = (1.0-m_decayRiseAlpha)*m_decayAvg + m_decayRiseAlpha*(m_peak);
-            else					//else magnitude is falling (use m_DecayFallAlpha time constant)
+			else					//else magnitude is falling (use m_DecayFallAlpha time constant)
 				m_decayAvg = (1.0-m_decayFallAlpha)*m_decayAvg + m_decayFallAlpha*(m_peak);
-            //pOutData[i].imag(3000*m_DecayAve);
-        }
-        //use greater magnitude of attack or Decay Averager
+		}
+		//use greater magnitude of attack or Decay Averager
 		if(m_attackAvg>m_decayAvg)
 			mag = m_attackAvg;
-        else
+		else
 			mag = m_decayAvg;
 
-        //pOutData[i].imag(3000*mag);
-        //calc gain depending on which side of knee the magnitude is on
+		//calc gain depending on which side of knee the magnitude is on
+		//Fixed gain below the knee is the knee's gain, m_fixedGain
 		if(mag<=m_knee)		//use fixed gain if below knee
-			gain = m_fixedGain;
-        else				//use variable gain if above knee
-			gain = AGC_OUTSCALE * pow(10.0, mag*(m_gainSlope - 1.0) );
-        //pOutData[i].real(.5*gain);
-        out[i].real(delayedin.real() * gain);
-        out[i].imag(delayedin.imag() * gain);
-    }
+			mag = m_knee;
+		double gain = AGC_OUTSCALE * FastMath::exp10(mag*(m_gainSlope - 1.0));
+
+		//Ramp from the last sub-block's gain so a change doesn't click
+		double step = (gain - m_lastGain) / n;
+		CPX *blockOut = &out[block];
+		for (int i = 0; i < n; i++) {
+			double g = m_lastGain + step * (i + 1);
+			blockOut[i].real(blockOut[i].real() * g);
+			blockOut[i].imag(blockOut[i].imag() * g);
+		}
+		m_lastGain = gain;
+	}
 
-        //m_Mutex.unlock();
+	return out;
+}
 
-    return out;
+void AGC::setLookAhead(int _ms)
+{
+	m_lookAheadMs = qMax(0, _ms);
+	//UI thread changes mode and threshold while processBlock() is using the delay line
+	m_pendingLookAheadMs.storeRelease(m_lookAheadMs);
+}
+
+//DSP thread
+void AGC::applyLookAhead(int _ms)
+{
+	int delaySamples = (int)(sampleRate * _ms * .001);
+	//Gain ramps over a sub-block, anything shorter than 2 can't get the gain down before a new peak goes out
+	if (delaySamples < 2 * m_subBlockSamples)
+		delaySamples = 2 * m_subBlockSamples;
+	//clamp Delay samples within buffer limit
+	if (delaySamples >= MAX_DELAY_BUF - 1)
+		delaySamples = MAX_DELAY_BUF - 1;
+
+	//Keep what's in the delay line so changing modes doesn't drop audio
+	if (delaySamples < m_delaySamples) {
+		//Drop oldest
+		memmove(m_sigDelayBuf, &m_sigDelayBuf[m_delaySamples - delaySamples], sizeof(CPX) * delaySamples);
+	} else if (delaySamples > m_delaySamples) {
+		//Pad oldest with silence
+		memmove(&m_sigDelayBuf[delaySamples - m_delaySamples], m_sigDelayBuf, sizeof(CPX) * m_delaySamples);
+		clearCPX(m_sigDelayBuf, delaySamples - m_delaySamples);
+	}
+	m_delaySamples = delaySamples;
+
+	//Attack has to charge up within the look ahead or the first part of a strong signal overshoots
+	double lookAheadSecs = _ms * .001;
+	double attackRise = qMax(ATTACK_RISE_TIMECONST * qMin(1.0, lookAheadSecs / DELAY_TIMECONST), 1.0 / sampleRate);
+	m_attackRiseAlpha = (1.0-exp(-m_subBlockSamples/(sampleRate * attackRise)) );
+
+	//Peak window has to cover the look ahead so gain stays down until the peak has gone out
+	double windowSecs = lookAheadSecs + (WINDOW_TIMECONST - DELAY_TIMECONST);
+	int windowBlocks = qBound(1, (int)ceil(sampleRate * windowSecs / m_subBlockSamples), MAX_DELAY_BUF);
+	if (windowBlocks != m_windowBlocks) {
+		//Current peak fills the new window and ages out normally
+		for (int i = 0; i < windowBlocks; i++)
+			m_magBuf[i] = m_peak;
+		m_magBufPos = 0;
+		m_windowBlocks = windowBlocks;
+	}
 }
 
 /*
@@ -261,23 +324,6 @@ void AGC::setParameters(bool useHang, int threshold, int slopeFactor, int decay)
 	m_threshold = threshold;
 	m_slopeFactor = slopeFactor;
 	m_decay = decay;
-    //sampleRate doesn't change in Pebble, call once to init
-	if(	m_sampleRate != sampleRate)
-    {	//clear out delay buffer and init some things if sample rate changes
-		m_sampleRate = sampleRate;
-        for(int i=0; i<MAX_DELAY_BUF; i++)
-        {
-			m_sigDelayBuf[i].real(0.0);
-			m_sigDelayBuf[i].imag(0.0);
-			m_magBuf[i] = -16.0;
-        }
-		m_sigDelayPtr = 0;
-		m_hangTimer = 0;
-		m_peak = -16.0;
-		m_decayAvg = -5.0;
-		m_attackAvg = -5.0;
-		m_magBufPos = 0;
-    }
 
     //calculate parameters for AGC gain as a function of input magnitude
 	m_knee = (double)m_threshold/20.0;
@@ -287,23 +333,21 @@ void AGC::setParameters(bool useHang, int threshold, int slopeFactor, int decay)
 //qDebug()<<"m_Knee = "<<m_Knee<<" m_GainSlope = "<<m_GainSlope<< "m_FixedGain = "<<m_FixedGain;
 
     //calculate fast and slow filter values.
-	m_attackRiseAlpha = (1.0-exp(-1.0/(m_sampleRate*ATTACK_RISE_TIMECONST)) );
-	m_attackFallAlpha = (1.0-exp(-1.0/(m_sampleRate*ATTACK_FALL_TIMECONST)) );
+	//Averagers run once per sub-block, 1-(1-alpha)^n is the same response as n per sample updates
+	double n = m_subBlockSamples;
+	//m_attackRiseAlpha depends on look ahead, set on the DSP thread by applyLookAhead()
+	m_attackFallAlpha = (1.0-exp(-n/(m_sampleRate*ATTACK_FALL_TIMECONST)) );
 
-	m_decayRiseAlpha = (1.0-exp(-1.0/(m_sampleRate * (double)m_decay*.001*DECAY_RISEFALL_RATIO)) );	//make rise time DECAY_RISEFALL_RATIO of fall
+	m_decayRiseAlpha = (1.0-exp(-n/(m_sampleRate * (double)m_decay*.001*DECAY_RISEFALL_RATIO)) );	//make rise time DECAY_RISEFALL_RATIO of fall
 	m_hangTime = (int)(m_sampleRate * (double)m_decay * .001);
 
 	if(m_useHang)
-		m_decayFallAlpha = (1.0-exp(-1.0/(m_sampleRate * RELEASE_TIMECONST)) );
+		m_decayFallAlpha = (1.0-exp(-n/(m_sampleRate * RELEASE_TIMECONST)) );
     else
-		m_decayFallAlpha = (1.0-exp(-1.0/(m_sampleRate * (double)m_decay *.001)) );
-
-	m_delaySamples = (int)(m_sampleRate*DELAY_TIMECONST);
-	m_windowSamples = (int)(m_sampleRate*WINDOW_TIMECONST);
+		m_decayFallAlpha = (1.0-exp(-n/(m_sampleRate * (double)m_decay *.001)) );
 
-    //clamp Delay samples within buffer limit
-	if(m_delaySamples >= MAX_DELAY_BUF-1)
-		m_delaySamples = MAX_DELAY_BUF-1;
+	m_lastGain = m_fixedGain;
+	setLookAhead(m_lookAheadMs);
 
     //m_Mutex.unlock();
 }
@@ -3,12 +3,17 @@
 #include "gpl.h"
 #include "processstep.h"
 #include "delayline.h"
+#include "fastmath.h"
+#include <QAtomicInteger>
 
 class AGC :
 	public ProcessStep
 {
 public:
 	enum AgcMode {AGC_OFF, ACG_FAST, AGC_MED, AGC_SLOW, AGC_LONG};
+	//Look ahead, ms.  CW is short so keying stays tight, default covers the bandpass filter's impulse response
+	static const int CW_LOOKAHEAD_MS = 5;
+	static const int DEFAULT_LOOKAHEAD_MS = 15;
 
 	AGC(quint32 _sampleRate, quint32 _bufferSize);
 	~AGC(void);
@@ -17,6 +22,10 @@ public:
     int getAgcThreshold();
 
 	CPX * processBlock(CPX *in);
+	//How far the gain looks ahead of the output, ie how long the signal is delayed.  Short for CW, longer for AM/SSB
+	//Any thread, the delay line is resized by processBlock() on the DSP thread before the next block
+	void setLookAhead(int _ms);
+	int lookAhead() {return m_lookAheadMs;}
 	//CPX * processBlock2(CPX *in);
 
 	//CPX *processBlock3(CPX *in); //Testing cuteSDR algorithm
@@ -25,16 +34,22 @@ public:
 private:
 	static const int DEFAULT_THRESHOLD = 20;
 	static const int MAX_DELAY_BUF = 2048;
+	//Envelope, peak detector and gain run once per sub-block instead of once per sample
+	//Gain is interpolated across each sub-block so there are no steps in the output
+	static const int SUB_BLOCK_SAMPLES = 32;
 	//CuteSDR algorithm constants converted for FP CPX samples and predefined modes
 	//signal delay line time delay in seconds.
 	//adjust to cover the impulse response time of filter
+	//Default look ahead, see setLookAhead()
 	static constexpr float DELAY_TIMECONST = .015;
 
 	//Peak Detector window time delay in seconds.
+	//Window is always this much longer than the look ahead delay
 	static constexpr float WINDOW_TIMECONST = .018;
 
 	//attack time constant in seconds
 	//just small enough to let attackave charge up within the DELAY_TIMECONST time
+	//Rise is scaled down for shorter look ahead
 	static constexpr float ATTACK_RISE_TIMECONST = .002;
 	static constexpr float ATTACK_FALL_TIMECONST = .005;
 
@@ -124,17 +139,22 @@ private:
 	double m_gainSlope;
 	double m_peak;
 
-	int m_sigDelayPtr;
 	int m_magBufPos;
 	//int m_delaySize;
+	int m_lookAheadMs;
 	int m_delaySamples;
-	int m_windowSamples;
+	int m_subBlockSamples; //SUB_BLOCK_SAMPLES or less if it doesn't divide numSamples
+	int m_windowBlocks; //Peak detector window in sub-blocks
+	double m_lastGain; //Gain at the end of the previous sub-block
+	QAtomicInteger<int> m_pendingLookAheadMs; //-1 if none, see setLookAhead()
 	int m_hangTime;
 	int m_hangTimer;
 
 	QMutex m_mutex;		//for keeping threads from stomping on each other
-	CPX m_sigDelayBuf[MAX_DELAY_BUF];
-	double m_magBuf[MAX_DELAY_BUF];
+	CPX m_sigDelayBuf[MAX_DELAY_BUF]; //Oldest sample first
+	double m_magBuf[MAX_DELAY_BUF]; //Log peak of each sub-block in the window
+
+	void applyLookAhead(int _ms);
 
 	//Utility function, used in many calculations exp(x) = e^x
 	inline float eVal(float x) {return exp(-1000.0 / (x * sampleRate));}
@@ -17,7 +17,10 @@ BandPassFilter::BandPassFilter(quint32 _sampleRate, quint32 _bufferSize):
 		m_bpFilter1->setEnabled(true);
 		m_bpFilter2 = NULL;
 	} else {
-		m_bpFilter2 = new CFastFIR();
+		//Partition matches the block so every call returns exactly _numSamples, no extra buffering delay
+		//2048/1025 for the throughput profile, shorter (wider transition band) for low latency blocks
+		quint32 partition = qMin(_bufferSize, (quint32)c_maxPartition);
+		m_bpFilter2 = new CFastFIR(partition * 2, partition + 1);
 		m_bpFilter1 = NULL;
 	}
 
@@ -40,6 +43,7 @@ void BandPassFilter::setBandPass(float _low, float _high)
 	if (m_bpFilter1 != NULL) {
 		m_bpFilter1->SetBandPass(m_lowFreq, m_highFreq);
 	} else if (m_bpFilter2 != NULL) {
+		//Cheap when dragging back and forth, designs are cached and crossfaded in on the DSP thread
 		m_bpFilter2->SetupParameters(m_lowFreq, m_highFreq, 0, sampleRate);
 	}
 }
@@ -11,6 +11,8 @@
 class BandPassFilter : public ProcessStep
 {
 public:
+	static const quint32 c_maxPartition = 1024; //FastFIR output per FFT, _bufferSize must be a multiple or less
+
 	BandPassFilter(quint32 _sampleRate, quint32 _bufferSize);
 	~BandPassFilter(void);
 
@@ -43,7 +43,12 @@ const Demod::DemodInfo Demod::demodInfo[] = {
 Demod::Demod(quint32 _sampleRate, quint32 _bufferSize) :
 	ProcessStep(_sampleRate,_bufferSize)
 {
-
+	//Sub class instances, only the top level Demod has these
+	m_demodAM = NULL;
+	m_demodSAM = NULL;
+	m_demodWFM = NULL;
+	m_demodNFM = NULL;
+	m_dataUi = NULL;
 }
 
 //Two input rates, one normal and one for wfm
@@ -52,6 +57,10 @@ Demod::Demod(quint32 _sampleRate, quint32 _wfmSampleRate, quint32 _bufferSize) :
 {   
 	m_inputSampleRate = _sampleRate;
 	m_inputWfmSampleRate = _wfmSampleRate;
+	m_demodAM = NULL;
+	m_demodSAM = NULL;
+	m_demodWFM = NULL;
+	m_demodNFM = NULL;
 
 	setDemodMode(DeviceInterface::dmAM, sampleRate, sampleRate);
 	
@@ -68,8 +77,17 @@ Demod::Demod(quint32 _sampleRate, quint32 _wfmSampleRate, quint32 _bufferSize) :
 	m_dataUi = NULL;
 }
 
+//DspServer creates one per client, don't leak the sub demods every time one disconnects
 Demod::~Demod()
 {
+	if (m_demodAM != NULL)
+		delete m_demodAM;
+	if (m_demodSAM != NULL)
+		delete m_demodSAM;
+	if (m_demodWFM != NULL)
+		delete m_demodWFM;
+	if (m_demodNFM != NULL)
+		delete m_demodNFM;
 }
 
 //Move to plugin
@@ -269,6 +287,11 @@ void Demod::resetDemod()
 	m_rdsString[0] = 0;
 	m_rdsBuf[0] = 0;
 	m_rdsUpdate = true; //Update display next loop
+	//Sample history from the old frequency
+	if (m_demodWFM != NULL)
+		m_demodWFM->resetFmMono();
+	if (m_demodNFM != NULL)
+		m_demodNFM->resetFM();
 }
 
 DeviceInterface::DemodMode Demod::stringToMode(QString m)
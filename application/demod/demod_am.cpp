@@ -6,11 +6,13 @@ Demod_AM::Demod_AM(int _inputRate, int _numSamples) :
     Demod(_inputRate, _numSamples)
 {
 	m_amDc = m_amDcLast = 0.0;
+	m_mag = new double[_numSamples];
 	setBandwidth(16000); //For testing
 }
 
 Demod_AM::~Demod_AM()
 {
+	delete[] m_mag;
 
 }
 
@@ -24,10 +26,11 @@ void Demod_AM::setBandwidth(double bandwidth)
 void Demod_AM::processBlock(CPX *in, CPX *out, int demodSamples)
 {
     double amOut;
+	FastMath::magArray(in, m_mag, demodSamples);
     for (int i=0;i<demodSamples;i++)
     {
         //Just return the magnitude of each sample
-		amOut = DB::amplitude(in[i]);
+		amOut = m_mag[i];
 		out[i].real(amOut);
 		out[i].imag(amOut);
     }
@@ -43,9 +46,11 @@ void Demod_AM::processBlockFiltered(CPX *in, CPX *out, int demodSamples)
     double mag; //sqrt(re^2 + im^2)
     double amOut;
 
+	//Vector pass, DC filter below has to run one sample at a time
+	FastMath::magArray(in, m_mag, demodSamples);
     for (int i = 0; i < demodSamples; i++)
     {
-		mag = DB::amplitude(in[i]);
+		mag = m_mag[i];
 
         //CuteSDR description of filter for reference
         //High pass filter(DC removal) with IIR filter
@@ -4,6 +4,7 @@
 #include "gpl.h"
 
 #include "demod.h"
+#include "fastmath.h"
 
 class Demod_AM : public Demod
 {
@@ -22,6 +23,7 @@ private:
     //DC Filtering
 	double m_amDc;
 	double m_amDcLast;
+	double *m_mag; //Block of magnitudes, see FastMath::magArray()
 
 	CFir m_lpFilter;
 
@@ -25,8 +25,7 @@
 Demod_NFM::Demod_NFM(int _inputRate, int _numSamples) :
     Demod(_inputRate, _numSamples)
 {
-    m_fmIPrev = 0.0;
-    m_fmQPrev = 0.0;
+    resetFM();
 
     //FMN PLL config
     m_pllFreqErrorDC = 0.0;
@@ -126,7 +125,7 @@ void Demod_NFM::processBlockFM2(CPX *in, CPX *out, int demodSamples)
     CPX prod;
 
     //Based on phase delta between samples, so we always need last sample from previous run
-    static CPX lastCpx(0,0);
+    CPX lastCpx = m_fmLastCpx;
     for (int i=0; i < demodSamples; i++)
     {
         //The angle between to subsequent samples can be calculated by multiplying one by the complex conjugate of the other
@@ -137,6 +136,14 @@ void Demod_NFM::processBlockFM2(CPX *in, CPX *out, int demodSamples)
 		out[i].imag(phaseCpx(prod) *.0005);
         lastCpx = in[i];
     }
+    m_fmLastCpx = lastCpx;
+}
+
+void Demod_NFM::resetFM()
+{
+    m_fmIPrev = 0.0;
+    m_fmQPrev = 0.0;
+    m_fmLastCpx = CPX(0,0);
 }
 
 /*
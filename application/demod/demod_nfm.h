@@ -22,10 +22,13 @@ public:
 
 	void simplePhase(CPX *in, CPX *out, int demodSamples);
 	void init(double samplerate);
+	//Clears sample history, from Demod::resetDemod()
+	void resetFM();
 private:
     //Previous I/Q values, used in simpleFM
 	float m_fmIPrev;
 	float m_fmQPrev;
+	CPX m_fmLastCpx; //Previous sample in processBlockFM2()
 
     //FMN PLL config (reference)
 	float m_fmBandwidth;
@@ -108,6 +108,14 @@ Demod_WFM::Demod_WFM(int _inputRate, int _numSamples) :
 {
     //SampleRate and audioRate are the same because audio is handled outside demod class
     init(_inputRate, _inputRate);
+	resetFmMono();
+}
+
+void Demod_WFM::resetFmMono()
+{
+	m_fmMonoLast = CPX(0,0);
+	m_fmDeemphasisAvgRe = 0.0;
+	m_fmDeemphasisAvgIm = 0.0;
 }
 
 void Demod_WFM::init(TYPEREAL samplerate, TYPEREAL _audioRate)
@@ -830,7 +838,7 @@ void Demod_WFM::fmMono( CPX * in, CPX * out, int bufSize)
 
 #if 1
     CPX d0;
-    static CPX d1;
+    CPX d1 = m_fmMonoLast;
 
     for (int i=0; i<bufSize; i++)
     {
@@ -841,6 +849,7 @@ void Demod_WFM::fmMono( CPX * in, CPX * out, int bufSize)
 		out[i].imag(out[i].real());
         d1 = d0;
     }
+    m_fmMonoLast = d1;
 #else
     SimpleFM2(in,out, bufSize);
 #endif
@@ -864,8 +873,8 @@ void Demod_WFM::fmDeemphasisFilter(int _bufSize, CPX *in, CPX *out)
 {
     int bufSize = _bufSize;
 
-    static float avgRe = 0.0;
-    static float avgIm = 0.0;
+    float avgRe = m_fmDeemphasisAvgRe;
+    float avgIm = m_fmDeemphasisAvgIm;
 
     for(int i=0; i<bufSize; i++)
     {
@@ -874,4 +883,6 @@ void Demod_WFM::fmDeemphasisFilter(int _bufSize, CPX *in, CPX *out)
         out[i].real(avgRe*2.0);
         out[i].imag(avgIm*2.0);
     }
+    m_fmDeemphasisAvgRe = avgRe;
+    m_fmDeemphasisAvgIm = avgIm;
 }
@@ -39,9 +39,14 @@ public:
 	int getNextRdsGroupData(tRDS_GROUPS* pGroupData);
 	int getStereoLock(int* pPilotLock);
     void fmMono(CPX *in, CPX *out, int bufSize);
+	//Clears fmMono() history, from Demod::resetDemod()
+	void resetFmMono();
 private:
 	void fmDeemphasisFilter(int _bufSize, CPX *in, CPX *out);
 	float m_fmDeemphasisAlpha;
+	CPX m_fmMonoLast; //Previous sample in fmMono()
+	float m_fmDeemphasisAvgRe; //fmDeemphasisFilter() state
+	float m_fmDeemphasisAvgIm;
 	static const float m_usDeemphasisTime; //Use for US & Korea FM
 	static const float m_intlDeemphasisTime;  //Use for international FM
 
@@ -0,0 +1,473 @@
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "dspserver.h"
+#include "db.h"
+#include <QtEndian>
+#include <QStringList>
+#include <QDebug>
+
+DspServerClient::DspServerClient(QTcpSocket *_socket, int _channel, quint32 _sampleRate, quint32 _demodSampleRate,
+	quint32 _demodWfmSampleRate, quint32 _framesPerBuffer, double _gain)
+{
+	m_socket = _socket;
+	m_channel = _channel;
+	m_sampleRate = _sampleRate;
+	m_demodSampleRate = _demodSampleRate;
+	m_framesPerBuffer = _framesPerBuffer;
+	m_gain = _gain;
+	m_droppedBytes = 0;
+
+	m_frequency = 0;
+	m_outputGain = 0.5;
+
+	m_bpFilter = new BandPassFilter(m_demodSampleRate, m_framesPerBuffer);
+	m_bpFilter->enableStep(true);
+	m_agc = new AGC(m_demodSampleRate, m_framesPerBuffer);
+	setAgc(3); //Medium
+	m_demod = new Demod(m_demodSampleRate, _demodWfmSampleRate, m_framesPerBuffer);
+	//Same defaults a master dspserver starts with
+	setMode(AM);
+	setFilter(-4000, 4000);
+
+	m_fractResampler.Init(m_framesPerBuffer);
+	m_audioBuf = memalign(m_framesPerBuffer);
+	m_audioOn = false;
+	m_audioRate = 8000;
+	m_audioPacket.resize(5 + c_audioPacketSize);
+	m_audioFill = 0;
+
+	m_spectrumOn = false;
+	m_spectrumRequested = false;
+	m_spectrumWidth = c_defaultSpectrumWidth;
+	m_spectrumMs = 100;
+	m_spectrumTimer.start();
+}
+
+DspServerClient::~DspServerClient()
+{
+	delete m_bpFilter;
+	delete m_agc;
+	delete m_demod;
+	free(m_audioBuf);
+}
+
+//Called with m_mutex locked
+void DspServerClient::queue(const QByteArray &_packet, bool _droppable)
+{
+	if (_droppable && m_output.size() + _packet.size() > c_maxQueuedBytes) {
+		//Client isn't keeping up, answers still go out
+		m_droppedBytes += _packet.size();
+		return;
+	}
+	m_output.append(_packet);
+}
+
+//Answer length is 2 ASCII digits in the common header, 99 max.  Called with m_mutex locked
+void DspServerClient::answer(QString _answer)
+{
+	QByteArray text = _answer.toLatin1().left(99);
+	QByteArray packet;
+	packet.append((char)AnswerData);
+	packet.append(QByteArray::number(text.size()).rightJustified(2, '0'));
+	packet.append(text);
+	queue(packet, false);
+}
+
+QByteArray DspServerClient::takeOutput()
+{
+	m_mutex.lock();
+	QByteArray output = m_output;
+	m_output.clear();
+	m_mutex.unlock();
+	return output;
+}
+
+double DspServerClient::mixerOffset(double _deviceFrequency)
+{
+	m_mutex.lock();
+	double offset = 0;
+	if (m_frequency != 0)
+		offset = qBound(-(double)m_sampleRate / 2, m_frequency - _deviceFrequency, (double)m_sampleRate / 2);
+	m_mutex.unlock();
+	return offset;
+}
+
+//Called with m_mutex locked
+void DspServerClient::setMode(int _mode)
+{
+	DeviceInterface::DemodMode demodMode;
+	switch (_mode) {
+		case LSB: demodMode = DeviceInterface::dmLSB; break;
+		case USB: demodMode = DeviceInterface::dmUSB; break;
+		case DSB: demodMode = DeviceInterface::dmDSB; break;
+		case CWL: demodMode = DeviceInterface::dmCWL; break;
+		case CWH: demodMode = DeviceInterface::dmCWU; break;
+		case FM: demodMode = DeviceInterface::dmFMN; break;
+		case AM: demodMode = DeviceInterface::dmAM; break;
+		case DIGU: demodMode = DeviceInterface::dmDIGU; break;
+		case DIGL: demodMode = DeviceInterface::dmDIGL; break;
+		case SAM: demodMode = DeviceInterface::dmSAM; break;
+		case SPEC:
+		case DRM:
+			//Spectrum only, audio is silence
+			demodMode = DeviceInterface::dmNONE; break;
+		default:
+			return;
+	}
+	m_mode = _mode;
+	m_demod->setDemodMode(demodMode, m_sampleRate, m_demodSampleRate);
+	m_demod->resetDemod();
+	bool isCw = demodMode == DeviceInterface::dmCWL || demodMode == DeviceInterface::dmCWU;
+	m_agc->setLookAhead(isCw ? AGC::CW_LOOKAHEAD_MS : AGC::DEFAULT_LOOKAHEAD_MS);
+}
+
+//Called with m_mutex locked
+void DspServerClient::setFilter(int _low, int _high)
+{
+	int limit = m_demodSampleRate / 2;
+	m_lowFilter = qBound(-limit, _low, limit);
+	m_highFilter = qBound(-limit, _high, limit);
+	if (m_lowFilter >= m_highFilter)
+		return;
+	m_bpFilter->setBandPass(m_lowFilter, m_highFilter);
+	m_demod->setBandwidth(m_highFilter - m_lowFilter);
+}
+
+//ghpsdr3 agc 0 = off, 1 long, 2 slow, 3 medium, 4 fast.  Called with m_mutex locked
+void DspServerClient::setAgc(int _agc)
+{
+	switch (_agc) {
+		case 0: m_agc->setAgcMode(AGC::AGC_OFF, 0); break;
+		case 1: m_agc->setAgcMode(AGC::AGC_LONG, c_defaultAgcThreshold); break;
+		case 2: m_agc->setAgcMode(AGC::AGC_SLOW, c_defaultAgcThreshold); break;
+		case 3: m_agc->setAgcMode(AGC::AGC_MED, c_defaultAgcThreshold); break;
+		case 4: m_agc->setAgcMode(AGC::ACG_FAST, c_defaultAgcThreshold); break;
+		default: break;
+	}
+}
+
+bool DspServerClient::receive(const QByteArray &_bytes)
+{
+	bool retune = false;
+	m_command.append(_bytes);
+	while (m_command.size() >= c_commandSize) {
+		//Text up to the first NUL
+		QString text = QString::fromLatin1(m_command.constData(), qstrnlen(m_command.constData(), c_commandSize));
+		m_command.remove(0, c_commandSize);
+		if (command(text.trimmed()))
+			retune = true;
+	}
+	return retune;
+}
+
+//Returns true if the mixer offset needs to change
+bool DspServerClient::command(QString _command)
+{
+	QStringList args = _command.split(' ', QString::SkipEmptyParts);
+	if (args.isEmpty())
+		return false;
+	QString cmd = args[0].toLower();
+	bool retune = false;
+
+	m_mutex.lock();
+	if (cmd == "startaudiostream") {
+		//Buffer size, rate, channels, encoding.  We always send c_audioPacketSize mono ALAW
+		if (args.count() >= 3)
+			m_audioRate = qBound(8000u, args[2].toUInt(), qMin(48000u, m_demodSampleRate));
+		m_audioFill = 0;
+		m_audioOn = true;
+	} else if (cmd == "stopaudiostream") {
+		m_audioOn = false;
+		m_spectrumOn = false;
+	} else if (cmd == "setfps" && args.count() >= 3) {
+		//Width, frames per second
+		m_spectrumWidth = qBound(1, args[1].toInt(), 65535);
+		m_spectrumMs = 1000 / qBound(1, args[2].toInt(), 50);
+		m_spectrumOn = true;
+	} else if (cmd == "getspectrum" && args.count() >= 2) {
+		m_spectrumWidth = qBound(1, args[1].toInt(), 65535);
+		m_spectrumRequested = true;
+	} else if (cmd == "setfrequency" && args.count() >= 2) {
+		m_frequency = args[1].toDouble();
+		m_demod->resetDemod();
+		retune = true;
+	} else if (cmd == "setmode" && args.count() >= 2) {
+		setMode(args[1].toInt());
+	} else if (cmd == "setfilter" && args.count() >= 3) {
+		setFilter(args[1].toInt(), args[2].toInt());
+	} else if (cmd == "setagc" && args.count() >= 2) {
+		setAgc(args[1].toInt());
+	} else if (cmd == "setrxoutputgain" && args.count() >= 2) {
+		m_outputGain = qBound(0, args[1].toInt(), 100) / 100.0;
+	} else if (cmd == "q-version") {
+		answer("q-version:20130609;-master");
+	} else if (cmd == "q-protocol3") {
+		answer("q-protocol3:Y");
+	} else if (cmd == "q-master") {
+		//Every client is master of its own receiver
+		answer("q-master:master");
+	} else if (cmd == "q-loffset") {
+		//We mix in the front end, there's no hardware LO offset
+		answer("q-loffset:0.000000;");
+	} else if (cmd.startsWith("q-cantx")) {
+		answer("q-cantx:N");
+	} else if (cmd == "q-rtpport") {
+		answer("q-rtpport:0;");
+	} else if (cmd == "q-server") {
+		answer("q-server:Pebble P");
+	} else if (cmd == "q-info") {
+		answer(QString("q-info:s;0;f;%1;m;%2;z;0;l;%3;r;%4;")
+			.arg((qint64)m_frequency).arg(m_mode).arg(m_lowFilter).arg(m_highFilter));
+	}
+	//Anything else a full dspserver does (tx, sub rx, noise reduction) is accepted and ignored
+	m_mutex.unlock();
+	return retune;
+}
+
+//Front end channel output at m_demodSampleRate, same chain as Receiver::processDemodBlock()
+void DspServerClient::process(CPX *_in, quint32 _numSamples)
+{
+	m_mutex.lock();
+	if (!m_audioOn) {
+		m_mutex.unlock();
+		return;
+	}
+	CPX *nextStep = _in;
+	scaleCPX(nextStep, nextStep, m_gain, _numSamples);
+	nextStep = m_bpFilter->process(nextStep, _numSamples);
+	nextStep = m_agc->processBlock(nextStep);
+	nextStep = m_demod->processBlock(nextStep, _numSamples);
+	if (m_demod->demodMode() == DeviceInterface::dmNONE) {
+		//Demod passed IQ through
+		clearCPX(m_audioBuf, _numSamples);
+		nextStep = m_audioBuf;
+	}
+	int numOut = m_fractResampler.Resample(_numSamples, (double)m_demodSampleRate / m_audioRate, nextStep, m_audioBuf);
+
+	//Common header (type, version, sub version), big endian length, ALAW mono
+	quint8 *p = (quint8 *)m_audioPacket.data();
+	double sample;
+	for (int i = 0; i < numOut; i++) {
+		sample = qBound(-0.9999, m_audioBuf[i].real() * m_outputGain, 0.9999);
+		p[5 + m_audioFill++] = m_alaw.LinearToALaw((qint16)(sample * 32767.0));
+		if (m_audioFill == c_audioPacketSize) {
+			p[0] = AudioData;
+			p[1] = 2;
+			p[2] = 1;
+			qToBigEndian<quint16>(c_audioPacketSize, &p[3]);
+			queue(m_audioPacket, true);
+			m_audioFill = 0;
+		}
+	}
+	m_mutex.unlock();
+}
+
+//Shared unprocessed spectrum (-fs/2 to +fs/2 in dB) re-centered on our frequency and reduced to m_spectrumWidth
+void DspServerClient::spectrum(const double *_spectrum, int _numBins, double _deviceFrequency)
+{
+	m_mutex.lock();
+	bool isDue = m_spectrumOn && m_spectrumTimer.elapsed() >= m_spectrumMs;
+	if (!isDue && !m_spectrumRequested) {
+		m_mutex.unlock();
+		return;
+	}
+	m_spectrumTimer.start();
+	m_spectrumRequested = false;
+
+	double offset = 0;
+	if (m_frequency != 0)
+		offset = m_frequency - _deviceFrequency;
+	double binsPerHz = (double)_numBins / m_sampleRate;
+	double binsPerOut = (double)_numBins / m_spectrumWidth;
+	double first = _numBins / 2.0 + offset * binsPerHz - m_spectrumWidth / 2.0 * binsPerOut;
+
+	//Common header, then big endian width, meter, sub rx meter, sample rate and LO offset
+	QByteArray packet(15 + m_spectrumWidth, 0);
+	quint8 *p = (quint8 *)packet.data();
+	quint8 *bins = &p[15];
+	int b0;
+	int b1;
+	double db;
+	for (quint32 i = 0; i < m_spectrumWidth; i++) {
+		//Peak of the bins that fall in this one, bins are -dB like Receiver::processBandscopeData() expects
+		b0 = qMax(0, (int)floor(first + i * binsPerOut));
+		b1 = qMin(_numBins, qMax(b0 + 1, (int)floor(first + (i + 1) * binsPerOut)));
+		db = DB::minDb;
+		for (int b = b0; b < b1; b++)
+			db = qMax(db, _spectrum[b]);
+		bins[i] = qBound(0, -qRound(db), 255);
+	}
+
+	//Meter is the peak in our pass band
+	b0 = qMax(0, (int)floor(_numBins / 2.0 + (offset + m_lowFilter) * binsPerHz));
+	b1 = qMin(_numBins, qMax(b0 + 1, (int)ceil(_numBins / 2.0 + (offset + m_highFilter) * binsPerHz)));
+	db = DB::minDb;
+	for (int b = b0; b < b1; b++)
+		db = qMax(db, _spectrum[b]);
+
+	p[0] = SpectrumData;
+	p[1] = 2;
+	p[2] = 1;
+	qToBigEndian<quint16>(m_spectrumWidth, &p[3]);
+	qToBigEndian<qint16>(qRound(db), &p[5]);
+	qToBigEndian<qint16>(qRound(db), &p[7]);
+	qToBigEndian<quint32>(m_sampleRate, &p[9]);
+	qToBigEndian<quint16>(0, &p[13]);
+	queue(packet, true);
+	m_mutex.unlock();
+}
+
+DspServer::DspServer(FreqDomainFrontEnd *_frontEnd, quint32 _sampleRate, quint32 _demodSampleRate,
+	quint32 _demodWfmSampleRate, quint32 _framesPerBuffer, double _gain)
+{
+	m_frontEnd = _frontEnd;
+	m_sampleRate = _sampleRate;
+	m_demodSampleRate = _demodSampleRate;
+	m_demodWfmSampleRate = _demodWfmSampleRate;
+	m_framesPerBuffer = _framesPerBuffer;
+	m_gain = _gain;
+	m_maxClients = 0;
+	m_numClients.store(0);
+	m_deviceFrequency = 0;
+	m_frameBuf = memalign(m_framesPerBuffer);
+
+	connect(&m_server, &QTcpServer::newConnection, this, &DspServer::newConnection);
+	connect(&m_flushTimer, &QTimer::timeout, this, &DspServer::flush);
+}
+
+DspServer::~DspServer()
+{
+	m_flushTimer.stop();
+	m_server.close();
+	m_clientsMutex.lock();
+	QList<DspServerClient *> clients = m_clients;
+	m_clients.clear();
+	m_numClients.store(0);
+	m_clientsMutex.unlock();
+	foreach (DspServerClient *client, clients) {
+		m_frontEnd->removeChannel(client->channel());
+		client->socket()->disconnect(this);
+		client->socket()->close();
+		client->socket()->deleteLater();
+		delete client;
+	}
+	free(m_frameBuf);
+}
+
+bool DspServer::listen(quint16 _port, int _maxClients)
+{
+	m_maxClients = _maxClients;
+	if (!m_server.listen(QHostAddress::Any, _port)) {
+		qDebug()<<"DspServer: can't listen on port "<<_port<<" "<<m_server.errorString();
+		return false;
+	}
+	m_flushTimer.start(c_flushMs);
+	qDebug()<<"DspServer: listening on port "<<_port<<" for "<<_maxClients<<" clients";
+	return true;
+}
+
+void DspServer::setDeviceFrequency(double _frequency)
+{
+	m_clientsMutex.lock();
+	m_deviceFrequency = _frequency;
+	foreach (DspServerClient *client, m_clients)
+		updateMixer(client);
+	m_clientsMutex.unlock();
+}
+
+//Called with m_clientsMutex locked
+void DspServer::updateMixer(DspServerClient *_client)
+{
+	m_frontEnd->setMixerFrequency(_client->mixerOffset(m_deviceFrequency), _client->channel());
+}
+
+DspServerClient *DspServer::findClient(QObject *_socket)
+{
+	foreach (DspServerClient *client, m_clients) {
+		if (client->socket() == _socket)
+			return client;
+	}
+	return NULL;
+}
+
+void DspServer::newConnection()
+{
+	QTcpSocket *socket;
+	while ((socket = m_server.nextPendingConnection()) != NULL) {
+		int channel = -1;
+		if (m_numClients.load() < m_maxClients)
+			channel = m_frontEnd->addChannel(0);
+		if (channel < 0) {
+			qDebug()<<"DspServer: refused "<<socket->peerAddress().toString();
+			socket->close();
+			socket->deleteLater();
+			continue;
+		}
+		DspServerClient *client = new DspServerClient(socket, channel, m_sampleRate, m_demodSampleRate,
+			m_demodWfmSampleRate, m_framesPerBuffer, m_gain);
+		connect(socket, &QTcpSocket::readyRead, this, &DspServer::newData);
+		connect(socket, &QTcpSocket::disconnected, this, &DspServer::closeConnection);
+		m_clientsMutex.lock();
+		m_clients.append(client);
+		m_numClients.store(m_clients.count());
+		m_clientsMutex.unlock();
+		qDebug()<<"DspServer: client "<<socket->peerAddress().toString()<<" on channel "<<channel;
+	}
+}
+
+void DspServer::closeConnection()
+{
+	QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+	m_clientsMutex.lock();
+	DspServerClient *client = findClient(socket);
+	if (client != NULL) {
+		m_clients.removeOne(client);
+		m_numClients.store(m_clients.count());
+	}
+	m_clientsMutex.unlock();
+	if (client == NULL)
+		return;
+	m_frontEnd->removeChannel(client->channel());
+	qDebug()<<"DspServer: client "<<socket->peerAddress().toString()<<" closed, dropped "<<client->droppedBytes()<<" bytes";
+	delete client;
+	socket->deleteLater();
+}
+
+void DspServer::newData()
+{
+	QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+	//Only the UI thread adds and removes clients, we don't need m_clientsMutex to look
+	DspServerClient *client = findClient(socket);
+	if (client == NULL)
+		return;
+	if (client->receive(socket->readAll())) {
+		m_clientsMutex.lock();
+		updateMixer(client);
+		m_clientsMutex.unlock();
+	}
+}
+
+//UI thread, writes whatever the DSP thread has queued.  Sockets that are already backed up are left alone
+//and their client starts dropping audio and spectrum, see DspServerClient::queue()
+void DspServer::flush()
+{
+	foreach (DspServerClient *client, m_clients) {
+		if (client->socket()->bytesToWrite() > 0)
+			continue;
+		QByteArray output = client->takeOutput();
+		if (!output.isEmpty())
+			client->socket()->write(output);
+	}
+}
+
+void DspServer::process(const double *_spectrum, int _numBins)
+{
+	m_clientsMutex.lock();
+	foreach (DspServerClient *client, m_clients) {
+		while (m_frontEnd->takeFrame(m_frameBuf, m_framesPerBuffer, client->channel()))
+			client->process(m_frameBuf, m_framesPerBuffer);
+		if (_spectrum != NULL && _numBins > 0)
+			client->spectrum(_spectrum, _numBins, m_deviceFrequency);
+	}
+	m_clientsMutex.unlock();
+}
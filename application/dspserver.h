@@ -0,0 +1,175 @@
+#ifndef DSPSERVER_H
+#define DSPSERVER_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "cpx.h"
+#include "device_interfaces.h"
+#include "freqdomainfrontend.h"
+#include "fractresampler.h"
+#include "alawcompression.h"
+#include "bandpassfilter.h"
+#include "agc.h"
+#include "demod.h"
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QAtomicInteger>
+
+/*
+	ghpsdr3 dspserver compatible server, one wideband device feeding many remote listeners
+
+	Anything that connects like Ghpsdr3Device (QtRadio, glSDR, another Pebble) gets its own narrowband receiver
+	inside the band the device is covering.  Same wire protocol as SdrEmulator/dspserveremulator.cpp:
+	64 byte NUL padded text commands, answers, ALAW audio and spectrum packets on the one TCP stream.
+
+	Shared, paid once no matter how many clients
+		Device, DC removal, IQ balance, noise blankers			Receiver::processIQData()
+		Input rate forward FFT									FreqDomainFrontEnd
+		Unprocessed spectrum									SignalSpectrum
+	Per client
+		Mixer offset and decimation								FreqDomainFrontEnd channel, M bins and an M point inverse
+		Band pass, AGC, demod, resampler to the client's audio rate, ALAW
+		Spectrum, the shared unprocessed spectrum re-centered on the client's frequency and reduced to its width
+
+	Threads
+		Sockets, commands and writes are on the UI thread, process() is on the DSP thread
+		Each client's chain is under its own mutex, commands change it between blocks
+		DSP thread only appends packets to the client's queue, m_flushTimer writes them out.  A client that isn't
+		reading loses packets past c_maxQueuedBytes, the DSP thread never waits on a socket
+
+	Needs the frequency domain front end, Receiver doesn't start us without one
+	Wfm isn't a ghpsdr3 mode, clients run at the receiver's demod rate
+*/
+
+class DspServerClient
+{
+public:
+	//ghpsdr3 modes, same as Ghpsdr3Device::gDemodMode
+	enum Ghpsdr3Mode {LSB = 0, USB, DSB, CWL, CWH, FM, AM, DIGU, SPEC, DIGL, SAM, DRM};
+
+	DspServerClient(QTcpSocket *_socket, int _channel, quint32 _sampleRate, quint32 _demodSampleRate,
+		quint32 _demodWfmSampleRate, quint32 _framesPerBuffer, double _gain);
+	~DspServerClient();
+
+	QTcpSocket *socket() {return m_socket;}
+	int channel() {return m_channel;}
+
+	//UI thread.  Bytes from the socket, answers go to the output queue.  True if the mixer offset needs to change
+	bool receive(const QByteArray &_bytes);
+	//Offset from the device frequency, what the client's front end channel mixes to DC
+	double mixerOffset(double _deviceFrequency);
+	//Packets queued since the last call
+	QByteArray takeOutput();
+	quint64 droppedBytes() {return m_droppedBytes;}
+
+	//DSP thread
+	void process(CPX *_in, quint32 _numSamples);
+	void spectrum(const double *_spectrum, int _numBins, double _deviceFrequency);
+
+	//Network buffer sizes, Ghpsdr3Device only accepts these
+	static const quint32 c_audioPacketSize = 2000;
+	static const quint16 c_defaultSpectrumWidth = 2048;
+
+private:
+	static const int c_commandSize = 64;
+	static const int c_maxQueuedBytes = 256 * 1024;
+	static const int c_defaultAgcThreshold = 30; //Same as ReceiverWidget
+
+	enum PacketType {SpectrumData = 0, AudioData = 1, AnswerData = 4};
+
+	bool command(QString _command);
+	void queue(const QByteArray &_packet, bool _droppable);
+	void answer(QString _answer);
+	void setMode(int _mode);
+	void setFilter(int _low, int _high);
+	void setAgc(int _agc);
+
+	QTcpSocket *m_socket;
+	QByteArray m_command; //Bytes of a command we haven't got all of yet, UI thread
+	int m_channel;
+	quint32 m_sampleRate;
+	quint32 m_demodSampleRate;
+	quint32 m_framesPerBuffer;
+	double m_gain; //Decimation loss, same as Receiver::processDemodBlock()
+
+	QMutex m_mutex; //Everything below, UI thread commands vs DSP thread
+	double m_frequency; //0 until the client sets one, then we follow it as the device is retuned
+	int m_mode; //Ghpsdr3Mode
+	int m_lowFilter;
+	int m_highFilter;
+	float m_outputGain; //setrxoutputgain, 0 to 1
+
+	BandPassFilter *m_bpFilter;
+	AGC *m_agc;
+	Demod *m_demod;
+	CFractResampler m_fractResampler;
+	CPX *m_audioBuf;
+	ALawCompression m_alaw;
+	bool m_audioOn;
+	quint32 m_audioRate;
+	QByteArray m_audioPacket;
+	quint32 m_audioFill;
+
+	bool m_spectrumOn; //setfps, getSpectrum sends one
+	bool m_spectrumRequested;
+	quint16 m_spectrumWidth;
+	int m_spectrumMs;
+	QElapsedTimer m_spectrumTimer;
+
+	QByteArray m_output;
+	quint64 m_droppedBytes;
+};
+
+class DspServer : public QObject
+{
+	Q_OBJECT
+public:
+	static const int c_flushMs = 10;
+
+	//_frontEnd is the receiver's, each client gets a channel on it.  _gain restores decimation loss
+	DspServer(FreqDomainFrontEnd *_frontEnd, quint32 _sampleRate, quint32 _demodSampleRate,
+		quint32 _demodWfmSampleRate, quint32 _framesPerBuffer, double _gain);
+	~DspServer();
+
+	//UI thread
+	bool listen(quint16 _port, int _maxClients);
+	void setDeviceFrequency(double _frequency);
+
+	//Any thread, Receiver keeps the front end running in wfm while this is true
+	bool hasClients() {return m_numClients.load() != 0;}
+
+	//DSP thread, after FreqDomainFrontEnd::process().  _spectrum is SignalSpectrum::getUnprocessed()
+	void process(const double *_spectrum, int _numBins);
+
+private slots:
+	void newConnection();
+	void newData();
+	void closeConnection();
+	void flush();
+
+private:
+	DspServerClient *findClient(QObject *_socket);
+	void updateMixer(DspServerClient *_client);
+
+	FreqDomainFrontEnd *m_frontEnd;
+	quint32 m_sampleRate;
+	quint32 m_demodSampleRate;
+	quint32 m_demodWfmSampleRate;
+	quint32 m_framesPerBuffer;
+	double m_gain;
+	int m_maxClients;
+
+	QTcpServer m_server;
+	QTimer m_flushTimer;
+	QMutex m_clientsMutex; //m_clients list, UI thread adds and removes, DSP thread walks it
+	QList<DspServerClient *> m_clients;
+	QAtomicInteger<int> m_numClients;
+	double m_deviceFrequency; //UI thread writes, DSP thread reads for spectrum centering
+
+	CPX *m_frameBuf; //DSP thread
+};
+
+#endif // DSPSERVER_H
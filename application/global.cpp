@@ -3,7 +3,6 @@
 #include "global.h"
 #include <QDebug>
 #include "qcoreapplication.h"
-#include "testbench.h"
 #include "buildinfo.h" //Generated by pebbleqt.pro
 Global::Global()
 {
@@ -33,9 +32,6 @@ Global::Global()
 	sprintf(revision,"Build %s on %s using QT:%s",PEBBLE_VERSION, PEBBLE_DATE, PEBBLE_QT);
     //qDebug(revision);
 
-    sdr = NULL;
-    perform.InitPerformance();
-
 	beep.setSource(QUrl::fromLocalFile(pebbleDataPath + "beep-07.wav"));
 	beep.setLoopCount(1);
 	beep.setVolume(0.25f);
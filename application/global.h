@@ -7,15 +7,10 @@
 #include "QFile"
 #include <QSize>
 #include <QMainWindow>
-#include "perform.h"
 #include <QSoundEffect>
 #include <QScreen>
 
-class Receiver;
-class Settings;
-class TestBench;
-class DeviceInterface;
-
+//Process wide, read only after startup.  Anything that belongs to a receiver is in ReceiverContext
 class Global
 {
 public:
@@ -23,14 +18,8 @@ public:
 	~Global();
 
 	QDebug *pLogfile;
-    Receiver *receiver;
-    DeviceInterface *sdr;
     char *revision;
-    Settings *settings;
-    Perform perform;
-    TestBench* testBench;
     QSize defaultWindowSize;
-    QMainWindow *mainWindow;
 	QSoundEffect beep;
 	QString appDirPath; //Location of executable, used to access pebbledata, plugins, etc
 	QString pebbleDataPath; //Location of data files
@@ -0,0 +1,183 @@
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "latencytest.h"
+#include <algorithm>
+
+const double LatencyTest::c_burstAmplitude = 0.1; //-20dBFS
+const double LatencyTest::c_detectRatio = 4.0; //12db above average noise
+
+LatencyTest::LatencyTest()
+{
+	m_isActive.store(0);
+	m_isRestart.store(0);
+	m_numBursts = c_numBursts;
+	m_nco = NULL;
+	m_ncoRate = 0;
+	m_ncoFreq = 0;
+	reset();
+}
+
+LatencyTest::~LatencyTest()
+{
+	if (m_nco != NULL)
+		delete m_nco;
+}
+
+void LatencyTest::start(quint32 _numBursts)
+{
+	m_numBursts = qMax((quint32)1, _numBursts);
+	//DSP thread sees restart before it sees us active
+	m_isRestart.storeRelease(1);
+	m_isActive.storeRelease(1);
+}
+
+void LatencyTest::cancel()
+{
+	m_isActive.storeRelease(0);
+}
+
+void LatencyTest::reset()
+{
+	for (int i = 0; i < NUM_BUDGET; i++)
+		m_budget[i].clear();
+	m_missed = 0;
+	m_inSamples = 0;
+	m_inRate = 1;
+	m_burstSample = 0;
+	m_burstRemaining = 0;
+	m_inputMs = 0;
+	m_blockStartNs = 0;
+	m_clock.start();
+	setState(BASELINE);
+}
+
+void LatencyTest::setState(State _state)
+{
+	m_state = _state;
+	m_stateStartMs = m_clock.elapsed();
+	if (m_state == BASELINE) {
+		m_baselineSum = 0;
+		m_baselineCount = 0;
+	}
+}
+
+void LatencyTest::processIQ(CPX *_in, quint32 _numSamples, quint32 _sampleRate, double _toneFreq, quint64 _holdoverSamples)
+{
+	if (m_isRestart.loadAcquire() != 0) {
+		m_isRestart.store(0);
+		reset();
+	}
+	m_blockStartNs = m_clock.nsecsElapsed();
+	m_inRate = qMax((quint32)1, _sampleRate);
+	quint64 blockStart = m_inSamples;
+	m_inSamples += _numSamples;
+
+	if (m_state == INJECT) {
+		if (m_nco == NULL || m_ncoRate != _sampleRate) {
+			if (m_nco != NULL)
+				delete m_nco;
+			m_nco = new NCO(_sampleRate, _numSamples);
+			m_ncoRate = _sampleRate;
+			m_ncoFreq = _toneFreq + 1; //Force setFrequency()
+		}
+		if (m_ncoFreq != _toneFreq) {
+			m_nco->setFrequency(_toneFreq);
+			m_ncoFreq = _toneFreq;
+		}
+		//Burst starts with this block
+		m_burstSample = blockStart;
+		m_burstRemaining = (quint64)c_burstMs * _sampleRate / 1000;
+		m_inputMs = _holdoverSamples * 1000.0 / _sampleRate;
+		setState(DETECT);
+	}
+	//May take more than one block, and may already have been detected
+	if (m_burstRemaining > 0) {
+		quint32 numSamples = qMin(_numSamples, m_burstRemaining);
+		m_nco->genSingle(_in, numSamples, c_burstAmplitude, true);
+		m_burstRemaining -= numSamples;
+	}
+}
+
+void LatencyTest::processAudio(const CPX *_in, quint32 _numSamples, quint32 _sampleRate, double _ringMs, double _deviceMs)
+{
+	if (m_isRestart.loadAcquire() != 0 || _numSamples == 0 || _sampleRate == 0)
+		return; //processIQ() hasn't seen the restart yet
+
+	qint64 elapsed = m_clock.elapsed() - m_stateStartMs;
+	double level;
+	double maxLevel = 0;
+	switch (m_state) {
+		case BASELINE:
+			for (quint32 i = 0; i < _numSamples; i++)
+				m_baselineSum += qMax(qAbs(_in[i].real()), qAbs(_in[i].imag()));
+			m_baselineCount += _numSamples;
+			if (elapsed >= c_baselineMs) {
+				//Floor so digital silence doesn't make every bit of noise a detection
+				m_threshold = qMax(c_detectRatio * m_baselineSum / m_baselineCount, 1.0e-4);
+				setState(INJECT);
+			}
+			break;
+
+		case INJECT:
+			//processIQ() starts the burst
+			break;
+
+		case DETECT:
+			for (quint32 i = 0; i < _numSamples; i++) {
+				level = qMax(qAbs(_in[i].real()), qAbs(_in[i].imag()));
+				if (level < m_threshold)
+					continue;
+				//Stream time of audio sample i, in input samples, vs where the burst went in
+				double outMs = (_numSamples - i) * 1000.0 / _sampleRate;
+				double dspMs = (m_inSamples - m_burstSample) * 1000.0 / m_inRate - outMs;
+				double processingMs = (m_clock.nsecsElapsed() - m_blockStartNs) / 1.0e6;
+				m_budget[INPUT].append(m_inputMs);
+				m_budget[DSP].append(dspMs);
+				m_budget[PROCESSING].append(processingMs);
+				m_budget[AUDIO_RING].append(_ringMs);
+				m_budget[SOUND_CARD].append(_deviceMs);
+				m_budget[TOTAL].append(m_inputMs + dspMs + processingMs + _ringMs + _deviceMs);
+				setState(QUIET);
+				break;
+			}
+			if (m_state == DETECT && elapsed >= c_timeoutMs) {
+				m_missed++;
+				m_burstRemaining = 0;
+				setState(QUIET);
+			}
+			if (m_state == QUIET && (quint32)m_budget[TOTAL].count() + m_missed >= m_numBursts) {
+				m_isActive.storeRelease(0);
+				emit finished(report());
+			}
+			break;
+
+		case QUIET:
+			//Wait for the burst and AGC to settle before measuring noise again
+			for (quint32 i = 0; i < _numSamples; i++)
+				maxLevel = qMax(maxLevel, qMax(qAbs(_in[i].real()), qAbs(_in[i].imag())));
+			if ((elapsed >= c_gapMs && maxLevel < m_threshold) || elapsed >= c_timeoutMs)
+				setState(BASELINE);
+			break;
+	}
+}
+
+QString LatencyTest::report()
+{
+	static const char *names[NUM_BUDGET] = {"Input", "DSP", "Processing", "Audio ring", "Sound card", "Total"};
+	QString str = QString("Loopback latency: %1 bursts, %2 detected, %3 missed\n")
+			.arg(m_numBursts).arg(m_budget[TOTAL].count()).arg(m_missed);
+	str += "Total is device to speaker, the rest is an estimated budget, not measured per stage\n";
+	QVector<double> v;
+	int n;
+	for (int i = 0; i < NUM_BUDGET; i++) {
+		v = m_budget[i];
+		n = v.count();
+		if (n == 0)
+			continue;
+		std::sort(v.begin(), v.end());
+		str += QString("%1 min %2 p50 %3 p95 %4 max %5 ms\n").arg(QString(names[i]), -11)
+				.arg(v[0], 0, 'f', 1).arg(v[n / 2], 0, 'f', 1)
+				.arg(v[qMin(n - 1, (int)(n * 0.95))], 0, 'f', 1).arg(v[n - 1], 0, 'f', 1);
+	}
+	return str;
+}
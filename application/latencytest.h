@@ -0,0 +1,103 @@
+#ifndef LATENCYTEST_H
+#define LATENCYTEST_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "cpx.h"
+#include "nco.h"
+#include <QObject>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QAtomicInteger>
+
+/*
+	Loopback latency test, how long a sample takes from the device to the speaker
+
+	A tone burst from an NCO is added to the incoming IQ at the tuned frequency, in the middle of the pass band, and
+	processAudioData() watches for it to come out.  Repeated c_numBursts times so we get a distribution, not one
+	lucky number.  Needs a mode with audible carrier (AM, SSB, CW) and squelch open.
+
+	Only the loopback total is a measurement.  Samples aren't stamped as they pass each stage, so the budget below
+	is estimated from the one detection per burst and the fill levels at that moment, it tells where the time
+	probably went, not what each stage actually took.
+
+	Budget, all in ms
+		Input		Device block and V2 re-blocking, how long the first sample of the block waited to be processed
+		DSP			Stream time from burst in to burst out: m_sampleBuf accumulation, FIR delays, resampler
+		Processing	Wall time from processIQData() entry to processAudioData() for the block the burst came out in
+		Audio ring	AudioOutputRing fill when the burst was queued
+		Sound card	Audio API buffers past the ring, Audio::OutputDeviceLatencyMs()
+		Total		Sum of the above, device to speaker
+
+	Sample counts
+		Input samples are counted as they arrive, so the burst has a sample number.  When it's detected, its position
+		in the audio block is converted back to an input sample number, the difference is the DSP term.
+		Counting samples instead of reading a clock means the DSP term doesn't include the thread being late.
+
+	Both process calls are on the DSP thread, start() and cancel() on the UI thread
+*/
+
+class LatencyTest : public QObject
+{
+	Q_OBJECT
+public:
+	static const quint32 c_numBursts = 20;
+	static const quint32 c_burstMs = 50;
+	static const quint32 c_gapMs = 500; //Quiet time between bursts, lets AGC recover
+	static const quint32 c_baselineMs = 300; //Noise level measured before each burst
+	static const quint32 c_timeoutMs = 3000; //Burst is counted as missed
+	static const double c_burstAmplitude; //Added to incoming IQ
+	static const double c_detectRatio; //Audio must be this far above baseline to count as the burst
+
+	LatencyTest();
+	~LatencyTest();
+
+	//UI thread
+	void start(quint32 _numBursts = c_numBursts);
+	void cancel();
+	bool isActive() {return m_isActive.load() != 0;}
+
+	//DSP thread.  Start of processIQData(), _holdoverSamples is how long the first sample has been waiting
+	void processIQ(CPX *_in, quint32 _numSamples, quint32 _sampleRate, double _toneFreq, quint64 _holdoverSamples);
+	//DSP thread.  processAudioData(), before it's queued
+	void processAudio(const CPX *_in, quint32 _numSamples, quint32 _sampleRate, double _ringMs, double _deviceMs);
+
+signals:
+	void finished(QString _report);
+
+private:
+	enum State {BASELINE, INJECT, DETECT, QUIET};
+	//Latency budget terms, estimated from the burst, see above
+	enum Budget {INPUT, DSP, PROCESSING, AUDIO_RING, SOUND_CARD, TOTAL, NUM_BUDGET};
+
+	QAtomicInteger<int> m_isActive;
+	QAtomicInteger<int> m_isRestart; //Set by start(), DSP thread resets
+	quint32 m_numBursts;
+
+	//DSP thread
+	State m_state;
+	NCO *m_nco;
+	quint32 m_ncoRate;
+	double m_ncoFreq;
+	QElapsedTimer m_clock;
+	qint64 m_stateStartMs;
+	qint64 m_blockStartNs; //processIQData() entry for the current block
+
+	quint64 m_inSamples; //Input samples seen since start()
+	quint32 m_inRate;
+	quint64 m_burstSample; //Input sample the burst started at
+	quint32 m_burstRemaining; //Samples still to inject
+	double m_inputMs; //Input term for the current burst
+
+	double m_baselineSum;
+	quint64 m_baselineCount;
+	double m_threshold;
+
+	QVector<double> m_budget[NUM_BUDGET];
+	quint32 m_missed;
+
+	void reset();
+	void setState(State _state);
+	QString report();
+};
+
+#endif // LATENCYTEST_H
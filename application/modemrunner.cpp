@@ -0,0 +1,108 @@
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "modemrunner.h"
+#include <QDebug>
+
+ModemRunner::ModemRunner(quint32 _maxSamples)
+{
+	m_maxSamples = _maxSamples;
+	for (quint32 i = 0; i < c_numSlots; i++) {
+		Slot &slot = m_queue.slot(i);
+		slot.samples = new CPX[m_maxSamples];
+		slot.numSamples = 0;
+		slot.firstSample = 0;
+		slot.utcMs = 0;
+	}
+	m_isActive.store(0);
+	m_nextSample = 0;
+
+	m_modem = NULL;
+	m_modem2 = NULL;
+	m_sampleRate = 0;
+	m_reportedDrops = 0;
+	m_droppedBlocks.store(0);
+	m_droppedSamples.store(0);
+
+	m_worker = new PollingWorker("PebbleModem", [this]() {return process();}, c_idleMs);
+}
+
+ModemRunner::~ModemRunner()
+{
+	delete m_worker;
+	for (quint32 i = 0; i < c_numSlots; i++)
+		delete[] m_queue.slot(i).samples;
+}
+
+void ModemRunner::setModem(DigitalModemInterface *_modem, quint32 _sampleRate)
+{
+	m_isActive.storeRelease(0);
+	m_worker->stop();
+	if (m_droppedBlocks.load() > 0)
+		qDebug()<<"ModemRunner: dropped "<<m_droppedBlocks.load()<<" blocks, modem too slow";
+
+	m_modem = _modem;
+	m_modem2 = NULL;
+	if (m_modem != NULL)
+		m_modem2 = qobject_cast<DigitalModemInterface2 *>(m_modem->asQObject());
+	m_sampleRate = _sampleRate;
+
+	//Worker is stopped so we can touch its side.  Anything queued was for the old modem
+	m_queue.clear();
+	m_droppedBlocks.store(0);
+	m_droppedSamples.store(0);
+	m_reportedDrops = 0;
+	if (m_modem == NULL)
+		return;
+
+	m_worker->start();
+	m_isActive.storeRelease(1);
+}
+
+void ModemRunner::publish(const CPX *_in, quint32 _numSamples, qint64 _utcMs)
+{
+	if (m_isActive.loadAcquire() == 0)
+		return;
+
+	quint32 numSamples = qMin(_numSamples, m_maxSamples);
+	Slot *slot = m_queue.writeSlot();
+	if (slot == NULL) {
+		//Modem is a full queue behind, it loses this block, audio doesn't wait
+		m_droppedBlocks.fetchAndAddRelaxed(1);
+		m_droppedSamples.fetchAndAddRelaxed(numSamples);
+		m_nextSample += numSamples;
+		return;
+	}
+
+	copyCPX(slot->samples, _in, numSamples);
+	slot->numSamples = numSamples;
+	slot->firstSample = m_nextSample;
+	slot->utcMs = _utcMs;
+	m_nextSample += numSamples;
+	m_queue.commitWrite();
+}
+
+bool ModemRunner::process()
+{
+	Slot *slot = m_queue.readSlot();
+	if (slot == NULL)
+		return false;
+
+	if (m_modem2 != NULL) {
+		ModemBlock block;
+		block.samples = slot->samples;
+		block.numSamples = slot->numSamples;
+		block.sampleRate = m_sampleRate;
+		block.firstSample = slot->firstSample;
+		block.utcMs = slot->utcMs;
+		quint64 dropped = m_droppedSamples.load();
+		block.droppedSamples = dropped - m_reportedDrops;
+		m_reportedDrops = dropped;
+		m_modem2->processModemBlock(block);
+	} else {
+		//V1 modems don't get a count, they assume the block size they were given in setSampleRate()
+		m_modem->processBlock(slot->samples);
+	}
+	//Producer doesn't reuse the slot until we're done with it
+	m_queue.commitRead();
+	return true;
+}
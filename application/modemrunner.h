@@ -0,0 +1,79 @@
+#ifndef MODEMRUNNER_H
+#define MODEMRUNNER_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "cpx.h"
+#include "digital_modem_interfaces.h"
+#include "spscring.h"
+#include "pollingworker.h"
+#include <QObject>
+#include <QAtomicInteger>
+
+/*
+	Runs the active digital modem on its own thread
+
+	Modems used to be called inline in Receiver::processIQData() before AGC, so an expensive decoder (Morse FIR,
+	WWV matched filter) delayed every block of audio and could stall the device.  Now the DSP thread only copies
+	the post bandpass block into a queue and carries on, the modem catches up on its own worker.
+
+	Queue
+		SpscSlotQueue of c_numSlots blocks of up to _maxSamples each, DSP thread produces, PollingWorker consumes
+		If the modem is c_numSlots blocks behind the new block is dropped and counted, never the DSP thread waiting
+
+	Modems
+		DigitalModemInterface2 modems get a ModemBlock with count, sample rate, position and time stamp
+		Older modems still get processBlock(CPX *), their return value was never used for anything but the input
+*/
+
+class ModemRunner : public QObject
+{
+	Q_OBJECT
+public:
+	static const quint32 c_numSlots = 16; //Power of 2
+	static const quint32 c_idleMs = 5; //Worker sleep when queue is empty
+
+	ModemRunner(quint32 _maxSamples);
+	~ModemRunner();
+
+	//UI thread.  Stops the current modem's worker, NULL leaves us idle.  Queue starts empty
+	void setModem(DigitalModemInterface *_modem, quint32 _sampleRate);
+	DigitalModemInterface *modem() {return m_modem;}
+
+	//DSP thread, every block.  Copies and returns
+	void publish(const CPX *_in, quint32 _numSamples, qint64 _utcMs);
+
+	//Stats, safe to read from any thread
+	quint64 droppedBlocks() {return m_droppedBlocks.load();}
+	quint64 droppedSamples() {return m_droppedSamples.load();}
+
+private:
+	struct Slot {
+		CPX *samples;
+		quint32 numSamples;
+		quint64 firstSample;
+		qint64 utcMs;
+	};
+
+	quint32 m_maxSamples;
+	SpscSlotQueue<Slot, c_numSlots> m_queue;
+	QAtomicInteger<int> m_isActive; //Producer drops everything while 0
+
+	//Producer state
+	quint64 m_nextSample;
+
+	//Consumer state, only touched by worker while it's running
+	DigitalModemInterface *m_modem;
+	DigitalModemInterface2 *m_modem2; //Same object if modem supports V2, else NULL
+	quint32 m_sampleRate;
+	quint64 m_reportedDrops; //m_droppedSamples already passed on in a ModemBlock
+
+	QAtomicInteger<quint64> m_droppedBlocks;
+	QAtomicInteger<quint64> m_droppedSamples;
+
+	PollingWorker *m_worker;
+
+	//Worker, returns false if queue was empty
+	bool process();
+};
+
+#endif // MODEMRUNNER_H
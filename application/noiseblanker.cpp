@@ -12,11 +12,13 @@ NoiseBlanker::NoiseBlanker(quint32 _sampleRate, quint32 _bufferSize):ProcessStep
 	nbSpike = 7;
 	nbSpikeCount =0;
 	nbThreshold = 3.3;
+	nbMag = new double[numSamples];
 
 }
 
 NoiseBlanker::~NoiseBlanker(void)
 {
+	delete[] nbMag;
 }
 void NoiseBlanker::setNbEnabled(bool b)
 {
@@ -49,9 +51,10 @@ CPX * NoiseBlanker::ProcessBlock(CPX *in)
 		return in;
 	}
 	float mag = 0.0;
+	FastMath::magArray(in, nbMag, size);
 	for (int i =0; i < size; i++)
 	{
-		mag = magCpx(in[i]);
+		mag = nbMag[i];
 		//Insert current sample at head of delay line
 		nbDelay->NewSample(in[i]);
 
@@ -83,9 +86,10 @@ CPX * NoiseBlanker::ProcessBlock2(CPX *in)
 		return in;
 		}
 	float mag = 0.0;
+	FastMath::magArray(in, nbMag, size);
 	for (int i = 0; i < size; i++)
 	{
-		mag = magCpx(in[i]);
+		mag = nbMag[i];
 		//Weighted average 75/25
 		nb2AverageCPX = scaleCpx(nb2AverageCPX, 0.75) + scaleCpx(in[i],0.25);
 		nb2AverageMag = 0.999 * nb2AverageMag + 0.001 * mag;
@@ -3,6 +3,7 @@
 #include "gpl.h"
 #include "processstep.h"
 #include "delayline.h"
+#include "fastmath.h"
 
 class NoiseBlanker :
 	public ProcessStep
@@ -27,5 +28,6 @@ private:
 	int nbSpikeCount;
 	int nbSpike; //# samples we consider to be a spike, typically 7
 	double nbThreshold; //Adjustable, typically 3.3;
+	double *nbMag; //Magnitude of each sample in the block, see FastMath::magArray()
 
 };
@@ -2,7 +2,6 @@
 #include "gpl.h"
 #include "pebbleii.h"
 #include "global.h"
-#include "testbench.h"
 
 Global *global;
 
@@ -11,16 +10,11 @@ PebbleII::PebbleII(QWidget *parent, Qt::WindowFlags flags)
 : QMainWindow(parent,flags)
 {
     global = new Global(); //We need globals in constructors, so must be first thing we do
-    //Setup test bench here, not in global constructor or we get circular use with global constants
-    global->testBench = new TestBench();
-    global->testBench->init();
-
-	global->mainWindow = this; //mainWindow is used in Settings()
-	global->settings = new Settings(); //We need these early in startup
+	//Test bench and settings for this receiver, mainWindow is used in Settings()
+	context = new ReceiverContext(this);
 
     ui.setupUi(this);
-	receiver = new Receiver(ui.receiverUI, this);
-    global->receiver = receiver; //Many classes need access
+	receiver = new Receiver(context, ui.receiverUI);
 
     QCoreApplication::setApplicationVersion("2.0.0");
     QCoreApplication::setApplicationName("Pebble II");
@@ -33,8 +27,7 @@ PebbleII::PebbleII(QWidget *parent, Qt::WindowFlags flags)
 PebbleII::~PebbleII()
 {
 	delete receiver; //Trigger shutdown via destructors
-	delete global->testBench;
-	delete global->settings;
+	delete context;
 	delete global;
 }
  void PebbleII::closeEvent(QCloseEvent *event)
@@ -6,6 +6,7 @@
 #include "ui_pebbleii.h"
 #include "receiver.h"
 #include "settings.h"
+#include "receivercontext.h"
 
 class PebbleII : public QMainWindow
 {
@@ -19,6 +20,7 @@ public:
 private:
 	Ui::PebbleIIClass ui;
 	Receiver *receiver;
+	ReceiverContext *context; //Settings, test bench and device for receiver
 	void closeEvent(QCloseEvent *event);
 
 };
@@ -62,6 +62,9 @@ macx {
         #DEFINES += USE_FFTCUTE
         #DEFINES += USE_FFTOOURA
         DEFINES += USE_FFTACCELERATE
+        #Every library compiled in is a run time choice (FFTRegistry), USE_ above is only the default
+        #Cute and Ooura are always compiled in, pebblelib.pro links fftw3 and Accelerate
+        DEFINES += HAVE_FFTW HAVE_FFTACCELERATE
 
         #Audio library choices are PORTAUDIO, QTAUDIO
         #WARNING: When you change this, delete pebble.ini or manually reset all settings because input/output names may change
@@ -91,6 +94,7 @@ win32 {
         #DEFINES += USE_FFTW
         DEFINES += USE_FFTCUTE
         #DEFINES += USE_FFTOOURA
+        #Cute and Ooura are always compiled in and chosen at run time (FFTRegistry), add HAVE_FFTW if linked
 
         #Audio library choices are PORTAUDIO, QTAUDIO
         #WARNING: When you change this, delete pebble.ini or manually reset all settings because input/output names may change
@@ -7,6 +7,8 @@ TARGET = Pebble
 QT += widgets core gui
 #For QWebEngineView
 QT += webenginewidgets
+#For DspServer
+QT += network
 
 #See readme.md for build instructions and pre-requisites
 
@@ -266,6 +268,7 @@ HEADERS += \
 	settings.h \
 	receiverwidget.h \
 	receiver.h \
+	receivercontext.h \
     presets.h \
     pebbleii.h \
 	noisefilter.h \
@@ -288,7 +291,11 @@ HEADERS += \
     sdroptions.h \
     dcremoval.h \
     bandpassfilter.h \
-    doubleslider.h
+    doubleslider.h \
+    stationindex.h \
+    modemrunner.h \
+    latencytest.h \
+    dspserver.h
 
 SOURCES += \
     spectrumwidget.cpp \
@@ -299,6 +306,7 @@ SOURCES += \
 	settings.cpp \
 	receiverwidget.cpp \
 	receiver.cpp \
+	receivercontext.cpp \
     presets.cpp \
     pebbleii.cpp \
 	noisefilter.cpp \
@@ -319,7 +327,11 @@ SOURCES += \
     sdroptions.cpp \
     dcremoval.cpp \
     bandpassfilter.cpp \
-    doubleslider.cpp
+    doubleslider.cpp \
+    stationindex.cpp \
+    modemrunner.cpp \
+    latencytest.cpp \
+    dspserver.cpp
 
 FORMS += \
     spectrumwidget.ui \
@@ -74,6 +74,15 @@ DeviceInterface *Plugins::GetDeviceInterface(QString name)
     return NULL;
 }
 
+DeviceInterface2 *Plugins::GetDeviceInterface2(DeviceInterface *_device)
+{
+	foreach(PluginInfo p, pluginInfoList) {
+		if (p.deviceInterface == _device && p.type == PluginInfo::DEVICE_PLUGIN)
+			return p.deviceInterface2;
+	}
+	return NULL;
+}
+
 void Plugins::findPlugins()
 {
     //Load static plugins
@@ -100,6 +109,7 @@ void Plugins::findPlugins()
         } else {
             DigitalModemInterface *iDigitalModem = qobject_cast<DigitalModemInterface *>(plugin);
 			DeviceInterface *iDeviceInterface = qobject_cast<DeviceInterface *>(plugin);
+			DeviceInterface2 *iDeviceInterface2 = qobject_cast<DeviceInterface2 *>(plugin);
             if (iDigitalModem) {
                 //plugin supports interface
                 pluginInfo.type = PluginInfo::MODEM_PLUGIN;
@@ -109,6 +119,7 @@ void Plugins::findPlugins()
                 pluginInfo.deviceNumber  = 0;
                 pluginInfo.modemInterface = iDigitalModem;
                 pluginInfo.deviceInterface = NULL;
+                pluginInfo.deviceInterface2 = NULL;
                 pluginInfoList.append(pluginInfo);
             }
             if (iDeviceInterface) {
@@ -121,6 +132,7 @@ void Plugins::findPlugins()
 				pluginInfo.description = iDeviceInterface->get(DeviceInterface::Key_PluginDescription).toString();
 				pluginInfo.fileName = fileName;
 				pluginInfo.deviceInterface = iDeviceInterface;
+				pluginInfo.deviceInterface2 = iDeviceInterface2;
 				pluginInfo.modemInterface = NULL;
 				pluginInfoList.append(pluginInfo);
             }
@@ -12,6 +12,8 @@
 #include "digital_modem_interfaces.h"
 #include "device_interfaces.h"
 
+class Receiver;
+
 struct PluginInfo
 {
 	enum PluginType {MODEM_PLUGIN, DEVICE_PLUGIN, MODEM_PSEUDO_PLUGIN};
@@ -22,6 +24,7 @@ struct PluginInfo
     quint16 deviceNumber; //Combined with filename to reference multiple devices in one plugin
     DigitalModemInterface *modemInterface;
 	DeviceInterface *deviceInterface;
+	DeviceInterface2 *deviceInterface2; //Same object if device supports V2, else NULL
 };
 //Add to QT metatype so we can use QVariants with this in UI lists
 //QVariant v; v.setValue(p);
@@ -40,6 +43,8 @@ public:
 
     DigitalModemInterface *GetModemInterface(QString name);
 	DeviceInterface *GetDeviceInterface(QString name);
+	//NULL if device is V1 only
+	DeviceInterface2 *GetDeviceInterface2(DeviceInterface *_device);
 
 private:
     void findPlugins();
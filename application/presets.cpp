@@ -3,6 +3,17 @@
 #include "presets.h"
 #include <QMenu>
 #include <QMessageBox>
+#include <QDataStream>
+
+//eibi.cache header, bump version if Station or the stream format changes
+const quint32 c_eibiCacheMagic = 0x45494249; //"EIBI"
+const quint32 c_eibiCacheVersion = 1;
+//Smallest possible record is freq (8 bytes) and 10 null QStrings (4 bytes each)
+const qint64 c_eibiCacheMinRecordBytes = 8 + 10 * 4;
+//Smallest possible csv line is 10 ';' and a newline
+const qint64 c_eibiCsvMinLineBytes = 11;
+//Current eibi.csv has ~10K stations, anything near this is a corrupt cache
+const qint32 c_eibiMaxStations = 1000000;
 
 Presets::Presets(ReceiverWidget *w)
 {
@@ -11,6 +22,7 @@ Presets::Presets(ReceiverWidget *w)
 	memoryFile = global->pebbleDataPath + "memory.csv";
 	bandsFile = global->pebbleDataPath + "bands.csv";
 	eibiFile = global->pebbleDataPath + "eibi.csv";
+	eibiCacheFile = global->pebbleDataPath + "eibi.cache";
 
     bands = NULL;
     stations = NULL;
@@ -174,32 +186,24 @@ bool Presets::ReadBands()
         bands[i].bandIndex = i; //back ref to position in bands[]
     }
     file.close();
+    freqIndex.buildBands(bands, numBands);
     return true;
 }
 
 Band *Presets::FindBand(double freq)
 {
-    if (bands == NULL || freq==0)
+    int i = FindBandIndex(freq);
+    if (i < 0)
         return NULL;
-
-    //Brute force, first only for now
-    for (int i=0; i<numBands; i++) {
-		if (freq >= bands[i].low && freq <= bands[i].high)
-            return &bands[i];
-    }
-    return NULL;
+    return &bands[i];
 }
 int Presets::FindBandIndex(double freq)
 {
     if (bands == NULL || freq==0)
         return -1;
 
-    //Brute force, first only for now
-    for (int i=0; i<numBands; i++) {
-		if (freq >= bands[i].low && freq <= bands[i].high)
-            return i;
-    }
-    return -1;
+    //First match in bands.csv order
+    return freqIndex.findBand(freq);
 }
 
 int Presets::GetNumBands()
@@ -221,21 +225,13 @@ bool Presets::ReadStations()
     if (bands == NULL)
         return false;
 
-    QFile fEibi(eibiFile);
-    if (!fEibi.open(QIODevice::ReadOnly))// | QIODevice::Text))
-        return false;
-    //How many lines in file
-    numEibi = csvCountLines(&fEibi);
-    if (numEibi <= 1) {
-        //bands.csv must have at least on line plus header
-        numEibi = 0;
-        fEibi.close();
-        return false;
+    QVector<Station> eibi;
+    if (!ReadEibiCache(eibi)) {
+        if (!ReadEibiCSV(eibi))
+            return false;
+        WriteEibiCache(eibi);
     }
-    //1st line is header, don't count
-    numEibi--;
-    //Reset stream
-    fEibi.seek(0);
+    numEibi = eibi.count();
 
     QFile fMemory(memoryFile);
     if (!fMemory.open(QIODevice::ReadOnly))// | QIODevice::Text))
@@ -263,31 +259,14 @@ bool Presets::ReadStations()
     stations = new Station[numStations];
     memories = new Station[maxMemory];  //More than we need
 
-    //Read file into memory, throw away header line
-    line = csvReadLine(&fEibi);
-    //qDebug("Bands: %s",line);
-    parts = csvSplit(line, ';');
-    //Header has an extra ';' in file, don't check exact count, just min
-    if (parts.count() < 11) {
-        fEibi.close();
-        return false; //Not right # columns
-    }
-
     int bandIndex;
     int stationIndex;
 
     //Process eibi.csv file first.  Then can be updated with new downloads
     for (int i=0; i<numEibi; i++)
     {
-        line = csvReadLine(&fEibi);
-        //Need to handle escaped delimiters, delimiters in string quotes
-        parts = csvSplit(line, ';');
-
-        if (parts.count() != 11)
-            continue; //Skip invalid line, should have 7 elements
-
         stationIndex = i;
-        AddStation(stations, stationIndex, parts);
+        stations[stationIndex] = eibi[i];
 
         //Find band for each station
         bandIndex = FindBandIndex(stations[stationIndex].freq);
@@ -341,12 +320,125 @@ bool Presets::ReadStations()
         }
     }
 
-    fEibi.close();
+    freqIndex.buildStations(stations, numStations);
+
     fMemory.close();
     return true;
 
 }
 
+bool Presets::ReadEibiCSV(QVector<Station> &eibi)
+{
+    QFile fEibi(eibiFile);
+    if (!fEibi.open(QIODevice::ReadOnly))// | QIODevice::Text))
+        return false;
+    //How many lines in file
+    int numLines = csvCountLines(&fEibi);
+    if (numLines <= 1) {
+        //eibi.csv must have at least on line plus header
+        fEibi.close();
+        return false;
+    }
+    //1st line is header, don't count
+    numLines--;
+
+    QString line;
+    QStringList parts;
+    //Read file into memory, throw away header line
+    line = csvReadLine(&fEibi);
+    parts = csvSplit(line, ';');
+    //Header has an extra ';' in file, don't check exact count, just min
+    if (parts.count() < 11) {
+        fEibi.close();
+        return false; //Not right # columns
+    }
+
+    Station s;
+    eibi.clear();
+    eibi.reserve(numLines);
+    for (int i=0; i<numLines; i++)
+    {
+        line = csvReadLine(&fEibi);
+        //Need to handle escaped delimiters, delimiters in string quotes
+        parts = csvSplit(line, ';');
+
+        if (parts.count() != 11)
+            continue; //Skip invalid line, should have 11 elements
+
+        AddStation(&s, 0, parts);
+        eibi.append(s);
+    }
+    fEibi.close();
+    return true;
+}
+
+//Cache is only valid for the exact eibi.csv it was built from, size and timestamp must match
+bool Presets::ReadEibiCache(QVector<Station> &eibi)
+{
+    QFileInfo csvInfo(eibiFile);
+    if (!csvInfo.exists())
+        return false;
+    QFile file(eibiCacheFile);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic;
+    quint32 version;
+    qint64 csvSize;
+    qint64 csvModified;
+    qint32 count;
+    in >> magic >> version >> csvSize >> csvModified >> count;
+    if (in.status() != QDataStream::Ok || magic != c_eibiCacheMagic || version != c_eibiCacheVersion ||
+            csvSize != csvInfo.size() || csvModified != csvInfo.lastModified().toMSecsSinceEpoch() || count <= 0) {
+        file.close();
+        return false;
+    }
+    //Don't trust count, a truncated or damaged cache could have us allocate gigabytes.  Caller rebuilds from csv
+    if (count > c_eibiMaxStations || count > csvSize / c_eibiCsvMinLineBytes ||
+            count > (file.size() - file.pos()) / c_eibiCacheMinRecordBytes) {
+        qDebug()<<"EiBi cache station count"<<count<<"doesn't match file, rebuilding";
+        file.close();
+        return false;
+    }
+
+    eibi.resize(count);
+    for (int i=0; i<count && in.status() == QDataStream::Ok; i++) {
+        Station &s = eibi[i];
+        in >> s.freq >> s.time >> s.days >> s.itu >> s.station >> s.language >> s.target >> s.remarks >>
+            s.p >> s.start >> s.stop;
+    }
+    file.close();
+    if (in.status() != QDataStream::Ok) {
+        eibi.clear();
+        return false;
+    }
+    return true;
+}
+
+//Best effort, if PebbleData isn't writable we just parse the csv every time like we used to
+void Presets::WriteEibiCache(const QVector<Station> &eibi)
+{
+    QFileInfo csvInfo(eibiFile);
+    QFile file(eibiCacheFile);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << c_eibiCacheMagic << c_eibiCacheVersion << (qint64)csvInfo.size() <<
+        (qint64)csvInfo.lastModified().toMSecsSinceEpoch() << (qint32)eibi.count();
+    for (int i=0; i<eibi.count(); i++) {
+        const Station &s = eibi[i];
+        out << s.freq << s.time << s.days << s.itu << s.station << s.language << s.target << s.remarks <<
+            s.p << s.start << s.stop;
+    }
+    file.close();
+    if (out.status() != QDataStream::Ok)
+        file.remove(); //Don't leave a partial cache behind
+}
+
 void Presets::AddStation(Station *s, int i, QStringList parts)
 {
     s[i].freq = parts[Station::KHZ].toDouble()*1000;
@@ -377,16 +469,16 @@ QList<Station> Presets::FindStation(double currentFreq, int fRange)
     double fKhz = trunc(currentFreq / 1000);
     double fKhzTemp;
     Band *b = FindBand(currentFreq);
-    int stationIndex;
     Station s;
 
     if (b != NULL) {
-        int numS = b->numStations;
-        for (int i=0; i < numS; i++) {
-            stationIndex = b->stations[i];
-            if (stationIndex < 0)
-                continue; //Invalid
-            s = stations[stationIndex];
+        //Any freq that truncates to fKhz +/- fRange, then same band and kHz check as before
+        QVector<int> span;
+        freqIndex.findStations((fKhz - fRange) * 1000, (fKhz + fRange + 1) * 1000, QDateTime(), span);
+        for (int i=0; i < span.count(); i++) {
+            s = stations[span[i]];
+            if (s.bandIndex != b->bandIndex)
+                continue;
             //Check if within range
             fKhzTemp = trunc(s.freq / 1000);
             if ((fKhz >= fKhzTemp - fRange) && (fKhz <= fKhzTemp + fRange))
@@ -396,6 +488,15 @@ QList<Station> Presets::FindStation(double currentFreq, int fRange)
     return stationList;
 }
 
+QVector<int> Presets::FindStationsInSpan(double lowFreq, double highFreq, bool onAirNow)
+{
+    QVector<int> span;
+    if (stations == NULL)
+        return span;
+    freqIndex.findStations(lowFreq, highFreq, onAirNow ? QDateTime::currentDateTimeUtc() : QDateTime(), span);
+    return span;
+}
+
 Band::BANDTYPE Presets::StringToBandType(QString s)
 {
     if (s.compare("HAM",Qt::CaseInsensitive)==0)
@@ -6,6 +6,7 @@
 #include <QtCore>
 #include "receiverwidget.h"
 #include "demod.h"
+#include "stationindex.h"
 
 /*
     EIBI CSV format - semi-colon delimted file
@@ -107,6 +108,8 @@ public:
 
     bool ReadStations();
     QList<Station> FindStation(double currentFreq, int fRange = 0);
+    //Indexes into GetStations() between lowFreq and highFreq, optionally only those on the air now
+    QVector<int> FindStationsInSpan(double lowFreq, double highFreq, bool onAirNow = true);
     Station *GetStations(){return stations;}
 
     Band::BANDTYPE StringToBandType(QString s);  //Converts string from file to type
@@ -133,8 +136,16 @@ private:
     void AddStation(Station *s, int i, QStringList parts);
 
     QString eibiFile;
+    QString eibiCacheFile;
     int numEibi;
 
+    //eibi.csv is ~10k lines, parse once and keep a binary copy until the csv changes
+    bool ReadEibiCache(QVector<Station> &eibi);
+    void WriteEibiCache(const QVector<Station> &eibi);
+    bool ReadEibiCSV(QVector<Station> &eibi);
+
+    StationIndex freqIndex;
+
     Station *stations; //eibi.csv + memory.csv
     int numStations;
 
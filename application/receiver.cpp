@@ -6,20 +6,27 @@
 #include "processstep.h"
 #include "testbench.h"
 #include "db.h"
+#include "deviceinterfacebase.h" //iqBlockToCPX()
+#include "fftregistry.h"
+#include "fastmath.h"
+#include <QDateTime>
 
 /*
 Core receiver logic, coordinates soundcard, fft, demod, etc
 */
-Receiver::Receiver(ReceiverWidget *rw, QMainWindow *main)
+Receiver::Receiver(ReceiverContext *_context, ReceiverWidget *rw)
 {
+	m_context = _context;
+	m_context->receiver = this;
 	m_useDemodDecimator = true;
 	m_useDemodWfmDecimator = true;
+	m_useFreqDomainFrontEnd = true;
 
 	//Read ini file or set defaults if no ini file exists
-	m_settings = global->settings;
+	m_settings = m_context->settings;
 	m_plugins = new Plugins(this,m_settings);
 
-	m_mainWindow = main;
+	m_mainWindow = m_context->mainWindow;
 	m_receiverWidget = rw;
 
 	QRect pos;
@@ -41,6 +48,21 @@ Receiver::Receiver(ReceiverWidget *rw, QMainWindow *main)
     dir.mkdir("PebbleRecordings");
 	m_recordingPath += "/PebbleRecordings/";
 
+	//Names are what Settings::m_probeCapture matches
+	m_probeHub = new ProbeHub();
+	m_probeRawIQ = m_probeHub->addPoint(TB_RAW_IQ, "Incoming");
+	m_probePostMixer = m_probeHub->addPoint(TB_POST_MIXER, "PostMixer");
+	m_probePostBp = m_probeHub->addPoint(TB_POST_BP, "PostBandpass");
+	m_probePostDemod = m_probeHub->addPoint(TB_POST_DEMOD, "PostDemod");
+	m_probeModem = m_probeHub->addPoint(TB_MODEM, "Modem");
+	m_captureSink = NULL;
+	m_captureStats = NULL;
+	m_context->testBench->setProbeHub(m_probeHub);
+
+	m_latencyTest = new LatencyTest();
+	connect(m_latencyTest, SIGNAL(finished(QString)), this, SLOT(latencyTestFinished(QString)));
+	m_iqBlockHoldover = 0;
+
 	//ReceiverWidget link back
 	m_receiverWidget->setReceiver(this);
 	QStringList welcome;
@@ -64,6 +86,7 @@ Receiver::Receiver(ReceiverWidget *rw, QMainWindow *main)
 	m_demod = NULL;
 	m_audioOutput = NULL;
 	m_bpFilter = NULL;
+	m_pendingDemodMode.store(-1);
 	m_noiseBlanker = NULL;
 	m_noiseFilter = NULL;
 	m_signalStrength = NULL;
@@ -74,11 +97,21 @@ Receiver::Receiver(ReceiverWidget *rw, QMainWindow *main)
 	m_workingBuf = NULL;
 	m_sampleBuf = NULL;
 	m_audioBuf = NULL;
+	m_demodReblocker = NULL;
+	m_wfmReblocker = NULL;
 	m_dbSpectrumBuf = NULL;
 	m_demodDecimator = NULL;
 	m_demodWfmDecimator = NULL;
-
-	m_sdrOptions = new SdrOptions();
+	m_fdFrontEnd = NULL;
+	m_dspServer = NULL;
+	m_iqRecorder = NULL;
+	m_modemRunner = NULL;
+	m_iqBlockBuf = NULL;
+	m_iqBlockFill = 0;
+	m_nextDeviceSample = 0;
+	m_deviceDroppedSamples = 0;
+
+	m_sdrOptions = new SdrOptions(m_context);
 	connect(m_sdrOptions,SIGNAL(restart()),this,SLOT(restart()));
 
     //qDebug()<<plugins->GetPluginNames();
@@ -88,6 +121,11 @@ Receiver::Receiver(ReceiverWidget *rw, QMainWindow *main)
 	m_developerMenu = new QMenu("Developer");
 	m_developerMenu->addAction("TestBench",this,SLOT(openTestBench()));
 	m_developerMenu->addAction("Device Info",this,SLOT(openDeviceAboutBox()));
+	m_developerMenu->addAction("Latency Test",this,SLOT(startLatencyTest()));
+	QAction *lowLatency = m_developerMenu->addAction("Low Latency DSP");
+	lowLatency->setCheckable(true);
+	lowLatency->setChecked(m_settings->m_lowLatency);
+	connect(lowLatency, SIGNAL(toggled(bool)), this, SLOT(lowLatencyToggled(bool)));
 	m_mainMenu->addAction(m_developerMenu->menuAction());
 	m_helpMenu = new QMenu("Help");
 	m_helpMenu->addAction("About",this,SLOT(openAboutBox())); //This will be auto-merged with Application menu on Mac
@@ -118,12 +156,12 @@ bool Receiver::turnPowerOn()
 	m_powerOn = true;
 
 	//We need SDR* for transition
-	m_sdr = global->sdr;
+	m_sdr = m_context->sdr;
 	if (m_sdr == NULL)
         return false; //Means something is wrong with plugins,
 
 	//If plugin has multiple devices, we need to set the last one used
-	m_sdr->set(DeviceInterface::Key_DeviceNumber,global->settings->m_sdrDeviceNumber);
+	m_sdr->set(DeviceInterface::Key_DeviceNumber,m_settings->m_sdrDeviceNumber);
 
     //Setup callback for device plugins to use when they have new IQ data
     using namespace std::placeholders;
@@ -132,10 +170,24 @@ bool Receiver::turnPowerOn()
     //bind(Method ptr, object, arg1, ... argn)
 
 	m_sdr->command(DeviceInterface::Cmd_ReadSettings,0); //Always start with most current
-	if (!m_sdr->initialize(std::bind(&Receiver::processIQData, this, _1, _2),
-						 std::bind(&Receiver::processBandscopeData, this, _1, _2),
-						 std::bind(&Receiver::processAudioData, this, _1, _2),
-						 m_settings->m_framesPerBuffer)) {
+	m_iqBlockFill = 0;
+	m_nextDeviceSample = 0;
+	m_deviceDroppedSamples = 0;
+	m_pendingDemodMode.store(-1);
+	//V2 devices hand us IQBlocks with a sample counter, older ones call processIQData directly
+	DeviceInterface2 *sdr2 = m_plugins->GetDeviceInterface2(m_sdr);
+	bool initialized;
+	if (sdr2 != NULL)
+		initialized = sdr2->initialize2(std::bind(&Receiver::processIQBlock, this, _1),
+										std::bind(&Receiver::processBandscopeData, this, _1, _2),
+										std::bind(&Receiver::processAudioData, this, _1, _2),
+										m_settings->m_framesPerBuffer);
+	else
+		initialized = m_sdr->initialize(std::bind(&Receiver::processIQData, this, _1, _2),
+										std::bind(&Receiver::processBandscopeData, this, _1, _2),
+										std::bind(&Receiver::processAudioData, this, _1, _2),
+										m_settings->m_framesPerBuffer);
+	if (!initialized) {
 		turnPowerOff();
 		return false;
 	}
@@ -148,7 +200,9 @@ bool Receiver::turnPowerOn()
 
 	m_sampleRate = m_demodSampleRate = m_sdr->get(DeviceInterface::Key_SampleRate).toInt();
 	m_framesPerBuffer = m_demodFrames = m_settings->m_framesPerBuffer;
-	global->testBench->initProcessSteps(m_sampleRate, m_framesPerBuffer);
+	m_context->testBench->initProcessSteps(m_sampleRate, m_framesPerBuffer);
+
+	m_iqRecorder = new IQRecorder(m_sampleRate, qMax(0, m_settings->m_recordHistorySecs));
 
     //These steps work on full sample rates
 	m_noiseBlanker = new NoiseBlanker(m_sampleRate,m_framesPerBuffer);
@@ -199,6 +253,16 @@ bool Receiver::turnPowerOn()
 
 	}
 
+	if (m_useFreqDomainFrontEnd) {
+		//Same output rate as above, but mixing and decimation are done on one input rate FFT
+		m_fdFrontEnd = new FreqDomainFrontEnd(m_sampleRate, m_demodSampleRate, m_framesPerBuffer);
+		if (!m_fdFrontEnd->isValid()) {
+			//Rate we can't handle, use time domain mixer and decimator
+			delete m_fdFrontEnd;
+			m_fdFrontEnd = NULL;
+		}
+	}
+
 	//audioOutRate can be fixed by remote devices, default to 11025 which is a rate supported by QTAudio and PortAudio on Mac
 	m_audioOutRate = m_sdr->get(DeviceInterface::Key_AudioOutputSampleRate).toUInt();
 	//audioOutRate = demodSampleRate;
@@ -218,7 +282,7 @@ bool Receiver::turnPowerOn()
 	}
 
     //We need original sample rate, and post mixer sample rate for zoomed spectrum
-	m_signalSpectrum = new SignalSpectrum(m_sampleRate, m_demodSampleRate, m_framesPerBuffer);
+	m_signalSpectrum = new SignalSpectrum(m_context, m_sampleRate, m_demodSampleRate, m_framesPerBuffer);
 
     //Init demod with defaults
     //Demod uses variable frame size, up to framesPerBuffer
@@ -228,16 +292,28 @@ bool Receiver::turnPowerOn()
 	m_demod = new Demod(m_demodSampleRate, m_demodWfmSampleRate,m_framesPerBuffer); //Can't change rate later, fix
 
     //demodFrames = demodSampleRate / (1.0 * sampleRate) * framesPerBuffer; //Temp Hack
-    //post mixer/downconvert frames are now the same as pre
+    //post mixer/downconvert frames are the same as pre, unless we're in the low latency profile
+	//Throughput: 2048 samples at a 48k demod rate is 43ms of audio before the chain even starts
+	//Low latency: 256 is 5ms, bandpass uses a matching short partition, see BandPassFilter
 	m_demodFrames = m_framesPerBuffer;
+	if (m_settings->m_lowLatency) {
+		int frames = m_settings->m_lowLatencyFrames;
+		if (frames >= 64 && frames < m_framesPerBuffer && (frames & (frames - 1)) == 0)
+			m_demodFrames = frames;
+		else
+			qDebug()<<"LowLatencyFrames must be a power of 2 from 64 to"<<m_framesPerBuffer<<", using"<<m_framesPerBuffer;
+	}
 
     //Sets the Mixer NCO frequency
     //downConvert.SetFrequency(-RDS_FREQUENCY);
 
 	m_workingBuf = memalign(m_framesPerBuffer);
-	m_sampleBuf = memalign(m_framesPerBuffer);
+	m_sampleBuf = memalign(m_demodFrames);
 	m_audioBuf = memalign(m_framesPerBuffer);
-	m_sampleBufLen = 0;
+	m_iqBlockBuf = memalign(m_framesPerBuffer);
+	//Decimators never return more than they were given
+	m_demodReblocker = new Reblocker(m_demodFrames, m_framesPerBuffer);
+	m_wfmReblocker = new Reblocker(m_framesPerBuffer, m_framesPerBuffer);
 	m_dbSpectrumBuf = new double[m_framesPerBuffer];
 
 	m_presets = new Presets(m_receiverWidget);
@@ -257,6 +333,7 @@ bool Receiver::turnPowerOn()
 			m_receiverWidget, SLOT(newSignalStrength(double,double,double,double,double)));
 
 	m_iDigitalModem = NULL;
+	m_modemRunner = new ModemRunner(m_framesPerBuffer);
 
 	m_bpFilter = new BandPassFilter(m_demodSampleRate, m_demodFrames);
 	m_bpFilter->enableStep(true);
@@ -270,8 +347,24 @@ bool Receiver::turnPowerOn()
 	m_converterMode = m_sdr->get(DeviceInterface::Key_ConverterMode).toBool();
 	m_converterOffset = m_sdr->get(DeviceInterface::Key_ConverterOffset).toDouble();
 
+	if (m_settings->m_dspServerPort > 0) {
+		if (m_fdFrontEnd == NULL) {
+			qDebug()<<"Receiver: dsp server needs the frequency domain front end, not started";
+		} else {
+			//Clients get the same decimation loss correction as processDemodBlock()
+			quint32 decimationLoss = m_demodDecimator != NULL ? m_demodDecimator->decBy2Stages() : 0;
+			m_dspServer = new DspServer(m_fdFrontEnd, m_sampleRate, m_demodSampleRate, m_demodWfmSampleRate,
+				m_framesPerBuffer, DB::dBToAmplitude(decimationLoss * 2));
+			if (!m_dspServer->listen(m_settings->m_dspServerPort, m_settings->m_dspServerMaxClients)) {
+				delete m_dspServer;
+				m_dspServer = NULL;
+			}
+		}
+	}
+
 	//This should always be last because it starts samples flowing through the processBlocks
 	m_audioOutput->StartOutput(m_sdr->get(DeviceInterface::Key_OutputDeviceName).toString(), m_audioOutRate);
+	startCaptureProbe();
 	m_sdr->command(DeviceInterface::Cmd_Start,0);
 
     //Don't set title until we connect and start.
@@ -295,7 +388,7 @@ void Receiver::setWindowTitle()
 
 void Receiver::openTestBench()
 {
-	TestBench *testBench = global->testBench;
+	TestBench *testBench = m_context->testBench;
 
 	testBench->init(); //Sets up last device settings used
 	//Anchor in upper left
@@ -341,6 +434,9 @@ void Receiver::openAboutBox()
 #ifdef USE_FFTACCELERATE
 	welcome += "\nDSP = Mac Accelerate";
 #endif
+	welcome += "\n";
+	welcome += FFTRegistry::report();
+	welcome += FastMath::check();
 #ifdef USE_QT_AUDIO
 	welcome += "\nAUDIO = QT Audio";
 #endif
@@ -401,6 +497,7 @@ bool Receiver::turnPowerOff()
 {
 
 	m_powerOn = false;
+	m_latencyTest->cancel();
 
     //If we're closing app, don't bother to set title, crashes sometime
     QWidget *app = QApplication::activeWindow();
@@ -413,7 +510,7 @@ bool Receiver::turnPowerOff()
 		m_sdrOptions->showSdrOptions(m_sdr, false);
 
 	if (m_isRecording) {
-		m_recordingFile.Close();
+		m_iqRecorder->stopRecording();
 		m_isRecording = false;
     }
 	//Carefull with order of shutting down
@@ -426,6 +523,7 @@ bool Receiver::turnPowerOff()
     }
 	if (m_audioOutput != NULL)
 		m_audioOutput->Stop();
+	stopCaptureProbe();
 
 	//m_iDigitalModem = NULL;
 
@@ -441,6 +539,11 @@ bool Receiver::turnPowerOff()
 		//delete sdr;
 		m_sdr = NULL;
 	}
+	//Before the front end its clients have channels on
+	if (m_dspServer != NULL) {
+		delete m_dspServer;
+		m_dspServer = NULL;
+	}
 	if (m_demodDecimator != NULL) {
 		delete m_demodDecimator;
 		m_demodDecimator = NULL;
@@ -449,6 +552,18 @@ bool Receiver::turnPowerOff()
 		delete m_demodWfmDecimator;
 		m_demodWfmDecimator = NULL;
 	}
+	if (m_fdFrontEnd != NULL) {
+		delete m_fdFrontEnd;
+		m_fdFrontEnd = NULL;
+	}
+	if (m_iqRecorder != NULL) {
+		delete m_iqRecorder;
+		m_iqRecorder = NULL;
+	}
+	if (m_modemRunner != NULL) {
+		delete m_modemRunner; //Stops modem worker
+		m_modemRunner = NULL;
+	}
 	if (m_demod != NULL) {
 		delete m_demod;
 		m_demod = NULL;
@@ -512,10 +627,24 @@ bool Receiver::turnPowerOff()
 		free (m_sampleBuf);
 		m_sampleBuf = NULL;
     }
+	if (m_demodReblocker != NULL) {
+		delete m_demodReblocker;
+		m_demodReblocker = NULL;
+	}
+	if (m_wfmReblocker != NULL) {
+		delete m_wfmReblocker;
+		m_wfmReblocker = NULL;
+	}
 	if (m_audioBuf != NULL) {
 		free (m_audioBuf);
 		m_audioBuf = NULL;
     }
+	if (m_iqBlockBuf != NULL) {
+		free (m_iqBlockBuf);
+		m_iqBlockBuf = NULL;
+	}
+	if (m_deviceDroppedSamples > 0)
+		qDebug()<<"Receiver: device dropped "<<m_deviceDroppedSamples<<" samples";
 	if (m_dbSpectrumBuf != NULL) {
 		free (m_dbSpectrumBuf);
 		m_dbSpectrumBuf = NULL;
@@ -525,8 +654,8 @@ bool Receiver::turnPowerOff()
 void Receiver::close()
 {
 	turnPowerOff();
-	if (global->testBench->isVisible())
-		global->testBench->setVisible(false);
+	if (m_context->testBench->isVisible())
+		m_context->testBench->setVisible(false);
 	if (m_readmeView != NULL && m_readmeView->isVisible())
 		m_readmeView->setVisible(false);
 	if (m_gplView != NULL && m_gplView->isVisible())
@@ -538,6 +667,10 @@ Receiver::~Receiver(void)
 	//Delete all the plugins
 	if (m_plugins != NULL)
 		delete m_plugins;
+	m_context->testBench->setProbeHub(NULL);
+	stopCaptureProbe();
+	delete m_probeHub; //Stops probe thread
+	delete m_latencyTest;
 	//settings is deleted by pebbleii
 	//plugins (sdr) are deleted by ~Plugins()
 }
@@ -560,19 +693,21 @@ void Receiver::recToggled(bool on)
 		baseName +="kHz_";
 		baseName += QString::number(m_sampleRate/1000);
 		baseName += "kSps_";
+		QString suffix = m_settings->m_recordCompressed ? ".piq" : ".wav";
         QFileInfo fInfo;
         for (int i=1; i<1000; i++) {
-			m_recordingFileName = m_recordingPath + baseName + QString::number(i) + ".wav";
+			m_recordingFileName = m_recordingPath + baseName + QString::number(i) + suffix;
 			fInfo.setFile(m_recordingFileName);
             if (!fInfo.exists())
                 break; //Got a unique name
             //When we overrun counter, last filename will be continually overwritten
         }
 
-		m_recordingFile.OpenWrite(m_recordingFileName, m_sampleRate, m_frequency, m_demod->demodMode(), 0);
-		m_isRecording = true;
+		//Recorder writes the last RecordHistorySecs first, so the file starts before REC was pressed
+		m_isRecording = m_iqRecorder->startRecording(m_recordingFileName, m_frequency, m_demod->demodMode(),
+			m_settings->m_recordCompressed);
     } else {
-		m_recordingFile.Close();
+		m_iqRecorder->stopRecording();
 		m_isRecording = false;
     }
 }
@@ -626,6 +761,9 @@ double Receiver::setSDRFrequency(double fRequested, double fCurrent)
 	}
 	if (m_sdr->set(DeviceInterface::Key_DeviceFrequency,fRequested)) {
 		m_frequency = fRequested;
+		//Server clients keep their frequency, their offsets change
+		if (m_dspServer != NULL)
+			m_dspServer->setDeviceFrequency(m_frequency);
 	} else {
 		//Failed, return current freq without change
 		fRequested =  fCurrent;
@@ -637,24 +775,48 @@ double Receiver::setSDRFrequency(double fRequested, double fCurrent)
 }
 
 //Called by ReceiverWidget to sets demod mode and default bandpass filter for each mode
+//The new bandpass filter crossfades in (see CFastFIR), the demod and decimation chain switch in processIQData()
 void Receiver::demodModeChanged(DeviceInterface::DemodMode _demodMode)
 {
 	if(m_demod != NULL) {
+		quint32 hiResSampleRate = m_demodSampleRate;
 		if (_demodMode == DeviceInterface::dmFMM || _demodMode == DeviceInterface::dmFMS)
-			m_signalSpectrum->setSampleRate(m_sampleRate, m_demodWfmSampleRate);
-        else
-			m_signalSpectrum->setSampleRate(m_sampleRate, m_demodSampleRate);
+			hiResSampleRate = m_demodWfmSampleRate;
+		//Restarts the spectrum worker, only needed going in or out of wfm
+		if (m_signalSpectrum->getHiResSampleRate() != hiResSampleRate)
+			m_signalSpectrum->setSampleRate(m_sampleRate, hiResSampleRate);
 
-        //Demod will return new demo
-		m_demod->setDemodMode(_demodMode, m_sampleRate, m_demodSampleRate);
 		m_sdr->set(DeviceInterface::Key_LastDemodMode,_demodMode);
-		m_sampleBufLen = 0;
+		m_pendingDemodMode.store(_demodMode);
 	}
 	if (m_iDigitalModem != NULL) {
 		m_iDigitalModem->setDemodMode(_demodMode);
     }
 }
+
+//DSP thread, between blocks so no stage sees a mode change part way through
+//Wfm and narrow decimation chains are both built in turnPowerOn(), switching just picks the other one
+void Receiver::applyDemodMode(DeviceInterface::DemodMode _demodMode)
+{
+	DeviceInterface::DemodMode lastMode = m_demod->demodMode();
+	bool wasWfm = lastMode == DeviceInterface::dmFMM || lastMode == DeviceInterface::dmFMS;
+	bool isWfm = _demodMode == DeviceInterface::dmFMM || _demodMode == DeviceInterface::dmFMS;
+
+	m_demod->setDemodMode(_demodMode, m_sampleRate, m_demodSampleRate);
+	bool isCw = _demodMode == DeviceInterface::dmCWL || _demodMode == DeviceInterface::dmCWU;
+	m_agc->setLookAhead(isCw ? AGC::CW_LOOKAHEAD_MS : AGC::DEFAULT_LOOKAHEAD_MS);
+	if (wasWfm != isWfm) {
+		//Different rate from here on, samples held in the reblockers are from the other chain
+		m_demodReblocker->reset();
+		m_wfmReblocker->reset();
+		//Front end isn't fed in wfm, don't use stale history when we switch back
+		if (m_fdFrontEnd != NULL)
+			m_fdFrontEnd->reset();
+	}
+}
+
 //Called by ReceiverWidget when UI changes filter settings
+//No restart, bandpass designs are cached and swapped in with a short crossfade
 void Receiver::filterChanged(int lo, int hi)
 {
 	if (m_demod == NULL)
@@ -692,6 +854,80 @@ void Receiver::muteChanged(bool b)
 {
 	m_mute = b;
 }
+
+void Receiver::startLatencyTest()
+{
+	if (!m_powerOn) {
+		QMessageBox::information(NULL,"Pebble","Turn power on and tune an AM, SSB or CW signal with squelch open");
+		return;
+	}
+	m_latencyTest->start();
+}
+
+//Takes effect next power on, every block size dependent step is built in turnPowerOn()
+void Receiver::lowLatencyToggled(bool _on)
+{
+	m_settings->m_lowLatency = _on;
+	m_settings->writeSettings();
+	if (m_powerOn)
+		QMessageBox::information(NULL,"Pebble","Low latency DSP will be used the next time power is turned on");
+}
+
+void Receiver::latencyTestFinished(QString _report)
+{
+	qDebug()<<_report;
+	m_context->testBench->sendDebugTxt(_report);
+	QMessageBox::information(NULL,"Pebble",_report);
+}
+
+//Modem thread
+void Receiver::modemTestbench(int _length, CPX *_buf, double _sampleRate, int _profile)
+{
+	m_probeModem->tap(_buf, _length, _sampleRate, _profile);
+}
+
+void Receiver::modemTestbench(int _length, double *_buf, double _sampleRate, int _profile)
+{
+	m_probeModem->tap(_buf, _length, _sampleRate, _profile);
+}
+
+//Captures one probe point to PebbleRecordings as raw float32 without the test bench, for scripted runs
+//Settings ProbeCapture=PostBandpass for example, empty is off
+void Receiver::startCaptureProbe()
+{
+	if (m_settings->m_probeCapture.isEmpty())
+		return;
+	ProbePoint *point = m_probeHub->findPoint(m_settings->m_probeCapture);
+	if (point == NULL) {
+		qDebug()<<"Receiver: no probe point "<<m_settings->m_probeCapture;
+		return;
+	}
+	if (m_captureSink == NULL)
+		m_captureSink = new ProbeFileSink();
+	if (m_captureStats == NULL)
+		m_captureStats = new ProbeStatsSink();
+	QString fileName = m_recordingPath + "probe_" + point->name() + "_" +
+			QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss") + ".raw";
+	if (!m_captureSink->open(fileName))
+		return;
+	m_captureStats->reset();
+	m_probeHub->attach(m_captureSink, point->id());
+	m_probeHub->attach(m_captureStats, point->id());
+}
+
+void Receiver::stopCaptureProbe()
+{
+	if (m_captureSink == NULL)
+		return;
+	m_probeHub->detach(m_captureSink);
+	m_probeHub->detach(m_captureStats);
+	m_captureSink->close();
+	qDebug()<<"Receiver: capture probe "<<m_captureStats->summary();
+	delete m_captureSink;
+	m_captureSink = NULL;
+	delete m_captureStats;
+	m_captureStats = NULL;
+}
 //Called by ReceiverWidget
 void Receiver::audioGainChanged(int g)
 {
@@ -710,6 +946,9 @@ void Receiver::mixerChanged(int f)
 {
 	m_mixerFrequency = f;
 
+	if (m_fdFrontEnd != NULL)
+		m_fdFrontEnd->setMixerFrequency(f);
+
 	if (m_useDemodDecimator && m_mixer != NULL) {
 		m_mixer->setFrequency(f);
 		m_demod->resetDemod();
@@ -729,7 +968,7 @@ void Receiver::sdrOptionsPressed()
     //If power on, use active sdr to make changes
 	if (m_sdr == NULL) {
         //Power is off, create temporary one so we can set settings
-		m_sdr = global->sdr;
+		m_sdr = m_context->sdr;
     }
 	m_sdrOptions->showSdrOptions(m_sdr, true);
 }
@@ -755,6 +994,55 @@ that is disabled and not do a useless copy from IN to OUT.
 */
 
 //New ProcessBlock for device plugins
+//Device thread.  Re-blocks V2 device buffers into m_framesPerBuffer CPX blocks for processIQData
+void Receiver::processIQBlock(const IQBlock &_block)
+{
+	if (m_sdr == NULL || !m_powerOn || m_iqBlockBuf == NULL) {
+		if (_block.release != NULL)
+			_block.release(_block.owner, _block.handle);
+		return;
+	}
+
+	//Device counter includes anything it lost, so a gap is a loss even if the device didn't flag it
+	if (_block.flags & IQB_DISCONTINUITY) {
+		//Retune or restart, samples held over are from the old stream
+		m_iqBlockFill = 0;
+	} else if (_block.sampleCounter > m_nextDeviceSample) {
+		m_deviceDroppedSamples += _block.sampleCounter - m_nextDeviceSample;
+	} else if (_block.flags & IQB_DROPPED) {
+		//Device that doesn't count lost samples
+		m_deviceDroppedSamples += _block.droppedSamples;
+	}
+	m_nextDeviceSample = _block.sampleCounter + _block.numSamples;
+
+	if (_block.format == IQF_CPX && _block.numSamples == (quint32)m_framesPerBuffer && m_iqBlockFill == 0) {
+		//Same as a V1 device, no copy
+		m_iqBlockHoldover = _block.numSamples;
+		processIQData((CPX *)_block.samples, m_framesPerBuffer);
+	} else {
+		//Larger, smaller or native format blocks.  Partial block is held over until the next callback
+		quint32 offset = 0;
+		quint32 numSamples;
+		while (offset < _block.numSamples) {
+			numSamples = qMin(_block.numSamples - offset, (quint32)(m_framesPerBuffer - m_iqBlockFill));
+			DeviceInterfaceBase::iqBlockToCPX(_block, offset, numSamples, &m_iqBlockBuf[m_iqBlockFill]);
+			offset += numSamples;
+			m_iqBlockFill += numSamples;
+			if (m_iqBlockFill == (quint32)m_framesPerBuffer) {
+				//First sample of m_iqBlockBuf has been waiting for the rest of it and everything after it in _block
+				m_iqBlockHoldover = m_framesPerBuffer + _block.numSamples - offset;
+				processIQData(m_iqBlockBuf, m_framesPerBuffer);
+				m_iqBlockFill = 0;
+			}
+		}
+	}
+	m_iqBlockHoldover = 0;
+
+	//We're done with the device's buffer
+	if (_block.release != NULL)
+		_block.release(_block.owner, _block.handle);
+}
+
 void Receiver::processIQData(CPX *in, quint16 numSamples)
 {
 	if (m_sdr == NULL || !m_powerOn)
@@ -762,6 +1050,10 @@ void Receiver::processIQData(CPX *in, quint16 numSamples)
 
 	CPX *nextStep = in;
 
+	int pendingDemodMode = m_pendingDemodMode.fetchAndStoreRelaxed(-1);
+	if (pendingDemodMode >= 0)
+		applyDemodMode((DeviceInterface::DemodMode)pendingDemodMode);
+
 	//Number of samples in the buffer before each step
 	//Will change with decimation and resampling
 	//Use instead of numSamples
@@ -785,7 +1077,7 @@ void Receiver::processIQData(CPX *in, quint16 numSamples)
      *  2/17/13         .007035 Actual- 200k max!
      */
 
-    //global->perform.StartPerformance("ProcessBlock");
+    //m_context->perform.StartPerformance("ProcessBlock");
 
 	//We make an assumption that the number of samples we get is always equal to what we asked for.
 	//This is critical, since buffers are created and loops are generated using framesPerBuffer
@@ -794,15 +1086,26 @@ void Receiver::processIQData(CPX *in, quint16 numSamples)
 	//	audio->inBufferUnderflowCount++; //Treat like in buffer underflow
 
     //Inject signals from test bench if desired
-	global->testBench->genSweep(numSamples, nextStep);
-	global->testBench->genNoise(numSamples, nextStep);
+	if (Q_UNLIKELY(m_context->testBench->isGenerating())) {
+		m_context->testBench->genSweep(numSamples, nextStep);
+		m_context->testBench->genNoise(numSamples, nextStep);
+	}
 
-	if (m_isRecording)
-		m_recordingFile.WriteSamples(nextStep,numSamples);
+	//Returns right away unless recording or keeping history.  Disk writes happen on the recorder thread
+	if (m_iqRecorder != NULL)
+		m_iqRecorder->write(nextStep,numSamples);
 
-	global->testBench->displayData(numSamples,nextStep,m_sampleRate,TB_RAW_IQ);
+	//Latency test burst goes in after the recorder so it never ends up in a recording
+	if (Q_UNLIKELY(m_latencyTest->isActive())) {
+		//V1 devices only tell us the block had to fill
+		quint64 holdover = m_iqBlockHoldover > 0 ? m_iqBlockHoldover : numSamples;
+		m_latencyTest->processIQ(nextStep, numSamples, m_sampleRate,
+			m_mixerFrequency + (m_bpFilter->lowFreq() + m_bpFilter->highFreq()) / 2, holdover);
+	}
+
+	m_probeRawIQ->tap(nextStep, numSamples, m_sampleRate);
 
-    //global->perform.StartPerformance();
+    //m_context->perform.StartPerformance();
     /*
       3 step decimation
       1. Decimate to max spectrum, ie RTL2832 samples at >1msps
@@ -822,9 +1125,19 @@ void Receiver::processIQData(CPX *in, quint16 numSamples)
 	nextStep = m_noiseBlanker->ProcessBlock(nextStep);
 	nextStep = m_noiseBlanker->ProcessBlock2(nextStep);
 
-    //Spectrum display, in buffer is not modified
+	bool isWfm = m_demod->demodMode() == DeviceInterface::dmFMM || m_demod->demodMode() == DeviceInterface::dmFMS;
+
+	//Server clients share the front end FFT whatever mode we're in
+	bool serveClients = m_dspServer != NULL && m_dspServer->hasClients();
+	if (m_fdFrontEnd != NULL && (!isWfm || serveClients)) {
+		//Mixes and decimates for the demod chain below, and for every dsp server client
+		m_fdFrontEnd->process(nextStep, numSamples);
+	}
+    //Spectrum display, in buffer is not modified.  Just a copy, spectrum worker does the FFT
 	m_signalSpectrum->unprocessed(nextStep, numSamples);
-    //global->perform.StopPerformance(100);
+	if (serveClients)
+		m_dspServer->process(m_signalSpectrum->getUnprocessed(), m_signalSpectrum->binCount());
+    //m_context->perform.StopPerformance(100);
 
 	//Signal (Specific frequency) processing
 
@@ -843,19 +1156,17 @@ void Receiver::processIQData(CPX *in, quint16 numSamples)
 
       Solution, decimate before demod to get to 300k where sampleRate > 300k, after demod where sampleRate <300k
     */
-    double resampRate;
-
 	if (m_lastDemodFrequency != m_demodFrequency) {
 		m_signalStrength->reset(); //Start new averages
 		m_lastDemodFrequency = m_demodFrequency;
 	}
 
-    //global->perform.StartPerformance();
-	if (m_demod->demodMode() == DeviceInterface::dmFMM || m_demod->demodMode() == DeviceInterface::dmFMS) {
+    //m_context->perform.StartPerformance();
+	if (isWfm) {
         //These steps are at demodWfmSampleRate NOT demodSampleRate
         //Special handling for wide band fm
 
-		//global->perform.StartPerformance("wfm decimator");
+		//m_context->perform.StartPerformance("wfm decimator");
 		if (!m_useDemodWfmDecimator) {
 			//Replaces Mixer.cpp and mixes and decimates
 			// InLength must be a multiple of 2^N where N is the maximum decimation by 2 stages expected.
@@ -866,146 +1177,155 @@ void Receiver::processIQData(CPX *in, quint16 numSamples)
 			numStepSamples = m_demodWfmDecimator->process(nextStep, m_workingBuf, numStepSamples);
 		}
 
-		//global->perform.StopPerformance(1000);
-
-        //We are always decimating by a factor of 2
-        //so we know we can accumulate a full fft buffer at this lower sample rate
-		for (int i=0; i<numStepSamples; i++) {
-			m_sampleBuf[m_sampleBufLen++] = m_workingBuf[i];
-        }
-
-#if 1
-		if (m_sampleBufLen < m_framesPerBuffer)
-            return; //Nothing to do until we have full buffer
-		numStepSamples = m_framesPerBuffer;
-#endif
-		m_sampleBufLen = 0;
-        //Create zoomed spectrum
-		m_signalSpectrum->zoomed(m_sampleBuf, numStepSamples);
-		nextStep = m_sampleBuf;
-
-		//nextStep = m_signalStrength->tdEstimate(nextStep, numStepSamples,true,true);
-		//Calc this here, at lower sample rate, for efficiency
-		//Uses original unprocessed spectrum data
-		//There is no bandpass filter for FM, so hi and low are hard coded
-		m_avgDb = m_signalStrength->fdEstimate(m_signalSpectrum->getUnprocessed(),m_signalSpectrum->binCount(),
-				m_signalSpectrum->getSampleRate(),-100000, 100000, m_mixerFrequency);
-		//Squelch based on last avgerages
-		if (m_avgDb < m_squelchDb) {
-			//We don't need to do any other processing if signal is below squelch
-			return;
-		}
-
-		nextStep = m_demod->processBlock(nextStep, numStepSamples);
+		//m_context->perform.StopPerformance(1000);
 
-		resampRate = (m_demodWfmSampleRate*1.0) / (m_audioOutRate*1.0);
+		//Wfm always runs full framesPerBuffer blocks, low latency profile doesn't apply
+		m_wfmReblocker->write(m_workingBuf, numStepSamples);
+		while ((nextStep = m_wfmReblocker->next()) != NULL)
+			processWfmBlock(nextStep, m_framesPerBuffer);
 
     } else {
-		//DB::analyzeCPX(nextStep,numStepSamples,"Pre-Decimate");
-		//global->perform.StartPerformance();
-		if (!m_useDemodDecimator) {
-        //Replaces Mixer.cpp
-			numStepSamples = m_downConvert1.ProcessData(numStepSamples, nextStep,m_workingBuf);
+		if (m_fdFrontEnd != NULL) {
+			//Already mixed and decimated, front end buffers output until we have a full block
+			while (m_fdFrontEnd->takeFrame(m_sampleBuf, m_demodFrames))
+				processDemodBlock(m_sampleBuf, m_demodFrames);
 		} else {
-			nextStep = m_mixer->processBlock(nextStep);
-			numStepSamples = m_demodDecimator->process(nextStep, m_workingBuf, numStepSamples);
+			//DB::analyzeCPX(nextStep,numStepSamples,"Pre-Decimate");
+			//m_context->perform.StartPerformance();
+			if (!m_useDemodDecimator) {
+			//Replaces Mixer.cpp
+				numStepSamples = m_downConvert1.ProcessData(numStepSamples, nextStep,m_workingBuf);
+			} else {
+				nextStep = m_mixer->processBlock(nextStep);
+				numStepSamples = m_demodDecimator->process(nextStep, m_workingBuf, numStepSamples);
+			}
+			//m_context->perform.StopPerformance(1000);
+
+			//This is a significant change from the way we used to process post downconvert
+			//We used to process every downConvertLen samples, 32 for a 2m sdr sample rate
+			//Which didn't work when we added zoomed spectrum, we need full framesPerBuffer to get same fidelity as unprocessed
+			//One that worked, it didn't make any sense to process smaller chunks through the rest of the chain!
+			//Low latency profile goes back to smaller chunks, m_demodFrames, and re-blocks for the zoomed spectrum
+
+			//Accumulate decimator output into m_demodFrames blocks, may be none or several per call
+			m_demodReblocker->write(m_workingBuf, numStepSamples);
+			while ((nextStep = m_demodReblocker->next()) != NULL)
+				processDemodBlock(nextStep, m_demodFrames);
 		}
-		//global->perform.StopPerformance(1000);
+    }
+}
 
-		//This is a significant change from the way we used to process post downconvert
-        //We used to process every downConvertLen samples, 32 for a 2m sdr sample rate
-        //Which didn't work when we added zoomed spectrum, we need full framesPerBuffer to get same fidelity as unprocessed
-        //One that worked, it didn't make any sense to process smaller chunks through the rest of the chain!
+//Wfm chain at m_demodWfmSampleRate, full m_framesPerBuffer blocks
+void Receiver::processWfmBlock(CPX *in, int numSamples)
+{
+	CPX *nextStep = in;
+	quint32 numStepSamples = numSamples;
 
-        //We are always decimating by a factor of 2
-        //so we know we can accumulate a full fft buffer at this lower sample rate
-		for (int i=0; i<numStepSamples; i++) {
-			m_sampleBuf[m_sampleBufLen++] = m_workingBuf[i];
-        }
+	//Create zoomed spectrum
+	m_signalSpectrum->zoomed(nextStep, numStepSamples);
+
+	//nextStep = m_signalStrength->tdEstimate(nextStep, numStepSamples,true,true);
+	//Calc this here, at lower sample rate, for efficiency
+	//Uses original unprocessed spectrum data
+	//There is no bandpass filter for FM, so hi and low are hard coded
+	m_avgDb = m_signalStrength->fdEstimate(m_signalSpectrum->getUnprocessed(),m_signalSpectrum->binCount(),
+			m_signalSpectrum->getSampleRate(),-100000, 100000, m_mixerFrequency);
+	//Squelch based on last avgerages
+	if (m_avgDb < m_squelchDb) {
+		//We don't need to do any other processing if signal is below squelch
+		return;
+	}
 
-		//Build full frame buffer
-		if (m_sampleBufLen < m_framesPerBuffer)
-            return; //Nothing to do until we have full buffer
-		numStepSamples = m_framesPerBuffer;
-		m_sampleBufLen = 0;
-		nextStep = m_sampleBuf;
-
-		//Restore gain lost in decimation
-		//https://www.intersil.com/content/dam/Intersil/documents/an94/an9401.pdf
-		quint32 decimationLoss = m_demodDecimator->decBy2Stages();
-		//3db per stage, but use 2db for some headroom
-		//Note: not clear to me if decimation affects time domain signal amplitude or just FFT power?
-		scaleCPX(nextStep,nextStep,DB::dBToAmplitude(decimationLoss * 2),numStepSamples);
-
-		//Create zoomed spectrum
-		//global->perform.StartPerformance("Signal Spectrum Zoomed");
-		m_signalSpectrum->zoomed(nextStep, numStepSamples);
-		//global->perform.StopPerformance(100);
-
-		global->testBench->displayData(numStepSamples,nextStep,m_demodSampleRate,TB_POST_MIXER);
-
-        //global->perform.StartPerformance();
-
-		//global->perform.StartPerformance("Band Pass Filter");
-		nextStep = m_bpFilter->process(nextStep, numStepSamples);
-		//global->perform.StopPerformance(100);
-
-		global->testBench->displayData(numStepSamples,nextStep,m_demodSampleRate,TB_POST_BP);
-
-		//If squelch is set, and we're below threshold and should set output to zero
-		//Do this in SignalStrength, since that's where we're calculating average signal strength anyway
-		//Calc this here, at lower sample rate, for efficiency
-		//Uses original unprocessed spectrum data
-		m_avgDb = m_signalStrength->fdEstimate(m_signalSpectrum->getUnprocessed(),m_signalSpectrum->binCount(),
-				m_signalSpectrum->getSampleRate(),m_bpFilter->lowFreq(), m_bpFilter->highFreq(), m_mixerFrequency);
-		//Squelch based on last avgerages
-		if (m_avgDb < m_squelchDb) {
-			//We don't need to do any other processing if signal is below squelch
-			return;
-		}
+	nextStep = m_demod->processBlock(nextStep, numStepSamples);
 
-        //Tune only mode, no demod or output
-		if (m_demod->demodMode() == DeviceInterface::dmNONE){
-			clearCPX(m_audioBuf,m_framesPerBuffer);
-            return;
-        }
+	outputAudio(nextStep, numStepSamples, (m_demodWfmSampleRate*1.0) / (m_audioOutRate*1.0));
+}
 
-		//global->perform.StartPerformance("Noise Filter");
-		nextStep = m_noiseFilter->ProcessBlock(nextStep);
-		//global->perform.StopPerformance(100);
+//Everything except wfm, at m_demodSampleRate in m_demodFrames blocks
+void Receiver::processDemodBlock(CPX *in, int numSamples)
+{
+	CPX *nextStep = in;
+	quint32 numStepSamples = numSamples;
 
-		//Test giving data plugins full post mixer buffer, with TD and FD buffers
-		//Before AGC so levels are stable
-		if (m_iDigitalModem != NULL)
-			nextStep = m_iDigitalModem->processBlock(nextStep);
+	//Restore gain lost in decimation
+	//https://www.intersil.com/content/dam/Intersil/documents/an94/an9401.pdf
+	quint32 decimationLoss = m_demodDecimator->decBy2Stages();
+	//3db per stage, but use 2db for some headroom
+	//Note: not clear to me if decimation affects time domain signal amplitude or just FFT power?
+	//Front end has unity gain, but scale the same so levels into AGC don't change between the two
+	scaleCPX(nextStep,nextStep,DB::dBToAmplitude(decimationLoss * 2),numStepSamples);
+
+	//Create zoomed spectrum
+	//m_context->perform.StartPerformance("Signal Spectrum Zoomed");
+	//Worker takes the last m_framesPerBuffer samples, so short low latency blocks are fine
+	m_signalSpectrum->zoomed(nextStep, numStepSamples);
+	//m_context->perform.StopPerformance(100);
+
+	m_probePostMixer->tap(nextStep, numStepSamples, m_demodSampleRate);
+
+	//m_context->perform.StartPerformance();
+
+	//m_context->perform.StartPerformance("Band Pass Filter");
+	nextStep = m_bpFilter->process(nextStep, numStepSamples);
+	//m_context->perform.StopPerformance(100);
+
+	m_probePostBp->tap(nextStep, numStepSamples, m_demodSampleRate);
+
+	//If squelch is set, and we're below threshold and should set output to zero
+	//Do this in SignalStrength, since that's where we're calculating average signal strength anyway
+	//Calc this here, at lower sample rate, for efficiency
+	//Uses original unprocessed spectrum data
+	m_avgDb = m_signalStrength->fdEstimate(m_signalSpectrum->getUnprocessed(),m_signalSpectrum->binCount(),
+			m_signalSpectrum->getSampleRate(),m_bpFilter->lowFreq(), m_bpFilter->highFreq(), m_mixerFrequency);
+	//Squelch based on last avgerages
+	if (m_avgDb < m_squelchDb) {
+		//We don't need to do any other processing if signal is below squelch
+		return;
+	}
 
-		//global->perform.StartPerformance("AGC");
-		nextStep = m_agc->processBlock(nextStep);
-		//global->perform.StopPerformance(100);
+	//Tune only mode, no demod or output
+	if (m_demod->demodMode() == DeviceInterface::dmNONE){
+		clearCPX(m_audioBuf,m_framesPerBuffer);
+		return;
+	}
 
-		//global->perform.StartPerformance("Demod");
-		nextStep = m_demod->processBlock(nextStep, numStepSamples);
-		//global->perform.StopPerformance(100);
+	//m_context->perform.StartPerformance("Noise Filter");
+	nextStep = m_noiseFilter->ProcessBlock(nextStep);
+	//m_context->perform.StopPerformance(100);
 
-		//audioCpx from here on
+	//Test giving data plugins full post mixer buffer, with TD and FD buffers
+	//Before AGC so levels are stable.  Modem runs on its own thread, we just queue a copy
+	if (m_modemRunner != NULL)
+		m_modemRunner->publish(nextStep, numStepSamples, QDateTime::currentMSecsSinceEpoch());
 
-		global->testBench->displayData(numStepSamples,nextStep,m_demodSampleRate,TB_POST_DEMOD);
+	//m_context->perform.StartPerformance("AGC");
+	nextStep = m_agc->processBlock(nextStep);
+	//m_context->perform.StopPerformance(100);
 
-		resampRate = (m_demodSampleRate*1.0) / (m_audioOutRate*1.0);
+	//m_context->perform.StartPerformance("Demod");
+	nextStep = m_demod->processBlock(nextStep, numStepSamples);
+	//m_context->perform.StopPerformance(100);
 
-    }
+	//audioCpx from here on
 
+	m_probePostDemod->tap(nextStep, numStepSamples, m_demodSampleRate);
+
+	outputAudio(nextStep, numStepSamples, (m_demodSampleRate*1.0) / (m_audioOutRate*1.0));
+}
+
+void Receiver::outputAudio(CPX *in, int numSamples, double resampRate)
+{
 	//Fractional resampler is very expensive, 1000 to 1500ms
-	//global->perform.StartPerformance("Fract Resampler");
+	//m_context->perform.StartPerformance("Fract Resampler");
 	if (resampRate != 1)
-		numStepSamples = m_fractResampler.Resample(numStepSamples,resampRate,nextStep,m_audioBuf);
+		numSamples = m_fractResampler.Resample(numSamples,resampRate,in,m_audioBuf);
 	else
-		copyCPX(m_audioBuf,nextStep,numStepSamples);
-	//global->perform.StopPerformance(100);
+		copyCPX(m_audioBuf,in,numSamples);
+	//m_context->perform.StopPerformance(100);
 
-	//global->perform.StartPerformance("Process Audio");
-	processAudioData(m_audioBuf,numStepSamples);
-	//global->perform.StopPerformance(100);
+	//m_context->perform.StartPerformance("Process Audio");
+	processAudioData(m_audioBuf,numSamples);
+	//m_context->perform.StopPerformance(100);
 }
 
 //Should be ProcessSpectrumData, using it for now
@@ -1028,89 +1348,52 @@ void Receiver::processBandscopeData(quint8 *in, quint16 numPoints)
 //Called by devices and other call backs to output audio data
 void Receiver::processAudioData(CPX *in, quint16 numSamples)
 {
+	if (Q_UNLIKELY(m_latencyTest->isActive()))
+		m_latencyTest->processAudio(in, numSamples, m_audioOutRate, m_audioOutput->outBufferLatencyMs,
+			m_audioOutput->OutputDeviceLatencyMs());
 	// apply volume setting, mute and output
-	//global->perform.StartPerformance();
+	//m_context->perform.StartPerformance();
 	m_audioOutput->SendToOutput(in,numSamples, m_gain, m_mute);
-	//global->perform.StopPerformance(100);
-}
-
-#if 0
-/*
- Alternate receive chain that does most of the processing in frequency domain
- */
-
-//!!!! Out of date and never worked properly, here for reference
-void Receiver::ProcessBlockFreqDomain(CPX *in, CPX *out, int frameCount)
-{
-    return;
-
-	CPX *nextStep = in;
-
-	//Convert to freq domain
-    fft->FFTForward(in,NULL,frameCount);
-	//fft->freqDomain is in 0 to sampleRate order, not -F to 0 to +F
-
-
-	//Frequency domain mixer?
-
-
-	//Filter in place
-	bpFilter->Convolution(fft);
-
-	//Convert back to time domain for final processing using fft internal buffers
-    fft->FFTInverse(NULL,NULL,fftSize);
-	//Do overlap/add to reduce to frameCount
-	fft->OverlapAdd(out, frameCount);
-
-	nextStep = out;
-
-	//downsample
-    //Broken after change to downconvert TBD
-//	for(int i=0,j=0; i<framesPerBuffer; i+=downSampleFactor,j++)
-//		nextStep[j] = nextStep[i];
-
-    nextStep = demod->ProcessBlock(nextStep,demodFrames);
-
-
-	if (mute)
-		clearCPX(out, demodFrames);
-	else
-		scaleCPX(out, nextStep, gain, demodFrames);
-
-    audioOutput->SendToOutput(out,demodFrames);
-
+	//m_context->perform.StopPerformance(100);
 }
-#endif
 
 void Receiver::setDigitalModem(QString _name, QWidget *_parent)
 {
     if (_name == NULL || _parent == NULL) {
+		//Stop feeding it before we tear down its UI
+		if (m_modemRunner != NULL)
+			m_modemRunner->setModem(NULL, 0);
 		if (m_iDigitalModem != NULL)
 			m_iDigitalModem->setupDataUi(NULL);
 
 		m_iDigitalModem = NULL;
         return;
     }
-	//processIQ checks m_iDigitalModem != NULL to see if modem is active
-	//Don't set it until modem has been completely set up
+	//Don't start the runner until modem has been completely set up
 	DigitalModemInterface *modem = m_plugins->GetModemInterface(_name);
 	if (modem != NULL) {
+		//Previous modem, if any, stops getting samples
+		if (m_modemRunner != NULL)
+			m_modemRunner->setModem(NULL, 0);
 
-        //Display array of CPX data in TestBench
-		connect(modem->asQObject(), SIGNAL(testbench(int, CPX*, double, int)),global->testBench,SLOT(displayData(int, CPX*, double, int)));
-
-        //Display array of double data in TestBench
-		connect(modem->asQObject(), SIGNAL(testbench(int, double*, double, int)),global->testBench,SLOT(displayData(int, double*, double, int)));
+		//Display array of CPX or double data in TestBench.  Modem emits on its own thread with buffers it will reuse,
+		//so these have to be direct, the probe copies them
+		connect(modem->asQObject(), SIGNAL(testbench(int, CPX*, double, int)),this,SLOT(modemTestbench(int, CPX*, double, int)),
+				(Qt::ConnectionType)(Qt::DirectConnection | Qt::UniqueConnection));
+		connect(modem->asQObject(), SIGNAL(testbench(int, double*, double, int)),this,SLOT(modemTestbench(int, double*, double, int)),
+				(Qt::ConnectionType)(Qt::DirectConnection | Qt::UniqueConnection));
 
-		connect(modem->asQObject(), SIGNAL(addProfile(QString,int)), global->testBench,SLOT(addProfile(QString,int)));
+		connect(modem->asQObject(), SIGNAL(addProfile(QString,int)), m_context->testBench,SLOT(addProfile(QString,int)));
 
-		connect(modem->asQObject(), SIGNAL(removeProfile(quint16)), global->testBench,SLOT(removeProfile(quint16)));
+		connect(modem->asQObject(), SIGNAL(removeProfile(quint16)), m_context->testBench,SLOT(removeProfile(quint16)));
 
 		modem->setSampleRate(m_demodSampleRate, m_demodFrames);
 		modem->setupDataUi(_parent);
 
 		//processIQ can start directing samples
 		m_iDigitalModem = modem;
+		if (m_modemRunner != NULL)
+			m_modemRunner->setModem(modem, m_demodSampleRate);
     }
 
 }
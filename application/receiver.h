@@ -2,10 +2,12 @@
 //GPL license and attributions are in gpl.h and terms are included in this file by reference
 #include "gpl.h"
 #include "global.h"
+#include "receivercontext.h"
 
 #include <QMainWindow>
 #include <QtCore/QVariant>
 #include <QMutex>
+#include <QAtomicInteger>
 #include "audio.h"
 #include "audiopa.h"
 #include "cpx.h"
@@ -26,10 +28,17 @@
 #include "fir.h"
 #include "fractresampler.h"
 #include "wavfile.h"
+#include "iqrecorder.h"
+#include "modemrunner.h"
+#include "probe.h"
+#include "latencytest.h"
+#include "reblocker.h"
 #include "sdroptions.h"
 #include "fft.h"
 #include "dcremoval.h"
 #include "decimator.h"
+#include "freqdomainfrontend.h"
+#include "dspserver.h"
 
 //Testing goertzel
 #include "goertzel.h"
@@ -44,7 +53,7 @@ class Receiver:public QObject
 	friend class SdrOptions; //Avoid lots of needless access methods for now
 
 public:
-	Receiver(ReceiverWidget *rw, QMainWindow *main);
+	Receiver(ReceiverContext *_context, ReceiverWidget *rw);
 	~Receiver(void);
 	bool turnPowerOn();
 	bool turnPowerOff();
@@ -58,6 +67,8 @@ public:
 	bool getPowerOn() {return m_powerOn;}
 
 	Settings * getSettings() {return m_settings;}
+	ReceiverContext *getContext() {return m_context;}
+	void processIQBlock(const IQBlock &_block);
 	void processIQData(CPX *in, quint16 numSamples);
 	void processBandscopeData(quint8 *in, quint16 numPoints);
 	void processAudioData(CPX *in, quint16 numSamples);
@@ -96,6 +107,12 @@ public:
 		void nb2Changed(bool b);
 		void agcModeChanged(AGC::AgcMode _mode, int _threshold);
 		void muteChanged(bool b);
+		//Modem testbench() signals, direct connection on the modem thread
+		void modemTestbench(int _length, CPX *_buf, double _sampleRate, int _profile);
+		void modemTestbench(int _length, double *_buf, double _sampleRate, int _profile);
+		void startLatencyTest();
+		void latencyTestFinished(QString _report);
+		void lowLatencyToggled(bool _on);
 
 private:
 	ReceiverWidget *m_receiverWidget;
@@ -114,12 +131,35 @@ private:
 		TB_POST_MIXER,
 		TB_POST_BP,
 		TB_POST_DEMOD,
-		TB_POST_DECIMATE
+		TB_POST_DECIMATE,
+		TB_MODEM = 1000 //Probe point only, modem blocks carry the modem's own profile
     };
 
+	//Test bench and capture taps, see probe.h
+	ProbeHub *m_probeHub;
+	ProbePoint *m_probeRawIQ;
+	ProbePoint *m_probePostMixer;
+	ProbePoint *m_probePostBp;
+	ProbePoint *m_probePostDemod;
+	ProbePoint *m_probeModem;
+	//Settings::m_probeCapture, headless capture while power is on
+	ProbeFileSink *m_captureSink;
+	ProbeStatsSink *m_captureStats;
+	void startCaptureProbe();
+	void stopCaptureProbe();
+
+	LatencyTest *m_latencyTest; //Developer menu, see latencytest.h
+
+	//processIQData() stages after decimation, one call per re-blocked block
+	void processDemodBlock(CPX *in, int numSamples);
+	void processWfmBlock(CPX *in, int numSamples);
+	void applyDemodMode(DeviceInterface::DemodMode _demodMode);
+	void outputAudio(CPX *in, int numSamples, double resampRate);
+
 	bool m_mute;
 	QMutex m_mutex;
 	bool m_powerOn;
+	ReceiverContext *m_context;
 	Settings *m_settings;
 	Presets *m_presets;
 	QMainWindow *m_mainWindow;
@@ -134,10 +174,18 @@ private:
 	AGC *m_agc;
 	IQBalance *m_iqBalance;
 	DigitalModemInterface *m_iDigitalModem; //Active digital modem if any
+	ModemRunner *m_modemRunner; //Runs m_iDigitalModem off the DSP thread
 	bool m_isRecording;
 	QString m_recordingFileName;
 	QString m_recordingPath;
-	WavFile m_recordingFile;
+	IQRecorder *m_iqRecorder; //Collects history while power is on if RecordHistorySecs > 0
+
+	//processIQBlock() state, device thread only
+	CPX *m_iqBlockBuf; //V2 blocks re-blocked to m_framesPerBuffer
+	quint32 m_iqBlockFill;
+	quint64 m_nextDeviceSample; //Expected sampleCounter of the next block
+	quint64 m_iqBlockHoldover; //Device samples since the first one in the block passed to processIQData, 0 for V1
+	quint64 m_deviceDroppedSamples;
 
 	double m_frequency; //Current LO frequency (not mixed)
 	double m_mixerFrequency;
@@ -147,6 +195,7 @@ private:
 	int m_sampleRate;
 	int m_framesPerBuffer; //#samples in each callback
 	//sample rate and buffer size after down sampling step
+	//Same as m_framesPerBuffer, or Settings::m_lowLatencyFrames in the low latency profile
 	int m_demodFrames;
 	int m_downSample2Frames;
 	FIRFilter *m_downSampleFilter;
@@ -160,14 +209,23 @@ private:
 	Decimator *m_demodWfmDecimator;
 	bool m_useDemodDecimator;
 	bool m_useDemodWfmDecimator;
+	//Mixer and demod decimator in one input rate FFT, not used for wfm
+	FreqDomainFrontEnd *m_fdFrontEnd;
+	bool m_useFreqDomainFrontEnd;
+	//ghpsdr3 compatible server, clients get channels on m_fdFrontEnd.  Settings::m_dspServerPort, NULL if off
+	DspServer *m_dspServer;
 
 	int m_audioOutRate;
 	int m_demodSampleRate;
 	int m_demodWfmSampleRate;
 	CPX *m_workingBuf;
-	CPX *m_sampleBuf; //Used to accumulate post mixer/downconvert samples to get a full buffer
+	CPX *m_sampleBuf; //m_demodFrames block from the front end
 	CPX *m_audioBuf; //Used for final audio output processing
-	quint16 m_sampleBufLen;
+	//Re-blocking between stages, see reblocker.h
+	Reblocker *m_demodReblocker; //Decimator output to m_demodFrames blocks
+	Reblocker *m_wfmReblocker; //Wfm decimator output to m_framesPerBuffer blocks
+	//Set by demodModeChanged(), processIQData() switches to it between blocks. -1 if nothing pending
+	QAtomicInteger<int> m_pendingDemodMode;
 
 	double *m_dbSpectrumBuf; //Used when spectrum is set by remote
 
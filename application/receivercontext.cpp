@@ -0,0 +1,25 @@
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "receivercontext.h"
+#include "settings.h"
+#include "testbench.h"
+
+ReceiverContext::ReceiverContext(QMainWindow *_mainWindow, QString _iniName)
+{
+	mainWindow = _mainWindow;
+	iniName = _iniName;
+	receiver = NULL;
+	sdr = NULL;
+	perform.InitPerformance();
+
+	//Settings restores test bench state, so test bench has to exist first
+	testBench = new TestBench();
+	testBench->init();
+	settings = new Settings(this); //We need these early in startup
+}
+
+ReceiverContext::~ReceiverContext()
+{
+	delete settings;
+	delete testBench;
+}
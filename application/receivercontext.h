@@ -0,0 +1,39 @@
+#ifndef RECEIVERCONTEXT_H
+#define RECEIVERCONTEXT_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include <QString>
+#include <QMainWindow>
+#include "perform.h"
+
+class Receiver;
+class Settings;
+class TestBench;
+class DeviceInterface;
+
+/*
+	Everything that belongs to one receiver and used to be in Global
+
+	Created by the window that hosts the receiver and passed to Receiver, which hands it on to SignalSpectrum,
+	SdrOptions and the widgets.  Nothing in the DSP path reaches for global-> anymore, so several receivers
+	(different devices or tunings) can run in one process, each on its own thread, sharing only plugins,
+	FFT calibration (FFTRegistry) and read only paths in Global
+
+	_iniName selects the settings file in PebbleData, "pebble" for the first receiver
+*/
+class ReceiverContext
+{
+public:
+	ReceiverContext(QMainWindow *_mainWindow, QString _iniName = "pebble");
+	~ReceiverContext();
+
+	Receiver *receiver; //Set by Receiver constructor
+	DeviceInterface *sdr; //Current device, updated whenever the user changes device selection
+	Settings *settings;
+	TestBench *testBench;
+	Perform perform;
+	QMainWindow *mainWindow; //Window geometry is saved in settings
+	QString iniName;
+};
+
+#endif // RECEIVERCONTEXT_H
@@ -20,6 +20,8 @@ ReceiverWidget::ReceiverWidget(QWidget *parent):QWidget(parent)
 void ReceiverWidget::setReceiver(Receiver *r)
 {
 	m_receiver = r;
+	m_context = m_receiver->getContext();
+	ui.spectrumWidget->setContext(m_context);
     m_presets = NULL;
 
 	m_powerOn = false;
@@ -166,12 +168,12 @@ void ReceiverWidget::setReceiver(Receiver *r)
     foreach (PluginInfo p,m_receiver->getDevicePluginInfo()) {
         v.setValue(p);
         sdrSelector->addItem(p.name,v);
-		if (p.fileName == global->settings->m_sdrDeviceFilename &&
+		if (p.fileName == m_context->settings->m_sdrDeviceFilename &&
 			p.type == PluginInfo::DEVICE_PLUGIN) {
                 cur = sdrSelector->count()-1;
 				m_sdr = p.deviceInterface;
 				m_sdr->command(DeviceInterface::Cmd_ReadSettings,0);
-				global->sdr = m_sdr;
+				m_context->sdr = m_sdr;
         }
     }
 
@@ -672,7 +674,7 @@ void ReceiverWidget::powerToggled(bool on)
 		setLoMode(true);
 
 		//Load last data plugin
-		QString pluginName = global->settings->m_dataPluginName;
+		QString pluginName = m_context->settings->m_dataPluginName;
 		quint32 dataSelection = ui.dataSelectionBox->findText(pluginName);
 		ui.dataSelectionBox->blockSignals(true);
 		ui.dataSelectionBox->setCurrentIndex(dataSelection); //Triggers connection
@@ -939,7 +941,7 @@ void ReceiverWidget::loadDataPlugin(QString pluginName)
 	m_dataSelection = ui.dataSelectionBox->itemData(dataSelection).value<PluginInfo>();
 
 	//Save for reload on next power on
-	global->settings->m_dataPluginName=pluginName;
+	m_context->settings->m_dataPluginName=pluginName;
 
 	if (pluginName == "No Data") {
 		//Data frame is always open if we get here
@@ -969,11 +971,11 @@ void ReceiverWidget::modeSelectionChanged(QString m)
 	//Todo: Work on this, still not accurately reflecting click
 	case DeviceInterface::dmCWU:
         //Subtract modeOffset from actual freq so we hear upper tone
-		m_modeOffset = -global->settings->m_modeOffset; //Same as CW decoder
+		m_modeOffset = -m_context->settings->m_modeOffset; //Same as CW decoder
 		break;
 	case DeviceInterface::dmCWL:
         //Add modeOffset to actual tuned freq so we hear lower tone
-		m_modeOffset = global->settings->m_modeOffset;
+		m_modeOffset = m_context->settings->m_modeOffset;
 		break;
 	default:
 		m_modeOffset = 0;
@@ -1153,11 +1155,11 @@ void ReceiverWidget::receiverChanged(int i)
     int cur = ui.sdrSelector->currentIndex();
     PluginInfo p = ui.sdrSelector->itemData(cur).value<PluginInfo>();
     //Replace
-	global->settings->m_sdrDeviceFilename = p.fileName;
-	global->settings->m_sdrDeviceNumber = p.deviceNumber;
+	m_context->settings->m_sdrDeviceFilename = p.fileName;
+	m_context->settings->m_sdrDeviceNumber = p.deviceNumber;
 
 	m_sdr = p.deviceInterface;
-	global->sdr = m_sdr;
+	m_context->sdr = m_sdr;
     //Close the sdr option window if open
     m_receiver->closeSdrOptions();
 }
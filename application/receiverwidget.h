@@ -72,8 +72,9 @@ protected:
 private:
 	static const quint16 MASTER_CLOCK_INTERVAL = 100; //ms
 
-	DeviceInterface *m_sdr; //global->sdr is always updated whenever the user changes device selection
+	DeviceInterface *m_sdr; //m_context->sdr is always updated whenever the user changes device selection
 	Receiver *m_receiver;
+	ReceiverContext *m_context; //Receiver we are the view for
 	QWidget *m_directInputWidget;
 	Ui::DirectInput *m_directInputUi;
 
@@ -3,8 +3,9 @@
 #include "receiver.h"
 #include <QMessageBox>
 
-SdrOptions::SdrOptions():QObject()
+SdrOptions::SdrOptions(ReceiverContext *_context):QObject()
 {
+	m_context = _context;
 	m_sdrOptionsDialog = NULL;
 	m_sd = NULL;
 	m_di = NULL;
@@ -56,9 +57,9 @@ void SdrOptions::showSdrOptions(DeviceInterface *_di, bool b)
 			m_sd->deviceSelection->addItem(m_di->get(DeviceInterface::Key_DeviceName,i).toString());
 		}
 		//Select active device
-		m_sd->deviceSelection->setCurrentIndex(global->settings->m_sdrDeviceNumber);
+		m_sd->deviceSelection->setCurrentIndex(m_context->settings->m_sdrDeviceNumber);
 		//And make sure device has same number
-		m_di->set(DeviceInterface::Key_DeviceNumber,global->settings->m_sdrDeviceNumber);
+		m_di->set(DeviceInterface::Key_DeviceNumber,m_context->settings->m_sdrDeviceNumber);
 		//And connect so we get changes
 		connect(m_sd->deviceSelection,SIGNAL(currentIndexChanged(int)),this,SLOT(deviceSelectionChanged(int)));
 
@@ -241,14 +242,14 @@ void SdrOptions::dcRemovalChanged(bool b)
 	m_dcRemove = b;
 	m_di->set(DeviceInterface::Key_RemoveDC,b);
 	m_di->command(DeviceInterface::Cmd_WriteSettings,0);
-	if (!global->receiver->getPowerOn())
+	if (!m_context->receiver->getPowerOn())
 		return;
-	global->receiver->m_dcRemove->enableStep(b);
+	m_context->receiver->m_dcRemove->enableStep(b);
 
 }
 
 void SdrOptions::deviceSelectionChanged(int i) {
-	global->settings->m_sdrDeviceNumber = i;
+	m_context->settings->m_sdrDeviceNumber = i;
 	//Set device number
 	m_di->set(DeviceInterface::Key_DeviceNumber, i); //Which ini file to read from
 	//Read settings, ReadSettings will switch on deviceNumber
@@ -320,9 +321,9 @@ void SdrOptions::balancePhaseChanged(int v)
 	m_sd->iqBalancePhaseLabel->setText("Phase: " + QString::number(newValue));
 	m_di->set(DeviceInterface::Key_IQBalancePhase, newValue);
 
-	if (!global->receiver->getPowerOn())
+	if (!m_context->receiver->getPowerOn())
 		return;
-	global->receiver->getIQBalance()->setPhaseFactor(newValue);
+	m_context->receiver->getIQBalance()->setPhaseFactor(newValue);
 	m_di->command(DeviceInterface::Cmd_WriteSettings,0);
 }
 
@@ -334,18 +335,18 @@ void SdrOptions::balanceGainChanged(int v)
 	m_di->set(DeviceInterface::Key_IQBalanceGain, newValue);
 	m_di->command(DeviceInterface::Cmd_WriteSettings,0);
 	//Update in realtime
-	if (!global->receiver->getPowerOn())
+	if (!m_context->receiver->getPowerOn())
 		return;
-	global->receiver->getIQBalance()->setGainFactor(newValue);
+	m_context->receiver->getIQBalance()->setGainFactor(newValue);
 }
 
 void SdrOptions::balanceEnabledChanged(bool b)
 {
 	m_di->set(DeviceInterface::Key_IQBalanceEnabled, b);
 	m_di->command(DeviceInterface::Cmd_WriteSettings,0);
-	if (!global->receiver->getPowerOn())
+	if (!m_context->receiver->getPowerOn())
 		return;
-	global->receiver->getIQBalance()->enableStep(b);
+	m_context->receiver->getIQBalance()->enableStep(b);
 }
 
 void SdrOptions::balanceReset()
@@ -5,11 +5,13 @@
 #include "ui_sdr.h"
 #include "audio.h"
 
+class ReceiverContext;
+
 class SdrOptions:public QObject
 {
 	Q_OBJECT
 public:
-	SdrOptions();
+	SdrOptions(ReceiverContext *_context);
 	~SdrOptions();
 	void showSdrOptions(DeviceInterface *_di, bool b);
 
@@ -37,6 +39,7 @@ signals:
 	void restart();
 
 private:
+	ReceiverContext *m_context;
 	DeviceInterface *m_di;
 
 	QDialog *m_sdrOptionsDialog;
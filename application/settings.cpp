@@ -5,15 +5,18 @@
 #include "demod.h" //For DeviceInterface::DEMODMODE
 #include "receiver.h"
 #include "testbench.h"
+#include "receivercontext.h"
+#include "fftregistry.h"
 
 
-Settings::Settings(void)
+Settings::Settings(ReceiverContext *_context)
 {
+	m_context = _context;
 	//Use ini files to avoid any registry problems or install/uninstall 
 	//Scope::UserScope puts file C:\Users\...\AppData\Roaming\N1DDY
 	//Scope::SystemScope puts file c:\ProgramData\n1ddy
 
-	m_qSettings = new QSettings(global->pebbleDataPath+"pebble.ini",QSettings::IniFormat);
+	m_qSettings = new QSettings(global->pebbleDataPath + m_context->iniName + ".ini",QSettings::IniFormat);
 	//qSettings->beginGroup("IQ");
 
 	//qSetting->endGroup("IQ");
@@ -45,7 +48,7 @@ void Settings::readSettings()
 	m_windowHeight = m_qSettings->value("windowHeight", -1).toInt();
 	m_windowWidth = m_qSettings->value("windowWidth", -1).toInt();
 	//bump tight to right
-	m_windowXPos = m_qSettings->value("windowXPos",pos.right() - global->mainWindow->minimumWidth()).toInt();
+	m_windowXPos = m_qSettings->value("windowXPos",pos.right() - m_context->mainWindow->minimumWidth()).toInt();
 	m_windowYPos = m_qSettings->value("windowYPos", pos.top()).toInt();
 
 	m_sdrDeviceFilename = m_qSettings->value("sdrDeviceFilename", "SR_V9").toString();
@@ -55,6 +58,8 @@ void Settings::readSettings()
 	m_postMixerDecimate = m_qSettings->value("PostMixerDecimate",true).toBool();
     //Be careful about changing this, has global impact
 	m_framesPerBuffer = m_qSettings->value("FramesPerBuffer",2048).toInt();
+	m_lowLatency = m_qSettings->value("LowLatency", false).toBool();
+	m_lowLatencyFrames = m_qSettings->value("LowLatencyFrames", 256).toInt();
 	//Could be UI, more bins = more resolution at zoom levels
 	m_numSpectrumBins = m_qSettings->value("NumSpectrumBins",4096).toInt();
 	//Hires spectrum is less than 100k or 50hz per bin at 2048 bins
@@ -71,28 +76,43 @@ void Settings::readSettings()
 	m_autoScaleMin = m_qSettings->value("AutoScaleMin",true).toBool();
 
 	m_updatesPerSecond = m_qSettings->value("UpdatesPerSec", 10).toInt();
+	m_largeSpectrumSize = m_qSettings->value("LargeSpectrumSize", 0).toInt();
+	m_largeSpectrumAverages = m_qSettings->value("LargeSpectrumAverages", 4).toInt();
+	m_largeSpectrumUpdateMs = m_qSettings->value("LargeSpectrumUpdateMs", 500).toInt();
+	m_recordHistorySecs = m_qSettings->value("RecordHistorySecs", 0).toInt();
+	m_recordCompressed = m_qSettings->value("RecordCompressed", false).toBool();
+	m_probeCapture = m_qSettings->value("ProbeCapture", "").toString();
+	m_dspServerPort = m_qSettings->value("DspServerPort", 0).toInt();
+	m_dspServerMaxClients = m_qSettings->value("DspServerMaxClients", 8).toInt();
 
 	m_dataPluginName = m_qSettings->value("DataPluginName","No Data").toString();
 
+	//Fastest FFT backend per (size, direction), see FFTRegistry.  Delete group to calibrate again
+	m_qSettings->beginGroup("FFT");
+	m_fftAutoTune = m_qSettings->value("AutoTune", true).toBool();
+	FFTRegistry::setAutoTune(m_fftAutoTune);
+	FFTRegistry::setResults(m_qSettings->value("Calibration").toStringList());
+	m_qSettings->endGroup();
+
 	m_qSettings->beginGroup(tr("Testbench"));
-	global->testBench->m_sweepStartFrequency = m_qSettings->value(tr("SweepStartFrequency"),0.0).toDouble();
-	global->testBench->m_sweepStopFrequency = m_qSettings->value(tr("SweepStopFrequency"),1.0).toDouble();
-	global->testBench->m_sweepRate = m_qSettings->value(tr("SweepRate"),0.0).toDouble();
-	global->testBench->m_displayRate = m_qSettings->value(tr("DisplayRate"),10).toInt();
-	global->testBench->m_vertRange = m_qSettings->value(tr("VertRange"),10000).toInt();
-	global->testBench->m_trigIndex = m_qSettings->value(tr("TrigIndex"),0).toInt();
-	global->testBench->m_trigLevel = m_qSettings->value(tr("TrigLevel"),100).toInt();
-	global->testBench->m_horzSpan = m_qSettings->value(tr("HorzSpan"),100).toInt();
-	global->testBench->m_profile = m_qSettings->value(tr("Profile"),0).toInt();
-	global->testBench->m_timeDisplay = m_qSettings->value(tr("TimeDisplay"),false).toBool();
-	global->testBench->m_genOn = m_qSettings->value(tr("GenOn"),false).toBool();
-	global->testBench->m_noiseOn = m_qSettings->value(tr("NoiseOn"),false).toBool();
-	global->testBench->m_peakOn = m_qSettings->value(tr("PeakOn"),false).toBool();
-	global->testBench->m_pulseWidth = m_qSettings->value(tr("PulseWidth"),0.0).toDouble();
-	global->testBench->m_pulsePeriod = m_qSettings->value(tr("PulsePeriod"),0.0).toDouble();
-	global->testBench->m_signalPower = m_qSettings->value(tr("SignalPower"),0.0).toDouble();
-	global->testBench->m_noisePower = m_qSettings->value(tr("NoisePower"),-70.0).toDouble();
-	global->testBench->m_useFmGen = m_qSettings->value(tr("UseFmGen"),false).toBool();
+	m_context->testBench->m_sweepStartFrequency = m_qSettings->value(tr("SweepStartFrequency"),0.0).toDouble();
+	m_context->testBench->m_sweepStopFrequency = m_qSettings->value(tr("SweepStopFrequency"),1.0).toDouble();
+	m_context->testBench->m_sweepRate = m_qSettings->value(tr("SweepRate"),0.0).toDouble();
+	m_context->testBench->m_displayRate = m_qSettings->value(tr("DisplayRate"),10).toInt();
+	m_context->testBench->m_vertRange = m_qSettings->value(tr("VertRange"),10000).toInt();
+	m_context->testBench->m_trigIndex = m_qSettings->value(tr("TrigIndex"),0).toInt();
+	m_context->testBench->m_trigLevel = m_qSettings->value(tr("TrigLevel"),100).toInt();
+	m_context->testBench->m_horzSpan = m_qSettings->value(tr("HorzSpan"),100).toInt();
+	m_context->testBench->m_profile = m_qSettings->value(tr("Profile"),0).toInt();
+	m_context->testBench->m_timeDisplay = m_qSettings->value(tr("TimeDisplay"),false).toBool();
+	m_context->testBench->m_genOn = m_qSettings->value(tr("GenOn"),false).toBool();
+	m_context->testBench->m_noiseOn = m_qSettings->value(tr("NoiseOn"),false).toBool();
+	m_context->testBench->m_peakOn = m_qSettings->value(tr("PeakOn"),false).toBool();
+	m_context->testBench->m_pulseWidth = m_qSettings->value(tr("PulseWidth"),0.0).toDouble();
+	m_context->testBench->m_pulsePeriod = m_qSettings->value(tr("PulsePeriod"),0.0).toDouble();
+	m_context->testBench->m_signalPower = m_qSettings->value(tr("SignalPower"),0.0).toDouble();
+	m_context->testBench->m_noisePower = m_qSettings->value(tr("NoisePower"),-70.0).toDouble();
+	m_context->testBench->m_useFmGen = m_qSettings->value(tr("UseFmGen"),false).toBool();
 	m_qSettings->endGroup();
 
 }
@@ -101,10 +121,10 @@ void Settings::readSettings()
 void Settings::writeSettings()
 {
 	//Get the current window size and position so we can save it
-	m_windowHeight = global->mainWindow->height();
-	m_windowWidth = global->mainWindow->width();
-	m_windowXPos = global->mainWindow->x();
-	m_windowYPos = global->mainWindow->y();
+	m_windowHeight = m_context->mainWindow->height();
+	m_windowWidth = m_context->mainWindow->width();
+	m_windowXPos = m_context->mainWindow->x();
+	m_windowYPos = m_context->mainWindow->y();
 	m_qSettings->setValue("windowHeight",m_windowHeight);
 	m_qSettings->setValue("windowWidth",m_windowWidth);
 	m_qSettings->setValue("windowXPos",m_windowXPos);
@@ -118,6 +138,8 @@ void Settings::writeSettings()
 	m_qSettings->setValue("DecimateLimit",m_decimateLimit);
 	m_qSettings->setValue("PostMixerDecimate",m_postMixerDecimate);
 	m_qSettings->setValue("FramesPerBuffer",m_framesPerBuffer);
+	m_qSettings->setValue("LowLatency",m_lowLatency);
+	m_qSettings->setValue("LowLatencyFrames",m_lowLatencyFrames);
 	m_qSettings->setValue("NumSpectrumBins",m_numSpectrumBins);
 	m_qSettings->setValue("NumHiResSpectrumBins",m_numHiResSpectrumBins);
 	m_qSettings->setValue("LeftRightIncrement",m_leftRightIncrement);
@@ -129,29 +151,42 @@ void Settings::writeSettings()
 	m_qSettings->setValue("AutoScaleMin",m_autoScaleMin);
 
 	m_qSettings->setValue("UpdatesPerSec",m_updatesPerSecond);
+	m_qSettings->setValue("LargeSpectrumSize",m_largeSpectrumSize);
+	m_qSettings->setValue("LargeSpectrumAverages",m_largeSpectrumAverages);
+	m_qSettings->setValue("LargeSpectrumUpdateMs",m_largeSpectrumUpdateMs);
+	m_qSettings->setValue("RecordHistorySecs",m_recordHistorySecs);
+	m_qSettings->setValue("RecordCompressed",m_recordCompressed);
+	m_qSettings->setValue("ProbeCapture",m_probeCapture);
+	m_qSettings->setValue("DspServerPort",m_dspServerPort);
+	m_qSettings->setValue("DspServerMaxClients",m_dspServerMaxClients);
 
 	m_qSettings->setValue("DataPluginName",m_dataPluginName);
 
+	m_qSettings->beginGroup("FFT");
+	m_qSettings->setValue("AutoTune",m_fftAutoTune);
+	m_qSettings->setValue("Calibration",FFTRegistry::results());
+	m_qSettings->endGroup();
+
 	m_qSettings->beginGroup(tr("Testbench"));
 
-	m_qSettings->setValue(tr("SweepStartFrequency"),global->testBench->m_sweepStartFrequency);
-	m_qSettings->setValue(tr("SweepStopFrequency"),global->testBench->m_sweepStopFrequency);
-	m_qSettings->setValue(tr("SweepRate"),global->testBench->m_sweepRate);
-	m_qSettings->setValue(tr("DisplayRate"),global->testBench->m_displayRate);
-	m_qSettings->setValue(tr("VertRange"),global->testBench->m_vertRange);
-	m_qSettings->setValue(tr("TrigIndex"),global->testBench->m_trigIndex);
-	m_qSettings->setValue(tr("TimeDisplay"),global->testBench->m_timeDisplay);
-	m_qSettings->setValue(tr("HorzSpan"),global->testBench->m_horzSpan);
-	m_qSettings->setValue(tr("TrigLevel"),global->testBench->m_trigLevel);
-	m_qSettings->setValue(tr("Profile"),global->testBench->m_profile);
-	m_qSettings->setValue(tr("GenOn"),global->testBench->m_genOn);
-	m_qSettings->setValue(tr("NoiseOn"),global->testBench->m_noiseOn);
-	m_qSettings->setValue(tr("PeakOn"),global->testBench->m_peakOn);
-	m_qSettings->setValue(tr("PulseWidth"),global->testBench->m_pulseWidth);
-	m_qSettings->setValue(tr("PulsePeriod"),global->testBench->m_pulsePeriod);
-	m_qSettings->setValue(tr("SignalPower"),global->testBench->m_signalPower);
-	m_qSettings->setValue(tr("NoisePower"),global->testBench->m_noisePower);
-	m_qSettings->setValue(tr("UseFmGen"),global->testBench->m_useFmGen);
+	m_qSettings->setValue(tr("SweepStartFrequency"),m_context->testBench->m_sweepStartFrequency);
+	m_qSettings->setValue(tr("SweepStopFrequency"),m_context->testBench->m_sweepStopFrequency);
+	m_qSettings->setValue(tr("SweepRate"),m_context->testBench->m_sweepRate);
+	m_qSettings->setValue(tr("DisplayRate"),m_context->testBench->m_displayRate);
+	m_qSettings->setValue(tr("VertRange"),m_context->testBench->m_vertRange);
+	m_qSettings->setValue(tr("TrigIndex"),m_context->testBench->m_trigIndex);
+	m_qSettings->setValue(tr("TimeDisplay"),m_context->testBench->m_timeDisplay);
+	m_qSettings->setValue(tr("HorzSpan"),m_context->testBench->m_horzSpan);
+	m_qSettings->setValue(tr("TrigLevel"),m_context->testBench->m_trigLevel);
+	m_qSettings->setValue(tr("Profile"),m_context->testBench->m_profile);
+	m_qSettings->setValue(tr("GenOn"),m_context->testBench->m_genOn);
+	m_qSettings->setValue(tr("NoiseOn"),m_context->testBench->m_noiseOn);
+	m_qSettings->setValue(tr("PeakOn"),m_context->testBench->m_peakOn);
+	m_qSettings->setValue(tr("PulseWidth"),m_context->testBench->m_pulseWidth);
+	m_qSettings->setValue(tr("PulsePeriod"),m_context->testBench->m_pulsePeriod);
+	m_qSettings->setValue(tr("SignalPower"),m_context->testBench->m_signalPower);
+	m_qSettings->setValue(tr("NoisePower"),m_context->testBench->m_noisePower);
+	m_qSettings->setValue(tr("UseFmGen"),m_context->testBench->m_useFmGen);
 
 	m_qSettings->endGroup();
 
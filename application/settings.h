@@ -3,6 +3,8 @@
 #include "gpl.h"
 #include <QSettings>
 #include "QFont"
+
+class ReceiverContext;
 /*
 Encapsulates settings dialog, reading/writing settings file, etc
 */
@@ -11,7 +13,7 @@ class Settings:public QObject
 		Q_OBJECT
 
 public:
-	Settings();
+	Settings(ReceiverContext *_context);
 	~Settings(void);
 	void writeSettings();
 
@@ -22,7 +24,12 @@ public:
 	//If Output Sample Rate is above this, then we try to reduce it by skipping samples when we output
 	int m_decimateLimit;
 	bool m_postMixerDecimate; //If true, then downsample to decimate limit after mixer
-	int m_framesPerBuffer;
+	int m_framesPerBuffer; //Device and full rate DSP block size
+	//Low latency profile: post decimation chain (bandpass, AGC, demod, audio) runs in m_lowLatencyFrames blocks
+	//instead of m_framesPerBuffer.  Power of 2, takes effect at next power on
+	bool m_lowLatency;
+	int m_lowLatencyFrames;
+	bool m_fftAutoTune; //Pick fastest FFT backend per size, else USE_FFTxxx default
 	int m_numSpectrumBins;
 	int m_numHiResSpectrumBins;
 	double m_dbOffset; //DB calibration for spectrum and smeter
@@ -46,15 +53,31 @@ public:
 
 	//Spectrum settings
 	int m_updatesPerSecond;
+	//High resolution spectrum, see largespectrum.h.  0 = off, otherwise fft size 65536 to 4194304
+	int m_largeSpectrumSize;
+	int m_largeSpectrumAverages;
+	int m_largeSpectrumUpdateMs;
 	bool m_autoScaleMax;
 	bool m_autoScaleMin;
 
+	//Seconds of IQ kept in memory and written ahead of a new recording, see iqrecorder.h.  0 = none (default)
+	//Opt in, history costs 4 bytes per sample per second of memory, 800mb for 10 secs at 20msps
+	int m_recordHistorySecs;
+	//Record lossless compressed .piq instead of wav, see iqfile.h
+	bool m_recordCompressed;
+	//Probe point name captured to PebbleRecordings while power is on, see probe.h.  Empty = off
+	QString m_probeCapture;
+	//ghpsdr3 compatible dsp server, see dspserver.h.  0 = off, usual port is 8000.  Takes effect at next power on
+	int m_dspServerPort;
+	int m_dspServerMaxClients;
+
 	//Plugin settings
 	QString m_dataPluginName;
 
 	public slots:
 
 private:
+	ReceiverContext *m_context;
 	QSettings *m_qSettings;
 	void readSettings();
 
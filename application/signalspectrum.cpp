@@ -3,41 +3,52 @@
 #include "signalspectrum.h"
 #include "firfilter.h"
 
-SignalSpectrum::SignalSpectrum(quint32 _sampleRate, quint32 _hiResSampleRate, quint32 _bufferSize):
+SignalSpectrum::SignalSpectrum(ReceiverContext *_context, quint32 _sampleRate, quint32 _hiResSampleRate, quint32 _bufferSize):
 	ProcessStep(_sampleRate,_bufferSize)
 {
+	m_context = _context;
 	//FFT bin size can be greater than sample size
-	m_numSpectrumBins = global->settings->m_numSpectrumBins;
-	m_numHiResSpectrumBins = global->settings->m_numHiResSpectrumBins;
+	m_numSpectrumBins = m_context->settings->m_numSpectrumBins;
+	m_numHiResSpectrumBins = m_context->settings->m_numHiResSpectrumBins;
 
 	m_hiResSampleRate = _hiResSampleRate;
-	//Output buffers
-	m_rawIQ = memalign(numSamples);
 
-	m_fftUnprocessed = FFT::factory("Unprocessed spectrum");
-	m_unprocessedSpectrum = new double[m_numSpectrumBins];
+	//DSP thread writes at most one buffer at a time, worker always reads one buffer
+	m_unprocessedRing = new StagingRing(numSamples, numSamples);
+	m_hiResRing = new StagingRing(numSamples, numSamples);
+	m_unprocessedIn = memalign(numSamples);
+	m_hiResIn = memalign(numSamples);
 
-	m_fftHiRes = FFT::factory("HiRes spectrum");
-	m_hiResSpectrum = new double[m_numHiResSpectrumBins];
+	m_fftUnprocessed = FFT::factory("Unprocessed spectrum", m_numSpectrumBins, FFT::FORWARD);
+	m_fftHiRes = FFT::factory("HiRes spectrum", m_numHiResSpectrumBins, FFT::FORWARD);
 
-	m_tmp_cpx = memalign(m_numSpectrumBins);
+	m_displayFrames = new TripleBuffer<double>(m_numSpectrumBins);
+	m_strengthFrames = new TripleBuffer<double>(m_numSpectrumBins);
+	m_hiResFrames = new TripleBuffer<double>(m_numHiResSpectrumBins);
+	m_displayPending.store(0);
+
+	m_bandscope = new double[m_numSpectrumBins];
+	m_bandscopeReady = false;
 
 	//db calibration
-	m_dbOffset  = global->settings->m_dbOffset;
+	m_dbOffset  = m_context->settings->m_dbOffset;
 
     //Spectrum refresh rate from 1 to 50 per second
     //Init here for now and add UI element to set, save with settings data
-	m_updatesPerSec = global->settings->m_updatesPerSecond; //Refresh rate per second
+	m_updatesPerSec = m_context->settings->m_updatesPerSecond; //Refresh rate per second
 	//Elapsed time in ms for use with QElapsedTimer
 	m_spectrumTimerUpdate = 1000 /m_updatesPerSec;
 	m_hiResTimerUpdate = 1000/ m_updatesPerSec;
 
-	m_displayUpdateComplete = true;
-	m_displayUpdateOverrun = 0;
-
 	m_useHiRes = false;
 
-	m_isOverload = false;
+	m_isOverload.store(0);
+
+	m_largeSpectrum = NULL;
+	m_largeSpectrumReady.store(0);
+
+	//Nothing due or no new samples yet
+	m_worker = new PollingWorker("PebbleSignalSpectrum", [this]() {return computeSpectrum();}, 5);
 
 	setSampleRate(sampleRate, m_hiResSampleRate);
 
@@ -45,86 +56,185 @@ SignalSpectrum::SignalSpectrum(quint32 _sampleRate, quint32 _hiResSampleRate, qu
 
 SignalSpectrum::~SignalSpectrum(void)
 {
-	if (m_unprocessedSpectrum != NULL) {free (m_unprocessedSpectrum);}
-	if (m_hiResSpectrum != NULL) {free (m_hiResSpectrum);}
-	if (m_tmp_cpx != NULL) {free(m_tmp_cpx);}
-	if (m_rawIQ != NULL) {free(m_rawIQ);}
+	delete m_worker;
+	if (m_largeSpectrum != NULL) {delete m_largeSpectrum;}
+	delete m_fftUnprocessed;
+	delete m_fftHiRes;
+	delete m_unprocessedRing;
+	delete m_hiResRing;
+	delete m_displayFrames;
+	delete m_strengthFrames;
+	delete m_hiResFrames;
+	delete[] m_bandscope;
+	if (m_unprocessedIn != NULL) {free(m_unprocessedIn);}
+	if (m_hiResIn != NULL) {free(m_hiResIn);}
 }
 
+//Worker uses the ffts, so it's stopped while they change
 void SignalSpectrum::setSampleRate(quint32 _sampleRate, quint32 _hiResSampleRate)
 {
+	//Worker is at most one FFT away from checking if it's still running
+	m_worker->stop();
     sampleRate = _sampleRate;
 	m_hiResSampleRate = _hiResSampleRate;
 	m_fftUnprocessed->fftParams(m_numSpectrumBins, DB::maxDb, sampleRate, numSamples, WindowFunction::BLACKMANHARRIS);
 	m_fftHiRes->fftParams(m_numHiResSpectrumBins, DB::maxDb, m_hiResSampleRate, numSamples, WindowFunction::BLACKMANHARRIS);
-	m_emitFftCounter = 0;
+	createLargeSpectrum();
+	//Display only, DSP and audio threads come first
+	m_worker->start(QThread::LowPriority);
 }
 
-void SignalSpectrum::unprocessed(CPX * in, int _numSamples)
-{	
-	if (!m_spectrumTimer.isValid()) {
-		m_spectrumTimer.start(); //First time
+//Ring and fft size depend on sample rate, so start over if it changes
+//Demod mode changes call setSampleRate() with the same rate while DSP thread is writing, leave those alone
+void SignalSpectrum::createLargeSpectrum()
+{
+	if (m_largeSpectrum != NULL && m_largeSpectrum->sampleRate() == sampleRate)
 		return;
+	if (m_largeSpectrum != NULL) {
+		delete m_largeSpectrum;
+		m_largeSpectrum = NULL;
 	}
-	if (m_updatesPerSec == 0 ||  m_spectrumTimer.elapsed() < m_spectrumTimerUpdate)
+	if (m_context->settings->m_largeSpectrumSize <= 0)
 		return;
-	m_spectrumTimer.start(); //Reset
 
-	if (!m_displayUpdateComplete) {
-        //We're not keeping up with display for some reason
-		//qDebug()<<"Display update overrun counter "<<displayUpdateOverrun;
-		m_displayUpdateOverrun++;
-    }
-
-    //Keep a copy raw I/Q to local buffer for display
-	//copyCPX(rawIQ, in, numSamples);
-	//global->perform.StartPerformance("MakeSpectrum");
-	makeSpectrum(m_fftUnprocessed, in, m_unprocessedSpectrum, _numSamples);
-	//global->perform.StopPerformance(10);
-	m_displayUpdateComplete = false;
-	emit newFftData();
+	m_largeSpectrum = new LargeSpectrum(sampleRate, m_context->settings->m_largeSpectrumSize,
+		m_context->settings->m_largeSpectrumAverages, m_context->settings->m_largeSpectrumUpdateMs);
+	//Just sets a flag from LargeSpectrum's thread, our worker picks it up
+	connect(m_largeSpectrum, SIGNAL(newSpectrum()), this, SLOT(largeSpectrumReady()), Qt::DirectConnection);
+	m_largeSpectrum->start();
 }
 
-//http://www.arc.id.au/ZoomFFT.html
-void SignalSpectrum::zoomed(CPX *in, int _numSamples)
+//True if it's time for a new unprocessed spectrum
+bool SignalSpectrum::spectrumTimerElapsed()
 {
-	if (!m_useHiRes)
-		return; //Nothing to do
+	if (!m_spectrumTimer.isValid()) {
+		m_spectrumTimer.start(); //First time
+		return false;
+	}
+	if (m_updatesPerSec == 0 ||  m_spectrumTimer.elapsed() < m_spectrumTimerUpdate)
+		return false;
+	return true;
+}
 
+bool SignalSpectrum::hiResTimerElapsed()
+{
 	if (!m_hiResTimer.isValid()) {
 		m_hiResTimer.start(); //First time
-		return;
+		return false;
 	}
 	if (m_updatesPerSec == 0 ||  m_hiResTimer.elapsed() < m_hiResTimerUpdate)
+		return false;
+	return true;
+}
+
+void SignalSpectrum::unprocessed(CPX * in, int _numSamples)
+{	
+	if (m_largeSpectrum != NULL) {
+		//Worker does the FFT at its own cadence, see largeSpectrumReady()
+		m_largeSpectrum->write(in, _numSamples);
 		return;
-	m_hiResTimer.start(); //Reset
+	}
+	m_unprocessedRing->write(in, _numSamples);
+}
 
-	makeSpectrum(m_fftHiRes, in, m_hiResSpectrum, _numSamples);
-	//Updated HiRes fft data won't be available to SpectrumWidget untill Unprocessed() is called in next loop
-	//Should have no impact and avoids displaying spectrum 2x in each ProcessIQ loop
-	//This signal is for future use in case we want to do special handling in SpectrumWidget
-	emit newHiResFftData();
+//http://www.arc.id.au/ZoomFFT.html
+void SignalSpectrum::zoomed(CPX *in, int _numSamples)
+{
+	if (!m_useHiRes)
+		return; //Nothing to do
+	m_hiResRing->write(in, _numSamples);
 }
 
-void SignalSpectrum::makeSpectrum(FFT *fft, CPX *in, double *sOut, int _numSamples)
+//LargeSpectrum thread, reduce() is done by our worker
+void SignalSpectrum::largeSpectrumReady()
 {
-	m_isOverload = fft->fftSpectrum(in, sOut, _numSamples);
-    //out now has the spectrum in db, -f..0..+f
+	m_largeSpectrumReady.store(1);
 }
 
 void SignalSpectrum::setSpectrum(double *in)
 {
+	m_bandscopeMutex.lock();
 	for (int i=0; i< m_numSpectrumBins ;i++) {
-		m_unprocessedSpectrum[i] = in[i];
+		m_bandscope[i] = in[i];
+	}
+	m_bandscopeReady = true;
+	m_bandscopeMutex.unlock();
+}
+
+//Worker, m_displayFrames write buffer has the new spectrum
+void SignalSpectrum::publishUnprocessed()
+{
+	memcpy(m_strengthFrames->writeBuffer(), m_displayFrames->writeBuffer(), m_numSpectrumBins * sizeof(double));
+	m_strengthFrames->publish();
+	m_displayFrames->publish();
+	//Don't queue up paints, GUI gets the newest frame when it gets to it
+	if (m_displayPending.testAndSetOrdered(0, 1))
+		emit newFftData();
+}
+
+bool SignalSpectrum::computeSpectrum()
+{
+	bool didWork = false;
+
+	if (m_largeSpectrum != NULL) {
+		if (m_largeSpectrumReady.testAndSetOrdered(1, 0) &&
+				m_largeSpectrum->reduce(m_displayFrames->writeBuffer(), m_numSpectrumBins)) {
+			m_isOverload.store(m_largeSpectrum->isOverload() ? 1 : 0);
+			publishUnprocessed();
+			didWork = true;
+		}
+	} else if (spectrumTimerElapsed()) {
+		m_bandscopeMutex.lock();
+		if (m_bandscopeReady) {
+			memcpy(m_displayFrames->writeBuffer(), m_bandscope, m_numSpectrumBins * sizeof(double));
+			m_bandscopeReady = false;
+			m_bandscopeMutex.unlock();
+			publishUnprocessed();
+			m_spectrumTimer.start(); //Reset
+			didWork = true;
+		} else {
+			m_bandscopeMutex.unlock();
+			if (m_unprocessedRing->readLatest(m_unprocessedIn, numSamples)) {
+				//m_context->perform.StartPerformance("MakeSpectrum");
+				m_isOverload.store(m_fftUnprocessed->fftSpectrum(m_unprocessedIn, m_displayFrames->writeBuffer(),
+					numSamples) ? 1 : 0);
+				//m_context->perform.StopPerformance(10);
+				publishUnprocessed();
+				m_spectrumTimer.start(); //Reset
+				didWork = true;
+			}
+		}
+	}
+
+	if (m_useHiRes && hiResTimerElapsed() && m_hiResRing->readLatest(m_hiResIn, numSamples)) {
+		m_fftHiRes->fftSpectrum(m_hiResIn, m_hiResFrames->writeBuffer(), numSamples);
+		m_hiResFrames->publish();
+		m_hiResTimer.start(); //Reset
+		//Updated HiRes fft data won't be displayed until the next newFftData()
+		//This signal is for future use in case we want to do special handling in SpectrumWidget
+		emit newHiResFftData();
+		didWork = true;
 	}
-	m_displayUpdateComplete = false;
-	emit newFftData();
+	return didWork;
+}
+
+void SignalSpectrum::latchDisplay()
+{
+	m_displayFrames->update();
+	m_hiResFrames->update();
+	m_displayPending.store(0);
+}
+
+double *SignalSpectrum::getUnprocessed()
+{
+	m_strengthFrames->update();
+	return m_strengthFrames->readBuffer();
 }
 
 void SignalSpectrum::setUpdatesPerSec(int updatespersec)
 {
 	m_updatesPerSec = updatespersec;
-	global->settings->m_updatesPerSecond = m_updatesPerSec;
+	m_context->settings->m_updatesPerSecond = m_updatesPerSec;
 	if (m_updatesPerSec > 0) {
 		//Elapsed time in ms for use with QElapsedTimer
 		m_spectrumTimerUpdate = 1000 /m_updatesPerSec;
@@ -134,6 +244,7 @@ void SignalSpectrum::setUpdatesPerSec(int updatespersec)
 
 
 //See fft.cpp for details, this is here as a convenience so we don't have to expose FFT everywhere
+//mapFFTToScreen() only uses fft size and sample rate, so it's safe to call while the worker is in fftSpectrum()
 bool SignalSpectrum::mapFFTToScreen(qint32 maxHeight,
                                 qint32 maxWidth,
                                 double maxdB,
@@ -142,8 +253,10 @@ bool SignalSpectrum::mapFFTToScreen(qint32 maxHeight,
                                 qint32 stopFreq,
                                 qint32* outBuf )
 {
-	if (m_fftUnprocessed!=NULL)
-		return m_fftUnprocessed->mapFFTToScreen(m_unprocessedSpectrum, maxHeight,maxWidth,maxdB,mindB,startFreq,stopFreq,outBuf);
+	if (m_largeSpectrum != NULL && m_largeSpectrum->hasResult())
+		return m_largeSpectrum->mapToScreen(maxHeight,maxWidth,maxdB,mindB,startFreq,stopFreq,outBuf);
+	else if (m_fftUnprocessed!=NULL)
+		return m_fftUnprocessed->mapFFTToScreen(m_displayFrames->readBuffer(), maxHeight,maxWidth,maxdB,mindB,startFreq,stopFreq,outBuf);
     else
         return false;
 }
@@ -162,7 +275,7 @@ bool SignalSpectrum::mapFFTZoomedToScreen(qint32 maxHeight,
 	quint16 span = m_hiResSampleRate * zoom;
 
 	if (m_fftHiRes!=NULL)
-		return m_fftHiRes->mapFFTToScreen(m_hiResSpectrum,maxHeight,maxWidth,maxdB,mindB, -span/2 - modeOffset, span/2 - modeOffset, outBuf);
+		return m_fftHiRes->mapFFTToScreen(m_hiResFrames->readBuffer(),maxHeight,maxWidth,maxdB,mindB, -span/2 - modeOffset, span/2 - modeOffset, outBuf);
     else
         return false;
 }
@@ -5,77 +5,122 @@
 #include "demod.h"
 #include <QMutex>
 #include "settings.h"
+#include "receivercontext.h"
 #include "goertzel.h"
 #include "fftw.h"
 #include "windowfunction.h"
-
+#include "largespectrum.h"
+#include "stagingring.h"
+#include "triplebuffer.h"
+#include "pollingworker.h"
+
+/*
+	Unprocessed and hi res (zoomed) spectrum for SpectrumWidget and SignalStrength
+
+	DSP thread only copies blocks into a StagingRing, unprocessed() and zoomed() never FFT or wait
+	PollingWorker thread picks up the newest samples at m_updatesPerSec, does window, FFT, dB and
+	averaging, and publishes the result through TripleBuffers
+		m_displayFrames, m_hiResFrames		GUI thread, latchDisplay() from the newFftData() slot
+		m_strengthFrames					DSP thread, getUnprocessed() for SignalStrength squelch and s-meter
+	Nothing is shared between the DSP thread and the paint path, so a slow paint just skips frames
+	and display cadence can't cost audio samples
+
+	LargeSpectrum has its own worker and ring, ours only reduces its result for SignalStrength
+	setSpectrum() (device spectrum, no IQ) is handed to the worker under m_bandscopeMutex, which only the
+	device thread and worker use
+*/
 class SignalSpectrum :
 	public ProcessStep
 {
     Q_OBJECT
 
 public:
-	SignalSpectrum(quint32 _sampleRate, quint32 _hiResSampleRate, quint32 _bufferSize);
+	SignalSpectrum(ReceiverContext *_context, quint32 _sampleRate, quint32 _hiResSampleRate, quint32 _bufferSize);
 	~SignalSpectrum(void);
 	void setHiRes(bool _on) {m_useHiRes = _on;}
-	//Pass in soundcard buffer under/overflow counts for display
+	//DSP thread, copies samples for the worker
 	void unprocessed(CPX * in, int _numSamples);
-	void makeSpectrum(FFT *fft, CPX *in, double *out, int _numSamples); //Use if we just have CPX samples
+	void zoomed(CPX *in, int _numSamples);
 
 	//Used when we already have spectrum, typically from dsp server or device
 	//Just copies spectrum into unprocessed
 	void setSpectrum(double *in);
 
+	//GUI thread, picks up the newest frames.  Call once per newFftData() before mapping
+	void latchDisplay();
 	bool mapFFTToScreen(qint32 maxHeight, qint32 maxWidth,
                                     double maxdB, double mindB,
                                     qint32 startFreq, qint32 stopFreq,
                                     qint32* outBuf );
 
 	bool mapFFTZoomedToScreen(qint32 maxHeight, qint32 maxWidth, double maxdB, double mindB, double zoom, int modeOffset, qint32 *outBuf);
+	//Last latched unprocessed spectrum, GUI thread
+	double *getDisplayUnprocessed() {return m_displayFrames->readBuffer();}
 
 	int binCount() {return m_numSpectrumBins;}
-	double *getUnprocessed() {return m_unprocessedSpectrum;}
-	void zoomed(CPX *in, int _numSamples);
-	CPX *rawIQ() {return m_rawIQ;}
+	//Newest unprocessed spectrum, DSP thread only
+	double *getUnprocessed();
 
 	void setUpdatesPerSec(int updatespersec);
-	bool m_displayUpdateComplete; //Wrap in access func after testing
-	int m_displayUpdateOverrun; //temp counter
 
 	quint32 getHiResSampleRate() {return m_hiResSampleRate;}
 
 	void setSampleRate(quint32 _sampleRate, quint32 _hiResSampleRate);
 
-	qint32 m_emitFftCounter; //Testing to see if we're getting more paints than signals
+	bool getOverload() {return m_isOverload.load() != 0;}
 
-	bool getOverload() {return m_isOverload;}
+	//True if display and signal strength come from LargeSpectrum instead of our own FFT
+	bool isLargeSpectrum() {return m_largeSpectrum != NULL;}
 
 public slots:
+	void largeSpectrumReady();
 
 signals:
+	//Emitted from worker thread, at most one outstanding until latchDisplay()
     void newFftData(); //New spectrum data to display
 	void newHiResFftData(); //Not used yet, will allow us to update hires zoom independently if we want to
 
 
 private:
-	bool m_isOverload;
+	ReceiverContext *m_context;
+	QAtomicInt m_isOverload;
 
 	quint32 m_hiResSampleRate;
 
-	QMutex m_mutex;
 	int m_numSpectrumBins;
 	int m_numHiResSpectrumBins;
 
-	//Spectrum data at different steps in receive chaing
-	CPX *m_rawIQ;
-	double *m_unprocessedSpectrum;
-	double *m_hiResSpectrum; //Post bandpass spectrum with more resolution around signal
-	bool m_useHiRes;
-
-	CPX *m_tmp_cpx;
+	//DSP thread to worker
+	StagingRing *m_unprocessedRing;
+	StagingRing *m_hiResRing;
+	volatile bool m_useHiRes;
+
+	//Worker to readers
+	TripleBuffer<double> *m_displayFrames;
+	TripleBuffer<double> *m_strengthFrames;
+	TripleBuffer<double> *m_hiResFrames;
+	QAtomicInt m_displayPending; //newFftData() emitted and not latched yet
+
+	//Worker thread spectrum, we just feed it samples.  NULL if not enabled in settings
+	LargeSpectrum *m_largeSpectrum;
+	QAtomicInt m_largeSpectrumReady;
+	void createLargeSpectrum();
+
+	QMutex m_bandscopeMutex;
+	double *m_bandscope; //setSpectrum() copy
+	bool m_bandscopeReady;
+
+	//Worker only
+	CPX *m_unprocessedIn;
+	CPX *m_hiResIn;
 	FFT *m_fftUnprocessed;
 	FFT *m_fftHiRes; //Different sample rate, we might be able to re-use fft, but keep separate for now
 
+	PollingWorker *m_worker;
+	//Worker, returns false if nothing was done
+	bool computeSpectrum();
+	void publishUnprocessed();
+
 	float m_dbOffset; //Used to calibrate power to db calculations
 
 	int m_updatesPerSec; //Refresh rate per second
@@ -86,4 +131,7 @@ private:
 	QElapsedTimer m_hiResTimer;
 	qint64 m_hiResTimerUpdate;
 
+	bool spectrumTimerElapsed();
+	bool hiResTimerElapsed();
+
 };
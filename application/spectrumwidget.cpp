@@ -6,6 +6,7 @@
 #include <QMouseEvent>
 #include <QKeyEvent>
 #include <QWindow>
+#include <QDateTime>
 #include "device_interfaces.h"
 #include "cmath" //For std::abs() that supports float.  Include last so it overrides abs(int)
 
@@ -14,9 +15,8 @@ class Receiver;
 SpectrumWidget::SpectrumWidget(QWidget *parent)
 	: QWidget(parent)
 {
-	int index;
-
 	ui.setupUi(this);
+	m_context = NULL;
 
 	ui.topLabelFrame->setVisible(false);
 	ui.topPlotFrame->setVisible(false);
@@ -27,6 +27,7 @@ SpectrumWidget::SpectrumWidget(QWidget *parent)
 	ui.displayBox->addItem("Spect/Spect",SPECTRUM_SPECTRUM);
 	ui.displayBox->addItem("Spect/Wfall",SPECTRUM_WATERFALL);
 	ui.displayBox->addItem("Wfall/Wfall",WATERFALL_WATERFALL);
+	ui.displayBox->addItem("Overview/Wfall",OVERVIEW_WATERFALL);
 	//ui.displayBox->addItem("I/Q",IQ);
 	//ui.displayBox->addItem("Phase",PHASE);
 	ui.displayBox->addItem("No Display",NODISPLAY);
@@ -34,10 +35,7 @@ SpectrumWidget::SpectrumWidget(QWidget *parent)
 
     connect(ui.displayBox,SIGNAL(currentIndexChanged(int)),this,SLOT(displayChanged(int)));
 
-    //Starting plot range
-	//CuteSDR defaults to -50
-	m_plotMaxDb = global->settings->m_fullScaleDb;
-	m_autoScaleMax = global->settings->m_autoScaleMax;
+	//Current selections are set in setContext(), when we know which receiver's settings to use
 	ui.maxDbBox->addItem("Auto",10);
 	ui.maxDbBox->addItem("  0db",0);
 	ui.maxDbBox->addItem("-10db",-10);
@@ -45,15 +43,7 @@ SpectrumWidget::SpectrumWidget(QWidget *parent)
 	ui.maxDbBox->addItem("-30db",-30);
 	ui.maxDbBox->addItem("-40db",-40);
 	ui.maxDbBox->addItem("-50db",-50);
-	if (m_autoScaleMax)
-		index = 0;
-	else
-		index = ui.maxDbBox->findData(m_plotMaxDb);
-	ui.maxDbBox->setCurrentIndex(index);
-	connect(ui.maxDbBox,SIGNAL(currentIndexChanged(int)),this,SLOT(maxDbChanged(int)));
 
-	m_plotMinDb = global->settings->m_baseScaleDb;
-	m_autoScaleMin = global->settings->m_autoScaleMin;
 	ui.minDbBox->addItem("Auto",10);
 	ui.minDbBox->addItem("-120db",-120);
 	ui.minDbBox->addItem("-110db",-110);
@@ -61,12 +51,6 @@ SpectrumWidget::SpectrumWidget(QWidget *parent)
 	ui.minDbBox->addItem("- 90db",-90);
 	ui.minDbBox->addItem("- 80db",-80);
 	ui.minDbBox->addItem("- 70db",-70);
-	if (m_autoScaleMin)
-		index = 0;
-	else
-		index = ui.minDbBox->findData(m_plotMinDb);
-	ui.minDbBox->setCurrentIndex(index);
-	connect(ui.minDbBox,SIGNAL(currentIndexChanged(int)),this,SLOT(minDbChanged(int)));
 
 	ui.updatesPerSec->addItem("5x",5);
 	ui.updatesPerSec->addItem("10x",10);
@@ -75,9 +59,6 @@ SpectrumWidget::SpectrumWidget(QWidget *parent)
 	ui.updatesPerSec->addItem("25x",25);
 	ui.updatesPerSec->addItem("30x",30);
 	ui.updatesPerSec->addItem("Frz",0);
-	index = ui.updatesPerSec->findData(global->settings->m_updatesPerSecond);
-	ui.updatesPerSec->setCurrentIndex(index);
-	connect(ui.updatesPerSec,SIGNAL(currentIndexChanged(int)),this,SLOT(updatesPerSecChanged(int)));
 
 	m_spectrumMode=SPECTRUM;
 
@@ -195,6 +176,41 @@ SpectrumWidget::SpectrumWidget(QWidget *parent)
 	connect(ui.hiResButton,SIGNAL(clicked(bool)),this,SLOT(hiResClicked(bool)));
 	m_topPanelHighResolution = false;
 	m_isRunning = false;
+
+	m_overview = NULL;
+	m_overviewMaxDb = 0;
+	m_overviewMinDb = 0;
+	m_overviewCheckCounter = 0;
+}
+
+void SpectrumWidget::setContext(ReceiverContext *_context)
+{
+	int index;
+	m_context = _context;
+
+    //Starting plot range
+	//CuteSDR defaults to -50
+	m_plotMaxDb = m_context->settings->m_fullScaleDb;
+	m_autoScaleMax = m_context->settings->m_autoScaleMax;
+	if (m_autoScaleMax)
+		index = 0;
+	else
+		index = ui.maxDbBox->findData(m_plotMaxDb);
+	ui.maxDbBox->setCurrentIndex(index);
+	connect(ui.maxDbBox,SIGNAL(currentIndexChanged(int)),this,SLOT(maxDbChanged(int)));
+
+	m_plotMinDb = m_context->settings->m_baseScaleDb;
+	m_autoScaleMin = m_context->settings->m_autoScaleMin;
+	if (m_autoScaleMin)
+		index = 0;
+	else
+		index = ui.minDbBox->findData(m_plotMinDb);
+	ui.minDbBox->setCurrentIndex(index);
+	connect(ui.minDbBox,SIGNAL(currentIndexChanged(int)),this,SLOT(minDbChanged(int)));
+
+	index = ui.updatesPerSec->findData(m_context->settings->m_updatesPerSecond);
+	ui.updatesPerSec->setCurrentIndex(index);
+	connect(ui.updatesPerSec,SIGNAL(currentIndexChanged(int)),this,SLOT(updatesPerSecChanged(int)));
 }
 
 SpectrumWidget::~SpectrumWidget()
@@ -204,12 +220,14 @@ SpectrumWidget::~SpectrumWidget()
 	delete[] m_fftMap;
 	delete[] m_topPanelFftMap;
 	delete[] m_lineBuf;
+	if (m_overview != NULL)
+		delete m_overview;
 }
 void SpectrumWidget::run(bool r)
 {
     //Global is not initialized in constructor
-	ui.displayBox->setFont(global->settings->m_medFont);
-	ui.maxDbBox->setFont(global->settings->m_medFont);
+	ui.displayBox->setFont(m_context->settings->m_medFont);
+	ui.maxDbBox->setFont(m_context->settings->m_medFont);
 
     QRect plotFr = ui.plotFrame->geometry(); //relative to parent
 
@@ -231,7 +249,7 @@ void SpectrumWidget::run(bool r)
 	m_topPanelPlotLabel.fill(Qt::black);
 
 	if (r) {
-		m_spectrumMode = (DisplayMode)global->sdr->get(DeviceInterface::Key_LastSpectrumMode).toInt();
+		m_spectrumMode = (DisplayMode)m_context->sdr->get(DeviceInterface::Key_LastSpectrumMode).toInt();
 		//Triggers connection slot to set current mode
 		ui.displayBox->setCurrentIndex(ui.displayBox->findData(m_spectrumMode)); //Initial display mode
 		ui.zoomLabel->setText(QString().sprintf("S: %.0f kHz",m_sampleRate/1000.0));
@@ -245,6 +263,12 @@ void SpectrumWidget::run(bool r)
 		ui.zoomLabel->setText(QString().sprintf(""));
 		m_isRunning =false;
 		m_signalSpectrum = NULL;
+		//Next device or recording may not have an overview
+		if (m_overview != NULL)
+			delete m_overview;
+		m_overview = NULL;
+		m_overviewFileName.clear();
+		m_overviewPixmap = QPixmap();
 		m_plotArea.fill(Qt::black); //Start with a  clean plot every time
 		m_plotOverlay.fill(Qt::black); //Start with a  clean plot every time
         update();
@@ -524,6 +548,17 @@ void SpectrumWidget::mousePressEvent ( QMouseEvent * event )
 	if (m_spectrumMode == NODISPLAY)
 		return;
 
+	if (m_spectrumMode == OVERVIEW_WATERFALL && m_overview != NULL) {
+		QRect topPlotFr = mapFrameToWidget(ui.topPlotFrame);
+		if (topPlotFr.contains(event->pos())) {
+			//Jump to the slice under the mouse, device seeks before its next read
+			quint32 slice = (qint64)(event->pos().y() - topPlotFr.top()) * m_overview->numSlices() / topPlotFr.height();
+			m_context->sdr->set(DeviceInterface::Key_PlaybackPosition, m_overview->sliceSample(slice));
+			event->accept();
+			return;
+		}
+	}
+
     Qt::MouseButton button = event->button();
     // Mac: Qt::ControlModifier == Command Key
     // Mac: Qt::AltModifer == Option(Alt) Key
@@ -649,6 +684,12 @@ void SpectrumWidget::plotSelectionChanged(DisplayMode _mode)
 			//switching between Waterfall, Spectrum, etc clear the old display
 			updateTopPanel(WATERFALL,false);
 			break;
+		case OVERVIEW_WATERFALL:
+			updateTopPanel(WATERFALL,false);
+			//Overview is always the whole recording, nothing to zoom
+			ui.hiResButton->setVisible(false);
+			m_overviewCheckCounter = 0;
+			break;
 		default:
 			qDebug()<<"Invalid display mode";
 			break;
@@ -696,7 +737,7 @@ void SpectrumWidget::recalcScale()
 		return;
 
 	//Similar to SignalStrength, but works across entire spectrum, not just bandpass
-	double *spectrum = m_signalSpectrum->getUnprocessed();
+	double *spectrum = m_signalSpectrum->getDisplayUnprocessed();
 	double pwr = 0;
 	double totalPwr = 0;
 	double peakPwr = 0;
@@ -737,11 +778,12 @@ void SpectrumWidget::setSignalSpectrum(SignalSpectrum *s)
 {
 	m_signalSpectrum = s;
 	if (s!=NULL) {
-		connect(m_signalSpectrum,SIGNAL(newFftData()),this,SLOT(newFftData()));
+		//Emitted from spectrum worker thread
+		connect(m_signalSpectrum,SIGNAL(newFftData()),this,SLOT(newFftData()),Qt::QueuedConnection);
 
 		m_sampleRate = s->getSampleRate();
-		m_upDownIncrement = global->settings->m_upDownIncrement;
-		m_leftRightIncrement = global->settings->m_leftRightIncrement;
+		m_upDownIncrement = m_context->settings->m_upDownIncrement;
+		m_leftRightIncrement = m_context->settings->m_leftRightIncrement;
 	}
 }
 // Diplays frequency cursor and filter range
@@ -867,7 +909,7 @@ void SpectrumWidget::paintEvent(QPaintEvent *e)
 	{
 		if (true)
 		{
-			painter.setFont(global->settings->m_medFont);
+			painter.setFont(m_context->settings->m_medFont);
 			for (int i=0; i<m_message.count(); i++)
 			{
 				painter.drawText(20, 15 + (i*12) , m_message[i]);
@@ -917,12 +959,15 @@ void SpectrumWidget::paintEvent(QPaintEvent *e)
 			paintWaterfall(false, &painter);
 			break;
 
+		case OVERVIEW_WATERFALL:
+			paintOverview(&painter);
+			paintWaterfall(false, &painter);
+			break;
+
 		default:
 			break;
 	}
 
-    //Tell spectrum generator it ok to give us another one
-	m_signalSpectrum->m_displayUpdateComplete = true;
 }
 
 void SpectrumWidget::displayChanged(int s)
@@ -930,7 +975,7 @@ void SpectrumWidget::displayChanged(int s)
     //Get mode from itemData
 	DisplayMode displayMode = (DisplayMode)ui.displayBox->itemData(s).toInt();
 	//Save in device ini
-	global->sdr->set(DeviceInterface::Key_LastSpectrumMode,displayMode);
+	m_context->sdr->set(DeviceInterface::Key_LastSpectrumMode,displayMode);
     plotSelectionChanged(displayMode);
 }
 
@@ -945,9 +990,9 @@ void SpectrumWidget::maxDbChanged(int s)
 		m_plotMaxDb = db;
 	}
 
-	global->settings->m_autoScaleMax = m_autoScaleMax;
-	global->settings->m_fullScaleDb = m_plotMaxDb;
-	global->settings->writeSettings(); //save
+	m_context->settings->m_autoScaleMax = m_autoScaleMax;
+	m_context->settings->m_fullScaleDb = m_plotMaxDb;
+	m_context->settings->writeSettings(); //save
 	drawOverlay();
 	update();
 }
@@ -963,9 +1008,9 @@ void SpectrumWidget::minDbChanged(int t)
 		m_plotMinDb = db;
 	}
 
-	global->settings->m_autoScaleMin = m_autoScaleMin;
-	global->settings->m_baseScaleDb = m_plotMinDb;
-	global->settings->writeSettings(); //save
+	m_context->settings->m_autoScaleMin = m_autoScaleMin;
+	m_context->settings->m_baseScaleDb = m_plotMinDb;
+	m_context->settings->writeSettings(); //save
 	drawOverlay();
 	update();
 
@@ -1168,6 +1213,11 @@ void SpectrumWidget::drawWaterfall(QPixmap &_pixMap, QPixmap &_pixOverlayMap, qi
 //New Fft data is ready for display, update screen if last update is finished
 void SpectrumWidget::newFftData()
 {
+	//Queued, spectrum may have gone away since
+	if (m_signalSpectrum == NULL)
+		return;
+	//Newest frames, stay put until the next newFftData()
+	m_signalSpectrum->latchDisplay();
 	if (!m_isRunning)
         return;
 
@@ -1321,6 +1371,21 @@ void SpectrumWidget::newFftData()
 			}
 			drawWaterfall(m_topPanelPlotArea, m_topPanelPlotOverlay, m_topPanelFftMap);
 
+			//Lower waterfall
+			m_signalSpectrum->mapFFTToScreen(
+				255, //Equates to spectrumColor array
+				m_plotArea.width(),
+				//These are same as testbench
+				m_plotMaxDb, //FFT dB level  corresponding to output value == MaxHeight
+				m_plotMinDb, //FFT dB level corresponding to output value == 0
+				startFreq, //Low frequency
+				endFreq, //High frequency
+				m_fftMap );
+			drawWaterfall(m_plotArea,m_plotOverlay,m_fftMap);
+			update();
+			break;
+		case OVERVIEW_WATERFALL:
+			updateOverview();
 			//Lower waterfall
 			m_signalSpectrum->mapFFTToScreen(
 				255, //Equates to spectrumColor array
@@ -1657,9 +1722,9 @@ void SpectrumWidget::paintMouseCursor(bool paintTopPanel, QPainter *painter, QCo
 		freqLabel = "";
 	dbLabel.sprintf("%d db",mouseDb);
 
-	painter->setFont(global->settings->m_medFont);
+	painter->setFont(m_context->settings->m_medFont);
 	//How many pixels do we need to display label with specified font
-	QFontMetrics metrics(global->settings->m_medFont);
+	QFontMetrics metrics(m_context->settings->m_medFont);
 	QRect rect = metrics.boundingRect(freqLabel);
 	if (cursorPos.x() + rect.width() > plotFr.width())
 		cursorPos.setX(cursorPos.x() - rect.width()); //left of cursor
@@ -1758,6 +1823,123 @@ void SpectrumWidget::drawWaterfallOverlay(bool drawTopPanel)
 	delete labelPainter;
 }
 
+//Device builds the overview in the background for older recordings, so keep asking until it has one
+void SpectrumWidget::updateOverview()
+{
+	if (--m_overviewCheckCounter > 0)
+		return;
+	m_overviewCheckCounter = m_overviewCheckInterval;
+
+	QString fileName = m_context->sdr->get(DeviceInterface::Key_RecordingOverview).toString();
+	if (fileName == m_overviewFileName)
+		return;
+	m_overviewFileName = fileName;
+	if (m_overview == NULL)
+		m_overview = new IQOverview();
+	if (fileName.isEmpty() || !m_overview->load(fileName)) {
+		delete m_overview;
+		m_overview = NULL;
+	}
+	m_overviewPixmap = QPixmap(); //Force render
+	drawOverviewOverlay();
+	update();
+}
+
+//Start of recording at the top, same frequency span as the waterfall below so signals line up
+void SpectrumWidget::renderOverview(QSize _size)
+{
+	m_overviewMaxDb = m_plotMaxDb;
+	m_overviewMinDb = m_plotMinDb;
+	QImage image(_size, QImage::Format_RGB32);
+	if (m_overview == NULL || _size.isEmpty()) {
+		m_overviewPixmap = QPixmap::fromImage(image);
+		return;
+	}
+
+	//Overview values to colors at current dB scale
+	QRgb colors[256];
+	double db;
+	int map;
+	for (int i = 0; i < 256; i++) {
+		db = IQOverview::c_minDb + i * (IQOverview::c_maxDb - IQOverview::c_minDb) / 255.0;
+		map = (db - m_plotMinDb) * 255 / (m_plotMaxDb - m_plotMinDb);
+		map = map < 0 ? 0 : (map > 255 ? 255 : map);
+		colors[i] = m_spectrumColors[255 - map].rgb();
+	}
+
+	int width = _size.width();
+	int height = _size.height();
+	int level = m_overview->levelForRows(height);
+	quint32 rows = m_overview->numSlices(level);
+	quint32 numBins = m_overview->numBins();
+	const quint8 *tile;
+	QRgb *line;
+	for (int y = 0; y < height; y++) {
+		line = (QRgb *)image.scanLine(y);
+		tile = m_overview->tile(level, (quint64)y * rows / height);
+		if (tile == NULL) {
+			for (int x = 0; x < width; x++)
+				line[x] = colors[0];
+			continue;
+		}
+		for (int x = 0; x < width; x++)
+			line[x] = colors[tile[(quint64)x * numBins / width]];
+	}
+	m_overviewPixmap = QPixmap::fromImage(image);
+}
+
+void SpectrumWidget::paintOverview(QPainter *painter)
+{
+	QRect topPanelFr = mapFrameToWidget(ui.topPlotFrame);
+	QRect topPanelLabelFr = mapFrameToWidget(ui.topLabelFrame);
+
+	painter->drawPixmap(topPanelLabelFr,m_topPanelPlotLabel);
+	if (m_overview == NULL) {
+		painter->fillRect(topPanelFr, Qt::black);
+		painter->setPen(Qt::white);
+		painter->setFont(m_context->settings->m_medFont);
+		painter->drawText(topPanelFr, Qt::AlignCenter, "No overview for this device or recording (yet)");
+		return;
+	}
+
+	if (m_overviewPixmap.size() != topPanelFr.size() || m_overviewMaxDb != m_plotMaxDb ||
+			m_overviewMinDb != m_plotMinDb)
+		renderOverview(topPanelFr.size());
+	painter->drawPixmap(topPanelFr, m_overviewPixmap);
+
+	//Where we are in the recording
+	quint64 sample = m_context->sdr->get(DeviceInterface::Key_PlaybackPosition).toULongLong();
+	int y = topPanelFr.top() + (qint64)m_overview->findSliceBySample(sample) * topPanelFr.height() /
+		m_overview->numSlices();
+	painter->setPen(Qt::yellow);
+	painter->drawLine(topPanelFr.left(), y, topPanelFr.right(), y);
+
+	paintFreqCursor(painter, topPanelFr, false, Qt::white);
+}
+
+//Top label shows when the recording starts and ends instead of a frequency scale
+void SpectrumWidget::drawOverviewOverlay()
+{
+	m_topPanelPlotLabel.fill(Qt::black);
+	if (m_overview == NULL)
+		return;
+
+	QPainter labelPainter(&m_topPanelPlotLabel);
+	QFont overlayFont("Arial");
+	overlayFont.setPointSize(10);
+	overlayFont.setWeight(QFont::Normal);
+	labelPainter.setFont(overlayFont);
+	labelPainter.setPen(Qt::white);
+
+	QString format = "yyyy-MM-dd hh:mm:ss 'UTC'";
+	QString start = QDateTime::fromMSecsSinceEpoch(m_overview->sliceUtcMs(0)).toUTC().toString(format);
+	QString end = QDateTime::fromMSecsSinceEpoch(m_overview->sliceUtcMs(m_overview->numSlices() - 1)).
+		toUTC().toString(format);
+	QRect rect = m_topPanelPlotLabel.rect().adjusted(4, 0, -4, 0);
+	labelPainter.drawText(rect, Qt::AlignLeft | Qt::AlignVCenter, "Start " + start);
+	labelPainter.drawText(rect, Qt::AlignRight | Qt::AlignVCenter, "End " + end);
+}
+
 void SpectrumWidget::drawOverlay()
 {
 	if (!m_isRunning)
@@ -1794,6 +1976,10 @@ void SpectrumWidget::drawOverlay()
 		case WATERFALL:
 			drawWaterfallOverlay(false);
 			break;
+		case OVERVIEW_WATERFALL:
+			drawOverviewOverlay();
+			drawWaterfallOverlay(false);
+			break;
 		case NODISPLAY:
 			break;
 	}
@@ -3,6 +3,7 @@
 //GPL license and attributions are in gpl.h and terms are included in this file by reference
 #include "gpl.h"
 #include "global.h"
+#include "receivercontext.h"
 
 #include <QWidget>
 #include <QImage>
@@ -12,6 +13,7 @@
 #include "ui_spectrumwidget.h"
 #include "demod.h"
 #include "signalspectrum.h"
+#include "iqoverview.h"
 
 class SpectrumThread;
 
@@ -21,8 +23,9 @@ class SpectrumWidget : public QWidget
 
 public:
 	//Waterfall_Spectrum is non-standard mode and is deliberately skipped
+	//Modes are saved in device ini, add new ones at the end
 	enum DisplayMode {SPECTRUM = 0, WATERFALL, SPECTRUM_SPECTRUM, SPECTRUM_WATERFALL,
-		WATERFALL_WATERFALL, NODISPLAY};
+		WATERFALL_WATERFALL, NODISPLAY, OVERVIEW_WATERFALL};
 
 
 	SpectrumWidget(QWidget *parent = 0);
@@ -35,6 +38,8 @@ public:
 	//Text is displayed when spectrum is 'off' for now
 	void setMessage(QStringList s);
 	void setSignalSpectrum(SignalSpectrum *s);
+	//Settings are per receiver, call before run()
+	void setContext(ReceiverContext *_context);
 
 public slots:
 		void plotSelectionChanged(DisplayMode _mode);
@@ -56,6 +61,7 @@ private slots:
 	void newFftData();
 
 private:
+	ReceiverContext *m_context;
 	void paintFreqCursor(QPainter *painter, QRect plotFr, bool isZoomed, QColor color);
 	void drawOverlay();
 	double getMouseFreq();
@@ -70,6 +76,11 @@ private:
 	void drawWaterfall(QPixmap &_pixMap, QPixmap &_pixOverlayMap, qint32 *_fftMap);
 	void drawWaterfallOverlay(bool drawTopPanel);
 
+	void updateOverview();
+	void renderOverview(QSize _size);
+	void paintOverview(QPainter *painter);
+	void drawOverviewOverlay();
+
 	QString frequencyLabel(double f, qint16 precision = -1);
 	double calcZoom(int item);
 	void paintMouseCursor(bool paintTopPanel, QPainter *painter, QColor color, bool paintDb, bool paintFreq);
@@ -149,6 +160,16 @@ private:
 	bool m_autoScaleMin;
 	bool m_scaleNeedsRecalc;
 
+	//Whole recording in top panel, OVERVIEW_WATERFALL.  NULL if device doesn't have one
+	IQOverview *m_overview;
+	QString m_overviewFileName;
+	QPixmap m_overviewPixmap; //Rendered at top panel size and dB scale below
+	qint16 m_overviewMaxDb;
+	qint16 m_overviewMinDb;
+	int m_overviewCheckCounter;
+	//Device may still be building the overview, ask again every this many newFftData()
+	const int m_overviewCheckInterval = 10;
+
 	//Limits on what user can set ui controls
 	const int m_maxDbScaleLimit = -50;
 	const int m_minDbScaleLimit = -70;
@@ -0,0 +1,227 @@
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "stationindex.h"
+#include "presets.h"
+#include <algorithm>
+#include <cmath>
+
+const int c_minutesPerDay = 24 * 60;
+
+StationIndex::StationIndex()
+{
+}
+
+void StationIndex::buildBands(const Band *_bands, int _numBands)
+{
+	m_bandEdges.clear();
+	m_segmentBand.clear();
+	if (_bands == NULL || _numBands <= 0)
+		return;
+
+	//Bands are closed [low,high], segments are half open so use the next double past high as the edge
+	QVector<double> highEdges(_numBands);
+	for (int i = 0; i < _numBands; i++) {
+		highEdges[i] = std::nextafter(_bands[i].high, HUGE_VAL);
+		if (_bands[i].high < _bands[i].low)
+			continue; //Can never match
+		m_bandEdges.append(_bands[i].low);
+		m_bandEdges.append(highEdges[i]);
+	}
+	std::sort(m_bandEdges.begin(), m_bandEdges.end());
+	m_bandEdges.erase(std::unique(m_bandEdges.begin(), m_bandEdges.end()), m_bandEdges.end());
+	if (m_bandEdges.count() < 2) {
+		m_bandEdges.clear();
+		return;
+	}
+
+	//Every band edge is a segment edge, so a band either covers a whole segment or none of it
+	int numSegments = m_bandEdges.count() - 1;
+	m_segmentBand.fill(-1, numSegments);
+	double segLow;
+	for (int s = 0; s < numSegments; s++) {
+		segLow = m_bandEdges[s];
+		for (int i = 0; i < _numBands; i++) {
+			if (segLow >= _bands[i].low && segLow < highEdges[i]) {
+				m_segmentBand[s] = i;
+				break; //First match, same as original linear search
+			}
+		}
+	}
+}
+
+int StationIndex::findBand(double _freq) const
+{
+	if (m_segmentBand.isEmpty())
+		return -1;
+	//First edge > _freq, segment is the one before it
+	int s = std::upper_bound(m_bandEdges.constBegin(), m_bandEdges.constEnd(), _freq) - m_bandEdges.constBegin() - 1;
+	if (s < 0 || s >= m_segmentBand.count())
+		return -1;
+	return m_segmentBand[s];
+}
+
+void StationIndex::buildStations(const Station *_stations, int _numStations)
+{
+	m_entries.clear();
+	if (_stations == NULL || _numStations <= 0)
+		return;
+
+	m_entries.reserve(_numStations);
+	Entry entry;
+	for (int i = 0; i < _numStations; i++) {
+		if (_stations[i].freq <= 0)
+			continue; //Skipped csv line
+		entry.freq = _stations[i].freq;
+		if (!parseTime(_stations[i].time, entry.startMinute, entry.stopMinute)) {
+			//Memories usually have no time, treat as always on
+			entry.startMinute = 0;
+			entry.stopMinute = c_minutesPerDay;
+		}
+		entry.days = parseDays(_stations[i].days, entry.flags);
+		entry.station = i;
+		m_entries.append(entry);
+	}
+	//Stable so stations on the same frequency stay in file order, eibi then memory
+	std::stable_sort(m_entries.begin(), m_entries.end(), [](const Entry &a, const Entry &b) {
+		return a.freq < b.freq;
+	});
+}
+
+void StationIndex::findStations(double _lowFreq, double _highFreq, const QDateTime &_utc, QVector<int> &_out) const
+{
+	QVector<Entry>::const_iterator it = std::lower_bound(m_entries.constBegin(), m_entries.constEnd(), _lowFreq,
+		[](const Entry &e, double f) {return e.freq < f;});
+
+	bool checkSchedule = _utc.isValid();
+	int dayOfWeek = 0;
+	int minute = 0;
+	if (checkSchedule) {
+		QDateTime utc = _utc.toUTC();
+		dayOfWeek = utc.date().dayOfWeek();
+		minute = utc.time().hour() * 60 + utc.time().minute();
+	}
+
+	for (; it != m_entries.constEnd() && it->freq <= _highFreq; ++it) {
+		if (checkSchedule && !isOnAir(*it, dayOfWeek, minute))
+			continue;
+		_out.append(it->station);
+	}
+}
+
+bool StationIndex::isOnAir(const Entry &_entry, int _dayOfWeek, int _minute)
+{
+	quint8 today = 1 << (_dayOfWeek - 1);
+	quint8 yesterday = 1 << ((_dayOfWeek + 5) % 7);
+
+	if (_entry.startMinute == _entry.stopMinute)
+		return (_entry.days & today) != 0; //0000-0000, all day
+
+	if (_entry.startMinute < _entry.stopMinute)
+		return (_entry.days & today) && _minute >= _entry.startMinute && _minute < _entry.stopMinute;
+
+	//Runs past midnight, early part of today belongs to yesterday's broadcast
+	return ((_entry.days & today) && _minute >= _entry.startMinute) ||
+		((_entry.days & yesterday) && _minute < _entry.stopMinute);
+}
+
+//"hhmm-hhmm", 2400 is allowed as a stop time
+bool StationIndex::parseTime(const QString &_time, quint16 &_startMinute, quint16 &_stopMinute)
+{
+	QString time = _time.trimmed();
+	if (time.length() != 9 || time.at(4) != '-')
+		return false;
+
+	int digits[8];
+	int d = 0;
+	for (int i = 0; i < 9; i++) {
+		if (i == 4)
+			continue;
+		if (!time.at(i).isDigit())
+			return false;
+		digits[d++] = time.at(i).digitValue();
+	}
+	int startHour = digits[0] * 10 + digits[1];
+	int startMin = digits[2] * 10 + digits[3];
+	int stopHour = digits[4] * 10 + digits[5];
+	int stopMin = digits[6] * 10 + digits[7];
+	if (startHour > 23 || startMin > 59 || stopHour > 24 || stopMin > 59 || (stopHour == 24 && stopMin != 0))
+		return false;
+
+	_startMinute = startHour * 60 + startMin;
+	_stopMinute = stopHour * 60 + stopMin;
+	return true;
+}
+
+quint8 StationIndex::parseDays(const QString &_days, quint8 &_flags)
+{
+	static const char *dayNames[7] = {"mo", "tu", "we", "th", "fr", "sa", "su"};
+
+	_flags = 0;
+	QString days = _days.trimmed().toLower();
+	if (days.isEmpty())
+		return c_allDays;
+
+	int pos = 0;
+	int len = days.length();
+	//"1.Sa" first Saturday of the month, we don't track weeks
+	if (len > 2 && days.at(0).isDigit() && days.at(1) == '.') {
+		_flags |= c_irregular;
+		pos = 2;
+	}
+
+	quint8 mask = 0;
+	//"1245" Monday = 1
+	bool allDigits = pos == 0;
+	for (int i = 0; i < len && allDigits; i++)
+		allDigits = days.at(i) >= '1' && days.at(i) <= '7';
+	if (allDigits) {
+		for (int i = 0; i < len; i++)
+			mask |= 1 << (days.at(i).digitValue() - 1);
+		return mask;
+	}
+
+	//Two letter names with ',' lists and '-' ranges, ranges can wrap (We-Mo)
+	int prevDay = -1;
+	bool isRange = false;
+	int day;
+	while (pos < len) {
+		QChar c = days.at(pos);
+		if (c == ',') {
+			pos++;
+			continue;
+		}
+		if (c == '-') {
+			if (prevDay < 0 || isRange)
+				break; //Malformed
+			isRange = true;
+			pos++;
+			continue;
+		}
+		day = -1;
+		if (pos + 1 < len) {
+			for (int i = 0; i < 7; i++) {
+				if (c == dayNames[i][0] && days.at(pos + 1) == dayNames[i][1]) {
+					day = i;
+					break;
+				}
+			}
+		}
+		if (day < 0)
+			break; //Not a day name, irr, alt, dates etc
+		if (isRange) {
+			for (int d = prevDay; d != day; d = (d + 1) % 7)
+				mask |= 1 << d;
+			isRange = false;
+		}
+		mask |= 1 << day;
+		prevDay = day;
+		pos += 2;
+	}
+
+	if (pos < len || isRange || mask == 0) {
+		//Something we don't understand, show it any day but let caller know schedule is approximate
+		_flags |= c_irregular;
+		return c_allDays;
+	}
+	return mask;
+}
@@ -0,0 +1,68 @@
+#ifndef STATIONINDEX_H
+#define STATIONINDEX_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include <QtCore>
+
+class Station;
+class Band;
+
+/*
+	Frequency and schedule index for Presets
+
+	Stations
+		Small fixed size entry per station sorted by frequency, schedule parsed once from EiBi Time and Days columns
+		Span query is a binary search for the low edge and a walk to the high edge, so cost is the number of
+		stations in the span, not the size of the schedule
+
+	Bands
+		bands.csv ranges can overlap and FindBand() returns the first match in file order
+		Band edges split the spectrum into segments and each segment stores the first band that covers it,
+		so lookup is a binary search over segment edges with the same first match result
+
+	Days
+		Empty = every day, 1-7 (Monday = 1), Mo,Tu..Su with ranges (Mo-Fr, We-Mo wraps) and lists (SaSu, Tu,Th)
+		1.Sa (first Saturday) is treated as every Saturday and flagged irregular
+		Anything we can't parse (irr, alt, dates, seasons) is every day and flagged irregular
+	Time
+		hhmm-hhmm UTC, stop < start runs past midnight and belongs to the start day.  Missing = all day
+*/
+
+class StationIndex
+{
+public:
+	static const quint8 c_allDays = 0x7f; //Bit 0 = Monday
+	static const quint8 c_irregular = 0x01;
+
+	StationIndex();
+
+	void buildBands(const Band *_bands, int _numBands);
+	//Same result as linear first match search, -1 if no band
+	int findBand(double _freq) const;
+
+	void buildStations(const Station *_stations, int _numStations);
+	//Appends indexes into _stations[] with _lowFreq <= freq <= _highFreq, in frequency order
+	//If _utc is valid only stations on the air at that time are returned
+	void findStations(double _lowFreq, double _highFreq, const QDateTime &_utc, QVector<int> &_out) const;
+
+	static bool parseTime(const QString &_time, quint16 &_startMinute, quint16 &_stopMinute);
+	static quint8 parseDays(const QString &_days, quint8 &_flags);
+
+private:
+	struct Entry {
+		double freq; //Hz
+		quint16 startMinute; //UTC minute of day
+		quint16 stopMinute;
+		quint8 days;
+		quint8 flags;
+		qint32 station; //Index into stations[]
+	};
+
+	QVector<Entry> m_entries; //Sorted by freq
+	QVector<double> m_bandEdges; //Sorted, segment i is [edge i, edge i+1)
+	QVector<int> m_segmentBand; //First band covering each segment, -1 if none
+
+	static bool isOnAir(const Entry &_entry, int _dayOfWeek, int _minute);
+};
+
+#endif // STATIONINDEX_H
@@ -81,6 +81,7 @@ TestBench::TestBench(QWidget *parent) :
 	ui(new Ui::TestBench)
 {
 	m_active = false;
+	m_probeHub = NULL;
 	m_2DPixmap = QPixmap(0,0);
 	m_overlayPixmap = QPixmap(0,0);
 	m_size = QSize(0,0);
@@ -260,6 +261,34 @@ void TestBench::showEvent(QShowEvent *event)
 	Q_UNUSED(event);
 	m_active = true;
     m_pTimer->start(500);		//start up timer
+	if (m_probeHub != NULL)
+		m_probeHub->attach(this);
+}
+
+//Close and setVisible(false) both end up here, probes only cost the receiver while we're on screen
+void TestBench::hideEvent(QHideEvent *event)
+{
+	Q_UNUSED(event);
+	if (m_probeHub != NULL)
+		m_probeHub->detach(this);
+}
+
+void TestBench::setProbeHub(ProbeHub *_hub)
+{
+	if (m_probeHub != NULL)
+		m_probeHub->detach(this);
+	m_probeHub = _hub;
+	if (m_probeHub != NULL && isVisible())
+		m_probeHub->attach(this);
+}
+
+void TestBench::probeBlock(const ProbeBlock &_block)
+{
+	//displayData() doesn't modify the buffer
+	if (_block.cpx != NULL)
+		displayData(_block.numSamples, (TYPECPX *)_block.cpx, _block.sampleRate, _block.profile);
+	else
+		displayData(_block.numSamples, (TYPEREAL *)_block.real, _block.sampleRate, _block.profile);
 }
 
 void TestBench::onTestSlider1(int val)
@@ -47,6 +47,7 @@
 #include "nco.h"
 #include "fftcute.h"
 #include "demod/demod_wfm.h"
+#include "probe.h"
 
 
 //////////////////////////////////////////////////////////////////////
@@ -76,7 +77,8 @@ namespace Ui {
 	class TestBench;
 }
 
-class TestBench : public QDialog
+//Gets its data as a ProbeSink, attached to every probe point while the bench is visible
+class TestBench : public QDialog, public ProbeSink
 {
     Q_OBJECT
 
@@ -90,6 +92,13 @@ public:
 
 	void genSweep(int length, TYPECPX* pBuf);
 	void genNoise(int length, CPX *pBuf);
+	//Checked inline by the receiver so genSweep() and genNoise() aren't called at all when they're off
+	bool isGenerating() {return m_active && (m_genOn || m_noiseOn);}
+
+	//Set by receiver, NULL detaches us from the previous hub
+	void setProbeHub(ProbeHub *_hub);
+	//Probe thread
+	void probeBlock(const ProbeBlock &_block);
 
 	void sendDebugTxt(QString Str){ if(m_active) emit sendTxt(Str);}
 
@@ -175,6 +184,7 @@ protected:
 	void paintEvent(QPaintEvent *event);
 	void closeEvent(QCloseEvent *event);
 	void showEvent(QShowEvent *event);
+	void hideEvent(QHideEvent *event);
 
 private:
 	Ui::TestBench *ui;
@@ -230,6 +240,8 @@ private:
 	QMutex m_displayMutex;
 
 	NCO *m_nco;
+
+	ProbeHub *m_probeHub;
 };
 
 #endif // TESTBENCH_H
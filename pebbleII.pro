@@ -28,8 +28,11 @@ SUBDIRS =   pebblelib/pebblelib.pro \
             plugins/SDRPlayDevice \
             plugins/HackRFDevice \
             plugins/MorseGenDevice \
+            plugins/SynthSDRDevice \
+            plugins/ShmIqDevice \
             application/pebbleqt.pro \
-            SdrGarage
+            SdrGarage \
+            SdrEmulator
 
 # build must be last:
 #build in the order listed
@@ -7,10 +7,34 @@
 
 Audio::Audio(QObject *parent) : QObject(parent)
 {
+	outRing = NULL;
+	outBufferUnderflowCount = 0;
+	outBufferOverflowCount = 0;
+	outBufferLatencyMs = 0;
 }
 
 Audio::~Audio()
 {
+	if (outRing != NULL)
+		delete outRing;
+}
+
+double Audio::OutputDeviceLatencyMs()
+{
+	return 0;
+}
+
+//Common part of SendToOutput(), never blocks the DSP thread
+void Audio::QueueOutput(CPX *_cpxBuf, int _numSamples, float gain, bool mute)
+{
+	if (outRing == NULL)
+		return;
+	//Keep the sound card fed with silence when muted, otherwise every mute looks like an underrun
+	//UI returns gain from 0 to 100
+	outRing->write(_cpxBuf, _numSamples, mute ? 0 : gain / 100);
+	outBufferUnderflowCount = outRing->underruns();
+	outBufferOverflowCount = outRing->overruns();
+	outBufferLatencyMs = outRing->latencyMs();
 }
 
 Audio *Audio::Factory(CB_AudioProducer cb, quint16 framesPerBuffer)
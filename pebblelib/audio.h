@@ -7,6 +7,7 @@
 #include <QObject>
 #include <QstringList>
 #include "cpx.h"
+#include "audiooutputring.h"
 
 class Audio : public QObject
 {
@@ -22,6 +23,8 @@ public:
 	virtual int Restart()=0;
     virtual void SendToOutput(CPX *_cpxBuf,int _numSamples, float gain = 1.0, bool mute = false)=0;
 	virtual void ClearCounts()=0;
+	//Audio queued in the sound card or audio API past outRing, 0 if we can't tell
+	virtual double OutputDeviceLatencyMs();
 
     //Creates either PortAudio or QTAudio device
 	static Audio *Factory(CB_AudioProducer cb, quint16 framesPerBuffer);
@@ -37,6 +40,7 @@ public:
 	double inBufferOverflowCount;
 	double outBufferUnderflowCount;
 	double outBufferOverflowCount;
+	double outBufferLatencyMs; //Time audio waits in outRing
 
 	//Utility functions to convert samples
 	float Int2Float(int sample) {return sample / 32767;}
@@ -55,6 +59,10 @@ protected:
 	int framesPerBuffer; //#samples in each callback
 	CB_AudioProducer AudioProducer;
 	bool hasOutputTimedOut;
+
+	//SendToOutput() queues here, sound card callback pulls.  Created in StartOutput() once we know the rate
+	AudioOutputRing *outRing;
+	void QueueOutput(CPX *_cpxBuf, int _numSamples, float gain, bool mute);
 };
 
 #endif // AUDIO_H
@@ -0,0 +1,141 @@
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "audiooutputring.h"
+
+//Same clip level as old SendToOutput()
+const float c_maxOutput = 0.9999f;
+//Max read ratio change, +/- 0.5%.  Worst case crystal drift is 100x less
+const double c_maxSteer = 0.005;
+//Ratio change per unit of fill error, loop time constant is ~15sec at 48k with 2048 frame target
+const double c_steerGain = 0.005;
+//Fill level average per consumer callback, ~1sec time constant at typical callback rates
+const double c_fillSmoothing = 0.01;
+
+AudioOutputRing::AudioOutputRing(quint32 _sampleRate, quint32 _framesPerBuffer)
+{
+	m_sampleRate = _sampleRate;
+	//Producer writes in bursts of _framesPerBuffer, room for several so a slow sound card doesn't overrun
+	m_targetFill = _framesPerBuffer * 2;
+	m_capacity = 1;
+	while (m_capacity < _framesPerBuffer * 8)
+		m_capacity *= 2;
+	m_mask = m_capacity - 1;
+	m_ring = new float[m_capacity * c_numChannels];
+	reset();
+}
+
+AudioOutputRing::~AudioOutputRing()
+{
+	delete[] m_ring;
+}
+
+void AudioOutputRing::reset()
+{
+	m_writeCount.store(0);
+	m_readCount.store(0);
+	m_isPrimed = false;
+	m_avgFill = m_targetFill;
+	m_step = 1.0;
+	m_mu = 0;
+	memset(m_history, 0, sizeof(m_history));
+	m_latencyMs = 0;
+	clearCounts();
+}
+
+void AudioOutputRing::clearCounts()
+{
+	m_underruns.store(0);
+	m_overruns.store(0);
+}
+
+//No branches or calls in the loop, compiler turns this into packed min/max
+void AudioOutputRing::scaleAndClip(const double *_in, float *_out, quint32 _numValues, float _gain)
+{
+	float v;
+	for (quint32 i = 0; i < _numValues; i++) {
+		v = (float)_in[i] * _gain;
+		v = v > c_maxOutput ? c_maxOutput : v;
+		v = v < -c_maxOutput ? -c_maxOutput : v;
+		_out[i] = v;
+	}
+}
+
+quint32 AudioOutputRing::write(const CPX *_in, quint32 _numFrames, float _gain)
+{
+	quint32 writeCount = m_writeCount.load();
+	quint32 free = m_capacity - (writeCount - m_readCount.loadAcquire());
+	quint32 numFrames = _numFrames;
+	if (numFrames > free) {
+		m_overruns.fetchAndAddRelaxed(1);
+		numFrames = free;
+	}
+	const double *in = reinterpret_cast<const double *>(_in);
+	quint32 pos = writeCount & m_mask;
+	quint32 first = qMin(numFrames, m_capacity - pos);
+	scaleAndClip(in, &m_ring[pos * c_numChannels], first * c_numChannels, _gain);
+	if (first < numFrames)
+		scaleAndClip(&in[first * c_numChannels], m_ring, (numFrames - first) * c_numChannels, _gain);
+	//Release so consumer sees the samples before the count
+	m_writeCount.storeRelease(writeCount + numFrames);
+	return numFrames;
+}
+
+void AudioOutputRing::read(float *_out, quint32 _numFrames)
+{
+	quint32 readCount = m_readCount.load();
+	quint32 available = m_writeCount.loadAcquire() - readCount;
+
+	m_avgFill += c_fillSmoothing * (available - m_avgFill);
+	m_latencyMs = m_avgFill * 1000.0 / m_sampleRate;
+
+	if (!m_isPrimed) {
+		if (available < m_targetFill) {
+			memset(_out, 0, _numFrames * c_numChannels * sizeof(float));
+			return;
+		}
+		m_isPrimed = true;
+		m_avgFill = available;
+	}
+
+	//Too full reads faster, too empty reads slower
+	double error = (m_avgFill - m_targetFill) / m_targetFill;
+	m_step = 1.0 + qBound(-c_maxSteer, error * c_steerGain, c_maxSteer);
+
+	quint32 used = 0;
+	quint32 pos;
+	float y0, y1, y2, y3;
+	float t;
+	for (quint32 i = 0; i < _numFrames; i++) {
+		while (m_mu >= 1.0) {
+			if (used == available) {
+				//Out of data, silence for the rest of this callback and wait for producer to catch up
+				m_underruns.fetchAndAddRelaxed(1);
+				m_isPrimed = false;
+				memset(&_out[i * c_numChannels], 0, (_numFrames - i) * c_numChannels * sizeof(float));
+				m_readCount.storeRelease(readCount + used);
+				return;
+			}
+			pos = ((readCount + used) & m_mask) * c_numChannels;
+			for (quint32 c = 0; c < c_numChannels; c++) {
+				m_history[0][c] = m_history[1][c];
+				m_history[1][c] = m_history[2][c];
+				m_history[2][c] = m_history[3][c];
+				m_history[3][c] = m_ring[pos + c];
+			}
+			used++;
+			m_mu -= 1.0;
+		}
+		//Catmull-Rom between history[1] and history[2]
+		t = m_mu;
+		for (quint32 c = 0; c < c_numChannels; c++) {
+			y0 = m_history[0][c];
+			y1 = m_history[1][c];
+			y2 = m_history[2][c];
+			y3 = m_history[3][c];
+			_out[i * c_numChannels + c] = y1 + 0.5f * t * ((y2 - y0) + t * ((2.0f * y0 - 5.0f * y1 + 4.0f * y2 - y3)
+				+ t * (3.0f * (y1 - y2) + y3 - y0)));
+		}
+		m_mu += m_step;
+	}
+	m_readCount.storeRelease(readCount + used);
+}
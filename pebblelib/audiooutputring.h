@@ -0,0 +1,81 @@
+#ifndef AUDIOOUTPUTRING_H
+#define AUDIOOUTPUTRING_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "cpx.h"
+#include <QAtomicInteger>
+
+/*
+	Decouples the DSP thread from the sound card clock
+
+	SendToOutput() used to block in Pa_WriteStream() (PortAudio) or drop whatever didn't fit (QAudio), so either
+	sound card timing stalled the whole IQ pipeline or audio was lost.  Now SendToOutput() just queues samples here
+	and the audio API pulls them from its own callback.
+
+	Ring
+		Single producer (DSP thread), single consumer (audio callback), free running frame counters, no locks
+		Producer converts CPX (L=re, R=im) to interleaved float with gain and clipping as it copies
+		If the ring is full the newest samples are dropped and counted as an overrun
+
+	Drift
+		IQ device and sound card run off different crystals, typically 10-100ppm apart, so the ring slowly fills
+		or drains.  Consumer reads through a 4 point Hermite interpolator at a ratio steered by the smoothed fill
+		level: too full reads slightly faster, too empty slightly slower.  Ratio is limited to +/- 0.5% so
+		pitch never moves audibly.  Interpolator is flat to about fs/4, which covers any demodulated audio.
+
+	Underrun
+		Consumer outputs silence for the rest of the callback, counts an underrun and waits for the ring to
+		refill to the target level before playing again, so we get one clean gap instead of stutter
+*/
+
+class AudioOutputRing
+{
+public:
+	static const quint32 c_numChannels = 2;
+
+	//_framesPerBuffer is the largest block the producer writes, ring targets 2 of these
+	AudioOutputRing(quint32 _sampleRate, quint32 _framesPerBuffer);
+	~AudioOutputRing();
+
+	//Only call when producer and consumer are both stopped
+	void reset();
+
+	//DSP thread.  Returns frames queued, anything past that was dropped
+	quint32 write(const CPX *_in, quint32 _numFrames, float _gain);
+	//Audio callback.  Always fills _numFrames interleaved L/R frames, silence if we don't have data
+	void read(float *_out, quint32 _numFrames);
+
+	//Stats, safe to read from any thread
+	quint32 underruns() {return m_underruns.load();}
+	quint32 overruns() {return m_overruns.load();}
+	//Average time a sample spends in the ring, not including sound card buffers
+	double latencyMs() {return m_latencyMs;}
+	//Current consumer read ratio, > 1 means sound card is slower than producer
+	double ratio() {return m_step;}
+	void clearCounts();
+
+private:
+	quint32 m_sampleRate;
+	quint32 m_capacity; //Frames, power of 2
+	quint32 m_mask;
+	quint32 m_targetFill;
+	float *m_ring; //Interleaved L/R
+
+	QAtomicInteger<quint32> m_writeCount; //Producer only
+	QAtomicInteger<quint32> m_readCount; //Consumer only
+
+	//Consumer state
+	bool m_isPrimed;
+	double m_avgFill;
+	double m_step;
+	double m_mu; //Fractional position between m_history[1] and m_history[2]
+	float m_history[4][c_numChannels];
+
+	QAtomicInteger<quint32> m_underruns;
+	QAtomicInteger<quint32> m_overruns;
+	volatile double m_latencyMs;
+
+	static void scaleAndClip(const double *_in, float *_out, quint32 _numValues, float _gain);
+};
+
+#endif // AUDIOOUTPUTRING_H
@@ -20,7 +20,6 @@ AudioPA::AudioPA(CB_AudioProducer cb, int fpb):Audio()
 	sampleFormat = paFloat32;
 	//Todo: These can be removed I think, we're now setting them in Start() where we have SDR context
 	framesPerBuffer = fpb;
-	outStreamBuffer = new float[framesPerBuffer * 2];
 	inStream=NULL;
 	outStream=NULL;
 	error = Pa_Initialize();
@@ -104,6 +103,10 @@ int AudioPA::StartOutput(QString outputDeviceName, int _outputSampleRate)
     decimate = decimate < 1 ? 1 : decimate;
     outputSampleRate /= decimate;
 #endif
+    if (outRing != NULL)
+        delete outRing;
+    outRing = new AudioOutputRing(outputSampleRate, framesPerBuffer);
+
     error = Pa_IsFormatSupported(NULL,outParam,outputSampleRate);
     if (!error) {
         //Sample rate is set by SDR device if not using soundCard for I/Q
@@ -112,8 +115,9 @@ int AudioPA::StartOutput(QString outputDeviceName, int _outputSampleRate)
         //To avoid this, we always open with value from settings, even if we only use a fraction
         //of the buffer due to downsampling.
         //SendToOutput() will use the actual number of samples in buffer, not the size.
+        //Callback mode, outputCallback() pulls from outRing at the sound card's pace
         error = Pa_OpenStream(&outStream,NULL,outParam,
-			outputSampleRate,framesPerBuffer,paNoFlag,NULL,NULL );
+			outputSampleRate,framesPerBuffer,paNoFlag,&AudioPA::outputCallback,this );
 
         error = Pa_StartStream(outStream);
 	} else {
@@ -258,8 +262,19 @@ QStringList AudioPA::DeviceList(bool typeInput)
 	Pa_Terminate();
 	return devList;
 }
+//PortAudio's estimate for the open stream, includes host API buffers
+double AudioPA::OutputDeviceLatencyMs()
+{
+	if (outStream == NULL)
+		return 0;
+	const PaStreamInfo *info = Pa_GetStreamInfo(outStream);
+	return info != NULL ? info->outputLatency * 1000 : 0;
+}
+
 void AudioPA::ClearCounts()
 {
+	if (outRing != NULL)
+		outRing->clearCounts();
 	inBufferOverflowCount = 0;
 	inBufferUnderflowCount = 0;
 	outBufferOverflowCount = 0;
@@ -300,45 +315,27 @@ int AudioPA::streamCallback(
 	mutex.unlock();
 	return paContinue;
 }
-//Final call from receiver ProcessIQData to send audio out
-void AudioPA::SendToOutput(CPX *out, int outSamples, float gain, bool mute)
+//Output stream callback, runs on PortAudio's thread
+//Left and Right channel samples are interleaved, numSamples is the count of L/R pairs
+int AudioPA::outputCallback(
+    const void *input, void *output,
+	unsigned long numSamples,
+    const PaStreamCallbackTimeInfo* timeInfo,
+    PaStreamCallbackFlags statusFlags,
+    void *userData )
 {
-	float *outPtr;
-	outPtr = outStreamBuffer;
-    float temp;
-
-	//Save CPU and don't output anything if mute
-	//Note some sound systems may require outputting 0's, if so, then remove this check
-	if (mute)
-		return;
-
-	const float maxOutput = 0.9999;
-
-	//We may have to skip samples to reduce rate to match audio out, decimate set when we
-	//opened stream
-    for (int i=0;i<outSamples;i++)
-	{
-		//PortAudio doesn't have a SetVolume() call like QAudio, so we scale up samples
-		//UI returns gain from 0 to 100
-		out[i] *= (gain / 100); //1 is full gain
-
-		temp = out[i].real();
-        //Cap at -1 to +1 to make sure we don't overdrive
-		if (temp > maxOutput)
-			temp = maxOutput;
-		else if (temp < -maxOutput)
-			temp = -maxOutput;
-        *outPtr++ = temp;
-		temp = out[i].imag();
-        //Cap at -1 to +1 to make sure we don't overdrive
-		if (temp > maxOutput)
-			temp = maxOutput;
-		else if (temp < -maxOutput)
-			temp = -maxOutput;
-        *outPtr++ = temp;
-	}
+	Q_UNUSED(input);
+	Q_UNUSED(timeInfo);
+	Q_UNUSED(statusFlags); //outRing counts underruns and overruns
 
-	//Note we use frameCount, not #bytes in outStreamBuffer.  WriteStream knows format
-    error = Pa_WriteStream(outStream,outStreamBuffer,outSamples);
+	AudioPA *sc = (AudioPA*)userData;
+	sc->outRing->read((float*)output, numSamples);
+	return paContinue;
 }
 
+//Final call from receiver ProcessIQData to send audio out
+//Gain, clipping and float conversion happen as samples are queued, see AudioOutputRing
+void AudioPA::SendToOutput(CPX *out, int outSamples, float gain, bool mute)
+{
+	QueueOutput(out, outSamples, gain, mute);
+}
@@ -23,6 +23,7 @@ public:
 	int Restart();
     void SendToOutput(CPX *, int outSamples, float gain = 1.0, bool mute = false);
 	void ClearCounts();
+	double OutputDeviceLatencyMs();
 
     //Return device index for matching device
     int FindDeviceByName(QString name, bool inputDevice);
@@ -41,7 +42,6 @@ private:
 	//Input may come from another source, so we manage these streams separately
 	PaStream *inStream;
 	PaStream *outStream;
-	float *outStreamBuffer; 
 	PaSampleFormat sampleFormat;
 	PaError error;
 	static int streamCallback(const void *input, void *output,
@@ -49,5 +49,10 @@ private:
 		const PaStreamCallbackTimeInfo* timeInfo,
 		PaStreamCallbackFlags statusFlags,
 		void *userData );
+	static int outputCallback(const void *input, void *output,
+		unsigned long numSamples,
+		const PaStreamCallbackTimeInfo* timeInfo,
+		PaStreamCallbackFlags statusFlags,
+		void *userData );
 	static QMutex mutex;
 };
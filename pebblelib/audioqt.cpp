@@ -3,6 +3,25 @@
 #include "audioqt.h"
 #include <QDebug>
 
+AudioQTOutputDevice::AudioQTOutputDevice(AudioOutputRing *_ring, QObject *parent) : QIODevice(parent)
+{
+	ring = _ring;
+}
+
+qint64 AudioQTOutputDevice::readData(char *data, qint64 maxlen)
+{
+	qint64 frames = maxlen / (sizeof(float) * AudioOutputRing::c_numChannels);
+	ring->read((float*)data, frames);
+	return frames * sizeof(float) * AudioOutputRing::c_numChannels;
+}
+
+qint64 AudioQTOutputDevice::writeData(const char *data, qint64 len)
+{
+	Q_UNUSED(data);
+	Q_UNUSED(len);
+	return 0;
+}
+
 AudioQT::AudioQT(CB_AudioProducer cb, int fpb):Audio()
 {
 	AudioProducer = cb;
@@ -13,7 +32,9 @@ AudioQT::AudioQT(CB_AudioProducer cb, int fpb):Audio()
 	this->InputDeviceList();
 
     qaAudioOutput = NULL;
+	outputDeviceLatencyMs = 0;
     qaAudioInput = NULL;
+    outputDataSource = NULL;
     cpxOutBuffer = new CPX[framesPerBuffer];
     outStreamBuffer = new float[framesPerBuffer * 2]; //Max we'll ever see
     inStreamBuffer = new float[framesPerBuffer * 2 * 2]; //Max we'll ever see
@@ -133,14 +154,25 @@ int AudioQT::StartOutput(QString outputDeviceName, int _outputSampleRate)
 
     qaAudioOutput = new QAudioOutput(qaOutputDevice, qaFormat, this);
 
-	//We need to make sure the buffer is big enough, set to max
-	//If too small, we'll get choppy output as data is thrown away
+	if (outRing != NULL)
+		delete outRing;
+	outRing = new AudioOutputRing(outputSampleRate, framesPerBuffer);
+	if (outputDataSource != NULL)
+		delete outputDataSource;
+	outputDataSource = new AudioQTOutputDevice(outRing, this);
+	outputDataSource->open(QIODevice::ReadOnly);
+
+	//Pull mode, QAudioOutput reads from outputDataSource as it needs data
+	//Ring absorbs timing differences, so device buffer only has to cover event loop latency
 	//This has to be called before start
 	//Default if not set is 8192
-	qaAudioOutput->setBufferSize(outputSampleRate * sizeof(float) * 2); //1 second buffer
+	qaAudioOutput->setBufferSize(framesPerBuffer * sizeof(float) * 2 * 2);
 	qDebug()<<"Qt Audio output buffer size "<<qaAudioOutput->bufferSize();
+	//Gain is applied as samples are queued
+	qaAudioOutput->setVolume(1.0);
 
-    outputDataSource = qaAudioOutput->start();
+    qaAudioOutput->start(outputDataSource);
+	outputDeviceLatencyMs = qaFormat.durationForBytes(qaAudioOutput->bufferSize()) / 1000.0;
 	return 0;
 }
 int AudioQT::Stop()
@@ -166,78 +198,28 @@ int AudioQT::Restart()
 {
 	return 0;
 }
+//Gain, clipping and float conversion happen as samples are queued, see AudioOutputRing
 void AudioQT::SendToOutput(CPX *out, int outSamples, float gain, bool mute)
 {
     if (!qaAudioOutput)
         return;
-
-	//Save CPU and don't output anything if mute
-	//Note some sound systems may require outputting 0's, if so, then remove this check
-	if (mute)
-		return;
-
-	//We may have to skip samples to reduce rate to match audio out, decimate set when we
-	//opened stream
-	qint64 bytesWritten = 0;
-	const float maxOutput = 0.9999;
-    //qint16 left,right;
-
-	//CPX samples range from -1 to +1 and output samples have to be in same range or we clip
-	//So we can't scale samples by gain and must use QTAudio setVolume control
-	//Volume from 0 - 1
-	qaAudioOutput->setVolume(gain / 100.0); //UI gain from 0 to 100
-
-    for (int i=0, j=0;i<outSamples;i++, j+=2)
-	{
-		//Not sure if we need to clip, just in case
-		if (out[i].real() > maxOutput)
-			out[i].real(maxOutput);
-		else if (out[i].real() < -maxOutput)
-			out[i].real(-maxOutput);
-
-		if (out[i].imag() > maxOutput)
-			out[i].imag(maxOutput);
-		else if (out[i].imag() < -maxOutput)
-			out[i].imag(-maxOutput);
-
-        //If we use Int 16
-        //left = Float2Int(out[i].re);
-        //right = Float2Int(out[i].im);
-
-        //No conversion necessary from cpx
-		outStreamBuffer[j] = out[i].real();
-		outStreamBuffer[j+1] = out[i].imag();
-	}
-	quint32 bytesToWrite = outSamples*sizeof(float)*2;
-
-#if 0
-	//Experiment with blocking IO, waits for there to be enough room in buffer to write output
-	//Result, dramatically increases CPU usage
-	//Make sure we have enough buffer space to write
-	//Wait for bytesFree to be >= bytesToWrite
-	hasOutputTimedOut = false;
-
-	quint32 bytesFree = qaAudioOutput->bytesFree();
-	QTimer::singleShot(250, this, SLOT(OutputTimedOut()));
-	while (bytesFree < bytesToWrite) {
-		if (hasOutputTimedOut) {
-			qDebug()<<"QAudioOutput timed out";
-			return;
-		}
-		bytesFree = qaAudioOutput->bytesFree();
-	}
-#endif
-
-	bytesWritten = outputDataSource->write((char*)outStreamBuffer,bytesToWrite);
-	if (bytesWritten != bytesToWrite)  {
-		qDebug()<<"QT Audio Output: bytesWritten less than bytesToWrite"<<bytesWritten<<" "<<bytesToWrite;
-	}
+	QueueOutput(out, outSamples, gain, mute);
 }
 
 void AudioQT::ClearCounts()
 {
-
+	if (outRing != NULL)
+		outRing->clearCounts();
+	outBufferUnderflowCount = 0;
+	outBufferOverflowCount = 0;
 }
+//Pull mode keeps the device buffer close to full, so its size is the latency
+//Cached in StartOutput(), QAudioOutput isn't safe to query from the DSP thread
+double AudioQT::OutputDeviceLatencyMs()
+{
+	return outputDeviceLatencyMs;
+}
+
 QAudioDeviceInfo AudioQT::FindInputDeviceByName(QString name)
 {
     QAudioDeviceInfo device;
@@ -9,6 +9,23 @@
 #include <QAudioFormat>
 #include "producerconsumer.h"
 
+//Pull mode source for QAudioOutput, QAudioOutput reads whenever it has room and we read from outRing
+//Always returns what was asked for, silence if the ring is empty
+class AudioQTOutputDevice : public QIODevice
+{
+	Q_OBJECT
+public:
+	AudioQTOutputDevice(AudioOutputRing *_ring, QObject *parent = 0);
+	bool isSequential() const {return true;}
+
+protected:
+	qint64 readData(char *data, qint64 maxlen);
+	qint64 writeData(const char *data, qint64 len);
+
+private:
+	AudioOutputRing *ring;
+};
+
 class AudioQT : public Audio
 {
 	Q_OBJECT
@@ -26,6 +43,7 @@ public:
 	int Restart();
     void SendToOutput(CPX *, int outSamples, float gain = 1.0, bool mute = false);
 	void ClearCounts();
+	double OutputDeviceLatencyMs();
     QAudioDeviceInfo FindInputDeviceByName(QString name);
     QAudioDeviceInfo FindOutputDeviceByName(QString name);
 
@@ -42,7 +60,8 @@ private:
     QAudioOutput *qaAudioOutput;
 	//QIODevice*       qaOutput; // not owned
 	QAudioFormat     qaFormat;
-    QIODevice *outputDataSource;
+    AudioQTOutputDevice *outputDataSource;
+	double outputDeviceLatencyMs;
     QIODevice *inputDataSource;
 
     float *inStreamBuffer;
@@ -0,0 +1,187 @@
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "cicdecimator.h"
+#include <QDebug>
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#define CIC_SSE2
+#include <emmintrin.h>
+#endif
+
+CicDecimator::CicDecimator()
+{
+	m_decimateFactor = 1;
+	m_log2Factor = 0;
+	reset();
+}
+
+void CicDecimator::setDecimateFactor(quint32 _decimateFactor)
+{
+	quint32 factor = 1;
+	quint32 log2Factor = 0;
+	while (factor * 2 <= _decimateFactor && factor * 2 <= c_maxDecimateFactor) {
+		factor *= 2;
+		log2Factor++;
+	}
+	if (factor != _decimateFactor)
+		qDebug()<<"CicDecimator: decimate factor "<<_decimateFactor<<" not supported, using "<<factor;
+	if (factor != m_decimateFactor) {
+		m_decimateFactor = factor;
+		m_log2Factor = log2Factor;
+		reset();
+	}
+}
+
+void CicDecimator::reset()
+{
+	m_phase = 0;
+	for (quint32 s = 0; s < c_numStages; s++) {
+		m_integrator[s][0] = m_integrator[s][1] = 0;
+		m_comb[s][0] = m_comb[s][1] = 0;
+	}
+	m_fir[0][0] = m_fir[0][1] = 0;
+	m_fir[1][0] = m_fir[1][1] = 0;
+}
+
+//CPX8 is 2's complement -128 to +127, HackRF
+quint32 CicDecimator::process(const CPX8 *_in, quint32 _numSamples, CPX *_out)
+{
+	const qint8 *in = (const qint8 *)_in;
+	return processSamples(in, in + 1, 2, _numSamples, _out, 0, 128.0);
+}
+
+//CPXU8 is offset binary 0 to 255, RTL2832
+quint32 CicDecimator::process(const CPXU8 *_in, quint32 _numSamples, CPX *_out)
+{
+	const quint8 *in = (const quint8 *)_in;
+	return processSamples(in, in + 1, 2, _numSamples, _out, -128, 128.0);
+}
+
+//CPX16 is -32768 to +32767
+quint32 CicDecimator::process(const CPX16 *_in, quint32 _numSamples, CPX *_out)
+{
+	const qint16 *in = (const qint16 *)_in;
+	return processSamples(in, in + 1, 2, _numSamples, _out, 0, 32768.0);
+}
+
+quint32 CicDecimator::process(const qint16 *_inI, const qint16 *_inQ, quint32 _numSamples, CPX *_out)
+{
+	return processSamples(_inI, _inQ, 1, _numSamples, _out, 0, 32768.0);
+}
+
+//_stride is 2 for interleaved I,Q and 1 for separate arrays.  _offset is added to each sample to get to 2's complement
+template <typename T>
+quint32 CicDecimator::processSamples(const T *_inI, const T *_inQ, quint32 _stride, quint32 _numSamples, CPX *_out,
+	qint32 _offset, double _fullScale)
+{
+	//CIC gain is R^N, FIR taps sum to 6
+	const double scale = 1.0 / (_fullScale * (double)((quint64)1 << (m_log2Factor * c_numStages)) * 6.0);
+	double *out = reinterpret_cast<double *>(_out);
+	quint32 numOut = 0;
+	quint32 i = 0;
+	quint32 run;
+
+#ifdef CIC_SSE2
+	//Lane 0 = I, lane 1 = Q.  Integrators wrap mod 2^64 in _mm_add_epi64 same as scalar
+	//m_integrator[s], m_comb[s] and m_fir[n] are each an I,Q pair of 64bit ints, loaded as one register
+	__m128i x;
+	__m128i s0 = _mm_loadu_si128((const __m128i *)m_integrator[0]);
+	__m128i s1 = _mm_loadu_si128((const __m128i *)m_integrator[1]);
+	__m128i s2 = _mm_loadu_si128((const __m128i *)m_integrator[2]);
+	__m128i s3 = _mm_loadu_si128((const __m128i *)m_integrator[3]);
+	__m128i c, prev;
+	qint64 y[2];
+
+	while (i < _numSamples) {
+		run = qMin(m_decimateFactor - m_phase, _numSamples - i);
+		for (quint32 j = 0; j < run; j++) {
+			x = _mm_set_epi64x((qint64)(*_inQ + _offset), (qint64)(*_inI + _offset));
+			s0 = _mm_add_epi64(s0, x);
+			s1 = _mm_add_epi64(s1, s0);
+			s2 = _mm_add_epi64(s2, s1);
+			s3 = _mm_add_epi64(s3, s2);
+			_inI += _stride;
+			_inQ += _stride;
+		}
+		i += run;
+		m_phase += run;
+		if (m_phase < m_decimateFactor)
+			break;
+
+		m_phase = 0;
+		c = s3;
+		for (quint32 s = 0; s < c_numStages; s++) {
+			prev = _mm_loadu_si128((const __m128i *)m_comb[s]);
+			_mm_storeu_si128((__m128i *)m_comb[s], c);
+			c = _mm_sub_epi64(c, prev);
+		}
+		//No SSE2 int64 to double, FIR and scale are scalar at output rate
+		_mm_storeu_si128((__m128i *)y, c);
+		out[0] = (-y[0] + 8 * m_fir[0][0] - m_fir[1][0]) * scale;
+		out[1] = (-y[1] + 8 * m_fir[0][1] - m_fir[1][1]) * scale;
+		m_fir[1][0] = m_fir[0][0]; m_fir[0][0] = y[0];
+		m_fir[1][1] = m_fir[0][1]; m_fir[0][1] = y[1];
+		out += 2;
+		numOut++;
+	}
+
+	_mm_storeu_si128((__m128i *)m_integrator[0], s0);
+	_mm_storeu_si128((__m128i *)m_integrator[1], s1);
+	_mm_storeu_si128((__m128i *)m_integrator[2], s2);
+	_mm_storeu_si128((__m128i *)m_integrator[3], s3);
+	return numOut;
+#else
+	quint64 x0, x1;
+	quint64 c0, c1;
+	quint64 tmp;
+	qint64 y0, y1;
+
+	//Local copies so compiler can keep integrators in registers
+	quint64 i00 = m_integrator[0][0], i01 = m_integrator[0][1];
+	quint64 i10 = m_integrator[1][0], i11 = m_integrator[1][1];
+	quint64 i20 = m_integrator[2][0], i21 = m_integrator[2][1];
+	quint64 i30 = m_integrator[3][0], i31 = m_integrator[3][1];
+
+	while (i < _numSamples) {
+		//Integrators, as many input samples as we need to get to next output
+		run = qMin(m_decimateFactor - m_phase, _numSamples - i);
+		for (quint32 j = 0; j < run; j++) {
+			x0 = (quint64)(qint64)(*_inI + _offset);
+			x1 = (quint64)(qint64)(*_inQ + _offset);
+			i00 += x0; i01 += x1;
+			i10 += i00; i11 += i01;
+			i20 += i10; i21 += i11;
+			i30 += i20; i31 += i21;
+			_inI += _stride;
+			_inQ += _stride;
+		}
+		i += run;
+		m_phase += run;
+		if (m_phase < m_decimateFactor)
+			break; //Partial block, wait for more input
+
+		m_phase = 0;
+		//Combs at output rate
+		c0 = i30; c1 = i31;
+		for (quint32 s = 0; s < c_numStages; s++) {
+			tmp = c0; c0 -= m_comb[s][0]; m_comb[s][0] = tmp;
+			tmp = c1; c1 -= m_comb[s][1]; m_comb[s][1] = tmp;
+		}
+		//Compensating FIR [-1, 8, -1], output is delayed 1 sample
+		y0 = (qint64)c0;
+		y1 = (qint64)c1;
+		out[0] = (-y0 + 8 * m_fir[0][0] - m_fir[1][0]) * scale;
+		out[1] = (-y1 + 8 * m_fir[0][1] - m_fir[1][1]) * scale;
+		m_fir[1][0] = m_fir[0][0]; m_fir[0][0] = y0;
+		m_fir[1][1] = m_fir[0][1]; m_fir[0][1] = y1;
+		out += 2;
+		numOut++;
+	}
+
+	m_integrator[0][0] = i00; m_integrator[0][1] = i01;
+	m_integrator[1][0] = i10; m_integrator[1][1] = i11;
+	m_integrator[2][0] = i20; m_integrator[2][1] = i21;
+	m_integrator[3][0] = i30; m_integrator[3][1] = i31;
+	return numOut;
+#endif
+}
@@ -0,0 +1,72 @@
+#ifndef CICDECIMATOR_H
+#define CICDECIMATOR_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "cpx.h"
+
+/*
+	Integer front end decimator for very high sample rate devices (HackRF 10-20msps CPX8, int16 devices)
+
+	Decimator (decimator.h) works on CPX, so every device sample has to be widened to complex<double> before
+	the first halfband stage.  At 20msps that conversion alone is more than most machines can sustain.
+	This runs on the raw device samples, decimates by a power of 2 in integer arithmetic, and only converts
+	the (much smaller) output to CPX.
+
+	Structure
+		CIC, order 4 (c_numStages), differential delay 1, decimate by R = 2, 4, ... c_maxDecimateFactor
+		Integrators run at input rate, combs at output rate (Hogenauer)
+		3 tap compensating FIR at output rate to flatten CIC passband droop
+
+	Bit growth is N * log2(R), 24 bits at R=64.  16bit samples need 40 bits so we use 64bit registers.
+	Integrators are allowed to wrap, two's complement math guarantees the comb output is still correct.
+	Registers are unsigned to keep wrap-around well defined in C++.
+
+	CIC droop near DC for large R is approx 1 - N * w^2 / 24 (w in radians at output rate)
+	FIR [-a, 1+2a, -a] has response 1 + a * w^2 near DC, so a = N / 24 = 1/6 for N = 4 flattens the passband.
+	Scaled to integer taps this is [-1, 8, -1] / 6
+
+	Alias protection is the CIC's, which is good close to DC and poor at the edges of the output band.
+	Use this to get down to a rate the Decimator chain and spectrum can handle, not as the final filter.
+
+	I and Q are independent lanes.  With SSE2 each integrator and comb is one 128bit register holding both 64bit
+	lanes (same guard as fastmath.cpp), otherwise the scalar loops have no branches or calls so the compiler can try.
+*/
+
+class CicDecimator
+{
+public:
+	static const quint32 c_numStages = 4;
+	static const quint32 c_maxDecimateFactor = 64;
+
+	CicDecimator();
+
+	//Rounds down to a power of 2 between 1 and c_maxDecimateFactor, 1 is bypass
+	void setDecimateFactor(quint32 _decimateFactor);
+	quint32 decimateFactor() {return m_decimateFactor;}
+	//Clears filter state, call when stream restarts
+	void reset();
+
+	//Returns number of samples written to _out, normalized to +/- 1.0.  _out must hold _numSamples / R + 1
+	//Partial blocks are carried over to next call
+	quint32 process(const CPX8 *_in, quint32 _numSamples, CPX *_out);
+	quint32 process(const CPXU8 *_in, quint32 _numSamples, CPX *_out);
+	quint32 process(const CPX16 *_in, quint32 _numSamples, CPX *_out);
+	//Separate I and Q arrays, like SDRPlay
+	quint32 process(const qint16 *_inI, const qint16 *_inQ, quint32 _numSamples, CPX *_out);
+
+private:
+	quint32 m_decimateFactor;
+	quint32 m_log2Factor;
+	quint32 m_phase; //Input samples accumulated towards next output
+
+	//[0] = I, [1] = Q
+	quint64 m_integrator[c_numStages][2];
+	quint64 m_comb[c_numStages][2];
+	qint64 m_fir[2][2]; //Last 2 CIC outputs for compensating FIR
+
+	template <typename T>
+	quint32 processSamples(const T *_inI, const T *_inQ, quint32 _stride, quint32 _numSamples, CPX *_out,
+		qint32 _offset, double _fullScale);
+};
+
+#endif // CICDECIMATOR_H
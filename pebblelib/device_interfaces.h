@@ -75,7 +75,7 @@ public:
 		Key_ConverterMode,			//RW returns whether device is using an up/down converter
 		Key_ConverterOffset,		//RW Offset to device frequency to use if converter is active
 		Key_Setting,				//RW Direct access to device settings file. Settings name in _option
-		Key_DecimateFactor,			//RW If device plugin or device supports decimation
+		Key_DecimateFactor,			//RW If device plugin or device supports decimation, set only while device is off
 		Key_RemoveDC,				//RW Filter to remove dc component in device or plugin
 
 		//Hardware options
@@ -96,6 +96,8 @@ public:
 		Key_DeviceNB,				//RW quint16
 		Key_DeviceSlave,			//RO bool true if device is controled by somthing other than Pebble
 		Key_DeviceFreqCorrectionPpm,	//RW If device supports frequency correction in ppm
+		Key_RecordingOverview,		//RO QString Overview file for the recording being played, see iqoverview.h.  Empty if none (yet)
+		Key_PlaybackPosition,		//RW quint64 Sample offset in the recording being played
 
 		//Expansion room if needed
 		Key_CustomKey1 = 200,		//Devices can implement custom keys, as long as they start with this
@@ -179,5 +181,62 @@ public:
 //Creates cast macro for interface ie qobject_cast<DigitalModemInterface *>(plugin);
 Q_DECLARE_INTERFACE(DeviceInterface, DeviceInterface_iid)
 
+//Sample formats an IQBlock can carry.  Can only be extended
+enum IQSampleFormat {
+	IQF_CPX,		//CPX, already normalized to +/-1 with gain and IQ order applied
+	IQF_CPXFLOAT,	//CPXFLOAT
+	IQF_CPX16,		//CPX16, -32767 to +32767
+	IQF_CPX8,		//CPX8, -127 to +127
+	IQF_CPXU8		//CPXU8, 0 to 255 with 128 as zero like rtl2832
+};
+
+//IQBlock flags
+enum IQBlockFlags {
+	IQB_DROPPED = 0x01,			//Device lost droppedSamples before this block, sampleCounter includes them
+	IQB_DISCONTINUITY = 0x02,	//Stream restarted, retune or rate change.  Don't count the jump as a loss
+	IQB_SWAP_IQ = 0x04			//Native samples are Q,I.  Never set for IQF_CPX
+};
+
+//Hands a block back to the device, see IQBlock::release
+typedef void (*IQBlockRelease)(void *_owner, quint32 _handle);
+
+//One callback's worth of samples from a V2 device
+struct IQBlock
+{
+	void *samples;			//numSamples of format, interleaved I/Q.  Host may process IQF_CPX samples in place
+	quint32 numSamples;		//No quint16 limit
+	IQSampleFormat format;
+	double scale;			//(Native value - zero) * scale = normalized CPX, includes device and user gain.  1.0 for IQF_CPX
+	quint32 sampleRate;		//Rate of these samples, after any device decimation
+	quint64 sampleCounter;	//Device sample number of samples[0] since Cmd_Start, counts dropped samples
+	quint32 flags;			//IQBlockFlags
+	quint64 droppedSamples;	//With IQB_DROPPED, samples lost just before this block
+	//If release is NULL samples are only valid until the callback returns and the receiver copies what it needs
+	//Otherwise the receiver owns the buffer until it calls release(owner, handle), from any thread, exactly once
+	IQBlockRelease release;
+	void *owner;
+	quint32 handle;
+};
+
+//ProcessIQBlock callback: Call with a block descriptor, see IQBlock
+typedef std::function<void(const IQBlock &)> CB_ProcessIQBlock;
+
+//V2 adds IQBlock: 32 bit lengths, native formats, sample counter time stamps, drop accounting and zero copy hand off
+//DeviceInterfaceBase implements it for every plugin, old style devices get their CPX buffers wrapped in an IQBlock
+//List both in Q_INTERFACES(DeviceInterface DeviceInterface2) so Plugins still finds the device
+class DeviceInterface2 : public DeviceInterface
+{
+public:
+	//Used instead of initialize(), never both
+	virtual bool initialize2(CB_ProcessIQBlock _callback,
+							 CB_ProcessBandscopeData _callbackBandscope,
+							 CB_ProcessAudioData _callbackAudio,
+							 quint32 _framesPerBuffer) = 0;
+};
+
+#define DeviceInterface2_iid "N1DDY.Pebble.DeviceInterface.V2"
+
+Q_DECLARE_INTERFACE(DeviceInterface2, DeviceInterface2_iid)
+
 
 #endif // DEVICE_INTERFACES_H
@@ -2,6 +2,12 @@
 #include <QWidget>
 #include "pebblelib_global.h"
 #include "db.h"
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#define DEVICEINTERFACEBASE_SSE2
+#include <emmintrin.h>
+#endif
+
 PebbleLibGlobal *pebbleLibGlobal;
 
 DeviceInterfaceBase::DeviceInterfaceBase()
@@ -35,6 +41,13 @@ DeviceInterfaceBase::DeviceInterfaceBase()
 	processIQData = NULL;
 	processBandscopeData = NULL;
 	processAudioData = NULL;
+	processIQBlock = NULL;
+	m_adaptSampleCounter = 0;
+	m_adaptSampleRate = 0;
+	m_adaptRestart.store(1);
+	m_hostIQBlock = NULL;
+	m_hostIQData = NULL;
+	m_publishSampleCounter = 0;
 	m_audioOutputSampleRate = 11025;
 	m_audioInputBuffer = NULL;
 	//Set normalizeIQ gain by injecting known signal db into device and matching spectrum display
@@ -42,6 +55,8 @@ DeviceInterfaceBase::DeviceInterfaceBase()
 	m_converterMode = false;
 	m_converterOffset = 0;
 	m_decimateFactor = 1;
+	m_cicBuffer = NULL;
+	m_cicBufferSize = 0;
 }
 
 //Implement pure virtual destructor from interface, otherwise we don't link
@@ -56,6 +71,8 @@ DeviceInterfaceBase::~DeviceInterfaceBase()
 		delete m_audioInputBuffer;
 		m_audioInputBuffer = NULL;
 	}
+	if (m_cicBuffer != NULL)
+		free(m_cicBuffer);
 }
 
 bool DeviceInterfaceBase::initialize(CB_ProcessIQData _callback,
@@ -76,9 +93,210 @@ bool DeviceInterfaceBase::initialize(CB_ProcessIQData _callback,
 
 	m_audioInputBuffer = memalign(m_framesPerBuffer);
 
+	//Devices set m_decimateFactor in readSettings() or their options UI before initialize()
+	m_cicDecimator.setDecimateFactor(m_decimateFactor);
+	m_decimateFactor = m_cicDecimator.decimateFactor();
+	m_cicDecimator.reset();
+
+	//Publish whatever the host gets.  V2 hosts see IQBlocks from the adapter or the device, V1 hosts CPX
+	m_shmPublisher.close();
+	if (!m_shmIqBus.isEmpty() && m_shmPublisher.open(m_shmIqBus)) {
+		if (processIQBlock != NULL) {
+			m_hostIQBlock = processIQBlock;
+			processIQBlock = std::bind(&DeviceInterfaceBase::publishIQBlock, this, _1);
+		} else if (processIQData != NULL) {
+			m_hostIQData = processIQData;
+			m_publishSampleCounter = 0;
+			processIQData = std::bind(&DeviceInterfaceBase::publishIQData, this, _1, _2);
+		}
+	}
+
 	return true;
 }
 
+bool DeviceInterfaceBase::initialize2(CB_ProcessIQBlock _callback,
+									  CB_ProcessBandscopeData _callbackBandscope,
+									  CB_ProcessAudioData _callbackAudio,
+									  quint32 _framesPerBuffer)
+{
+	processIQBlock = _callback;
+	m_adaptSampleRate = 0;
+	m_adaptRestart.storeRelease(1);
+	//Device still sees a V1 host, so it keeps its quint16 buffers and we wrap them
+	using namespace std::placeholders;
+	return this->initialize(std::bind(&DeviceInterfaceBase::adaptIQData, this, _1, _2),
+							_callbackBandscope, _callbackAudio, qMin(_framesPerBuffer, (quint32)65535));
+}
+
+//Device thread, every block
+void DeviceInterfaceBase::adaptIQData(CPX *_in, quint16 _numSamples)
+{
+	//Key_SampleRate may be overridden and take a lock, look it up once per power on
+	if (m_adaptSampleRate == 0)
+		m_adaptSampleRate = get(Key_SampleRate).toUInt();
+
+	IQBlock block;
+	block.flags = 0;
+	if (m_adaptRestart.fetchAndStoreAcquire(0) != 0) {
+		//First block since power on or start, nothing before it is contiguous with it
+		m_adaptSampleCounter = 0;
+		block.flags = IQB_DISCONTINUITY;
+	}
+	block.samples = _in;
+	block.numSamples = _numSamples;
+	block.format = IQF_CPX;
+	block.scale = 1.0;
+	block.sampleRate = m_adaptSampleRate;
+	block.sampleCounter = m_adaptSampleCounter;
+	block.droppedSamples = 0;
+	//V1 devices reuse their buffer as soon as we return
+	block.release = NULL;
+	block.owner = NULL;
+	block.handle = 0;
+	m_adaptSampleCounter += _numSamples;
+	processIQBlock(block);
+}
+
+//Device thread, every block.  Host gets it first, it may process IQF_CPX in place
+void DeviceInterfaceBase::publishIQBlock(const IQBlock &_block)
+{
+	if (_block.format == IQF_CPX) {
+		//Receiver changes IQF_CPX samples in place, readers want them as the device delivered them
+		m_shmPublisher.publish(_block, m_deviceFrequency);
+		m_hostIQBlock(_block);
+	} else {
+		m_hostIQBlock(_block);
+		m_shmPublisher.publish(_block, m_deviceFrequency);
+	}
+}
+
+void DeviceInterfaceBase::publishIQData(CPX *_in, quint16 _numSamples)
+{
+	IQBlock block;
+	block.samples = _in;
+	block.numSamples = _numSamples;
+	block.format = IQF_CPX;
+	block.scale = 1.0;
+	block.sampleRate = m_sampleRate;
+	block.sampleCounter = m_publishSampleCounter;
+	block.flags = 0;
+	block.droppedSamples = 0;
+	block.release = NULL;
+	block.owner = NULL;
+	block.handle = 0;
+	m_publishSampleCounter += _numSamples;
+	m_shmPublisher.publish(block, m_deviceFrequency);
+	m_hostIQData(_in, _numSamples);
+}
+
+//CPX16 to CPX, SDR-IP, SDR-IQ and CPX16 IQBlocks run every sample through here
+//SSE2 does 4 samples per loop (same guard as fastmath.cpp), std::complex<double> is layout compatible with double[2]
+static void cpx16ToCPX(const CPX16 *_in, double _scale, bool _swap, quint32 _numSamples, CPX *_out)
+{
+	const qint16 *in = reinterpret_cast<const qint16 *>(_in);
+	double *out = reinterpret_cast<double *>(_out);
+	quint32 i = 0;
+
+#ifdef DEVICEINTERFACEBASE_SSE2
+	const __m128d scale = _mm_set1_pd(_scale);
+	__m128i x, lo, hi;
+	__m128d d0, d1, d2, d3;
+	for (; i + 4 <= _numSamples; i += 4) {
+		x = _mm_loadu_si128((const __m128i *)in);
+		//Unpacking with itself puts each int16 in the top half of a 32bit lane, arithmetic shift sign extends
+		lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+		hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+		d0 = _mm_mul_pd(_mm_cvtepi32_pd(lo), scale);
+		d1 = _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(lo, 8)), scale);
+		d2 = _mm_mul_pd(_mm_cvtepi32_pd(hi), scale);
+		d3 = _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(hi, 8)), scale);
+		if (_swap) {
+			d0 = _mm_shuffle_pd(d0, d0, 1);
+			d1 = _mm_shuffle_pd(d1, d1, 1);
+			d2 = _mm_shuffle_pd(d2, d2, 1);
+			d3 = _mm_shuffle_pd(d3, d3, 1);
+		}
+		_mm_storeu_pd(out, d0);
+		_mm_storeu_pd(out + 2, d1);
+		_mm_storeu_pd(out + 4, d2);
+		_mm_storeu_pd(out + 6, d3);
+		in += 8;
+		out += 8;
+	}
+#endif
+
+	if (_swap) {
+		for (; i < _numSamples; i++) {
+			out[0] = in[1] * _scale;
+			out[1] = in[0] * _scale;
+			in += 2;
+			out += 2;
+		}
+	} else {
+		for (; i < _numSamples; i++) {
+			out[0] = in[0] * _scale;
+			out[1] = in[1] * _scale;
+			in += 2;
+			out += 2;
+		}
+	}
+}
+
+template<typename T>
+static void blockToCPX(const T *_in, double _scale, double _zero, bool _swap, quint32 _numSamples, CPX *_out)
+{
+	//Swap check outside the loop, runs at full device rate.  CPX8 etc accessors aren't const, so copy each sample
+	T s;
+	if (_swap) {
+		for (quint32 i = 0; i < _numSamples; i++) {
+			s = _in[i];
+			_out[i].real((s.imag() - _zero) * _scale);
+			_out[i].imag((s.real() - _zero) * _scale);
+		}
+	} else {
+		for (quint32 i = 0; i < _numSamples; i++) {
+			s = _in[i];
+			_out[i].real((s.real() - _zero) * _scale);
+			_out[i].imag((s.imag() - _zero) * _scale);
+		}
+	}
+}
+
+void DeviceInterfaceBase::iqBlockToCPX(const IQBlock &_block, quint32 _offset, quint32 _numSamples, CPX *_out)
+{
+	bool swap = (_block.flags & IQB_SWAP_IQ) != 0;
+	switch (_block.format) {
+		case IQF_CPX:
+			//Already normalized
+			memcpy(_out, (const CPX *)_block.samples + _offset, _numSamples * sizeof(CPX));
+			break;
+		case IQF_CPXFLOAT:
+			blockToCPX((const CPXFLOAT *)_block.samples + _offset, _block.scale, 0, swap, _numSamples, _out);
+			break;
+		case IQF_CPX16:
+			cpx16ToCPX((const CPX16 *)_block.samples + _offset, _block.scale, swap, _numSamples, _out);
+			break;
+		case IQF_CPX8:
+			blockToCPX((const CPX8 *)_block.samples + _offset, _block.scale, 0, swap, _numSamples, _out);
+			break;
+		case IQF_CPXU8:
+			blockToCPX((const CPXU8 *)_block.samples + _offset, _block.scale, 128.0, swap, _numSamples, _out);
+			break;
+	}
+}
+
+quint32 DeviceInterfaceBase::bytesPerSample(IQSampleFormat _format)
+{
+	switch (_format) {
+		case IQF_CPX: return sizeof(CPX);
+		case IQF_CPXFLOAT: return sizeof(CPXFLOAT);
+		case IQF_CPX16: return sizeof(CPX16);
+		case IQF_CPX8: return sizeof(CPX8);
+		case IQF_CPXU8: return sizeof(CPXU8);
+	}
+	return 0;
+}
+
 bool DeviceInterfaceBase::connectDevice()
 {
 	return true;
@@ -86,11 +304,15 @@ bool DeviceInterfaceBase::connectDevice()
 
 bool DeviceInterfaceBase::disconnectDevice()
 {
+	//Tells readers we're gone, devices that don't call us close it in the next initialize() or when unloaded
+	m_shmPublisher.close();
 	return true;
 }
 
 void DeviceInterfaceBase::startDevice()
 {
+	//Stream starts over, adaptIQData() resets the sample counter and flags the first block
+	m_adaptRestart.storeRelease(1);
 	if (get(DeviceInterface::Key_DeviceType).toInt() == DT_AUDIO_IQ_DEVICE) {
 		//We handle audio
 		m_audioInput->StartInput(m_inputDeviceName, m_sampleRate);
@@ -423,8 +645,12 @@ bool DeviceInterfaceBase::set(StandardKeys _key, QVariant _value, QVariant _opti
 			m_settings->setValue(_value.toString(), _option);
 			break;
 		case Key_DecimateFactor:
-			m_decimateFactor = _value.toUInt();
-			break;
+			//Devices size their read buffers for the factor in initialize(), power cycle to change it
+			if (m_connected || m_running)
+				return false;
+			m_cicDecimator.setDecimateFactor(_value.toUInt());
+			m_decimateFactor = m_cicDecimator.decimateFactor();
+			return true;
 		case Key_RemoveDC:
 			m_removeDC = _value.toBool();
 			break;
@@ -485,6 +711,7 @@ void DeviceInterfaceBase::readSettings()
 	m_converterOffset = m_settings->value("ConverterOffset", 0).toDouble();
 	m_decimateFactor = m_settings->value("DecimateFactor",m_decimateFactor).toUInt();
 	m_removeDC = m_settings->value("RemoveDC",false).toBool();
+	m_shmIqBus = m_settings->value("ShmIqBus", QString()).toString();
 }
 
 void DeviceInterfaceBase::writeSettings()
@@ -513,6 +740,7 @@ void DeviceInterfaceBase::writeSettings()
 	m_settings->setValue("ConverterOffset",m_converterOffset);
 	m_settings->setValue("DecimateFactor",m_decimateFactor);
 	m_settings->setValue("RemoveDC",m_removeDC);
+	m_settings->setValue("ShmIqBus", m_shmIqBus);
 }
 
 
@@ -523,7 +751,10 @@ void DeviceInterfaceBase::initSettings(QString fname)
 	//Scope::UserScope puts file C:\Users\...\AppData\Roaming\N1DDY
 	//Scope::SystemScope puts file c:\ProgramData\n1ddy
 
-	m_settings = new QSettings(pebbleLibGlobal->appDirPath + "/PebbleData/" + fname +".ini",QSettings::IniFormat);
+	QString settingsPath = QString::fromLocal8Bit(qgetenv(c_settingsPathEnv));
+	if (settingsPath.isEmpty())
+		settingsPath = pebbleLibGlobal->appDirPath + "/PebbleData";
+	m_settings = new QSettings(settingsPath + "/" + fname +".ini",QSettings::IniFormat);
 
 }
 
@@ -735,16 +966,10 @@ void DeviceInterfaceBase::normalizeIQ(CPX *_out, CPX16 *_in, quint32 _numSamples
 		tmpOrder = IQO_IQ;
 	switch(tmpOrder) {
 		case DeviceInterface::IQO_IQ:
-			for (quint32 i=0; i < _numSamples; i++) {
-				_out[i].real(_in[i].real() * scale);
-				_out[i].imag(_in[i].imag() * scale);
-			}
+			cpx16ToCPX(_in, scale, false, _numSamples, _out);
 			break;
 		case DeviceInterface::IQO_QI:
-			for (quint32 i=0; i < _numSamples; i++) {
-				_out[i].real(_in[i].imag() * scale);
-				_out[i].imag(_in[i].real() * scale);
-			}
+			cpx16ToCPX(_in, scale, true, _numSamples, _out);
 			break;
 		case DeviceInterface::IQO_IONLY:
 			for (quint32 i=0; i < _numSamples; i++) {
@@ -926,3 +1151,63 @@ void DeviceInterfaceBase::audioProducer(float *samples, quint16 numSamples)
 	}
 	processIQData(m_audioInputBuffer, m_framesPerBuffer);
 }
+
+CPX *DeviceInterfaceBase::cicBuffer(quint32 _numSamples)
+{
+	if (_numSamples > m_cicBufferSize) {
+		if (m_cicBuffer != NULL)
+			free(m_cicBuffer);
+		m_cicBuffer = memalign(_numSamples);
+		m_cicBufferSize = _numSamples;
+	}
+	return m_cicBuffer;
+}
+
+//Decimated output goes through normalizeIQ(CPX) so gain and IQ order are handled in one place, at the lower rate
+quint32 DeviceInterfaceBase::normalizeIQDecimated(CPX *_out, CPX8 *_in, quint32 _numSamples, bool _reverse)
+{
+	if (m_cicDecimator.decimateFactor() == 1) {
+		normalizeIQ(_out, _in, _numSamples, _reverse);
+		return _numSamples;
+	}
+	CPX *buf = cicBuffer(_numSamples / m_cicDecimator.decimateFactor() + 1);
+	quint32 numOut = m_cicDecimator.process(_in, _numSamples, buf);
+	normalizeIQ(_out, buf, numOut, _reverse);
+	return numOut;
+}
+
+quint32 DeviceInterfaceBase::normalizeIQDecimated(CPX *_out, CPXU8 *_in, quint32 _numSamples, bool _reverse)
+{
+	if (m_cicDecimator.decimateFactor() == 1) {
+		normalizeIQ(_out, _in, _numSamples, _reverse);
+		return _numSamples;
+	}
+	CPX *buf = cicBuffer(_numSamples / m_cicDecimator.decimateFactor() + 1);
+	quint32 numOut = m_cicDecimator.process(_in, _numSamples, buf);
+	normalizeIQ(_out, buf, numOut, _reverse);
+	return numOut;
+}
+
+quint32 DeviceInterfaceBase::normalizeIQDecimated(CPX *_out, CPX16 *_in, quint32 _numSamples, bool _reverse)
+{
+	if (m_cicDecimator.decimateFactor() == 1) {
+		normalizeIQ(_out, _in, _numSamples, _reverse);
+		return _numSamples;
+	}
+	CPX *buf = cicBuffer(_numSamples / m_cicDecimator.decimateFactor() + 1);
+	quint32 numOut = m_cicDecimator.process(_in, _numSamples, buf);
+	normalizeIQ(_out, buf, numOut, _reverse);
+	return numOut;
+}
+
+quint32 DeviceInterfaceBase::normalizeIQDecimated(CPX *_out, short *_inI, short *_inQ, quint32 _numSamples, bool _reverse)
+{
+	if (m_cicDecimator.decimateFactor() == 1) {
+		normalizeIQ(_out, _inI, _inQ, _numSamples, _reverse);
+		return _numSamples;
+	}
+	CPX *buf = cicBuffer(_numSamples / m_cicDecimator.decimateFactor() + 1);
+	quint32 numOut = m_cicDecimator.process(_inI, _inQ, _numSamples, buf);
+	normalizeIQ(_out, buf, numOut, _reverse);
+	return numOut;
+}
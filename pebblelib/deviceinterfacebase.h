@@ -4,6 +4,8 @@
 #include "perform.h"
 #include "audio.h"
 #include "producerconsumer.h"
+#include "cicdecimator.h"
+#include "shmiqbus.h"
 
 //Cross platform structure packing
 #ifdef _WIN32
@@ -19,15 +21,28 @@
 	#define packStruct __attribute__((packed))
 #endif
 
-class PEBBLELIBSHARED_EXPORT DeviceInterfaceBase : public DeviceInterface
+class PEBBLELIBSHARED_EXPORT DeviceInterfaceBase : public DeviceInterface2
 {
 public:
+	//Directory for device .ini files instead of PebbleData, so tools can run plugins without touching user settings
+	static constexpr const char *c_settingsPathEnv = "PEBBLE_SETTINGS_PATH";
+
 	DeviceInterfaceBase();
 	virtual ~DeviceInterfaceBase();
 	virtual bool initialize(CB_ProcessIQData _callback,
 							CB_ProcessBandscopeData _callbackBandscope,
 							CB_ProcessAudioData _callbackAudio,
 							quint16 _framesPerBuffer);
+	//Adapter for devices that only know initialize(), their CPX buffers are passed on as IQF_CPX blocks
+	virtual bool initialize2(CB_ProcessIQBlock _callback,
+							 CB_ProcessBandscopeData _callbackBandscope,
+							 CB_ProcessAudioData _callbackAudio,
+							 quint32 _framesPerBuffer);
+
+	//For hosts, converts _numSamples of any IQBlock format starting at _offset to normalized CPX
+	static void iqBlockToCPX(const IQBlock &_block, quint32 _offset, quint32 _numSamples, CPX *_out);
+	//Size of one I/Q pair in _format, 0 if it isn't an IQSampleFormat (ie read from shared memory or a file)
+	static quint32 bytesPerSample(IQSampleFormat _format);
 
 	virtual bool command(StandardCommands _cmd, QVariant _arg);
 
@@ -53,6 +68,8 @@ protected:
 	CB_ProcessIQData processIQData;
 	CB_ProcessBandscopeData processBandscopeData;
 	CB_ProcessAudioData processAudioData;
+	//Set if host used initialize2(), devices with native IQBlock support can call it directly instead of processIQData
+	CB_ProcessIQBlock processIQBlock;
 
 
 	//Todo: Flag which of these is just a convenience for Pebble, vs required for the interface
@@ -116,12 +133,42 @@ protected:
 	//SDRPlay uses separate arrays of I and Q, like splitComplex in vDSP
 	void normalizeIQ(CPX *_out, short *_inI, short *_inQ, quint32 _numSamples, bool _reverse = false);
 
+	//Integer CIC pre-decimation by m_decimateFactor (power of 2) before conversion to CPX, see cicdecimator.h
+	//Returns number of samples written to _out, _numSamples / m_decimateFactor for whole buffers
+	quint32 normalizeIQDecimated(CPX *_out, CPX8 *_in, quint32 _numSamples, bool _reverse = false);
+	quint32 normalizeIQDecimated(CPX *_out, CPXU8 *_in, quint32 _numSamples, bool _reverse = false);
+	quint32 normalizeIQDecimated(CPX *_out, CPX16 *_in, quint32 _numSamples, bool _reverse = false);
+	quint32 normalizeIQDecimated(CPX *_out, short *_inI, short *_inQ, quint32 _numSamples, bool _reverse = false);
+
 	//Used for up or down converters
 	bool m_converterMode;
 	double m_converterOffset;
 
 	quint32 m_decimateFactor;
 	bool m_removeDC;
+
+	//Shared memory segment name every block is also published to, see shmiqbus.h.  Empty for none
+	QString m_shmIqBus;
+
+private:
+	CicDecimator m_cicDecimator;
+	CPX *m_cicBuffer; //Decimated samples before gain and IQ order are applied
+	quint32 m_cicBufferSize;
+	CPX *cicBuffer(quint32 _numSamples);
+
+	//initialize2() adapter state
+	void adaptIQData(CPX *_in, quint16 _numSamples);
+	quint64 m_adaptSampleCounter; //Device thread only
+	quint32 m_adaptSampleRate; //Looked up on first block, 0 until then
+	QAtomicInt m_adaptRestart; //Set at power on and startDevice(), next block starts the count over
+
+	//Shared memory IQ bus, host's callbacks are wrapped in initialize() when m_shmIqBus is set
+	void publishIQBlock(const IQBlock &_block);
+	void publishIQData(CPX *_in, quint16 _numSamples);
+	ShmIqPublisher m_shmPublisher;
+	CB_ProcessIQBlock m_hostIQBlock;
+	CB_ProcessIQData m_hostIQData;
+	quint64 m_publishSampleCounter; //V1 hosts, blocks don't carry one
 };
 
 #endif // DEVICEINTERFACEBASE_H
@@ -52,4 +52,28 @@ signals:
 //Creates cast macro for interface ie qobject_cast<DigitalModemInterface *>(plugin);
 Q_DECLARE_INTERFACE(DigitalModemInterface, DigitalModemInterface_iid)
 
+//Post bandpass samples for a V2 modem
+struct ModemBlock
+{
+	const CPX *samples; //Only valid during processModemBlock()
+	quint32 numSamples;
+	quint32 sampleRate;
+	quint64 firstSample; //Position of samples[0] in the stream since power on, includes dropped samples
+	qint64 utcMs; //When the block reached the receiver
+	quint64 droppedSamples; //Lost since the last block because the modem fell behind
+};
+
+//Modems are always run on their own thread (see ModemRunner), V2 adds block size and time stamps
+//List both in Q_INTERFACES(DigitalModemInterface DigitalModemInterface2) so Plugins still finds the modem
+class PEBBLELIBSHARED_EXPORT DigitalModemInterface2 : public DigitalModemInterface
+{
+public:
+	//Called instead of processBlock(), never on the DSP thread.  Nothing is returned to the receiver
+	virtual void processModemBlock(const ModemBlock &_block) = 0;
+};
+
+#define DigitalModemInterface2_iid "N1DDY.Pebble.DigitalModemInterface.V2"
+
+Q_DECLARE_INTERFACE(DigitalModemInterface2, DigitalModemInterface2_iid)
+
 #endif // DIGITAL_MODEM_INTERFACES_H
@@ -56,87 +56,112 @@
  * Rename K_Pi PI
  * Rename K_2pi TWOPI
  * Change CFft class ref to FFT *(we can switch FFT implementations)
+ * FFT and FIR sizes are per instance so low latency chains can use short partitions
  *
  */
 
 //////////////////////////////////////////////////////////////////////
 // Local Defines
 //////////////////////////////////////////////////////////////////////
+//Defaults, see CFastFIR(int, int) for shorter partitions
 #define CONV_FFT_SIZE 2048	//must be power of 2
 #define CONV_FIR_SIZE 1025	//must be <= FFT size. Make 1/2 +1 if want
 							//output to be in power of 2
 
 
-#define CONV_INBUF_SIZE (CONV_FFT_SIZE+CONV_FIR_SIZE-1)
-
-
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
 
 CFastFIR::CFastFIR()
+{
+	init(CONV_FFT_SIZE, CONV_FIR_SIZE, BLACKMAN_NUTTALL);
+}
+
+//Each FFT produces FFTSize - FIRSize + 1 output samples and only runs when that many inputs have arrived
+//Shorter partitions add less delay, at the cost of a wider transition band and more FFTs per sample
+CFastFIR::CFastFIR(int FFTSize, int FIRSize, Window window)
+{
+	init(FFTSize, qMin(FIRSize, FFTSize), window);
+}
+
+void CFastFIR::init(int FFTSize, int FIRSize, Window window)
 {
 int i;
+	m_fftSize = FFTSize;
+	m_firSize = FIRSize;
+	m_window = window;
 	m_pWindowTbl = NULL;
 	m_pFFTBuf = NULL;
+	m_pFFTBuf2 = NULL;
 	m_pFFTOverlapBuf = NULL;
-	m_pFilterCoef = NULL;
+	m_designFft = NULL;
 	//allocate internal buffer space on Heap
-	m_pWindowTbl = new TYPEREAL[CONV_FIR_SIZE];
-	m_pFilterCoef = new TYPECPX[CONV_FFT_SIZE];
-	m_pFFTBuf = new TYPECPX[CONV_FFT_SIZE];
-	m_pFFTOverlapBuf = new TYPECPX[CONV_FIR_SIZE];
+	//Coefficients live in FilterDesigns, so retuning doesn't allocate anything ProcessData uses
+	m_pWindowTbl = new TYPEREAL[m_firSize];
+	m_pFFTBuf = new TYPECPX[m_fftSize];
+	m_pFFTBuf2 = new TYPECPX[m_fftSize];
+	m_pFFTOverlapBuf = new TYPECPX[m_firSize];
 
-	if(!m_pWindowTbl || !m_pFilterCoef || !m_pFFTBuf || !m_pFFTOverlapBuf)
+	if(!m_pWindowTbl || !m_pFFTBuf || !m_pFFTBuf2 || !m_pFFTOverlapBuf)
 	{
 		//major poblems if memory fails here
 		return;
 	}
-	m_InBufInPos = (CONV_FIR_SIZE - 1);
-	for( i=0; i<CONV_FFT_SIZE; i++)
+	m_InBufInPos = (m_firSize - 1);
+	for( i=0; i<m_fftSize; i++)
 	{
 		m_pFFTBuf[i].real(0.0);
 		m_pFFTBuf[i].imag(0.0);
 	}
-#if 1
-	//create Blackman-Nuttall window function for windowed sinc low pass filter design
-	for( i=0; i<CONV_FIR_SIZE; i++)
+	for( i=0; i<m_firSize; i++)
 	{
-		m_pWindowTbl[i] = (0.3635819
-			- 0.4891775*cos( (TWOPI*i)/(CONV_FIR_SIZE-1) )
-			+ 0.1365995*cos( (2.0*TWOPI*i)/(CONV_FIR_SIZE-1) )
-			- 0.0106411*cos( (3.0*TWOPI*i)/(CONV_FIR_SIZE-1) ) );
 		m_pFFTOverlapBuf[i].real(0.0);
 		m_pFFTOverlapBuf[i].imag(0.0);
 	}
-#endif
-#if 0
-	//create Blackman-Harris window function for windowed sinc low pass filter design
-	for( i=0; i<CONV_FIR_SIZE; i++)
+	switch (m_window)
 	{
-		m_pWindowTbl[i] = (0.35875
-			- 0.48829*cos( (TWOPI*i)/(CONV_FIR_SIZE-1) )
-			+ 0.14128*cos( (2.0*TWOPI*i)/(CONV_FIR_SIZE-1) )
-			- 0.01168*cos( (3.0*TWOPI*i)/(CONV_FIR_SIZE-1) ) );
-		m_pFFTOverlapBuf[i].real(0.0);
-		m_pFFTOverlapBuf[i].imag(0.0);
-	}
-#endif
-#if 0
-	//create Nuttall window function for windowed sinc low pass filter design
-	for( i=0; i<CONV_FIR_SIZE; i++)
-	{
-		m_pWindowTbl[i] = (0.355768
-			- 0.487396*cos( (TWOPI*i)/(CONV_FIR_SIZE-1) )
-			+ 0.144232*cos( (2.0*TWOPI*i)/(CONV_FIR_SIZE-1) )
-			- 0.012604*cos( (3.0*TWOPI*i)/(CONV_FIR_SIZE-1) ) );
-		m_pFFTOverlapBuf[i].real(0.0);
-		m_pFFTOverlapBuf[i].imag(0.0);
+	case BLACKMAN_HARRIS:
+		//create Blackman-Harris window function for windowed sinc low pass filter design
+		for( i=0; i<m_firSize; i++)
+		{
+			m_pWindowTbl[i] = (0.35875
+				- 0.48829*cos( (TWOPI*i)/(m_firSize-1) )
+				+ 0.14128*cos( (2.0*TWOPI*i)/(m_firSize-1) )
+				- 0.01168*cos( (3.0*TWOPI*i)/(m_firSize-1) ) );
+		}
+		break;
+	case NUTTALL:
+		//create Nuttall window function for windowed sinc low pass filter design
+		for( i=0; i<m_firSize; i++)
+		{
+			m_pWindowTbl[i] = (0.355768
+				- 0.487396*cos( (TWOPI*i)/(m_firSize-1) )
+				+ 0.144232*cos( (2.0*TWOPI*i)/(m_firSize-1) )
+				- 0.012604*cos( (3.0*TWOPI*i)/(m_firSize-1) ) );
+		}
+		break;
+	case BLACKMAN_NUTTALL:
+	default:
+		//create Blackman-Nuttall window function for windowed sinc low pass filter design
+		for( i=0; i<m_firSize; i++)
+		{
+			m_pWindowTbl[i] = (0.3635819
+				- 0.4891775*cos( (TWOPI*i)/(m_firSize-1) )
+				+ 0.1365995*cos( (2.0*TWOPI*i)/(m_firSize-1) )
+				- 0.0106411*cos( (3.0*TWOPI*i)/(m_firSize-1) ) );
+		}
+		break;
 	}
-#endif
-	//m_Fft->FFTParams(CONV_FFT_SIZE, false, 0.0, 1.0);
-	m_Fft = FFT::factory("FastFIR");
-	m_Fft->fftParams(CONV_FFT_SIZE, 0, m_SampleRate, CONV_FIR_SIZE, WindowFunction::WINDOWTYPE::NONE);
+	//m_Fft->FFTParams(m_fftSize, false, 0.0, 1.0);
+	m_Fft = FFT::factory("FastFIR", m_fftSize, FFT::BOTH);
+	//Short partitions (low latency profile) would otherwise be rounded up to FFT::m_minFFTSize
+	m_Fft->setMinFFTSize(m_fftSize);
+	m_Fft->fftParams(m_fftSize, 0, m_SampleRate, m_firSize, WindowFunction::WINDOWTYPE::NONE);
+	//Same size, so same backend choice as m_Fft without another calibration
+	m_designFft = FFT::factory("FastFIR design", m_fftSize, FFT::BOTH);
+	m_designFft->setMinFFTSize(m_fftSize);
+	m_designFft->fftParams(m_fftSize, 0, m_SampleRate, m_firSize, WindowFunction::WINDOWTYPE::NONE);
 	m_FLoCut = -1.0;
 	m_FHiCut = 1.0;
 	m_Offset = 1.0;
@@ -165,16 +190,21 @@ void CFastFIR::FreeMemory()
 		delete [] m_pFFTOverlapBuf;
 		m_pFFTOverlapBuf = NULL;
 	}
-	if(m_pFilterCoef)
-	{
-		delete [] m_pFilterCoef;
-		m_pFilterCoef = NULL;
-	}
 	if(m_pFFTBuf)
 	{
 		delete [] m_pFFTBuf;
 		m_pFFTBuf = NULL;
 	}
+	if(m_pFFTBuf2)
+	{
+		delete [] m_pFFTBuf2;
+		m_pFFTBuf2 = NULL;
+	}
+	if(m_designFft)
+	{
+		delete m_designFft;
+		m_designFft = NULL;
+	}
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -187,11 +217,12 @@ void CFastFIR::FreeMemory()
 //  HiCut must be greater than LowCut
 //		example to make 2700Hz USB filter:
 //	SetupParameters( 100, 2800, 0, 48000);
+// Design is done here, not in ProcessData, and re-used from FilterDesignCache if we've seen
+// these parameters before.  ProcessData crossfades from the old to the new design over one FFT
 //////////////////////////////////////////////////////////////////////
 void CFastFIR::SetupParameters( TYPEREAL FLoCut, TYPEREAL FHiCut,
 								TYPEREAL Offset, TYPEREAL SampleRate)
 {
-int i;
 	if( (FLoCut==m_FLoCut) && (FHiCut==m_FHiCut) &&
 		(Offset==m_Offset) && (SampleRate==m_SampleRate) )
 	{
@@ -215,22 +246,46 @@ int i;
 		return;
 	}
 //qDebug()<<"FLowCut="<<FLoCut<<"FHiCut="<<FHiCut<<"SampleRate="<<SampleRate;
+	FilterDesignKey key = {FLoCut, FHiCut, SampleRate, (quint32)m_fftSize, (quint32)m_firSize, m_window};
+	QSharedPointer<FilterDesign> design = FilterDesignCache::find(key);
+	if (design.isNull())
+	{
+		design = QSharedPointer<FilterDesign>(new FilterDesign(key));
+		DesignCoef(FLoCut, FHiCut, SampleRate, design->coef);
+		FilterDesignCache::insert(design);
+	}
+
+	QSharedPointer<FilterDesign> retired;
 	m_Mutex.lock();
+	//Anything ProcessData let go of gets freed here, after unlock, not on the DSP thread
+	retired.swap(m_retiredDesign);
+	//Replaces a pending design that never got used
+	m_pendingDesign.swap(design);
+	m_Mutex.unlock();
+}
+
+//////////////////////////////////////////////////////////////////////
+// Windowed sinc band pass in the frequency domain, FLoCut and FHiCut already include any offset
+// Only uses m_pWindowTbl and m_designFft, so doesn't need m_Mutex
+//////////////////////////////////////////////////////////////////////
+void CFastFIR::DesignCoef(TYPEREAL FLoCut, TYPEREAL FHiCut, TYPEREAL SampleRate, TYPECPX* pFilterCoef)
+{
+int i;
 	//calculate some normalized filter parameters
 	TYPEREAL nFL = FLoCut/SampleRate;
 	TYPEREAL nFH = FHiCut/SampleRate;
 	TYPEREAL nFc = (nFH-nFL)/2.0;		//prototype LP filter cutoff
 	TYPEREAL nFs = TWOPI*(nFH+nFL)/2.0;		//2 PI times required frequency shift (FHiCut+FLoCut)/2
-	TYPEREAL fCenter = 0.5*(TYPEREAL)(CONV_FIR_SIZE-1);	//floating point center index of FIR filter
+	TYPEREAL fCenter = 0.5*(TYPEREAL)(m_firSize-1);	//floating point center index of FIR filter
 
-	for(i=0; i<CONV_FFT_SIZE; i++)		//zero pad entire coefficient buffer to FFT size
+	for(i=0; i<m_fftSize; i++)		//zero pad entire coefficient buffer to FFT size
 	{
-		m_pFilterCoef[i].real(0.0);
-		m_pFilterCoef[i].imag(0.0);
+		pFilterCoef[i].real(0.0);
+		pFilterCoef[i].imag(0.0);
 	}
 
 	//create LP FIR windowed sinc, sin(x)/x complex LP filter coefficients
-	for(i=0; i<CONV_FIR_SIZE; i++)
+	for(i=0; i<m_firSize; i++)
 	{
 		TYPEREAL x = (TYPEREAL)i - fCenter;
 		TYPEREAL z;
@@ -241,11 +296,11 @@ int i;
 
 		//shift lowpass filter coefficients in frequency by (hicut+lowcut)/2 to form bandpass filter anywhere in range
 		// (also scales by 1/FFTsize since inverse FFT routine scales by FFTsize)
-		m_pFilterCoef[i].real(z * cos(nFs * x)/(TYPEREAL)CONV_FFT_SIZE);
-		m_pFilterCoef[i].imag(z * sin(nFs * x)/(TYPEREAL)CONV_FFT_SIZE);
+		pFilterCoef[i].real(z * cos(nFs * x)/(TYPEREAL)m_fftSize);
+		pFilterCoef[i].imag(z * sin(nFs * x)/(TYPEREAL)m_fftSize);
 	}
 
-#if 0		//debug hack to write m_pFilterCoef to a file for analysis
+#if 0		//debug hack to write pFilterCoef to a file for analysis
 	QDir::setCurrent("d:/");
 	QFile File;
 	File.setFileName("lpcoef.txt");
@@ -253,9 +308,9 @@ int i;
 	{
 		qDebug()<<"file Opened OK";
 		char Buf[256];
-		for( i=0; i<CONV_FIR_SIZE; i++)
+		for( i=0; i<m_firSize; i++)
 		{
-			sprintf( Buf, "%19.12g %19.12g\r\n", (double)CONV_FFT_SIZE*m_pFilterCoef[i].re, (double)CONV_FFT_SIZE*m_pFilterCoef[i].im);
+			sprintf( Buf, "%19.12g %19.12g\r\n", (double)m_fftSize*pFilterCoef[i].re, (double)m_fftSize*pFilterCoef[i].im);
 			File.write(Buf);
 		}
 	}
@@ -264,11 +319,7 @@ int i;
 
 #endif
 	//convert FIR coefficients to frequency domain by taking forward FFT
-	m_Fft->fftForward(m_pFilterCoef, m_pFilterCoef, CONV_FFT_SIZE);
-	m_Mutex.unlock();
-
-
-
+	m_designFft->fftForward(pFilterCoef, pFilterCoef, m_fftSize);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -276,6 +327,7 @@ int i;
 //  returns number of complex samples placed in OutBuf
 //number of samples returned in general will not be equal to the number of
 //input samples due to FFT block size processing.
+//Output is silent until the first SetupParameters
 //600ns/samp
 ///////////////////////////////////////////////////////////////////////////////
 int CFastFIR::ProcessData(int InLength, TYPECPX* InBuf, TYPECPX* OutBuf)
@@ -290,27 +342,54 @@ int outpos = 0;
 	m_Mutex.lock();
 	while(len--)
 	{
-		j = m_InBufInPos - (CONV_FFT_SIZE - CONV_FIR_SIZE + 1) ;
+		j = m_InBufInPos - (m_fftSize - m_firSize + 1) ;
 		if(j >= 0 )
-		{	//keep copy of last CONV_FIR_SIZE-1 samples for overlap save
+		{	//keep copy of last m_firSize-1 samples for overlap save
 			m_pFFTOverlapBuf[j] = InBuf[i];
 		}
 		m_pFFTBuf[m_InBufInPos++] = InBuf[i++];
-		if(m_InBufInPos >= CONV_FFT_SIZE)
+		if(m_InBufInPos >= m_fftSize)
 		{	//perform FFT -> complexMultiply by FIR coefficients -> inverse FFT on filled FFT input buffer
-			m_Fft->fftForward(m_pFFTBuf, m_pFFTBuf, CONV_FFT_SIZE);
-			CpxMpy(CONV_FFT_SIZE, m_pFilterCoef, m_pFFTBuf, m_pFFTBuf);
-			m_Fft->fftInverse(m_pFFTBuf, m_pFFTBuf, CONV_FFT_SIZE);
-			for(j=(CONV_FIR_SIZE-1); j<CONV_FFT_SIZE; j++)
-			{	//copy FFT output into OutBuf minus CONV_FIR_SIZE-1 samples at beginning
-				OutBuf[outpos++] = m_pFFTBuf[j];
+			m_Fft->fftForward(m_pFFTBuf, m_pFFTBuf, m_fftSize);
+			if (m_pendingDesign.isNull())
+			{
+				if (m_design.isNull())
+					clearCPX(m_pFFTBuf, m_fftSize);
+				else
+					CpxMpy(m_fftSize, m_design->coef, m_pFFTBuf, m_pFFTBuf);
+				m_Fft->fftInverse(m_pFFTBuf, m_pFFTBuf, m_fftSize);
+				for(j=(m_firSize-1); j<m_fftSize; j++)
+				{	//copy FFT output into OutBuf minus m_firSize-1 samples at beginning
+					OutBuf[outpos++] = m_pFFTBuf[j];
+				}
+			}
+			else
+			{	//New design.  Overlap save output is already valid for both filters, so
+				//run this block through each and fade linearly from old to new, no pop
+				CpxMpy(m_fftSize, m_pendingDesign->coef, m_pFFTBuf, m_pFFTBuf2);
+				m_Fft->fftInverse(m_pFFTBuf2, m_pFFTBuf2, m_fftSize);
+				if (m_design.isNull())
+					clearCPX(m_pFFTBuf, m_fftSize);
+				else
+					CpxMpy(m_fftSize, m_design->coef, m_pFFTBuf, m_pFFTBuf);
+				m_Fft->fftInverse(m_pFFTBuf, m_pFFTBuf, m_fftSize);
+				TYPEREAL fadeStep = 1.0 / (TYPEREAL)(m_fftSize - m_firSize + 1);
+				TYPEREAL fade = fadeStep;
+				for(j=(m_firSize-1); j<m_fftSize; j++)
+				{
+					OutBuf[outpos++] = m_pFFTBuf[j] * (1.0 - fade) + m_pFFTBuf2[j] * fade;
+					fade += fadeStep;
+				}
+				//Pointer swaps only, old design is released in SetupParameters
+				m_retiredDesign.swap(m_design);
+				m_design.swap(m_pendingDesign);
 			}
-			for(j=0; j<(CONV_FIR_SIZE - 1);j++)
+			for(j=0; j<(m_firSize - 1);j++)
 			{	//copy overlap buffer into start of fft input buffer
 				m_pFFTBuf[j] = m_pFFTOverlapBuf[j];
 			}
 			//reset input position to data start position of fft input buffer
-			m_InBufInPos = CONV_FIR_SIZE - 1;
+			m_InBufInPos = m_firSize - 1;
 		}
 	}
 	m_Mutex.unlock();
@@ -49,18 +49,30 @@
 //Adapt to Pebble types
 #include "cpx.h"
 #include "fft.h"
+#include "filterdesigncache.h"
 class CFastFIR  
 {
 public:
+	//Window for the windowed sinc design, part of the FilterDesignCache key
+	enum Window {BLACKMAN_NUTTALL, BLACKMAN_HARRIS, NUTTALL};
+
 	CFastFIR();
+	CFastFIR(int FFTSize, int FIRSize, Window window = BLACKMAN_NUTTALL);
 	virtual ~CFastFIR();
 
+	//Designs (or finds a cached design) on the caller's thread, ProcessData crossfades to it on its next FFT
 	void SetupParameters( TYPEREAL FLoCut,TYPEREAL FHiCut,TYPEREAL Offset, TYPEREAL SampleRate);
 	int ProcessData(int InLength, TYPECPX* InBuf, TYPECPX* OutBuf);
 
 private:
 	void CpxMpy(int N, TYPECPX* m, TYPECPX* src, TYPECPX* dest);
 	void FreeMemory();
+	void init(int FFTSize, int FIRSize, Window window);
+	void DesignCoef(TYPEREAL FLoCut, TYPEREAL FHiCut, TYPEREAL SampleRate, TYPECPX* pFilterCoef);
+
+	int m_fftSize;
+	int m_firSize;
+	Window m_window;
 
 	TYPEREAL m_FLoCut;
 	TYPEREAL m_FHiCut;
@@ -70,9 +82,15 @@ private:
 	int m_InBufInPos;
 	TYPEREAL* m_pWindowTbl;
 	TYPECPX* m_pFFTOverlapBuf;
-	TYPECPX* m_pFilterCoef;
 	TYPECPX* m_pFFTBuf;
+	TYPECPX* m_pFFTBuf2;	//new filter's output while crossfading
+	//Swapped at an FFT boundary under m_Mutex, never allocated or freed in ProcessData
+	//Retired design is released by the next SetupParameters, on the caller's thread
+	QSharedPointer<FilterDesign> m_design;
+	QSharedPointer<FilterDesign> m_pendingDesign;
+	QSharedPointer<FilterDesign> m_retiredDesign;
 	QMutex m_Mutex;		//for keeping threads from stomping on each other
 	FFT *m_Fft;
+	FFT *m_designFft;	//SetupParameters runs on another thread than ProcessData
 };
 #endif // FASTFIR_H
@@ -0,0 +1,355 @@
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "fastmath.h"
+#include "db.h"
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#define FASTMATH_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef FASTMATH_SSE2
+//Same math as the scalar versions in fastmath.h, 2 lanes at a time
+namespace {
+
+inline __m128d select_pd(__m128d _mask, __m128d _a, __m128d _b)
+{
+	//_mask ? _a : _b
+	return _mm_or_pd(_mm_and_pd(_mask, _a), _mm_andnot_pd(_mask, _b));
+}
+
+//Two int32 in the low lanes, each becomes an all ones or all zeros 64 bit mask if _bit is set
+inline __m128d bitMask_pd(__m128i _q32, int _bit)
+{
+	__m128i q64 = _mm_unpacklo_epi32(_q32, _q32);
+	__m128i bit = _mm_set1_epi32(_bit);
+	return _mm_castsi128_pd(_mm_cmpeq_epi32(_mm_and_si128(q64, bit), bit));
+}
+
+inline __m128d poly_pd(__m128d _x, const double *_coef, int _num)
+{
+	//Horner, _coef[0] is the highest power
+	__m128d p = _mm_set1_pd(_coef[0]);
+	for (int i = 1; i < _num; i++)
+		p = _mm_add_pd(_mm_mul_pd(p, _x), _mm_set1_pd(_coef[i]));
+	return p;
+}
+
+const double c_lnCoef[] = {1.0/11, 1.0/9, 1.0/7, 1.0/5, 1.0/3, 1.0};
+const double c_exp2Coef[] = {1.0/3628800, 1.0/362880, 1.0/40320, 1.0/5040, 1.0/720, 1.0/120, 1.0/24, 1.0/6,
+	1.0/2, 1.0, 1.0};
+const double c_sinCoef[] = {1.0/6227020800.0, -1.0/39916800, 1.0/362880, -1.0/5040, 1.0/120, -1.0/6};
+const double c_cosCoef[] = {-1.0/87178291200.0, 1.0/479001600, -1.0/3628800, 1.0/40320, -1.0/720, 1.0/24,
+	-1.0/2, 1.0};
+const double c_atanCoef[] = {-1.0/15, 1.0/13, -1.0/11, 1.0/9, -1.0/7, 1.0/5, -1.0/3, 1.0};
+
+inline __m128d log2_pd(__m128d _x)
+{
+	const __m128d minNormal = _mm_set1_pd(2.2250738585072014e-308);
+	const __m128d one = _mm_set1_pd(1.0);
+	//max() returns the second operand for nan, same as the scalar version
+	__m128d x = _mm_max_pd(_x, minNormal);
+	__m128i bits = _mm_castpd_si128(x);
+	//Biased exponent to double without a 64 bit int convert, 2^52 + e - 2^52
+	const __m128i twoP52 = _mm_set1_epi64x(0x4330000000000000LL);
+	__m128d e = _mm_sub_pd(_mm_castsi128_pd(_mm_or_si128(_mm_srli_epi64(bits, 52), twoP52)),
+		_mm_set1_pd(4503599627370496.0 + 1023.0));
+	__m128i mant = _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+		_mm_set1_epi64x(0x3FF0000000000000LL));
+	__m128d m = _mm_castsi128_pd(mant);
+	__m128d big = _mm_cmpgt_pd(m, _mm_set1_pd(1.41421356237309504880));
+	m = select_pd(big, _mm_mul_pd(m, _mm_set1_pd(0.5)), m);
+	e = _mm_add_pd(e, _mm_and_pd(big, one));
+	__m128d t = _mm_div_pd(_mm_sub_pd(m, one), _mm_add_pd(m, one));
+	__m128d t2 = _mm_mul_pd(t, t);
+	__m128d ln = _mm_mul_pd(_mm_mul_pd(_mm_set1_pd(2.0), t), poly_pd(t2, c_lnCoef, 6));
+	return _mm_add_pd(e, _mm_mul_pd(ln, _mm_set1_pd(1.44269504088896340736)));
+}
+
+inline __m128d exp2_pd(__m128d _x)
+{
+	__m128d x = _mm_min_pd(_mm_max_pd(_x, _mm_set1_pd(-1022.0)), _mm_set1_pd(1023.0));
+	//Round to nearest, same as floor(x + 0.5) except exactly on .5 which doesn't change the result
+	__m128i n32 = _mm_cvtpd_epi32(x);
+	__m128d n = _mm_cvtepi32_pd(n32);
+	__m128d y = _mm_mul_pd(_mm_sub_pd(x, n), _mm_set1_pd(0.69314718055994530942));
+	__m128d p = poly_pd(y, c_exp2Coef, 11);
+	__m128i biased = _mm_unpacklo_epi32(_mm_add_epi32(n32, _mm_set1_epi32(1023)), _mm_setzero_si128());
+	return _mm_mul_pd(p, _mm_castsi128_pd(_mm_slli_epi64(biased, 52)));
+}
+
+inline __m128d cpxPower_pd(const CPX *_in)
+{
+	//re0 im0, re1 im1
+	__m128d a = _mm_loadu_pd((const double *)&_in[0]);
+	__m128d b = _mm_loadu_pd((const double *)&_in[1]);
+	a = _mm_mul_pd(a, a);
+	b = _mm_mul_pd(b, b);
+	return _mm_add_pd(_mm_unpacklo_pd(a, b), _mm_unpackhi_pd(a, b));
+}
+
+//10*log10 or 20*log10, 0 is DB::minDb
+inline __m128d toDb_pd(__m128d _x, double _factor, bool _clip)
+{
+	const __m128d minDb = _mm_set1_pd(DB::minDb);
+	__m128d db = _mm_mul_pd(log2_pd(_x), _mm_set1_pd(_factor * 0.30102999566398119521));
+	db = select_pd(_mm_cmpeq_pd(_x, _mm_setzero_pd()), minDb, db);
+	if (_clip)
+		db = _mm_min_pd(_mm_max_pd(db, minDb), _mm_set1_pd(DB::maxDb));
+	return db;
+}
+
+} //namespace
+#endif
+
+void FastMath::log10Array(const double *in, double *out, int numSamples)
+{
+	int i = 0;
+#ifdef FASTMATH_SSE2
+	const __m128d log10_2 = _mm_set1_pd(c_log10_2);
+	for (; i + 2 <= numSamples; i += 2)
+		_mm_storeu_pd(&out[i], _mm_mul_pd(log2_pd(_mm_loadu_pd(&in[i])), log10_2));
+#endif
+	for (; i < numSamples; i++)
+		out[i] = log10(in[i]);
+}
+
+void FastMath::exp10Array(const double *in, double *out, int numSamples)
+{
+	int i = 0;
+#ifdef FASTMATH_SSE2
+	const __m128d log2_10 = _mm_set1_pd(c_log2_10);
+	for (; i + 2 <= numSamples; i += 2)
+		_mm_storeu_pd(&out[i], exp2_pd(_mm_mul_pd(_mm_loadu_pd(&in[i]), log2_10)));
+#endif
+	for (; i < numSamples; i++)
+		out[i] = exp10(in[i]);
+}
+
+void FastMath::sqrtArray(const double *in, double *out, int numSamples)
+{
+	int i = 0;
+#ifdef FASTMATH_SSE2
+	for (; i + 2 <= numSamples; i += 2)
+		_mm_storeu_pd(&out[i], _mm_sqrt_pd(_mm_loadu_pd(&in[i])));
+#endif
+	for (; i < numSamples; i++)
+		out[i] = std::sqrt(in[i]);
+}
+
+void FastMath::sinCosArray(const double *in, double *sinOut, double *cosOut, int numSamples)
+{
+	int i = 0;
+#ifdef FASTMATH_SSE2
+	const __m128d signBit = _mm_set1_pd(-0.0);
+	for (; i + 2 <= numSamples; i += 2) {
+		__m128d x = _mm_loadu_pd(&in[i]);
+		__m128d q = _mm_add_pd(_mm_mul_pd(x, _mm_set1_pd(c_twoOverPi)), _mm_set1_pd(0.5));
+		//floor() for the int32 range
+		__m128i q32 = _mm_cvttpd_epi32(q);
+		__m128d qd = _mm_cvtepi32_pd(q32);
+		__m128d adjust = _mm_cmpgt_pd(qd, q);
+		qd = _mm_sub_pd(qd, _mm_and_pd(adjust, _mm_set1_pd(1.0)));
+		q32 = _mm_cvttpd_epi32(qd);
+		__m128d r = _mm_sub_pd(_mm_sub_pd(x, _mm_mul_pd(qd, _mm_set1_pd(c_pio2Hi))),
+			_mm_mul_pd(qd, _mm_set1_pd(c_pio2Lo)));
+		__m128d r2 = _mm_mul_pd(r, r);
+		__m128d s = _mm_add_pd(r, _mm_mul_pd(_mm_mul_pd(r, r2), poly_pd(r2, c_sinCoef, 6)));
+		__m128d c = poly_pd(r2, c_cosCoef, 8);
+		__m128d odd = bitMask_pd(q32, 1);
+		__m128d sr = select_pd(odd, c, s);
+		__m128d cr = select_pd(odd, s, c);
+		sr = _mm_xor_pd(sr, _mm_and_pd(bitMask_pd(q32, 2), signBit));
+		cr = _mm_xor_pd(cr, _mm_and_pd(bitMask_pd(_mm_add_epi32(q32, _mm_set1_epi32(1)), 2), signBit));
+		_mm_storeu_pd(&sinOut[i], sr);
+		_mm_storeu_pd(&cosOut[i], cr);
+	}
+#endif
+	for (; i < numSamples; i++)
+		sinCos(in[i], sinOut[i], cosOut[i]);
+}
+
+void FastMath::atan2Array(const double *y, const double *x, double *out, int numSamples)
+{
+	int i = 0;
+#ifdef FASTMATH_SSE2
+	const __m128d signBit = _mm_set1_pd(-0.0);
+	const __m128d one = _mm_set1_pd(1.0);
+	const __m128d zero = _mm_setzero_pd();
+	for (; i + 2 <= numSamples; i += 2) {
+		__m128d vy = _mm_loadu_pd(&y[i]);
+		__m128d vx = _mm_loadu_pd(&x[i]);
+		__m128d ax = _mm_andnot_pd(signBit, vx);
+		__m128d ay = _mm_andnot_pd(signBit, vy);
+		__m128d swap = _mm_cmpgt_pd(ay, ax);
+		__m128d num = select_pd(swap, ax, ay);
+		__m128d den = select_pd(swap, ay, ax);
+		//0/0 is 0
+		__m128d z = _mm_and_pd(_mm_cmpgt_pd(den, zero), _mm_div_pd(num, den));
+		z = _mm_div_pd(z, _mm_add_pd(one, _mm_sqrt_pd(_mm_add_pd(one, _mm_mul_pd(z, z)))));
+		z = _mm_div_pd(z, _mm_add_pd(one, _mm_sqrt_pd(_mm_add_pd(one, _mm_mul_pd(z, z)))));
+		__m128d a = _mm_mul_pd(_mm_set1_pd(4.0), _mm_mul_pd(z, poly_pd(_mm_mul_pd(z, z), c_atanCoef, 8)));
+		a = select_pd(swap, _mm_sub_pd(_mm_set1_pd(c_pio2), a), a);
+		a = select_pd(_mm_cmplt_pd(vx, zero), _mm_sub_pd(_mm_set1_pd(c_pi), a), a);
+		_mm_storeu_pd(&out[i], _mm_or_pd(a, _mm_and_pd(vy, signBit)));
+	}
+#endif
+	for (; i < numSamples; i++)
+		out[i] = atan2(y[i], x[i]);
+}
+
+void FastMath::powerArray(const CPX *in, double *out, int numSamples)
+{
+	int i = 0;
+#ifdef FASTMATH_SSE2
+	for (; i + 2 <= numSamples; i += 2)
+		_mm_storeu_pd(&out[i], cpxPower_pd(&in[i]));
+#endif
+	for (; i < numSamples; i++)
+		out[i] = in[i].real() * in[i].real() + in[i].imag() * in[i].imag();
+}
+
+void FastMath::magArray(const CPX *in, double *out, int numSamples)
+{
+	int i = 0;
+#ifdef FASTMATH_SSE2
+	for (; i + 2 <= numSamples; i += 2)
+		_mm_storeu_pd(&out[i], _mm_sqrt_pd(cpxPower_pd(&in[i])));
+#endif
+	for (; i < numSamples; i++)
+		out[i] = std::sqrt(in[i].real() * in[i].real() + in[i].imag() * in[i].imag());
+}
+
+double FastMath::maxAbs(const CPX *in, int numSamples)
+{
+	int i = 0;
+	double peak = 0;
+#ifdef FASTMATH_SSE2
+	//One CPX per register, 2 accumulators so the max latency overlaps
+	const __m128d absMask = _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+	__m128d max0 = _mm_setzero_pd();
+	__m128d max1 = _mm_setzero_pd();
+	for (; i + 2 <= numSamples; i += 2) {
+		max0 = _mm_max_pd(max0, _mm_and_pd(_mm_loadu_pd((const double *)&in[i]), absMask));
+		max1 = _mm_max_pd(max1, _mm_and_pd(_mm_loadu_pd((const double *)&in[i + 1]), absMask));
+	}
+	max0 = _mm_max_pd(max0, max1);
+	max0 = _mm_max_sd(max0, _mm_unpackhi_pd(max0, max0));
+	peak = _mm_cvtsd_f64(max0);
+#endif
+	for (; i < numSamples; i++)
+		peak = qMax(peak, qMax(fabs(in[i].real()), fabs(in[i].imag())));
+	return peak;
+}
+
+void FastMath::powerToDbArray(const double *in, double *out, int numSamples, bool clip)
+{
+	int i = 0;
+#ifdef FASTMATH_SSE2
+	for (; i + 2 <= numSamples; i += 2)
+		_mm_storeu_pd(&out[i], toDb_pd(_mm_loadu_pd(&in[i]), 10.0, clip));
+#endif
+	for (; i < numSamples; i++) {
+		out[i] = in[i] == 0 ? DB::minDb : 10.0 * log10(in[i]);
+		if (clip)
+			out[i] = DB::clip(out[i]);
+	}
+}
+
+void FastMath::amplitudeToDbArray(const double *in, double *out, int numSamples, bool clip)
+{
+	int i = 0;
+#ifdef FASTMATH_SSE2
+	for (; i + 2 <= numSamples; i += 2)
+		_mm_storeu_pd(&out[i], toDb_pd(_mm_loadu_pd(&in[i]), 20.0, clip));
+#endif
+	for (; i < numSamples; i++) {
+		out[i] = in[i] == 0 ? DB::minDb : 20.0 * log10(in[i]);
+		if (clip)
+			out[i] = DB::clip(out[i]);
+	}
+}
+
+//Array versions are checked, they run the scalar code for the odd sample at the end so that gets checked too
+QString FastMath::check(bool *_isOk)
+{
+	//Bounds from fastmath.h, powerTodB is 10 * the log10 bound
+	const double log10Bound = 1e-10;
+	const double exp10Bound = 1e-11;
+	const double sinCosBound = 1e-12;
+	const double atan2Bound = 1e-12;
+	const double dBBound = 1e-9;
+	const int n = 1001;
+	double in[n];
+	double in2[n];
+	double out[n];
+	double out2[n];
+	double err;
+	double maxErr;
+	bool isOk = true;
+	auto bound = [&isOk](double _maxErr, double _bound) -> QString {
+		if (_maxErr < _bound)
+			return "";
+		isOk = false;
+		return " FAIL";
+	};
+	QString str = "Fast math, max error vs libm:";
+#ifdef FASTMATH_SSE2
+	str += " (SSE2)";
+#endif
+
+	//log10 over the whole range we see, 1e-15 to 1e3 power
+	for (int i = 0; i < n; i++)
+		in[i] = ::pow(10.0, -15.0 + 18.0 * i / (n - 1)) * (1.0 + 0.37 * (i % 7));
+	log10Array(in, out, n);
+	maxErr = 0;
+	for (int i = 0; i < n; i++)
+		maxErr = qMax(maxErr, fabs(out[i] - ::log10(in[i])));
+	str += QString("\nlog10 %1 abs").arg(maxErr, 0, 'g', 2) + bound(maxErr, log10Bound);
+
+	//exp10, relative
+	for (int i = 0; i < n; i++)
+		in[i] = -15.0 + 18.0 * i / (n - 1);
+	exp10Array(in, out, n);
+	maxErr = 0;
+	for (int i = 0; i < n; i++)
+		maxErr = qMax(maxErr, fabs(out[i] / ::pow(10.0, in[i]) - 1.0));
+	str += QString("\nexp10 %1 rel").arg(maxErr, 0, 'g', 2) + bound(maxErr, exp10Bound);
+
+	//sin and cos, a few turns either side of 0 plus some large phases from free running NCOs
+	for (int i = 0; i < n; i++)
+		in[i] = (i < n - 10) ? -20.0 + 40.0 * i / (n - 1) : 1.0e5 * (i - n + 11) + 0.1234;
+	sinCosArray(in, out, out2, n);
+	maxErr = 0;
+	for (int i = 0; i < n; i++) {
+		err = qMax(fabs(out[i] - ::sin(in[i])), fabs(out2[i] - ::cos(in[i])));
+		maxErr = qMax(maxErr, err);
+	}
+	str += QString("\nsin cos %1 abs").arg(maxErr, 0, 'g', 2) + bound(maxErr, sinCosBound);
+
+	//atan2 all the way around, including the axes
+	for (int i = 0; i < n; i++) {
+		in[i] = ::sin(TWOPI * i / (n - 1)) * (1.0 + i % 5);
+		in2[i] = ::cos(TWOPI * i / (n - 1)) * (1.0 + i % 3);
+	}
+	in[0] = 0;
+	in2[1] = 0;
+	atan2Array(in, in2, out, n);
+	maxErr = 0;
+	for (int i = 0; i < n; i++)
+		maxErr = qMax(maxErr, fabs(out[i] - ::atan2(in[i], in2[i])));
+	str += QString("\natan2 %1 abs").arg(maxErr, 0, 'g', 2) + bound(maxErr, atan2Bound);
+
+	//Power to dB including 0
+	for (int i = 0; i < n; i++)
+		in[i] = i == 0 ? 0 : ::pow(10.0, -14.0 + 14.0 * i / (n - 1));
+	powerToDbArray(in, out, n);
+	maxErr = 0;
+	for (int i = 0; i < n; i++)
+		maxErr = qMax(maxErr, fabs(out[i] - DB::powerTodB(in[i])));
+	str += QString("\npowerTodB %1 dB").arg(maxErr, 0, 'g', 2) + bound(maxErr, dBBound);
+	str += "\n";
+	if (_isOk != NULL)
+		*_isOk = isOk;
+	return str;
+}
@@ -0,0 +1,198 @@
+#ifndef FASTMATH_H
+#define FASTMATH_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "pebblelib_global.h"
+#include "cpx.h"
+#include <QString>
+#include <cstring>
+#include <cmath>
+
+/*
+	Fast approximations of the libm functions called per sample or per bin
+
+	Scalar versions are inline for loops that can't be vectorized (AGC peak detector, noise blanker averages).
+	Array versions process 2 doubles at a time with SSE2 (any x86_64 build) and fall back to the same scalar
+	code elsewhere, so results are identical except for the last bit or two.  Use the array versions where
+	a loop can be split into a vector pass and a recursive pass.
+
+	Error bounds, checked against libm by check() (About box and SdrEmulator --selftest)
+	log2, log10		absolute error < 1e-10 for any normal x > 0.  x <= 0 returns log of smallest normal (-307.65 for log10)
+	exp, exp2, exp10	relative error < 1e-11, input clamped so result is a normal double
+	sqrt, rsqrt		hardware sqrt, exact to rounding.  Vectorized for throughput, not approximated
+	sin, cos		absolute error < 1e-12 for |x| < 1e6
+	atan2			absolute error < 1e-12 radians.  atan2(0,0) is 0, same as libm
+
+	No allocation, no state, thread safe
+*/
+class PEBBLELIBSHARED_EXPORT FastMath
+{
+public:
+	//FastMath(); //All static, no constructor
+
+	//Scalar versions
+	static inline double log2(double x) {
+		if (!(x >= c_minNormal))
+			x = c_minNormal; //Also catches nan
+		quint64 bits;
+		memcpy(&bits, &x, sizeof(bits));
+		double e = (double)((int)(bits >> 52) - 1023);
+		//Mantissa in [1,2), then centered on 1 so the series converges fast
+		bits = (bits & c_mantissaMask) | c_oneBits;
+		double m;
+		memcpy(&m, &bits, sizeof(m));
+		if (m > c_sqrt2) {
+			m *= 0.5;
+			e += 1.0;
+		}
+		return e + lnMantissa(m) * c_log2e;
+	}
+
+	static inline double log10(double x) {
+		return log2(x) * c_log10_2;
+	}
+
+	static inline double exp2(double x) {
+		x = qBound(-1022.0, x, 1023.0);
+		double n = floor(x + 0.5);
+		//2^f, f in [-0.5,0.5]
+		double p = exp2Fraction(x - n);
+		quint64 bits = (quint64)((qint64)n + 1023) << 52;
+		double scale;
+		memcpy(&scale, &bits, sizeof(scale));
+		return p * scale;
+	}
+
+	static inline double exp(double x) {
+		return exp2(x * c_log2e);
+	}
+
+	//10^x, ie dB to power is exp10(db / 10)
+	static inline double exp10(double x) {
+		return exp2(x * c_log2_10);
+	}
+
+	static inline double sqrt(double x) {
+		return std::sqrt(x);
+	}
+
+	static inline double rsqrt(double x) {
+		return 1.0 / std::sqrt(x);
+	}
+
+	static inline void sinCos(double x, double &s, double &c) {
+		//Cody-Waite reduction to [-pi/4, pi/4] and quadrant
+		double q = floor(x * c_twoOverPi + 0.5);
+		double r = (x - q * c_pio2Hi) - q * c_pio2Lo;
+		double sr, cr;
+		sinCosPoly(r, sr, cr);
+		int quadrant = (int)((qint64)q & 3);
+		if (quadrant & 1) {
+			double t = sr;
+			sr = cr;
+			cr = t;
+		}
+		s = (quadrant & 2) ? -sr : sr;
+		c = ((quadrant + 1) & 2) ? -cr : cr;
+	}
+
+	static inline double sin(double x) {
+		double s, c;
+		sinCos(x, s, c);
+		return s;
+	}
+
+	static inline double cos(double x) {
+		double s, c;
+		sinCos(x, s, c);
+		return c;
+	}
+
+	static inline double atan2(double y, double x) {
+		double ax = fabs(x);
+		double ay = fabs(y);
+		bool swap = ay > ax;
+		double num = swap ? ax : ay;
+		double den = swap ? ay : ax;
+		double z = den > 0 ? num / den : 0;
+		//atan(z) = 2 atan(z / (1 + sqrt(1 + z^2))), twice takes [0,1] to [0,tan(pi/16)]
+		z = z / (1.0 + std::sqrt(1.0 + z * z));
+		z = z / (1.0 + std::sqrt(1.0 + z * z));
+		double a = 4.0 * atanPoly(z);
+		if (swap)
+			a = c_pio2 - a;
+		if (x < 0)
+			a = c_pi - a;
+		return std::signbit(y) ? -a : a;
+	}
+
+	//Array versions, in and out can be the same buffer
+	static void log10Array(const double *in, double *out, int numSamples);
+	static void exp10Array(const double *in, double *out, int numSamples);
+	static void sqrtArray(const double *in, double *out, int numSamples);
+	static void sinCosArray(const double *in, double *sinOut, double *cosOut, int numSamples);
+	static void atan2Array(const double *y, const double *x, double *out, int numSamples);
+
+	//re^2 + im^2, same as DB::power()
+	static void powerArray(const CPX *in, double *out, int numSamples);
+	//sqrt(re^2 + im^2), same as DB::amplitude() and magCpx()
+	static void magArray(const CPX *in, double *out, int numSamples);
+	//10*log10(power), 0 is DB::minDb like DB::powerTodB().  Optionally clipped to DB::minDb..DB::maxDb
+	static void powerToDbArray(const double *in, double *out, int numSamples, bool clip = false);
+	//20*log10(amplitude), same rules as powerToDbArray()
+	static void amplitudeToDbArray(const double *in, double *out, int numSamples, bool clip = false);
+	//Largest max(|re|,|im|) in the block, 0 if numSamples is 0.  Peak envelope for AGC
+	static double maxAbs(const CPX *in, int numSamples);
+
+	//Max error of every function against libm, one line each.  _isOk is false if any is over its bound above
+	static QString check(bool *_isOk = NULL);
+
+private:
+	static constexpr double c_minNormal = 2.2250738585072014e-308;
+	static const quint64 c_mantissaMask = 0x000FFFFFFFFFFFFFULL;
+	static const quint64 c_oneBits = 0x3FF0000000000000ULL;
+
+	static constexpr double c_sqrt2 = 1.41421356237309504880;
+	static constexpr double c_log2e = 1.44269504088896340736;
+	static constexpr double c_log10_2 = 0.30102999566398119521;
+	static constexpr double c_log2_10 = 3.32192809488736234787;
+	static constexpr double c_ln2 = 0.69314718055994530942;
+	static constexpr double c_pi = 3.14159265358979323846;
+	static constexpr double c_pio2 = 1.57079632679489661923;
+	static constexpr double c_twoOverPi = 0.63661977236758134308;
+	//pi/2 split so q * c_pio2Hi is exact for |q| < 2^20
+	static constexpr double c_pio2Hi = 1.57079632673412561417e+00;
+	static constexpr double c_pio2Lo = 6.07710050650619224932e-11;
+
+	//ln(m) for m in [sqrt(.5),sqrt(2)].  2*atanh(t), t = (m-1)/(m+1) <= 0.1716, first omitted term < 2e-11
+	static inline double lnMantissa(double m) {
+		double t = (m - 1.0) / (m + 1.0);
+		double t2 = t * t;
+		return 2.0 * t * (1.0 + t2 * (1.0/3 + t2 * (1.0/5 + t2 * (1.0/7 + t2 * (1.0/9 + t2 * (1.0/11))))));
+	}
+
+	//2^f for f in [-0.5,0.5].  Taylor series of e^(f ln2) to y^10, first omitted term < 3e-12
+	static inline double exp2Fraction(double f) {
+		double y = f * c_ln2;
+		return 1.0 + y * (1.0 + y * (1.0/2 + y * (1.0/6 + y * (1.0/24 + y * (1.0/120 + y * (1.0/720 +
+			y * (1.0/5040 + y * (1.0/40320 + y * (1.0/362880 + y * (1.0/3628800))))))))));
+	}
+
+	//r in [-pi/4,pi/4].  Taylor to r^13 and r^14, first omitted terms < 3e-14
+	static inline void sinCosPoly(double r, double &s, double &c) {
+		double r2 = r * r;
+		s = r + r * r2 * (-1.0/6 + r2 * (1.0/120 + r2 * (-1.0/5040 + r2 * (1.0/362880 +
+			r2 * (-1.0/39916800 + r2 * (1.0/6227020800.0))))));
+		c = 1.0 + r2 * (-1.0/2 + r2 * (1.0/24 + r2 * (-1.0/720 + r2 * (1.0/40320 +
+			r2 * (-1.0/3628800 + r2 * (1.0/479001600 + r2 * (-1.0/87178291200.0)))))));
+	}
+
+	//z in [0,tan(pi/16)].  Taylor to z^15, first omitted term < 1e-13
+	static inline double atanPoly(double z) {
+		double z2 = z * z;
+		return z * (1.0 + z2 * (-1.0/3 + z2 * (1.0/5 + z2 * (-1.0/7 + z2 * (1.0/9 + z2 * (-1.0/11 +
+			z2 * (1.0/13 + z2 * (-1.0/15))))))));
+	}
+};
+
+#endif // FASTMATH_H
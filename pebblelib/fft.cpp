@@ -2,13 +2,10 @@
 #include "gpl.h"
 #include "fft.h"
 #include "db.h"
+#include "fastmath.h"
 #include <QDebug>
 
-//Forward declarations of supported subclasses in Factory
-#include "fftw.h"
-#include "fftcute.h"
-#include "fftooura.h"
-#include "fftaccelerate.h"
+#include "fftregistry.h"
 
 FFT::FFT()
 {
@@ -19,6 +16,7 @@ FFT::FFT()
 	m_windowFunction = NULL;
 
 	m_fftParamsSet = false; //Only set to true in FFT::FFTParams(...)
+	m_minSize = m_minFFTSize;
 
 	m_fftPower = NULL;
 	m_fftAmplitude = NULL;
@@ -44,24 +42,16 @@ FFT::~FFT()
 
 FFT* FFT::factory(QString _label)
 {
-	FFT *fft = NULL;
-#if defined USE_FFTW
-	qDebug()<<"Using FFTW for "<<_label;
-	fft = new FFTfftw();
-#elif defined USE_FFTCUTE
-	qDebug()<<"Using FFT CUTE for "<<_label;
-	fft = new CFft();
-#elif defined USE_FFTOOURA
-	qDebug()<<"Using FFT Ooura for "<<_label;
-	fft = new FFTOoura();
-#elif defined USE_FFTACCELERATE
-	qDebug()<<"Using FFT Accelerate for "<<_label;
-	fft = new FFTAccelerate();
-#else
-	qDebug()<<"Error in FFT configuration";
-#endif
+	FFTRegistry::Backend backend = FFTRegistry::defaultBackend();
+	qDebug()<<"Using"<<FFTRegistry::name(backend)<<"for"<<_label;
+	return FFTRegistry::create(backend);
+}
 
-	return fft;
+FFT* FFT::factory(QString _label, quint32 _fftSize, Direction _direction)
+{
+	FFTRegistry::Backend backend = FFTRegistry::backendFor(_fftSize, _direction);
+	qDebug()<<"Using"<<FFTRegistry::name(backend)<<"for"<<_label<<_fftSize;
+	return FFTRegistry::create(backend);
 }
 
 void FFT::fftParams(quint32 _fftSize, double _dBCompensation, double _sampleRate, int _samplesPerBuffer,
@@ -71,8 +61,8 @@ void FFT::fftParams(quint32 _fftSize, double _dBCompensation, double _sampleRate
 
 	if (_fftSize == 0)
         return; //Error
-	else if( _fftSize < m_minFFTSize )
-		m_fftSize = m_minFFTSize;
+	else if( _fftSize < m_minSize )
+		m_fftSize = m_minSize;
 	else if( _fftSize > m_maxFFTSize )
 		m_fftSize = m_maxFFTSize;
     else
@@ -233,9 +223,12 @@ void FFT::freqDomainToMagnitude(CPX * freqBuf, double baseline, double correctio
     //convert magnitude to a log scale (dB) (magnitude_dB = 20*log10(magnitude))
 
 	m_unfoldInOrder(freqBuf,m_workingBuf);
-	for (int i=0; i<m_fftSize; i++) {
-		fbr[i] = DB::powerTodB(DB::power(m_workingBuf[i]) + baseline) + correction;
-	}
+	FastMath::powerArray(m_workingBuf, fbr, m_fftSize);
+	for (int i=0; i<m_fftSize; i++)
+		fbr[i] += baseline;
+	FastMath::powerToDbArray(fbr, fbr, m_fftSize);
+	for (int i=0; i<m_fftSize; i++)
+		fbr[i] += correction;
 }
 
 //Utility to handle overlap/add using FFT buffers
@@ -329,8 +322,6 @@ void FFT::calcPowerAverages(CPX* in, double *out, int numSamples)
     //This is called from code that is locked with fftMutex, don't re-lock or will hang
 	double binPower;
 	double binAmp;
-	double binPowerdB;
-	double binAmpdB;
 	double psd;
 	double asd;
 
@@ -345,10 +336,12 @@ void FFT::calcPowerAverages(CPX* in, double *out, int numSamples)
 	//Some texts say Accelerate fft results are in polar notation (re = mag and im = phase)
 	//But analyzing results shows that re varies +/-, so it can't be magnitude
 
+	//Amplitude of every bin at once, out is scratch until the dB conversion at the end
+	FastMath::magArray(in, out, numSamples);
 	for( int i = 0; i < numSamples; i++){
 		//Amplitude Spectral Density
 		//fft output is in amplitude, so calculate that first
-		asd = DB::amplitude(in[i]) / m_windowFunction->coherentGain;
+		asd = out[i] / m_windowFunction->coherentGain;
 		//Power Spectral Density
 		//calculate power based on amplitude
 		psd = DB::amplitudeToPower(asd);
@@ -388,14 +381,13 @@ void FFT::calcPowerAverages(CPX* in, double *out, int numSamples)
 		m_fftPower[i] = psd;
 		m_fftAmplitude[i] = asd;
 
-		binPowerdB = DB::clip(DB::powerTodB(binPower));
-		binAmpdB = DB::clip(DB::amplitudeTodB(binAmp));
-
 		//Todo: UI to switch between amplitude and power spectrum?
-		out[i] = binAmpdB;
-		//out[i] = binPowerdB;
+		//Power would be binPower here and powerToDbArray() below
+		out[i] = binAmp;
 
     }
+	Q_UNUSED(binPower);
+	FastMath::amplitudeToDbArray(out, out, numSamples, true);
 }
 
 #if 0
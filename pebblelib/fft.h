@@ -8,18 +8,33 @@
 #include "QMutex"
 #include "windowfunction.h"
 
+//USE_FFTxxx (pebbleqt.pri) is the default backend, HAVE_FFTxxx means it's compiled in.  Cute and Ooura always are
+#if defined USE_FFTW && !defined HAVE_FFTW
+#define HAVE_FFTW
+#endif
+#if defined USE_FFTACCELERATE && !defined HAVE_FFTACCELERATE
+#define HAVE_FFTACCELERATE
+#endif
+
 //New base class for multiple FFT variations
 //This will eventually let us switch usage or at least document the various options
 //Code will eventually go back to using FFT everywhere, including imported code from other projects
 class PEBBLELIBSHARED_EXPORT FFT
 {
 public:
+	//What a call site uses the fft for, backends are timed separately for each, see FFTRegistry
+	enum Direction {FORWARD = 1, INVERSE = 2, BOTH = 3};
+
     FFT();
     virtual ~FFT();
 	static FFT* factory(QString _label); //Returns instance based on USE_FFT, USE_FFTCUTE, etc
+	//Fastest backend for this size and direction on this machine, falls back to factory(_label)
+	static FFT* factory(QString _label, quint32 _fftSize, Direction _direction);
 
 	const quint32 m_maxFFTSize = 65535;
-	const quint32 m_minFFTSize = 2048;
+	static const quint32 m_minFFTSize = 2048; //Static so callers can size before creating an instance
+	//CFastFIR partitions (low latency profile) need their exact size, see setMinFFTSize()
+	static const quint32 m_minPartitionFFTSize = 64;
 	//Maximum value of input samples -1 to +1
 	const double m_ampMax = 1.0;
 	const double m_overLimit = 0.9;	//limit for detecting over ranging inputs
@@ -28,6 +43,8 @@ public:
     //cutesdr usage
 	virtual void fftParams(quint32 _fftSize, double _dBCompensation, double _sampleRate, int _samplesPerBuffer,
 						   WindowFunction::WINDOWTYPE _windowType);
+	//Before fftParams(), lowers the m_minFFTSize floor for this instance, not below m_minPartitionFFTSize
+	void setMinFFTSize(quint32 _minFFTSize) {m_minSize = qMax(_minFFTSize, m_minPartitionFFTSize);}
     //Reset to init state, same parameters
 	virtual void resetFFT();
 
@@ -70,6 +87,7 @@ protected:
 	bool m_fftParamsSet; //Use to make sure base class calls FFT to init variables
 
 	qint32 m_fftSize;
+	quint32 m_minSize; //Smaller sizes are rounded up in fftParams(), m_minFFTSize unless setMinFFTSize()
 	double m_sampleRate;
 	double m_binWidth;
 
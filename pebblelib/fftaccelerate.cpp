@@ -1,4 +1,5 @@
 #include "fftaccelerate.h"
+#ifdef HAVE_FFTACCELERATE
 
 FFTAccelerate::FFTAccelerate() : FFT()
 {
@@ -117,3 +118,4 @@ bool FFTAccelerate::fftSpectrum(CPX *in, double *out, int numSamples)
 	return m_isOverload;
 
 }
+#endif // HAVE_FFTACCELERATE
@@ -4,6 +4,7 @@
 #include "gpl.h"
 
 #include "fft.h"
+#ifdef HAVE_FFTACCELERATE
 #include <Accelerate/Accelerate.h>
 
 //Mac only FFT library using Accelerate DSP library
@@ -30,5 +31,6 @@ private:
 	DSPDoubleSplitComplex splitComplex;
 	DSPDoubleSplitComplex splitComplexTemp; //For faster FFT
 };
+#endif // HAVE_FFTACCELERATE
 
 #endif // FFTACCELERATE_H
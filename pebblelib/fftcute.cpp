@@ -207,7 +207,10 @@ void CFft::fftForward(CPX * in, CPX * out, int numSamples)
     bitrv2(m_fftSize*2, m_pWorkArea + 2, (TYPEREAL*)m_workingBuf);
     CpxFFT(m_fftSize*2, (TYPEREAL*)m_workingBuf, m_pSinCosTbl);
 
-	copyCPX(m_freqDomain,m_workingBuf,m_fftSize) ;
+	//Swap back.  CpxFFT is exp(+j), swapping I/Q on both sides makes it exp(-j), same result as FFTW
+	//Swapping only the input gave the right magnitudes but not phase, which broke FFT convolution (CFastFIR)
+	for (int i=0; i<m_fftSize; i++)
+		m_freqDomain[i] = CPX(m_workingBuf[i].imag(), m_workingBuf[i].real());
 
     //If out == NULL, just leave result in freqDomain buffer and let caller get it
     if (out != NULL)
@@ -260,13 +263,15 @@ void CFft::fftInverse(CPX * in, CPX * out, int numSamples)
 
 	}
 	//Ooura is inplace, so copy to working dir so freqdomain is intact
-	copyCPX(m_workingBuf,m_freqDomain,m_fftSize);
+	//I/Q swapped on the way in and out like fftForward(), so inverse(forward(x)) == N*x
+	for (int i=0; i<m_fftSize; i++)
+		m_workingBuf[i] = CPX(m_freqDomain[i].imag(), m_freqDomain[i].real());
 
     bitrv2conj(m_fftSize*2, m_pWorkArea + 2, (TYPEREAL*)m_workingBuf);
 	cftbsub(m_fftSize*2, (TYPEREAL*)m_workingBuf, m_pSinCosTbl);
 
-    //in and out are same buffer so we need to copy to freqDomain buffer to be consistent
-	copyCPX(m_timeDomain, m_workingBuf, m_fftSize);
+	for (int i=0; i<m_fftSize; i++)
+		m_timeDomain[i] = CPX(m_workingBuf[i].imag(), m_workingBuf[i].real());
 
     if (out != NULL)
 		copyCPX(out, m_timeDomain, m_fftSize);
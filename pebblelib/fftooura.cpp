@@ -74,25 +74,16 @@ void FFTOoura::fftForward(CPX *in, CPX *out, int numSamples)
     if (!m_fftParamsSet)
         return;
 
-	if (in!=NULL) {
-
+	if (in!=NULL)
 		m_applyWindow(in,numSamples);
 
-		//CuteSDR swapped I/Q here
-		//11/14 Spectrum is reversed compared to FFTW, so IQ swap is necessary
-		double tmp;
-		for (int i=0; i<m_fftSize; i++) {
-			tmp = m_timeDomain[i].real();
-			m_timeDomain[i].real(m_timeDomain[i].imag());
-			m_timeDomain[i].imag(tmp);
-		}
-
-	}
 	//Ooura is inplace, so copy to working dir so timedomain is intact
 	copyCPX(m_workingBuf,m_timeDomain,m_fftSize);
 
 	//Size is 2x fftSize because offt works on double[] re-im-re-im etc
-	cdft(2*m_fftSize, +1, (double*)m_workingBuf, offtWorkArea, offtSinCosTable);
+	//-1 is exp(-j), same as FFTW_FORWARD.  Used to be +1 with I/Q swapped on input, which matched FFTW's
+	//magnitudes but not phase, so FFT convolution (CFastFIR) came out conjugated
+	cdft(2*m_fftSize, -1, (double*)m_workingBuf, offtWorkArea, offtSinCosTable);
 
 	copyCPX(m_freqDomain,m_workingBuf,m_fftSize) ;
 
@@ -134,7 +125,7 @@ void FFTOoura::fftInverse(CPX *in, CPX *out, int numSamples)
 	copyCPX(m_workingBuf,m_freqDomain,m_fftSize);
 
     //Size is 2x fftSize because offt works on double[] re-im-re-im et
-	cdft(2*m_fftSize, -1, (double*)m_workingBuf, offtWorkArea, offtSinCosTable);
+	cdft(2*m_fftSize, +1, (double*)m_workingBuf, offtWorkArea, offtSinCosTable);
 
 	copyCPX(m_timeDomain, m_workingBuf, m_fftSize);
 
@@ -0,0 +1,285 @@
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "fftregistry.h"
+#include <QElapsedTimer>
+#include <QDebug>
+#include <algorithm>
+
+#include "fftw.h"
+#include "fftcute.h"
+#include "fftooura.h"
+#include "fftaccelerate.h"
+
+QMutex FFTRegistry::s_mutex;
+QHash<quint32, FFTRegistry::Result> FFTRegistry::s_results;
+bool FFTRegistry::s_autoTune = true;
+
+bool FFTRegistry::isAvailable(Backend _backend)
+{
+	switch (_backend) {
+		case FFTW:
+#ifdef HAVE_FFTW
+			return true;
+#else
+			return false;
+#endif
+		case CUTE:
+		case OOURA:
+			return true;
+		case ACCELERATE:
+#ifdef HAVE_FFTACCELERATE
+			return true;
+#else
+			return false;
+#endif
+		default:
+			return false;
+	}
+}
+
+QString FFTRegistry::name(Backend _backend)
+{
+	switch (_backend) {
+		case FFTW: return "FFTW";
+		case CUTE: return "Cute";
+		case OOURA: return "Ooura";
+		case ACCELERATE: return "Accelerate";
+		default: return "Unknown";
+	}
+}
+
+FFTRegistry::Backend FFTRegistry::backendByName(QString _name)
+{
+	for (int i = 0; i < NUM_BACKENDS; i++) {
+		if (name((Backend)i) == _name)
+			return (Backend)i;
+	}
+	return NUM_BACKENDS;
+}
+
+FFTRegistry::Backend FFTRegistry::defaultBackend()
+{
+#if defined USE_FFTW
+	return FFTW;
+#elif defined USE_FFTCUTE
+	return CUTE;
+#elif defined USE_FFTOOURA
+	return OOURA;
+#elif defined USE_FFTACCELERATE
+	return ACCELERATE;
+#else
+	//Ooura is always compiled in
+	qDebug()<<"Error in FFT configuration, using Ooura";
+	return OOURA;
+#endif
+}
+
+FFT *FFTRegistry::create(Backend _backend)
+{
+	switch (_backend) {
+#ifdef HAVE_FFTW
+		case FFTW: return new FFTfftw();
+#endif
+		case CUTE: return new CFft();
+		case OOURA: return new FFTOoura();
+#ifdef HAVE_FFTACCELERATE
+		case ACCELERATE: return new FFTAccelerate();
+#endif
+		default:
+			qDebug()<<"FFT backend"<<name(_backend)<<"is not available";
+			return NULL;
+	}
+}
+
+void FFTRegistry::setAutoTune(bool _on)
+{
+	QMutexLocker locker(&s_mutex);
+	s_autoTune = _on;
+}
+
+bool FFTRegistry::autoTune()
+{
+	QMutexLocker locker(&s_mutex);
+	return s_autoTune;
+}
+
+FFTRegistry::Backend FFTRegistry::backendFor(quint32 _fftSize, FFT::Direction _direction)
+{
+	QMutexLocker locker(&s_mutex);
+	if (!s_autoTune)
+		return defaultBackend();
+	quint32 k = key(_fftSize, _direction);
+	if (!s_results.contains(k))
+		s_results.insert(k, calibrate(_fftSize, _direction));
+	return s_results.value(k).winner;
+}
+
+//Called with s_mutex locked
+FFTRegistry::Result FFTRegistry::calibrate(quint32 _fftSize, FFT::Direction _direction)
+{
+	Result result;
+	result.winner = defaultBackend();
+	CPX *in = memalign(_fftSize);
+	CPX *out = memalign(_fftSize);
+	//Same noise every time, so results only depend on the backend
+	quint32 seed = 12345;
+	for (quint32 i = 0; i < _fftSize; i++) {
+		seed = seed * 1664525 + 1013904223;
+		double re = (seed >> 8) / 16777216.0 - 0.5;
+		seed = seed * 1664525 + 1013904223;
+		double im = (seed >> 8) / 16777216.0 - 0.5;
+		in[i] = CPX(re, im);
+	}
+
+	double best = -1;
+	FFT *fft;
+	QElapsedTimer timer;
+	quint32 reps;
+	for (int b = 0; b < NUM_BACKENDS; b++) {
+		result.nsPerCall[b] = -1;
+		if (!isAvailable((Backend)b))
+			continue;
+		fft = create((Backend)b);
+		if (fft == NULL)
+			continue;
+		//Times the size asked for, CFastFIR partitions can be below FFT::m_minFFTSize
+		fft->setMinFFTSize(_fftSize);
+		fft->fftParams(_fftSize, 0, _fftSize, _fftSize, WindowFunction::NONE);
+		if ((quint32)fft->getFFTSize() != _fftSize || !check(fft, _fftSize, _direction, in, out)) {
+			qDebug()<<"FFT"<<name((Backend)b)<<"failed check at"<<_fftSize<<directionName(_direction);
+			delete fft;
+			continue;
+		}
+		//check() was the warm up
+		reps = 0;
+		timer.start();
+		do {
+			if (_direction & FFT::FORWARD)
+				fft->fftForward(in, out, _fftSize);
+			if (_direction & FFT::INVERSE)
+				fft->fftInverse(in, out, _fftSize);
+			reps++;
+		} while (timer.elapsed() < c_calibrateMs);
+		result.nsPerCall[b] = (double)timer.nsecsElapsed() / reps;
+		delete fft;
+
+		if (best < 0 || result.nsPerCall[b] < best) {
+			best = result.nsPerCall[b];
+			result.winner = (Backend)b;
+		}
+	}
+	free (in);
+	free (out);
+	qDebug()<<"FFT calibration"<<_fftSize<<directionName(_direction)<<"using"<<name(result.winner);
+	return result;
+}
+
+//Direct DFT of a few bins.  Forward is exp(-j) unscaled, inverse exp(+j) unscaled, same as FFTW
+bool FFTRegistry::check(FFT *_fft, quint32 _fftSize, FFT::Direction _direction, CPX *_in, CPX *_out)
+{
+	const quint32 bins[c_numCheckBins] = {1, _fftSize / 3, _fftSize / 2 + 1, _fftSize - 1};
+	//Rounding error is many orders below this, a sign or scale error is about sqrt(N)
+	const double tolerance = 1.0e-6 * _fftSize;
+	double sign;
+	CPX ref;
+	for (int d = FFT::FORWARD; d <= FFT::INVERSE; d <<= 1) {
+		if (!(_direction & d))
+			continue;
+		if (d == FFT::FORWARD) {
+			_fft->fftForward(_in, _out, _fftSize);
+			sign = -1;
+		} else {
+			_fft->fftInverse(_in, _out, _fftSize);
+			sign = 1;
+		}
+		for (quint32 i = 0; i < c_numCheckBins; i++) {
+			ref = 0;
+			for (quint32 n = 0; n < _fftSize; n++)
+				ref += _in[n] * std::polar(1.0, sign * TWOPI * ((quint64)bins[i] * n % _fftSize) / _fftSize);
+			if (std::abs(_out[bins[i]] - ref) > tolerance)
+				return false;
+		}
+	}
+	return true;
+}
+
+QString FFTRegistry::directionName(FFT::Direction _direction)
+{
+	switch (_direction) {
+		case FFT::FORWARD: return "Forward";
+		case FFT::INVERSE: return "Inverse";
+		default: return "Both";
+	}
+}
+
+//size,direction,winner,ns per call for each backend (-1 = n/a)
+QStringList FFTRegistry::results()
+{
+	QMutexLocker locker(&s_mutex);
+	QStringList list;
+	QString str;
+	foreach (quint32 k, s_results.keys()) {
+		Result r = s_results.value(k);
+		str = QString("%1,%2,%3").arg(k / 4).arg(directionName((FFT::Direction)(k % 4))).arg(name(r.winner));
+		for (int b = 0; b < NUM_BACKENDS; b++)
+			str += QString(",%1").arg(r.nsPerCall[b], 0, 'f', 0);
+		list.append(str);
+	}
+	return list;
+}
+
+void FFTRegistry::setResults(QStringList _results)
+{
+	QMutexLocker locker(&s_mutex);
+	QStringList fields;
+	Result r;
+	quint32 size;
+	int dir;
+	foreach (QString str, _results) {
+		fields = str.split(',');
+		if (fields.count() != 3 + NUM_BACKENDS)
+			continue;
+		size = fields[0].toUInt();
+		for (dir = FFT::FORWARD; dir <= FFT::BOTH; dir++) {
+			if (directionName((FFT::Direction)dir) == fields[1])
+				break;
+		}
+		r.winner = backendByName(fields[2]);
+		//Settings from another build or machine, calibrate again
+		if (size == 0 || dir > FFT::BOTH || r.winner == NUM_BACKENDS || !isAvailable(r.winner))
+			continue;
+		for (int b = 0; b < NUM_BACKENDS; b++)
+			r.nsPerCall[b] = fields[3 + b].toDouble();
+		s_results.insert(key(size, (FFT::Direction)dir), r);
+	}
+}
+
+void FFTRegistry::clearResults()
+{
+	QMutexLocker locker(&s_mutex);
+	s_results.clear();
+}
+
+QString FFTRegistry::report()
+{
+	QMutexLocker locker(&s_mutex);
+	QString str = "FFT backends:";
+	for (int b = 0; b < NUM_BACKENDS; b++) {
+		if (isAvailable((Backend)b))
+			str += " " + name((Backend)b);
+	}
+	str += QString(", default %1, auto tune %2\n").arg(name(defaultBackend())).arg(s_autoTune ? "on" : "off");
+
+	QList<quint32> keys = s_results.keys();
+	std::sort(keys.begin(), keys.end());
+	foreach (quint32 k, keys) {
+		Result r = s_results.value(k);
+		str += QString("%1 %2 %3:").arg(k / 4).arg(directionName((FFT::Direction)(k % 4))).arg(name(r.winner));
+		for (int b = 0; b < NUM_BACKENDS; b++) {
+			if (r.nsPerCall[b] >= 0)
+				str += QString(" %1 %2us").arg(name((Backend)b)).arg(r.nsPerCall[b] / 1000.0, 0, 'f', 1);
+		}
+		str += "\n";
+	}
+	return str;
+}
@@ -0,0 +1,72 @@
+#ifndef FFTREGISTRY_H
+#define FFTREGISTRY_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "fft.h"
+#include <QMutex>
+#include <QHash>
+#include <QStringList>
+
+/*
+	Run time choice of FFT backend
+
+	Every backend compiled in (HAVE_FFTxxx, see fft.h) is available.  Which one is fastest depends on size and
+	CPU, ie Ooura is often faster for small CFastFIR sizes and FFTW for large spectrum sizes, so the first time a
+	call site asks for a (size, direction) with FFT::factory(label, size, direction) each backend is timed and
+	the winner is used from then on.  Results are kept in pebble.ini (see Settings) so this only happens once
+	per machine, delete the [FFT] group to re-run it.
+
+	Calibration
+		Each backend is first checked against a direct DFT of a few bins, forward and inverse, so a backend with
+		a different sign or scaling convention can never be picked for convolution
+		Then timed for at least c_calibrateMs, FORWARD is fftForward(), INVERSE fftInverse(), BOTH one of each
+		Takes a few 10s of ms per size, on whatever thread constructs the FFT, normally power on
+
+	FFT::factory(label) without a size still returns the compile time default, USE_FFTxxx
+	Thread safe
+*/
+class PEBBLELIBSHARED_EXPORT FFTRegistry
+{
+public:
+	enum Backend {FFTW, CUTE, OOURA, ACCELERATE, NUM_BACKENDS};
+
+	static const quint32 c_calibrateMs = 20; //Minimum time per backend per (size, direction)
+	static const quint32 c_numCheckBins = 4; //Compared to direct DFT
+
+	static bool isAvailable(Backend _backend);
+	static QString name(Backend _backend);
+	static Backend defaultBackend();
+	static FFT *create(Backend _backend);
+
+	//Calibrates the first time a (size, direction) is asked for
+	static Backend backendFor(quint32 _fftSize, FFT::Direction _direction);
+	//Off = always defaultBackend(), for comparing
+	static void setAutoTune(bool _on);
+	static bool autoTune();
+
+	//Persisted winners and times, one string per (size, direction), see Settings
+	static QStringList results();
+	static void setResults(QStringList _results);
+	static void clearResults();
+
+	//Multi line table for the about box
+	static QString report();
+
+private:
+	struct Result {
+		Backend winner;
+		double nsPerCall[NUM_BACKENDS]; //< 0 not available or failed the DFT check
+	};
+
+	static QMutex s_mutex;
+	static QHash<quint32, Result> s_results; //key()
+	static bool s_autoTune;
+
+	static quint32 key(quint32 _fftSize, FFT::Direction _direction) {return _fftSize * 4 + _direction;}
+	static Result calibrate(quint32 _fftSize, FFT::Direction _direction);
+	static bool check(FFT *_fft, quint32 _fftSize, FFT::Direction _direction, CPX *_in, CPX *_out);
+	static QString directionName(FFT::Direction _direction);
+	static Backend backendByName(QString _name);
+};
+
+#endif // FFTREGISTRY_H
@@ -1,6 +1,7 @@
 //GPL license and attributions are in gpl.h and terms are included in this file by reference
 #include "gpl.h"
 #include "fftw.h"
+#ifdef HAVE_FFTW
 
 FFTfftw::FFTfftw() : FFT()
 {
@@ -79,6 +80,4 @@ bool FFTfftw::fftSpectrum(CPX *in, double *out, int numSamples)
 
 	return m_isOverload;
 }
-
-
-
+#endif // HAVE_FFTW
@@ -5,6 +5,7 @@
 
 #include "fft.h"
 #include "cpx.h"
+#ifdef HAVE_FFTW
 #include "../fftw-3.3.4/api/fftw3.h"
 
 class PEBBLELIBSHARED_EXPORT FFTfftw : public FFT
@@ -24,6 +25,6 @@ private:
     CPX *buf;
     int half_sz;
 };
-
+#endif // HAVE_FFTW
 
 #endif // FFTW_H
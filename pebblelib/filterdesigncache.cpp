@@ -0,0 +1,52 @@
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "filterdesigncache.h"
+
+QMutex FilterDesignCache::s_mutex;
+QList<QSharedPointer<FilterDesign>> FilterDesignCache::s_designs;
+quint32 FilterDesignCache::s_hits = 0;
+quint32 FilterDesignCache::s_misses = 0;
+
+FilterDesign::FilterDesign(const FilterDesignKey &_key) :
+	key(_key)
+{
+	coef = memalign(key.fftSize);
+	clearCPX(coef, key.fftSize);
+}
+
+FilterDesign::~FilterDesign()
+{
+	free(coef);
+}
+
+QSharedPointer<FilterDesign> FilterDesignCache::find(const FilterDesignKey &_key)
+{
+	QMutexLocker locker(&s_mutex);
+	for (int i = 0; i < s_designs.count(); i++) {
+		if (s_designs[i]->key == _key) {
+			s_hits++;
+			if (i > 0)
+				s_designs.move(i, 0);
+			return s_designs[0];
+		}
+	}
+	s_misses++;
+	return QSharedPointer<FilterDesign>();
+}
+
+void FilterDesignCache::insert(QSharedPointer<FilterDesign> _design)
+{
+	if (_design.isNull())
+		return;
+	QMutexLocker locker(&s_mutex);
+	s_designs.prepend(_design);
+	//Anyone still using an evicted design holds a reference to it
+	while (s_designs.count() > c_maxDesigns)
+		s_designs.removeLast();
+}
+
+void FilterDesignCache::clear()
+{
+	QMutexLocker locker(&s_mutex);
+	s_designs.clear();
+}
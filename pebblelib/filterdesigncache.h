@@ -0,0 +1,64 @@
+#ifndef FILTERDESIGNCACHE_H
+#define FILTERDESIGNCACHE_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "cpx.h"
+#include <QMutex>
+#include <QList>
+#include <QSharedPointer>
+
+/*
+	Frequency domain FIR designs, most recently used first
+
+	Dragging the filter edges or switching modes goes back and forth over the same few (low, high) pairs, so each
+	design (windowed sinc + forward FFT, see CFastFIR) is kept and re-used instead of being recalculated.
+	Designs are shared, a CFastFIR keeps a reference to the one it's using so eviction never frees coefficients
+	that are still being multiplied.  Least recently used design is dropped after c_maxDesigns.
+
+	Thread safe
+*/
+struct FilterDesignKey {
+	double low; //Hz, CW offset already added
+	double high;
+	double sampleRate;
+	quint32 fftSize;
+	quint32 firSize;
+	int window; //Window id of whoever designed it, ie CFastFIR::Window
+
+	bool operator==(const FilterDesignKey &_other) const {
+		return low == _other.low && high == _other.high && sampleRate == _other.sampleRate &&
+			fftSize == _other.fftSize && firSize == _other.firSize && window == _other.window;
+	}
+};
+
+class PEBBLELIBSHARED_EXPORT FilterDesign
+{
+public:
+	FilterDesign(const FilterDesignKey &_key);
+	~FilterDesign();
+
+	const FilterDesignKey key;
+	CPX *coef; //key.fftSize frequency domain coefficients, scaled by 1/fftSize for the inverse FFT
+};
+
+class PEBBLELIBSHARED_EXPORT FilterDesignCache
+{
+public:
+	static const int c_maxDesigns = 32; //2048 point designs are 32k each
+
+	//NULL if not cached.  A hit becomes the most recently used
+	static QSharedPointer<FilterDesign> find(const FilterDesignKey &_key);
+	static void insert(QSharedPointer<FilterDesign> _design);
+	static void clear();
+
+	static quint32 hits() {return s_hits;}
+	static quint32 misses() {return s_misses;}
+
+private:
+	static QMutex s_mutex;
+	static QList<QSharedPointer<FilterDesign>> s_designs; //Most recently used first
+	static quint32 s_hits;
+	static quint32 s_misses;
+};
+
+#endif // FILTERDESIGNCACHE_H
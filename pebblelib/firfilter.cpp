@@ -93,9 +93,9 @@ FIRFilter::FIRFilter(int sr, int ns, bool _useFFT, int _numTaps, int _delay)
 		//to avoid circular convolution.
 		//Circular convolution appears as a ghost signal that does not show up in the spectrum at the
 		//mirror frequency of a signal in the lower part of the spectrum
-		fftFIR = FFT::factory("FIR");
+		fftFIR = FFT::factory("FIR", numSamplesX2, FFT::FORWARD);
 		fftFIR->fftParams(numSamplesX2, 0, sr, numSamples, WindowFunction::NONE);
-		fftSamples = FFT::factory("FIR samples");
+		fftSamples = FFT::factory("FIR samples", numSamplesX2, FFT::BOTH);
 		fftSamples->fftParams(numSamplesX2, 0, sr, numSamples, WindowFunction::NONE);
 
 		//Time domain FIR coefficients
@@ -0,0 +1,428 @@
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "freqdomainfrontend.h"
+#include <QDebug>
+
+FreqDomainFrontEnd::FreqDomainFrontEnd(quint32 _sampleRate, quint32 _outputRate, quint32 _framesPerBuffer)
+{
+	m_isValid = false;
+	m_sampleRate = _sampleRate;
+	m_outputRate = _outputRate;
+	m_decimateFactor = 1;
+	m_fftSize = 0;
+	m_numKept = 0;
+	m_overlap = 0;
+	m_hop = 0;
+	m_firstValid = 0;
+	m_fft = NULL;
+	m_fftDesign = NULL;
+	m_fftConjugates = false;
+	m_fftReversed = false;
+	m_fftScale = 1;
+	m_inBuf = NULL;
+	m_inPos = 0;
+	m_freqDomain = NULL;
+	m_workBuf = NULL;
+	m_designBuf = NULL;
+	m_designFreq = NULL;
+	m_twiddle = NULL;
+	m_bitReverse = NULL;
+	m_designWindow = NULL;
+	m_fifoSize = 0;
+
+	if (_outputRate == 0 || _outputRate > _sampleRate || _sampleRate % _outputRate != 0) {
+		qDebug()<<"FreqDomainFrontEnd: output rate "<<_outputRate<<" is not an integer fraction of "<<_sampleRate;
+		return;
+	}
+	m_decimateFactor = _sampleRate / _outputRate;
+	if ((m_decimateFactor & (m_decimateFactor - 1)) != 0) {
+		qDebug()<<"FreqDomainFrontEnd: decimate factor "<<m_decimateFactor<<" is not a power of 2";
+		return;
+	}
+	//At least 2 blocks of input, and enough bins left after decimation for sharp filters
+	m_fftSize = FFT::m_minFFTSize;
+	while (m_fftSize < c_maxFFTSize && (m_fftSize < 2 * _framesPerBuffer ||
+			m_fftSize < c_minKeptBins * m_decimateFactor))
+		m_fftSize *= 2;
+
+	//Both only ever go forward, inverse is done on the kept bins
+	m_fft = FFT::factory("Freq domain front end", m_fftSize, FFT::FORWARD);
+	m_fftDesign = FFT::factory("Freq domain front end filter design", m_fftSize, FFT::FORWARD);
+	if (m_fft == NULL || m_fftDesign == NULL)
+		return;
+	m_numKept = m_fftSize / m_decimateFactor;
+	if (m_numKept < c_minUsableBins) {
+		qDebug()<<"FreqDomainFrontEnd: decimate factor "<<m_decimateFactor<<" too large for fft size "<<m_fftSize;
+		return;
+	}
+	m_overlap = m_fftSize / 4;
+	m_hop = m_fftSize - m_overlap;
+	m_firstValid = m_overlap / m_decimateFactor;
+
+	m_fft->fftParams(m_fftSize, 0, m_sampleRate, m_fftSize, WindowFunction::NONE);
+	m_fftDesign->fftParams(m_fftSize, 0, m_sampleRate, m_fftSize, WindowFunction::NONE);
+	if ((quint32)m_fft->getFFTSize() != m_fftSize) {
+		qDebug()<<"FreqDomainFrontEnd: fft size "<<m_fftSize<<" not supported";
+		return;
+	}
+
+	m_inBuf = memalign(m_fftSize);
+	m_freqDomain = memalign(m_fftSize);
+	m_designBuf = memalign(m_fftSize);
+	m_designFreq = memalign(m_fftSize);
+	m_workBuf = memalign(m_numKept);
+	clearCPX(m_freqDomain, m_fftSize);
+
+	//Worst case output is one frame waiting plus all the blocks one input buffer can complete
+	m_fifoSize = 2 * _framesPerBuffer + (_framesPerBuffer / m_hop + 2) * (m_hop / m_decimateFactor);
+
+	//Blackman-Nuttall, same as CFastFIR
+	quint32 numTaps = m_overlap + 1;
+	m_designWindow = new double[numTaps];
+	for (quint32 i = 0; i < numTaps; i++) {
+		m_designWindow[i] = 0.3635819
+			- 0.4891775 * cos((TWOPI * i) / (numTaps - 1))
+			+ 0.1365995 * cos((2.0 * TWOPI * i) / (numTaps - 1))
+			- 0.0106411 * cos((3.0 * TWOPI * i) / (numTaps - 1));
+	}
+
+	m_twiddle = memalign(m_numKept / 2);
+	for (quint32 i = 0; i < m_numKept / 2; i++)
+		m_twiddle[i] = std::polar(1.0, TWOPI * i / m_numKept);
+	quint32 numBits = 0;
+	while ((1u << numBits) < m_numKept)
+		numBits++;
+	m_bitReverse = new quint32[m_numKept];
+	for (quint32 i = 0; i < m_numKept; i++) {
+		quint32 r = 0;
+		for (quint32 b = 0; b < numBits; b++)
+			if (i & (1u << b))
+				r |= 1u << (numBits - 1 - b);
+		m_bitReverse[i] = r;
+	}
+
+	probeFFT();
+	m_isValid = true;
+	//Receiver's channel
+	addChannel(0);
+	reset();
+
+	qDebug()<<"FreqDomainFrontEnd: fft "<<m_fftSize<<" decimate "<<m_decimateFactor<<" kept bins "<<m_numKept;
+}
+
+FreqDomainFrontEnd::~FreqDomainFrontEnd()
+{
+	for (int i = 0; i < m_channels.count(); i++)
+		removeChannel(i);
+	if (m_fft != NULL)
+		delete m_fft;
+	if (m_fftDesign != NULL)
+		delete m_fftDesign;
+	if (m_inBuf != NULL) free(m_inBuf);
+	if (m_freqDomain != NULL) free(m_freqDomain);
+	if (m_workBuf != NULL) free(m_workBuf);
+	if (m_designBuf != NULL) free(m_designBuf);
+	if (m_designFreq != NULL) free(m_designFreq);
+	if (m_twiddle != NULL) free(m_twiddle);
+	if (m_bitReverse != NULL)
+		delete[] m_bitReverse;
+	if (m_designWindow != NULL)
+		delete[] m_designWindow;
+}
+
+//Filter is designed while process() keeps running, process() only waits for the swap
+void FreqDomainFrontEnd::setMixerFrequency(double _frequency, int _channel)
+{
+	if (!m_isValid)
+		return;
+	FilterDesign design;
+	m_designMutex.lock();
+	//Channels are only added and removed with m_designMutex, so ch stays valid
+	m_mutex.lock();
+	Channel *ch = channel(_channel);
+	m_mutex.unlock();
+	if (ch != NULL && _frequency != ch->mixerFrequency) {
+		designFilter(_frequency, ch->designBins, design);
+		m_mutex.lock();
+		applyFilter(ch, design);
+		m_mutex.unlock();
+	}
+	m_designMutex.unlock();
+}
+
+int FreqDomainFrontEnd::addChannel(double _mixerFrequency)
+{
+	if (!m_isValid)
+		return -1;
+	Channel *ch = new Channel();
+	ch->filterBins = memalign(m_numKept);
+	ch->designBins = memalign(m_numKept);
+	ch->outFifo = memalign(m_fifoSize);
+	ch->fifoLen = 0;
+	FilterDesign design;
+	m_designMutex.lock();
+	designFilter(_mixerFrequency, ch->designBins, design);
+	//Not in m_channels yet, process() can't see it
+	applyFilter(ch, design);
+	m_mutex.lock();
+	//Reuse a removed channel's slot so clients coming and going don't grow m_channels
+	int id = 0;
+	while (id < m_channels.count() && m_channels[id] != NULL)
+		id++;
+	if (id < m_channels.count())
+		m_channels[id] = ch;
+	else
+		m_channels.append(ch);
+	m_mutex.unlock();
+	m_designMutex.unlock();
+	return id;
+}
+
+void FreqDomainFrontEnd::removeChannel(int _channel)
+{
+	//Not while setMixerFrequency() is designing into it
+	m_designMutex.lock();
+	m_mutex.lock();
+	Channel *ch = channel(_channel);
+	if (ch != NULL)
+		m_channels[_channel] = NULL;
+	m_mutex.unlock();
+	m_designMutex.unlock();
+	if (ch == NULL)
+		return;
+	free(ch->filterBins);
+	free(ch->designBins);
+	free(ch->outFifo);
+	delete ch;
+}
+
+//Called with m_mutex locked, NULL if _channel was never added or has been removed
+FreqDomainFrontEnd::Channel *FreqDomainFrontEnd::channel(int _channel)
+{
+	if (_channel < 0 || _channel >= m_channels.count())
+		return NULL;
+	return m_channels[_channel];
+}
+
+void FreqDomainFrontEnd::reset()
+{
+	if (m_inBuf == NULL)
+		return;
+	m_mutex.lock();
+	//First block sees zeros as history, same as CFastFIR startup
+	clearCPX(m_inBuf, m_fftSize);
+	m_inPos = m_overlap;
+	foreach (Channel *ch, m_channels) {
+		if (ch != NULL) {
+			ch->fifoLen = 0;
+			ch->blockPhase = 0;
+		}
+	}
+	m_mutex.unlock();
+}
+
+void FreqDomainFrontEnd::process(const CPX *_in, quint32 _numSamples)
+{
+	if (!m_isValid)
+		return;
+	m_mutex.lock();
+	quint32 count;
+	while (_numSamples > 0) {
+		count = qMin(_numSamples, m_fftSize - m_inPos);
+		copyCPX(&m_inBuf[m_inPos], _in, count);
+		m_inPos += count;
+		_in += count;
+		_numSamples -= count;
+		if (m_inPos == m_fftSize) {
+			processBlock();
+			//Last N/4 samples are the history for the next block
+			copyCPX(m_inBuf, &m_inBuf[m_hop], m_overlap);
+			m_inPos = m_overlap;
+		}
+	}
+	m_mutex.unlock();
+}
+
+bool FreqDomainFrontEnd::takeFrame(CPX *_out, quint32 _numFrames, int _channel)
+{
+	m_mutex.lock();
+	Channel *ch = channel(_channel);
+	if (ch == NULL || ch->fifoLen < _numFrames) {
+		m_mutex.unlock();
+		return false;
+	}
+	copyCPX(_out, ch->outFifo, _numFrames);
+	ch->fifoLen -= _numFrames;
+	//Remainder is less than one block of output
+	memmove(ch->outFifo, &ch->outFifo[_numFrames], ch->fifoLen * sizeof(CPX));
+	m_mutex.unlock();
+	return true;
+}
+
+//Forward FFT implementations differ in sign convention, output order and CuteSDR/Ooura swap I/Q first,
+//which turns the transform into c * conj(DFT).  Probe with impulses so we can map any of them to a standard DFT
+void FreqDomainFrontEnd::probeFFT()
+{
+	CPX *fd = m_fft->getFreqDomain();
+
+	clearCPX(m_designBuf, m_fftSize);
+	m_designBuf[0] = CPX(1, 0);
+	m_fft->fftForward(m_designBuf, NULL, m_fftSize);
+	CPX c = fd[0];
+	m_designBuf[0] = CPX(0, 1);
+	m_fft->fftForward(m_designBuf, NULL, m_fftSize);
+	//Linear transform scales by j, conjugating transform by -j
+	m_fftConjugates = (fd[0] / c).imag() < 0;
+	m_fftScale = 1.0 / c;
+
+	//DFT of impulse at n=1 is e^(-j*2*pi*k/N)
+	m_designBuf[0] = 0;
+	m_designBuf[1] = CPX(1, 0);
+	m_fft->fftForward(m_designBuf, NULL, m_fftSize);
+	CPX v = fd[1] * m_fftScale;
+	if (m_fftConjugates)
+		v = std::conj(v);
+	m_fftReversed = v.imag() > 0;
+
+	qDebug()<<"FreqDomainFrontEnd: fft conjugates "<<m_fftConjugates<<" reversed "<<m_fftReversed;
+}
+
+void FreqDomainFrontEnd::forwardStandard(FFT *_fft, CPX *_in, CPX *_out)
+{
+	_fft->fftForward(_in, NULL, m_fftSize);
+	const CPX *raw = _fft->getFreqDomain();
+	const quint32 mask = m_fftSize - 1;
+	CPX v;
+	for (quint32 i = 0; i < m_fftSize; i++) {
+		v = (m_fftReversed ? raw[(m_fftSize - i) & mask] : raw[i]) * m_fftScale;
+		_out[i] = m_fftConjugates ? std::conj(v) : v;
+	}
+}
+
+//Filter edge has to stay inside the kept bins, Blackman-Nuttall main lobe is 4 bins of filter length either side
+//and the kept bins can be off center by 1/2 bin
+double FreqDomainFrontEnd::usableBandWidth()
+{
+	return m_outputRate / 2.0 - 4.0 * m_sampleRate / (m_overlap + 1) - (double)m_sampleRate / m_fftSize;
+}
+
+//Windowed sinc low pass like CFastFIR, shifted up to the mixer frequency, into _filterBins
+//Called with m_designMutex locked, not m_mutex.  Uses the forward FFT and design buffers, never channel state
+void FreqDomainFrontEnd::designFilter(double _mixerFrequency, CPX *_filterBins, FilterDesign &_design)
+{
+	double binWidth = (double)m_sampleRate / m_fftSize;
+	_design.mixerFrequency = _mixerFrequency;
+	_design.centerBin = qRound(_mixerFrequency / binWidth);
+	double residual = _mixerFrequency - _design.centerBin * binWidth;
+	_design.outputPhaseInc = -TWOPI * residual * m_decimateFactor / m_sampleRate;
+	_design.blockPhaseInc = fmod(-TWOPI * _mixerFrequency * m_hop / m_sampleRate, TWOPI);
+
+	quint32 numTaps = m_overlap + 1;
+	//Cutoff in the middle of the transition band, so pass band is flat to usableBandWidth()
+	double nFc = (usableBandWidth() + 2.0 * m_sampleRate / numTaps) / m_sampleRate;
+	double nMix = TWOPI * _mixerFrequency / m_sampleRate;
+	double center = 0.5 * (numTaps - 1);
+	double x;
+	double z;
+	double sum = 0;
+
+	clearCPX(m_designBuf, m_fftSize);
+	for (quint32 i = 0; i < numTaps; i++) {
+		x = (double)i - center;
+		if (x == 0)
+			z = 2.0 * nFc * m_designWindow[i];
+		else
+			z = sin(TWOPI * x * nFc) / (PI * x) * m_designWindow[i];
+		sum += z;
+		//Mixer shift is relative to block start, see channel math in processBlock()
+		m_designBuf[i] = z * std::polar(1.0, nMix * i);
+	}
+	forwardStandard(m_fftDesign, m_designBuf, m_designFreq);
+
+	//Unity gain in pass band, and 1/N for the inverse FFT
+	double scale = 1.0 / (sum * m_fftSize);
+	const quint32 mask = m_fftSize - 1;
+	const qint32 half = m_numKept / 2;
+	qint32 offset;
+	for (qint32 i = 0; i < (qint32)m_numKept; i++) {
+		offset = i < half ? i : i - (qint32)m_numKept;
+		_filterBins[i] = m_designFreq[(quint32)(_design.centerBin + offset) & mask] * scale;
+	}
+}
+
+//Called with m_mutex locked if the channel is in m_channels.  designBins has the new filter, old one becomes spare
+void FreqDomainFrontEnd::applyFilter(Channel *_channel, const FilterDesign &_design)
+{
+	std::swap(_channel->filterBins, _channel->designBins);
+	_channel->mixerFrequency = _design.mixerFrequency;
+	_channel->centerBin = _design.centerBin;
+	_channel->blockPhaseInc = _design.blockPhaseInc;
+	_channel->outputPhaseInc = _design.outputPhaseInc;
+	_channel->blockPhase = 0;
+}
+
+//Called with m_mutex locked
+void FreqDomainFrontEnd::processBlock()
+{
+	forwardStandard(m_fft, m_inBuf, m_freqDomain);
+	foreach (Channel *ch, m_channels) {
+		if (ch != NULL)
+			processChannel(ch);
+	}
+}
+
+//Called with m_mutex locked
+void FreqDomainFrontEnd::processChannel(Channel *_channel)
+{
+	quint32 numOut = m_numKept - m_firstValid;
+	if (_channel->fifoLen + numOut > m_fifoSize) {
+		//Nobody is taking frames, start over rather than overrun
+		_channel->fifoLen = 0;
+	}
+
+	//Rotate kept bins to DC and apply filter
+	const quint32 mask = m_fftSize - 1;
+	const qint32 half = m_numKept / 2;
+	qint32 offset;
+	for (qint32 i = 0; i < (qint32)m_numKept; i++) {
+		offset = i < half ? i : i - (qint32)m_numKept;
+		m_workBuf[i] = m_freqDomain[(quint32)(_channel->centerBin + offset) & mask] * _channel->filterBins[i];
+	}
+	//Decimate
+	inverseKept(m_workBuf);
+
+	//Output p is input sample p*D of this block.  We want e^(-j*2*pi*f*n/fs) applied to block start + p*D,
+	//less the k bins the rotation already took care of
+	CPX *out = &_channel->outFifo[_channel->fifoLen];
+	double phase = _channel->blockPhase + _channel->outputPhaseInc * m_firstValid;
+	for (quint32 p = m_firstValid; p < m_numKept; p++) {
+		*out++ = m_workBuf[p] * std::polar(1.0, phase);
+		phase += _channel->outputPhaseInc;
+	}
+	_channel->fifoLen += numOut;
+
+	_channel->blockPhase = fmod(_channel->blockPhase + _channel->blockPhaseInc, TWOPI);
+}
+
+//In place radix 2 inverse, unscaled.  M is small so this is not worth an FFT instance
+void FreqDomainFrontEnd::inverseKept(CPX *_buf)
+{
+	quint32 j;
+	for (quint32 i = 0; i < m_numKept; i++) {
+		j = m_bitReverse[i];
+		if (j > i)
+			std::swap(_buf[i], _buf[j]);
+	}
+	CPX t;
+	for (quint32 len = 2; len <= m_numKept; len <<= 1) {
+		quint32 half = len >> 1;
+		quint32 step = m_numKept / len;
+		for (quint32 i = 0; i < m_numKept; i += len) {
+			for (quint32 k = 0; k < half; k++) {
+				t = _buf[i + k + half] * m_twiddle[k * step];
+				_buf[i + k + half] = _buf[i + k] - t;
+				_buf[i + k] += t;
+			}
+		}
+	}
+}
@@ -0,0 +1,144 @@
+#ifndef FREQDOMAINFRONTEND_H
+#define FREQDOMAINFRONTEND_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "cpx.h"
+#include "fft.h"
+#include <QMutex>
+#include <QVector>
+
+/*
+	Frequency domain receiver front end: Mixer + Decimator with one forward FFT
+
+	The time domain chain touches every full rate sample in the mixer and again in each decimator stage.
+	Here we do one overlap-save forward FFT at the input rate and everything else happens on the few bins
+	around the signal.  SignalSpectrum still does its own FFT for display.
+
+	Overlap-save
+		N = fft size, filter length is N/4 + 1, so each block re-uses N/4 samples and advances hop = 3N/4
+		Last hop samples of each circular convolution are valid, the first N/4 are discarded
+
+	Mixing
+		Anti-alias filter is designed at the mixer frequency (shifted up by f), so only bins around f are non-zero
+		Bin rotation by k = round(f / binWidth) moves them to DC, the fraction of a bin left over (f - k*binWidth)
+		is removed with a phase correction at the output rate.  Net result is x * e^(-j*2*pi*f*n/fs), same as Mixer
+
+	Decimation
+		Decimate by D (power of 2) keeps M = N/D bins centered on k and does an M point inverse FFT
+		This is exact as long as the filter is zero outside the kept bins, so pass band is limited to
+		+/- (fs/2D - transition band)
+
+	Band pass shaping stays at the decimated rate (BandPassFilter, which is already an FFT convolution)
+	Filter resolution here is limited by filter length at the input rate, N/4 taps gives a transition band of
+	16 * fs / N, 2khz at 2msps with N = 16384.  Fine for anti-alias, far too wide for a 2.4k SSB filter.
+
+	Output accumulates at the decimated rate and receiver takes it in fixed size frames.
+
+	Channels
+		Everything after the forward FFT depends only on the mixer frequency, so more narrowband outputs
+		(DspServer clients) can share the input buffer and FFT.  Each channel has its own filter, phase and
+		output, and costs M bins and an M point inverse per block.  Channel 0 is created with the front end
+		and is the one the receiver uses.
+
+	FFT backends don't agree on sign, order or I/Q swap (CuteSDR and Ooura swap I/Q, which conjugates)
+	so we probe the forward FFT once and map its output to a standard DFT.
+	M point inverse is done here because FFT has a 2048 minimum size.
+*/
+
+class PEBBLELIBSHARED_EXPORT FreqDomainFrontEnd
+{
+public:
+	static const quint32 c_minKeptBins = 256; //Target for M, more bins = sharper filter edges
+	static const quint32 c_minUsableBins = 64; //Below this transition band eats most of the pass band
+	static const quint32 c_maxFFTSize = 32768; //Largest power of 2 FFT supports
+
+	//_outputRate must be _sampleRate / power of 2, same rate Decimator::buildDecimationChain() returns
+	FreqDomainFrontEnd(quint32 _sampleRate, quint32 _outputRate, quint32 _framesPerBuffer);
+	~FreqDomainFrontEnd();
+
+	//False if rates can't be handled, caller should use time domain chain
+	bool isValid() {return m_isValid;}
+	quint32 fftSize() {return m_fftSize;}
+	quint32 decimateFactor() {return m_decimateFactor;}
+
+	//Same semantics as Mixer::setFrequency()
+	void setMixerFrequency(double _frequency, int _channel = 0);
+	//Returns the new channel's id, -1 if front end isn't valid.  Ids of removed channels are reused
+	int addChannel(double _mixerFrequency);
+	void removeChannel(int _channel);
+	//Flat pass band either side of the mixer frequency, output rate / 2 less the transition band
+	double usableBandWidth();
+	//Clears history and pending output, call when stream restarts
+	void reset();
+
+	//Consumes any number of input samples, output accumulates until takeFrame()
+	void process(const CPX *_in, quint32 _numSamples);
+	//Copies _numFrames output samples of _channel if available
+	bool takeFrame(CPX *_out, quint32 _numFrames, int _channel = 0);
+
+private:
+	//Everything that depends on the mixer frequency
+	struct Channel {
+		double mixerFrequency;
+		qint32 centerBin; //k
+		double blockPhase; //Mixer phase at start of current block
+		double blockPhaseInc;
+		double outputPhaseInc; //Fractional bin correction per output sample
+		//Filter response for kept bins, in inverse FFT order, includes 1/N scaling
+		CPX *filterBins;
+		CPX *designBins; //Spare filterBins, designed into without m_mutex and then swapped, see applyFilter()
+		CPX *outFifo;
+		quint32 fifoLen;
+	};
+	//Everything designFilter() works out besides the filter bins
+	struct FilterDesign {
+		double mixerFrequency;
+		qint32 centerBin;
+		double blockPhaseInc;
+		double outputPhaseInc;
+	};
+
+	bool m_isValid;
+	quint32 m_sampleRate;
+	quint32 m_outputRate;
+	quint32 m_decimateFactor; //D
+	quint32 m_fftSize; //N
+	quint32 m_numKept; //M = N/D
+	quint32 m_overlap; //N/4, filter length - 1
+	quint32 m_hop; //N - overlap, new samples per block
+	quint32 m_firstValid; //overlap / D, first valid output in each inverse FFT
+
+	FFT *m_fft; //Input rate forward FFT, process thread
+	FFT *m_fftDesign; //Filter design, caller thread
+	//Forward FFT to standard DFT mapping, see probeFFT()
+	bool m_fftConjugates;
+	bool m_fftReversed;
+	CPX m_fftScale;
+
+	CPX *m_inBuf; //N, overlap history + new samples
+	quint32 m_inPos;
+	CPX *m_freqDomain; //N, standard order DFT of last block
+	CPX *m_workBuf; //M
+	CPX *m_designBuf; //N
+	CPX *m_designFreq; //N
+
+	CPX *m_twiddle; //M/2, e^(+j*2*pi*k/M)
+	quint32 *m_bitReverse; //M
+	double *m_designWindow; //Filter length
+
+	QMutex m_mutex; //Channel changes vs process, only held to swap in a filter that's already designed
+	QMutex m_designMutex; //Filter design scratch and channel add/remove, caller threads only, taken before m_mutex
+	QVector<Channel *> m_channels; //Index is channel id, NULL once removed
+	quint32 m_fifoSize;
+
+	Channel *channel(int _channel);
+	void probeFFT();
+	void forwardStandard(FFT *_fft, CPX *_in, CPX *_out);
+	void designFilter(double _mixerFrequency, CPX *_filterBins, FilterDesign &_design);
+	void applyFilter(Channel *_channel, const FilterDesign &_design);
+	void processBlock();
+	void processChannel(Channel *_channel);
+	void inverseKept(CPX *_buf);
+};
+
+#endif // FREQDOMAINFRONTEND_H
@@ -0,0 +1,432 @@
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "iqfile.h"
+#include <QDebug>
+
+IQFile::IQFile()
+{
+	m_isWrite = false;
+	m_isOpen = false;
+	memset(&m_header, 0, sizeof(m_header));
+	m_blockI = new qint16[c_blockSize];
+	m_blockQ = new qint16[c_blockSize];
+	m_blockCount = 0;
+	m_blockPos = 0;
+	m_nextBlock = 0;
+	m_codeBuf = new quint8[maxEncodedBytes()];
+}
+
+IQFile::~IQFile()
+{
+	close();
+	delete[] m_blockI;
+	delete[] m_blockQ;
+	delete[] m_codeBuf;
+}
+
+bool IQFile::openWrite(QString _fileName, quint32 _sampleRate, quint32 _loFreq, quint8 _mode)
+{
+	close();
+	m_file.setFileName(_fileName);
+	if (!m_file.open(QFile::WriteOnly | QFile::Truncate)) {
+		qDebug()<<"IQFile write error - "<<_fileName<<m_file.errorString();
+		return false;
+	}
+	memset(&m_header, 0, sizeof(m_header));
+	memcpy(m_header.id, "PIQF", 4);
+	m_header.version = c_version;
+	m_header.bitsPerSample = 16;
+	m_header.sampleRate = _sampleRate;
+	m_header.loFreq = _loFreq;
+	m_header.mode = _mode;
+	m_header.channels = 2;
+	m_header.blockSize = c_blockSize;
+	//Rewritten with counts and index offset by close()
+	if (m_file.write((const char *)&m_header, sizeof(m_header)) != sizeof(m_header)) {
+		m_file.close();
+		return false;
+	}
+	m_index.clear();
+	m_blockCount = 0;
+	m_isWrite = true;
+	m_isOpen = true;
+	return true;
+}
+
+bool IQFile::writeSamples(const PCM_DATA_2CH *_buf, quint32 _numSamples)
+{
+	if (!m_isOpen || !m_isWrite)
+		return false;
+	quint32 count;
+	while (_numSamples > 0) {
+		count = qMin(_numSamples, c_blockSize - m_blockCount);
+		for (quint32 i = 0; i < count; i++) {
+			m_blockI[m_blockCount + i] = _buf[i].left;
+			m_blockQ[m_blockCount + i] = _buf[i].right;
+		}
+		m_blockCount += count;
+		_buf += count;
+		_numSamples -= count;
+		if (m_blockCount == c_blockSize && !flushBlock())
+			return false;
+	}
+	return true;
+}
+
+bool IQFile::flushBlock()
+{
+	if (m_blockCount == 0)
+		return true;
+	quint32 bytes = encodeBlock(m_blockI, m_blockQ, m_blockCount, m_codeBuf);
+	m_index.append(m_file.pos());
+	m_header.numSamples += m_blockCount;
+	m_header.numBlocks++;
+	m_blockCount = 0;
+	return m_file.write((const char *)m_codeBuf, bytes) == bytes;
+}
+
+bool IQFile::close()
+{
+	if (!m_isOpen)
+		return true;
+	m_isOpen = false;
+	bool res = true;
+	if (m_isWrite) {
+		res = flushBlock();
+		//Index goes at the end, then header is updated to point to it
+		m_header.indexOffset = m_file.pos();
+		qint64 indexBytes = m_index.count() * sizeof(quint64);
+		if (m_file.write((const char *)m_index.constData(), indexBytes) != indexBytes)
+			res = false;
+		m_file.seek(0);
+		if (m_file.write((const char *)&m_header, sizeof(m_header)) != sizeof(m_header))
+			res = false;
+	}
+	m_file.close();
+	m_index.clear();
+	return res;
+}
+
+bool IQFile::openRead(QString _fileName)
+{
+	close();
+	m_file.setFileName(_fileName);
+	if (!m_file.open(QFile::ReadOnly))
+		return false;
+	if (m_file.read((char *)&m_header, sizeof(m_header)) != sizeof(m_header) ||
+			memcmp(m_header.id, "PIQF", 4) != 0 || m_header.version > c_version ||
+			m_header.bitsPerSample != 16 || m_header.channels != 2 || m_header.blockSize != c_blockSize) {
+		m_file.close();
+		return false;
+	}
+
+	bool indexOk = false;
+	if (m_header.indexOffset != 0 && m_header.numBlocks > 0) {
+		m_index.resize(m_header.numBlocks);
+		qint64 indexBytes = m_header.numBlocks * sizeof(quint64);
+		indexOk = m_file.seek(m_header.indexOffset) &&
+			m_file.read((char *)m_index.data(), indexBytes) == indexBytes;
+	}
+	if (!indexOk && !rebuildIndex()) {
+		m_file.close();
+		return false;
+	}
+	if (m_index.isEmpty()) {
+		m_file.close();
+		return false;
+	}
+
+	m_isWrite = false;
+	m_isOpen = true;
+	m_blockCount = 0;
+	m_blockPos = 0;
+	m_nextBlock = 0;
+	return true;
+}
+
+//File wasn't closed, walk the block chain and keep every complete block
+bool IQFile::rebuildIndex()
+{
+	m_index.clear();
+	m_header.numSamples = 0;
+	qint64 pos = sizeof(PIQ_HEADER);
+	qint64 fileSize = m_file.size();
+	quint32 blockBytes;
+	quint16 numSamples;
+	while (pos + 6 <= fileSize) {
+		if (!m_file.seek(pos) ||
+				m_file.read((char *)&blockBytes, 4) != 4 ||
+				m_file.read((char *)&numSamples, 2) != 2)
+			break;
+		if (numSamples == 0 || numSamples > c_blockSize || pos + 4 + blockBytes > fileSize)
+			break; //Partial last block
+		m_index.append(pos);
+		m_header.numSamples += numSamples;
+		pos += 4 + blockBytes;
+	}
+	m_header.numBlocks = m_index.count();
+	qDebug()<<"IQFile: no index, recovered "<<m_header.numBlocks<<" blocks";
+	return true;
+}
+
+bool IQFile::readBlock(quint32 _block)
+{
+	if (_block >= (quint32)m_index.count())
+		return false;
+	quint32 size;
+	if (!m_file.seek(m_index[_block]) || m_file.read((char *)&size, 4) != 4 || size + 4 > maxEncodedBytes())
+		return false;
+	memcpy(m_codeBuf, &size, 4);
+	if (m_file.read((char *)m_codeBuf + 4, size) != size)
+		return false;
+	if (decodeBlock(m_codeBuf, size + 4, m_blockI, m_blockQ, m_blockCount) == 0)
+		return false;
+	m_blockPos = 0;
+	m_nextBlock = _block + 1;
+	return true;
+}
+
+bool IQFile::seek(quint64 _sample)
+{
+	if (!m_isOpen || m_isWrite)
+		return false;
+	//Every block but the last is full
+	quint32 block = _sample / c_blockSize;
+	if (!readBlock(block))
+		return false;
+	m_blockPos = qMin((quint32)(_sample % c_blockSize), m_blockCount);
+	return true;
+}
+
+quint32 IQFile::readSamples(CPX *_buf, quint32 _numSamples)
+{
+	if (!m_isOpen || m_isWrite)
+		return 0;
+	quint32 samplesRead = 0;
+	quint32 count;
+	while (samplesRead < _numSamples) {
+		if (m_blockPos == m_blockCount) {
+			//End of file starts over in continuous loop, same as WavFile
+			if (m_nextBlock >= (quint32)m_index.count())
+				m_nextBlock = 0;
+			if (!readBlock(m_nextBlock))
+				break;
+		}
+		count = qMin(_numSamples - samplesRead, m_blockCount - m_blockPos);
+		for (quint32 i = 0; i < count; i++) {
+			_buf[samplesRead + i].real(m_blockI[m_blockPos + i] / 32767.0);
+			_buf[samplesRead + i].imag(m_blockQ[m_blockPos + i] / 32767.0);
+		}
+		m_blockPos += count;
+		samplesRead += count;
+	}
+	return samplesRead;
+}
+
+quint32 IQFile::encodeBlock(const qint16 *_i, const qint16 *_q, quint32 _numSamples, quint8 *_out)
+{
+	quint8 *out = _out + 4; //Size goes here when we know it
+	quint16 numSamples = _numSamples;
+	memcpy(out, &numSamples, 2);
+	out += 2;
+	out = encodeChannel(_i, _numSamples, out);
+	out = encodeChannel(_q, _numSamples, out);
+	quint32 size = out - _out - 4;
+	memcpy(_out, &size, 4);
+	return size + 4;
+}
+
+quint32 IQFile::decodeBlock(const quint8 *_in, quint32 _inBytes, qint16 *_i, qint16 *_q, quint32 &_numSamples)
+{
+	if (_inBytes < 6)
+		return 0;
+	quint32 size;
+	quint16 numSamples;
+	memcpy(&size, _in, 4);
+	memcpy(&numSamples, _in + 4, 2);
+	_numSamples = numSamples;
+	if (size + 4 > _inBytes || _numSamples == 0 || _numSamples > c_blockSize)
+		return 0;
+	const quint8 *end = _in + 4 + size;
+	const quint8 *in = _in + 6;
+	in = decodeChannel(in, end, _i, _numSamples);
+	if (in == NULL)
+		return 0;
+	in = decodeChannel(in, end, _q, _numSamples);
+	if (in == NULL)
+		return 0;
+	return size + 4;
+}
+
+quint8 *IQFile::encodeChannel(const qint16 *_in, quint32 _numSamples, quint8 *_out)
+{
+	//Pick the fixed predictor with the smallest total residual, one pass for all 4
+	quint64 sum[c_maxOrder + 1] = {0, 0, 0, 0};
+	qint32 e0, e1, e2, e3;
+	for (quint32 n = c_maxOrder; n < _numSamples; n++) {
+		e0 = _in[n];
+		e1 = e0 - _in[n - 1];
+		e2 = e1 - (_in[n - 1] - _in[n - 2]);
+		e3 = e2 - ((_in[n - 1] - _in[n - 2]) - (_in[n - 2] - _in[n - 3]));
+		sum[0] += qAbs(e0);
+		sum[1] += qAbs(e1);
+		sum[2] += qAbs(e2);
+		sum[3] += qAbs(e3);
+	}
+	quint32 order = 0;
+	for (quint32 o = 1; o <= c_maxOrder; o++) {
+		if (sum[o] < sum[order])
+			order = o;
+	}
+	order = qMin(order, _numSamples);
+
+	*_out++ = order;
+	memcpy(_out, _in, order * 2);
+	_out += order * 2;
+
+	//Residuals, zig-zag so small negative values are small positive values
+	qint32 error[c_blockSize];
+	quint32 residual[c_blockSize];
+	quint32 n;
+	switch (order) {
+		case 0:
+			for (n = order; n < _numSamples; n++)
+				error[n] = _in[n];
+			break;
+		case 1:
+			for (n = order; n < _numSamples; n++)
+				error[n] = _in[n] - _in[n - 1];
+			break;
+		case 2:
+			for (n = order; n < _numSamples; n++)
+				error[n] = _in[n] - 2 * _in[n - 1] + _in[n - 2];
+			break;
+		default:
+			for (n = order; n < _numSamples; n++)
+				error[n] = _in[n] - 3 * _in[n - 1] + 3 * _in[n - 2] - _in[n - 3];
+			break;
+	}
+	for (n = order; n < _numSamples; n++)
+		residual[n] = ((quint32)error[n] << 1) ^ (quint32)(error[n] >> 31);
+
+	//Widths for every partition first, so decoder knows all of them before the bits start
+	quint32 numResiduals = _numSamples - order;
+	quint32 numPartitions = (numResiduals + c_partitionSize - 1) / c_partitionSize;
+	quint8 *widths = _out;
+	quint32 first;
+	quint32 last;
+	quint32 max;
+	quint8 width;
+	for (quint32 p = 0; p < numPartitions; p++) {
+		first = order + p * c_partitionSize;
+		last = qMin(first + c_partitionSize, _numSamples);
+		max = 0;
+		for (n = first; n < last; n++)
+			max |= residual[n];
+		width = 0;
+		while (width < 32 && (max >> width) != 0)
+			width++;
+		widths[p] = width;
+	}
+	_out += numPartitions;
+
+	quint64 acc = 0;
+	quint32 bits = 0;
+	for (quint32 p = 0; p < numPartitions; p++) {
+		first = order + p * c_partitionSize;
+		last = qMin(first + c_partitionSize, _numSamples);
+		width = widths[p];
+		if (width == 0)
+			continue;
+		for (n = first; n < last; n++) {
+			acc |= (quint64)residual[n] << bits;
+			bits += width;
+			while (bits >= 8) {
+				*_out++ = acc;
+				acc >>= 8;
+				bits -= 8;
+			}
+		}
+	}
+	if (bits > 0)
+		*_out++ = acc;
+	return _out;
+}
+
+const quint8 *IQFile::decodeChannel(const quint8 *_in, const quint8 *_end, qint16 *_out, quint32 _numSamples)
+{
+	if (_in >= _end)
+		return NULL;
+	quint32 order = *_in++;
+	if (order > c_maxOrder || order > _numSamples || _in + order * 2 > _end)
+		return NULL;
+	memcpy(_out, _in, order * 2);
+	_in += order * 2;
+
+	quint32 numResiduals = _numSamples - order;
+	quint32 numPartitions = (numResiduals + c_partitionSize - 1) / c_partitionSize;
+	const quint8 *widths = _in;
+	_in += numPartitions;
+	if (_in > _end)
+		return NULL;
+
+	quint64 acc = 0;
+	quint32 bits = 0;
+	quint32 first;
+	quint32 last;
+	quint32 width;
+	quint64 mask;
+	quint64 needBits;
+	quint32 u;
+	quint32 n;
+	qint32 error[c_blockSize];
+	for (quint32 p = 0; p < numPartitions; p++) {
+		first = order + p * c_partitionSize;
+		last = qMin(first + c_partitionSize, _numSamples);
+		width = widths[p];
+		if (width > 32)
+			return NULL;
+		if (width == 0) {
+			for (n = first; n < last; n++)
+				error[n] = 0;
+			continue;
+		}
+		//Bytes this partition needs are known up front, so the inner loop has no end check
+		needBits = (quint64)(last - first) * width;
+		if (needBits > bits && _in + ((needBits - bits + 7) >> 3) > _end)
+			return NULL;
+		mask = ((quint64)1 << width) - 1;
+		for (n = first; n < last; n++) {
+			while (bits < width) {
+				acc |= (quint64)*_in++ << bits;
+				bits += 8;
+			}
+			u = acc & mask;
+			acc >>= width;
+			bits -= width;
+			error[n] = (qint32)(u >> 1) ^ -(qint32)(u & 1);
+		}
+	}
+	//Anything left in acc is padding
+
+	//Undo the predictor, separate loops so each one is tight
+	switch (order) {
+		case 0:
+			for (n = order; n < _numSamples; n++)
+				_out[n] = error[n];
+			break;
+		case 1:
+			for (n = order; n < _numSamples; n++)
+				_out[n] = error[n] + _out[n - 1];
+			break;
+		case 2:
+			for (n = order; n < _numSamples; n++)
+				_out[n] = error[n] + 2 * _out[n - 1] - _out[n - 2];
+			break;
+		default:
+			for (n = order; n < _numSamples; n++)
+				_out[n] = error[n] + 3 * _out[n - 1] - 3 * _out[n - 2] + _out[n - 3];
+			break;
+	}
+	return _in;
+}
@@ -0,0 +1,110 @@
+#ifndef IQFILE_H
+#define IQFILE_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "cpx.h"
+#include "wavfile.h"
+#include <QFile>
+#include <QVector>
+
+/*
+	Lossless compressed IQ file (.piq), same 16 bit samples as a Pebble wav file in 1/2 to 1/4 the space
+
+	Most of the 16 bits in a recording are noise floor headroom, and neighbouring samples are correlated,
+	so a small predictor plus bit packing sized to each block does most of what FLAC does at a fraction of
+	the cost.  Encode runs on the IQRecorder writer thread, decode is a few ns per sample.
+
+	Layout (little endian)
+		PIQ_HEADER, 64 bytes
+		Blocks of c_blockSize samples, each independent so we can seek to any block
+		Block index, one quint64 file offset per block, written by close()
+		If the file wasn't closed (crash, power loss) indexOffset is 0 and openRead() rebuilds the index
+		by walking the block size fields
+
+	Block
+		quint32 size of the rest of the block in bytes
+		quint16 number of samples
+		Each channel (I then Q)
+			quint8 predictor order 0-3, FLAC fixed polynomial predictors
+			qint16 warm up samples, one per order
+			quint8 bit width for each partition of c_partitionSize residuals
+			Residuals zig-zag encoded and packed LSB first at the partition's width, padded to a byte
+*/
+
+#pragma pack(1)
+typedef struct PIQ_HEADER
+{
+	quint8 id[4]; //"PIQF"
+	quint16 version;
+	quint16 bitsPerSample; //Always 16 for now
+	quint32 sampleRate;
+	quint32 loFreq;
+	quint8 mode; //Demod mode during recording, 255 if unknown
+	quint8 channels; //Always 2
+	quint16 blockSize;
+	quint64 numSamples;
+	quint64 indexOffset; //0 if file was not closed
+	quint32 numBlocks;
+	quint8 spare[24];
+}PIQ_HEADER;
+#pragma pack()
+
+class PEBBLELIBSHARED_EXPORT IQFile
+{
+public:
+	static const quint16 c_version = 1;
+	static const quint32 c_blockSize = 4096;
+	static const quint32 c_partitionSize = 256;
+	static const quint32 c_maxOrder = 3;
+
+	IQFile();
+	~IQFile();
+
+	bool openWrite(QString _fileName, quint32 _sampleRate, quint32 _loFreq, quint8 _mode);
+	bool writeSamples(const PCM_DATA_2CH *_buf, quint32 _numSamples);
+
+	bool openRead(QString _fileName);
+	//Same scaling as WavFile::ReadSamples(), loops back to the start at end of file
+	quint32 readSamples(CPX *_buf, quint32 _numSamples);
+	bool seek(quint64 _sample);
+	//Next sample readSamples() will return
+	quint64 position() {return m_nextBlock == 0 ? 0 : (quint64)(m_nextBlock - 1) * c_blockSize + m_blockPos;}
+
+	bool close();
+
+	quint32 sampleRate() {return m_header.sampleRate;}
+	quint32 loFreq() {return m_header.loFreq;}
+	quint8 mode() {return m_header.mode;}
+	quint64 numSamples() {return m_header.numSamples;}
+
+	//Exposed so the codec can be checked without a file
+	//Returns bytes written to _out, which must hold maxEncodedBytes()
+	static quint32 encodeBlock(const qint16 *_i, const qint16 *_q, quint32 _numSamples, quint8 *_out);
+	//Returns bytes consumed, 0 if the block is invalid
+	static quint32 decodeBlock(const quint8 *_in, quint32 _inBytes, qint16 *_i, qint16 *_q, quint32 &_numSamples);
+	static quint32 maxEncodedBytes() {return 6 + 2 * (1 + c_maxOrder * 2 + c_blockSize / c_partitionSize + c_blockSize * 4);}
+
+private:
+	QFile m_file;
+	bool m_isWrite;
+	bool m_isOpen;
+	PIQ_HEADER m_header;
+	QVector<quint64> m_index; //File offset of each block
+
+	//Planar samples for the block being filled (write) or played (read)
+	qint16 *m_blockI;
+	qint16 *m_blockQ;
+	quint32 m_blockCount; //Samples in block
+	quint32 m_blockPos; //Next sample to read
+	quint32 m_nextBlock; //Read only
+	quint8 *m_codeBuf;
+
+	bool flushBlock();
+	bool readBlock(quint32 _block);
+	bool rebuildIndex();
+
+	static quint8 *encodeChannel(const qint16 *_in, quint32 _numSamples, quint8 *_out);
+	static const quint8 *decodeChannel(const quint8 *_in, const quint8 *_end, qint16 *_out, quint32 _numSamples);
+};
+
+#endif // IQFILE_H
@@ -0,0 +1,439 @@
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "iqoverview.h"
+#include "iqfile.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+
+const quint32 c_cpxBufSize = 4096; //PCM converted per pass
+const quint32 c_buildChunk = 65536; //Samples per read when building from a recording
+const double c_floorDb = -400; //Below anything a 16 bit sample can produce
+
+IQOverview::IQOverview()
+{
+	m_sampleRate = 0;
+	m_loFreq = 0;
+	m_samplesPerSlice = c_numBins;
+	m_startUtcMs = 0;
+	m_totalSamples = 0;
+	m_elapsedSamples = 0;
+	m_numSlices = 0;
+	m_sliceStartSample = 0;
+	m_sliceStartElapsed = 0;
+	m_slicePos = 0;
+	m_frameStride = c_numBins;
+
+	m_frame = new CPX[c_numBins];
+	m_fftBuf = new CPX[c_numBins];
+	m_cpxBuf = new CPX[c_cpxBufSize];
+	m_sliceMax = new double[c_numBins];
+
+	//Hann
+	m_window = new double[c_numBins];
+	m_windowGain = 0;
+	for (quint32 i = 0; i < c_numBins; i++) {
+		m_window[i] = 0.5 - 0.5 * cos(2.0 * M_PI * i / c_numBins);
+		m_windowGain += m_window[i];
+	}
+
+	m_twiddle = new CPX[c_numBins / 2];
+	for (quint32 i = 0; i < c_numBins / 2; i++)
+		m_twiddle[i] = CPX(cos(-2.0 * M_PI * i / c_numBins), sin(-2.0 * M_PI * i / c_numBins));
+	m_bitReverse = new quint32[c_numBins];
+	quint32 numBits = 0;
+	while ((1u << numBits) < c_numBins)
+		numBits++;
+	quint32 r;
+	for (quint32 i = 0; i < c_numBins; i++) {
+		r = 0;
+		for (quint32 b = 0; b < numBits; b++)
+			r |= ((i >> b) & 1) << (numBits - 1 - b);
+		m_bitReverse[i] = r;
+	}
+}
+
+IQOverview::~IQOverview()
+{
+	delete[] m_frame;
+	delete[] m_fftBuf;
+	delete[] m_cpxBuf;
+	delete[] m_sliceMax;
+	delete[] m_window;
+	delete[] m_twiddle;
+	delete[] m_bitReverse;
+}
+
+void IQOverview::begin(quint32 _sampleRate, quint32 _loFreq, qint64 _startUtcMs)
+{
+	m_sampleRate = qMax((quint32)1, _sampleRate);
+	m_loFreq = _loFreq;
+	m_startUtcMs = _startUtcMs;
+	m_samplesPerSlice = qMax(c_numBins, (quint32)((quint64)m_sampleRate * c_sliceMs / 1000));
+	m_frameStride = qMax(c_numBins, m_samplesPerSlice / c_maxFramesPerSlice);
+	m_totalSamples = 0;
+	m_elapsedSamples = 0;
+	m_numSlices = 0;
+	m_slices.clear();
+	m_tiles.clear();
+	m_levelOffsets.clear();
+	startSlice();
+}
+
+void IQOverview::startSlice()
+{
+	m_sliceStartSample = m_totalSamples;
+	m_sliceStartElapsed = m_elapsedSamples;
+	m_slicePos = 0;
+	for (quint32 i = 0; i < c_numBins; i++)
+		m_sliceMax[i] = c_floorDb;
+}
+
+void IQOverview::endSlice()
+{
+	if (m_slicePos == 0)
+		return;
+	PIQ_OVERVIEW_SLICE slice;
+	slice.sampleOffset = m_sliceStartSample;
+	slice.utcMs = m_startUtcMs + (qint64)(m_sliceStartElapsed * 1000 / m_sampleRate);
+	m_slices.append(slice);
+
+	//Short last slice may not have a whole frame, leave it at the floor
+	double scale = 255.0 / (c_maxDb - c_minDb);
+	double v;
+	//Level 0 only, save() may have left a pyramid after it
+	int offset = m_numSlices * c_numBins;
+	m_tiles.resize(offset + c_numBins);
+	quint8 *tile = m_tiles.data() + offset;
+	for (quint32 i = 0; i < c_numBins; i++) {
+		v = (m_sliceMax[i] - c_minDb) * scale;
+		tile[i] = v <= 0 ? 0 : (v >= 255 ? 255 : (quint8)v);
+	}
+	m_numSlices++;
+}
+
+void IQOverview::addSamples(const PCM_DATA_2CH *_in, quint32 _numSamples)
+{
+	quint32 count;
+	while (_numSamples > 0) {
+		count = qMin(_numSamples, c_cpxBufSize);
+		//Same scaling as WavFile::ReadSamples() so levels match an overview built from the file
+		for (quint32 i = 0; i < count; i++) {
+			m_cpxBuf[i].real(_in[i].left / 32767.0);
+			m_cpxBuf[i].imag(_in[i].right / 32767.0);
+		}
+		addSamples(m_cpxBuf, count);
+		_in += count;
+		_numSamples -= count;
+	}
+}
+
+void IQOverview::addSamples(const CPX *_in, quint32 _numSamples)
+{
+	quint32 posInStride;
+	quint32 sliceLeft;
+	quint32 count;
+	while (_numSamples > 0) {
+		posInStride = m_slicePos % m_frameStride;
+		sliceLeft = m_samplesPerSlice - m_slicePos;
+		if (posInStride < c_numBins) {
+			//Inside a frame, copy what we need of it
+			count = qMin(qMin(_numSamples, c_numBins - posInStride), sliceLeft);
+			memcpy(&m_frame[posInStride], _in, count * sizeof(CPX));
+			if (posInStride + count == c_numBins)
+				fftFrame();
+		} else {
+			//Between frames, skip to the next one
+			count = qMin(qMin(_numSamples, m_frameStride - posInStride), sliceLeft);
+		}
+		m_slicePos += count;
+		m_totalSamples += count;
+		m_elapsedSamples += count;
+		_in += count;
+		_numSamples -= count;
+		if (m_slicePos == m_samplesPerSlice) {
+			endSlice();
+			startSlice();
+		}
+	}
+}
+
+void IQOverview::addGap(quint64 _numSamples)
+{
+	m_elapsedSamples += _numSamples;
+}
+
+void IQOverview::fftFrame()
+{
+	for (quint32 i = 0; i < c_numBins; i++)
+		m_fftBuf[m_bitReverse[i]] = m_frame[i] * m_window[i];
+
+	CPX t;
+	quint32 half;
+	quint32 step;
+	for (quint32 size = 2; size <= c_numBins; size <<= 1) {
+		half = size >> 1;
+		step = c_numBins / size;
+		for (quint32 start = 0; start < c_numBins; start += size) {
+			for (quint32 k = 0; k < half; k++) {
+				t = m_fftBuf[start + k + half] * m_twiddle[k * step];
+				m_fftBuf[start + k + half] = m_fftBuf[start + k] - t;
+				m_fftBuf[start + k] += t;
+			}
+		}
+	}
+
+	//Full scale tone is 0db.  Unfold so bin 0 is -f
+	double gainDb = 20 * log10(m_windowGain);
+	double power;
+	double db;
+	quint32 bin;
+	for (quint32 i = 0; i < c_numBins; i++) {
+		bin = (i + c_numBins / 2) % c_numBins;
+		power = m_fftBuf[bin].real() * m_fftBuf[bin].real() + m_fftBuf[bin].imag() * m_fftBuf[bin].imag();
+		if (power <= 0)
+			continue;
+		db = 10 * log10(power) - gainDb;
+		if (db > m_sliceMax[i])
+			m_sliceMax[i] = db;
+	}
+}
+
+void IQOverview::buildPyramid()
+{
+	m_levelOffsets.clear();
+	if (m_numSlices == 0)
+		return;
+
+	int numLevels = 1;
+	quint64 total = m_numSlices;
+	for (quint32 rows = m_numSlices; rows > 1; numLevels++) {
+		rows = (rows + 1) / 2;
+		total += rows;
+	}
+	m_tiles.resize(total * c_numBins);
+
+	m_levelOffsets.append(0);
+	quint32 offset = m_numSlices * c_numBins;
+	quint32 prevRows;
+	const quint8 *prev;
+	const quint8 *a;
+	const quint8 *b;
+	quint8 *out;
+	for (int level = 1; level < numLevels; level++) {
+		prevRows = numSlices(level - 1);
+		prev = m_tiles.constData() + m_levelOffsets[level - 1];
+		out = m_tiles.data() + offset;
+		m_levelOffsets.append(offset);
+		for (quint32 r = 0; r < prevRows; r += 2) {
+			a = prev + r * c_numBins;
+			//Odd row out at the end carries up unchanged
+			b = r + 1 < prevRows ? a + c_numBins : a;
+			for (quint32 i = 0; i < c_numBins; i++)
+				out[i] = qMax(a[i], b[i]);
+			out += c_numBins;
+		}
+		offset = out - m_tiles.constData();
+	}
+}
+
+bool IQOverview::save(QString _fileName)
+{
+	endSlice();
+	startSlice();
+	buildPyramid();
+	if (m_numSlices == 0)
+		return false;
+
+	PIQ_OVERVIEW_HEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.id, "PIQO", 4);
+	header.version = c_version;
+	header.numBins = c_numBins;
+	header.sampleRate = m_sampleRate;
+	header.loFreq = m_loFreq;
+	header.samplesPerSlice = m_samplesPerSlice;
+	header.numSlices = m_numSlices;
+	header.numLevels = m_levelOffsets.count();
+	header.sourceSamples = m_totalSamples;
+	header.startUtcMs = m_startUtcMs;
+
+	QFile file(_fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		qDebug()<<"IQOverview: unable to write "<<_fileName;
+		return false;
+	}
+	qint64 slicesBytes = m_slices.count() * sizeof(PIQ_OVERVIEW_SLICE);
+	bool ok = file.write((const char *)&header, sizeof(header)) == sizeof(header) &&
+		file.write((const char *)m_slices.constData(), slicesBytes) == slicesBytes &&
+		file.write((const char *)m_tiles.constData(), m_tiles.count()) == m_tiles.count();
+	file.close();
+	if (!ok) {
+		//Half written overview is worse than none, it will be rebuilt next time the recording is opened
+		file.remove();
+		return false;
+	}
+	return true;
+}
+
+bool IQOverview::load(QString _fileName, quint64 _sourceSamples)
+{
+	m_numSlices = 0;
+	m_slices.clear();
+	m_tiles.clear();
+	m_levelOffsets.clear();
+
+	QFile file(_fileName);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+	PIQ_OVERVIEW_HEADER header;
+	if (file.read((char *)&header, sizeof(header)) != sizeof(header))
+		return false;
+	if (memcmp(header.id, "PIQO", 4) != 0 || header.version != c_version || header.numBins != c_numBins ||
+			header.numSlices == 0 || header.sampleRate == 0)
+		return false;
+	if (_sourceSamples != 0 && header.sourceSamples != _sourceSamples)
+		return false; //Recording has changed since overview was built
+
+	m_numSlices = header.numSlices;
+	m_slices.resize(m_numSlices);
+	qint64 slicesBytes = m_numSlices * sizeof(PIQ_OVERVIEW_SLICE);
+	if (file.read((char *)m_slices.data(), slicesBytes) != slicesBytes) {
+		m_numSlices = 0;
+		return false;
+	}
+
+	quint64 total = 0;
+	for (int level = 0; level < header.numLevels; level++) {
+		m_levelOffsets.append(total * c_numBins);
+		total += numSlices(level);
+	}
+	m_tiles.resize(total * c_numBins);
+	if (numSlices(header.numLevels - 1) != 1 ||
+			file.read((char *)m_tiles.data(), m_tiles.count()) != m_tiles.count()) {
+		m_numSlices = 0;
+		m_levelOffsets.clear();
+		return false;
+	}
+
+	m_sampleRate = header.sampleRate;
+	m_loFreq = header.loFreq;
+	m_samplesPerSlice = header.samplesPerSlice;
+	m_totalSamples = header.sourceSamples;
+	m_startUtcMs = header.startUtcMs;
+	return true;
+}
+
+quint32 IQOverview::numSlices(int _level)
+{
+	if (_level < 0 || _level >= 32)
+		return 0;
+	//ceil(n / 2^level), same as halving with the odd row carried up each level
+	return ((quint64)m_numSlices + (1ULL << _level) - 1) >> _level;
+}
+
+int IQOverview::levelForRows(quint32 _rows)
+{
+	for (int level = 0; level < m_levelOffsets.count(); level++) {
+		if (numSlices(level) <= _rows)
+			return level;
+	}
+	return m_levelOffsets.count() - 1;
+}
+
+const quint8 *IQOverview::tile(int _level, quint32 _row)
+{
+	if (_level < 0 || _level >= m_levelOffsets.count() || _row >= numSlices(_level))
+		return NULL;
+	return m_tiles.constData() + m_levelOffsets[_level] + _row * c_numBins;
+}
+
+quint64 IQOverview::sliceSample(quint32 _slice)
+{
+	if (m_slices.isEmpty())
+		return 0;
+	return m_slices[qMin(_slice, (quint32)m_slices.count() - 1)].sampleOffset;
+}
+
+qint64 IQOverview::sliceUtcMs(quint32 _slice)
+{
+	if (m_slices.isEmpty())
+		return m_startUtcMs;
+	return m_slices[qMin(_slice, (quint32)m_slices.count() - 1)].utcMs;
+}
+
+quint32 IQOverview::findSliceBySample(quint64 _sample)
+{
+	QVector<PIQ_OVERVIEW_SLICE>::const_iterator it = std::upper_bound(m_slices.constBegin(), m_slices.constEnd(), _sample,
+		[](quint64 s, const PIQ_OVERVIEW_SLICE &slice) {return s < slice.sampleOffset;});
+	return it == m_slices.constBegin() ? 0 : it - m_slices.constBegin() - 1;
+}
+
+quint32 IQOverview::findSliceByUtcMs(qint64 _utcMs)
+{
+	QVector<PIQ_OVERVIEW_SLICE>::const_iterator it = std::upper_bound(m_slices.constBegin(), m_slices.constEnd(), _utcMs,
+		[](qint64 t, const PIQ_OVERVIEW_SLICE &slice) {return t < slice.utcMs;});
+	return it == m_slices.constBegin() ? 0 : it - m_slices.constBegin() - 1;
+}
+
+bool IQOverview::build(QString _recording, const volatile bool &_isRunning)
+{
+	QFileInfo fi(_recording);
+	bool isIQFile = fi.suffix().compare("piq", Qt::CaseInsensitive) == 0;
+	IQFile iqFile;
+	WavFile wavFile;
+	quint64 numSamples;
+	if (isIQFile) {
+		if (!iqFile.openRead(_recording))
+			return false;
+		numSamples = iqFile.numSamples();
+		begin(iqFile.sampleRate(), iqFile.loFreq(), 0);
+	} else {
+		if (!wavFile.OpenRead(_recording, c_buildChunk))
+			return false;
+		numSamples = wavFile.GetNumSamples();
+		begin(wavFile.GetSampleRate(), wavFile.GetLoFreq(), 0);
+	}
+	//Neither format has a start time, file was last written when recording stopped
+	m_startUtcMs = fi.lastModified().toMSecsSinceEpoch() - (qint64)(numSamples * 1000 / m_sampleRate);
+
+	CPX *buf = new CPX[c_buildChunk];
+	quint64 done = 0;
+	quint32 count;
+	while (done < numSamples && _isRunning) {
+		count = qMin((quint64)c_buildChunk, numSamples - done);
+		if (isIQFile)
+			count = iqFile.readSamples(buf, count);
+		else
+			count = wavFile.ReadSamples(buf, count);
+		if (count == 0)
+			break;
+		addSamples(buf, count);
+		done += count;
+	}
+	delete[] buf;
+	if (isIQFile)
+		iqFile.close();
+	else
+		wavFile.Close();
+	return done == numSamples;
+}
+
+IQOverviewBuilder::IQOverviewBuilder(QString _recording)
+{
+	m_recording = _recording;
+	m_isRunning = false;
+	m_isDone.store(0);
+}
+
+void IQOverviewBuilder::start()
+{
+	IQOverview overview;
+	bool success = overview.build(m_recording, m_isRunning) &&
+		overview.save(IQOverview::fileNameFor(m_recording));
+	m_isDone.storeRelease(1);
+	emit finished(success);
+}
@@ -0,0 +1,163 @@
+#ifndef IQOVERVIEW_H
+#define IQOVERVIEW_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "cpx.h"
+#include "wavfile.h"
+#include <QObject>
+#include <QVector>
+#include <QAtomicInteger>
+
+/*
+	Overview index for long IQ recordings, the whole file as a waterfall without playing it
+
+	Finding something in an hour long recording meant playing it back in real time.  The overview is a sidecar
+	file (recording + ".ovw") with a coarse spectrum for every c_sliceMs of the recording, so the UI can draw the
+	whole file at once and jump straight to anything that shows up in it.
+
+	Slices
+		Every c_sliceMs of samples (level 0) gets c_numBins quint8 dB values, c_minDb to c_maxDb
+		Max hold of up to c_maxFramesPerSlice c_numBins point FFTs spread across the slice, so short bursts
+		still show up and building the index costs about the same at any sample rate
+		Each slice also has its sample offset and UTC time, so a row on screen maps back to a point in the file.
+		Time keeps running across gaps (IQRecorder dropped samples) so it isn't always sample / sampleRate
+
+	Pyramid
+		Level n+1 is the max of each pair of rows in level n, down to a single row
+		Drawing never has to touch more rows than there are pixels, whatever the length of the recording
+
+	Built by IQRecorder while recording, or by IQOverviewBuilder the first time an older recording is opened
+*/
+
+#pragma pack(1)
+typedef struct PIQ_OVERVIEW_HEADER
+{
+	quint8 id[4]; //"PIQO"
+	quint16 version;
+	quint16 numBins;
+	quint32 sampleRate;
+	quint32 loFreq;
+	quint32 samplesPerSlice;
+	quint32 numSlices; //Level 0
+	quint16 numLevels;
+	quint16 spare1;
+	quint64 sourceSamples; //Samples in recording when overview was built, stale if they don't match
+	qint64 startUtcMs;
+	quint8 spare[16];
+}PIQ_OVERVIEW_HEADER;
+
+typedef struct PIQ_OVERVIEW_SLICE
+{
+	quint64 sampleOffset;
+	qint64 utcMs;
+}PIQ_OVERVIEW_SLICE;
+#pragma pack()
+
+class PEBBLELIBSHARED_EXPORT IQOverview
+{
+public:
+	static const quint16 c_version = 1;
+	static const quint32 c_numBins = 256;
+	static const quint32 c_sliceMs = 100;
+	static const quint32 c_maxFramesPerSlice = 32;
+	static const int c_minDb = -150;
+	static const int c_maxDb = 0;
+
+	IQOverview();
+	~IQOverview();
+
+	static QString fileNameFor(QString _recording) {return _recording + ".ovw";}
+
+	//Builder
+	void begin(quint32 _sampleRate, quint32 _loFreq, qint64 _startUtcMs);
+	void addSamples(const PCM_DATA_2CH *_in, quint32 _numSamples);
+	void addSamples(const CPX *_in, quint32 _numSamples);
+	//Samples that never made it to the recording, advances time but not sample offset
+	void addGap(quint64 _numSamples);
+	//Closes the last partial slice, builds the pyramid and writes the file
+	bool save(QString _fileName);
+	//Reads a whole .wav or .piq recording, gives up if _isRunning goes false.  Doesn't save
+	bool build(QString _recording, const volatile bool &_isRunning);
+
+	//Reader.  Fails if file is not an overview, or _sourceSamples is not 0 and doesn't match the recording
+	bool load(QString _fileName, quint64 _sourceSamples = 0);
+	bool isValid() {return m_numSlices > 0 && !m_levelOffsets.isEmpty();}
+
+	quint32 sampleRate() {return m_sampleRate;}
+	quint32 loFreq() {return m_loFreq;}
+	quint32 numBins() {return c_numBins;}
+	quint64 sourceSamples() {return m_totalSamples;}
+	int numLevels() {return m_levelOffsets.count();}
+	quint32 numSlices(int _level = 0);
+	//Smallest level with no more than _rows rows
+	int levelForRows(quint32 _rows);
+	//c_numBins values, -f..0..+f, 0 = c_minDb 255 = c_maxDb.  NULL if out of range
+	const quint8 *tile(int _level, quint32 _row);
+	//Level 0 slice that a row at _level starts with
+	quint32 firstSlice(int _level, quint32 _row) {return _row << _level;}
+
+	quint64 sliceSample(quint32 _slice);
+	qint64 sliceUtcMs(quint32 _slice);
+	//Slice containing sample or time, clamped to first/last slice
+	quint32 findSliceBySample(quint64 _sample);
+	quint32 findSliceByUtcMs(qint64 _utcMs);
+
+private:
+	quint32 m_sampleRate;
+	quint32 m_loFreq;
+	quint32 m_samplesPerSlice;
+	qint64 m_startUtcMs;
+	quint64 m_totalSamples; //Recording samples
+	quint64 m_elapsedSamples; //Including gaps, for time
+
+	quint32 m_numSlices;
+	QVector<PIQ_OVERVIEW_SLICE> m_slices;
+	QVector<quint8> m_tiles; //All levels, level 0 first
+	QVector<quint32> m_levelOffsets; //Start of each level in m_tiles, built by save() or load()
+
+	//Slice being built
+	quint64 m_sliceStartSample;
+	quint64 m_sliceStartElapsed;
+	quint32 m_slicePos; //Samples into slice
+	quint32 m_frameStride; //A frame starts every m_frameStride samples
+	CPX *m_frame;
+	CPX *m_fftBuf;
+	double *m_window;
+	double m_windowGain;
+	double *m_sliceMax; //dB
+	CPX *m_cpxBuf; //PCM converted for addSamples()
+
+	//In house radix 2, FFT backends differ in sign and I/Q order and some aren't safe to plan off the main thread
+	CPX *m_twiddle;
+	quint32 *m_bitReverse;
+
+	void startSlice();
+	void endSlice();
+	void fftFrame();
+	void buildPyramid();
+};
+
+//Builds overview for an existing recording on its own thread, one job run to the end so not a PollingWorker
+//stop() makes build() give up early
+class PEBBLELIBSHARED_EXPORT IQOverviewBuilder : public QObject
+{
+	Q_OBJECT
+public:
+	IQOverviewBuilder(QString _recording);
+	void arm() {m_isRunning = true;}
+	void stop() {m_isRunning = false;}
+	bool isDone() {return m_isDone.loadAcquire() != 0;}
+
+public slots:
+	void start();
+
+signals:
+	void finished(bool _success);
+
+private:
+	QString m_recording;
+	volatile bool m_isRunning;
+	QAtomicInteger<int> m_isDone;
+};
+
+#endif // IQOVERVIEW_H
@@ -0,0 +1,188 @@
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "iqrecorder.h"
+#include <QDebug>
+#include <QDateTime>
+#ifdef Q_OS_LINUX
+#include <sys/mman.h>
+#endif
+
+//Transparent huge page size on x86 and most arm64 kernels
+const quint64 c_arenaAlign = 2097152;
+
+IQRecorder::IQRecorder(quint32 _sampleRate, quint32 _historySecs)
+{
+	m_sampleRate = qMax((quint32)1, _sampleRate);
+	m_historySamples = (quint64)qMin(_historySecs, c_maxHistorySecs) * m_sampleRate;
+
+	//History plus enough slack that the writer can fall behind by a disk stall without being lapped
+	quint64 slack = (quint64)c_slackSecs * m_sampleRate + c_maxWriteChunk;
+	quint64 maxSamples = c_maxArenaBytes / sizeof(PCM_DATA_2CH);
+	if (m_historySamples + slack > maxSamples) {
+		m_historySamples = maxSamples - slack;
+		qDebug()<<"IQRecorder: history limited to "<<m_historySamples / m_sampleRate<<" seconds";
+	}
+	m_arenaBytes = (m_historySamples + slack) * sizeof(PCM_DATA_2CH);
+	m_arenaBytes = (m_arenaBytes + c_arenaAlign - 1) / c_arenaAlign * c_arenaAlign;
+	m_arena = NULL;
+	m_isWriting.store(0);
+	//Without history there is nothing to collect until REC is pressed
+	if (m_historySamples > 0 && allocateArena())
+		m_isWriting.storeRelease(1);
+
+	m_readCount = 0;
+	m_drainBuf = new PCM_DATA_2CH[c_maxDrain];
+	m_droppedSamples.store(0);
+
+	m_isCompressed = false;
+	m_isRecording = false;
+	//Caught up, a few blocks will arrive before we look again
+	m_worker = new PollingWorker("PebbleIQRecorder", [this]() {return drain();}, 20);
+}
+
+//UI thread, producer isn't writing yet
+bool IQRecorder::allocateArena()
+{
+	if (m_arena != NULL)
+		return true;
+	void *buf = NULL;
+	if (posix_memalign(&buf, c_arenaAlign, m_arenaBytes) != 0)
+		buf = NULL;
+	m_arena = (PCM_DATA_2CH *)buf;
+	if (m_arena == NULL) {
+		qDebug()<<"IQRecorder: unable to allocate "<<m_arenaBytes<<" bytes";
+		m_historySamples = 0;
+		return false;
+	}
+#ifdef Q_OS_LINUX
+	//Hint only, fewer TLB misses on a ring this size.  Ignored if THP is disabled
+	madvise(m_arena, m_arenaBytes, MADV_HUGEPAGE);
+#endif
+	//Touch every page now so the DSP thread never takes a page fault
+	memset(m_arena, 0, m_arenaBytes);
+	m_ring.setBuffer(m_arena, m_arenaBytes / sizeof(PCM_DATA_2CH), c_maxWriteChunk);
+	return true;
+}
+
+IQRecorder::~IQRecorder()
+{
+	stopRecording();
+	delete m_worker;
+	if (m_arena != NULL)
+		free(m_arena);
+	delete[] m_drainBuf;
+}
+
+//Same scaling as WavFile::WriteSamples(CPX *), but clipped instead of wrapping
+static void cpxToPcm(const CPX *_in, PCM_DATA_2CH *_out, quint32 _numSamples)
+{
+	double re;
+	double im;
+	for (quint32 i = 0; i < _numSamples; i++) {
+		re = _in[i].real() * 32767;
+		im = _in[i].imag() * 32767;
+		re = re > 32767 ? 32767 : (re < -32767 ? -32767 : re);
+		im = im > 32767 ? 32767 : (im < -32767 ? -32767 : im);
+		_out[i].left = (qint16)re;
+		_out[i].right = (qint16)im;
+	}
+}
+
+void IQRecorder::write(const CPX *_in, quint32 _numSamples)
+{
+	if (!m_isWriting.loadAcquire())
+		return;
+	m_ring.write(_in, _numSamples, cpxToPcm);
+}
+
+bool IQRecorder::startRecording(QString _fileName, quint32 _loFreq, quint8 _mode, bool _compressed)
+{
+	if (m_isRecording)
+		stopRecording();
+	if (!allocateArena())
+		return false;
+	m_isCompressed = _compressed;
+	if (m_isCompressed) {
+		if (!m_iqFile.openWrite(_fileName, m_sampleRate, _loFreq, _mode))
+			return false;
+	} else if (!m_wavFile.OpenWrite(_fileName, m_sampleRate, _loFreq, _mode, 0)) {
+		return false;
+	}
+
+	//Back up by as much history as we have, at startup the ring may not be full yet
+	//Without history we start with the next block the producer writes
+	m_isWriting.storeRelease(1);
+	quint64 end = m_ring.writeCount();
+	m_readCount = end - qMin(end, m_historySamples);
+	m_droppedSamples.store(0);
+	qint64 startUtcMs = QDateTime::currentMSecsSinceEpoch() - (qint64)((end - m_readCount) * 1000 / m_sampleRate);
+	m_overview.begin(m_sampleRate, _loFreq, startUtcMs);
+	m_overviewFileName = IQOverview::fileNameFor(_fileName);
+
+	m_isRecording = true;
+	m_worker->start();
+	return true;
+}
+
+void IQRecorder::stopRecording()
+{
+	if (!m_isRecording)
+		return;
+	m_worker->stop();
+
+	//Everything up to the moment REC was released, producer may still be running
+	quint64 stopAt = m_ring.writeCount();
+	while (m_readCount < stopAt && drainTo(stopAt))
+		;
+	if (m_isCompressed)
+		m_iqFile.close();
+	else
+		m_wavFile.Close();
+	m_overview.save(m_overviewFileName);
+	m_isRecording = false;
+	if (m_historySamples == 0)
+		m_isWriting.store(0);
+	if (m_droppedSamples.load() > 0)
+		qDebug()<<"IQRecorder: dropped "<<m_droppedSamples.load()<<" samples, disk too slow";
+}
+
+bool IQRecorder::drain()
+{
+	return drainTo(m_ring.writeCount());
+}
+
+bool IQRecorder::drainTo(quint64 _end)
+{
+	if (_end <= m_readCount)
+		return false;
+
+	//Producer may be overwriting the oldest c_maxWriteChunk samples right now
+	quint64 oldestSafe = m_ring.oldestSafe();
+	if (m_readCount < oldestSafe) {
+		m_droppedSamples.fetchAndAddRelaxed(oldestSafe - m_readCount);
+		m_overview.addGap(oldestSafe - m_readCount);
+		m_readCount = oldestSafe;
+		if (m_readCount >= _end)
+			return true;
+	}
+
+	quint32 numSamples = qMin(_end - m_readCount, (quint64)c_maxDrain);
+	m_ring.read(m_readCount, m_drainBuf, numSamples);
+
+	//Check producer didn't lap us while we were copying, if it did the copy can't be trusted
+	if (m_ring.isLapped(m_readCount)) {
+		m_droppedSamples.fetchAndAddRelaxed(numSamples);
+		m_overview.addGap(numSamples);
+		m_readCount += numSamples;
+		return true;
+	}
+
+	if (m_isCompressed)
+		m_iqFile.writeSamples(m_drainBuf, numSamples);
+	else
+		m_wavFile.WriteSamples(m_drainBuf, numSamples);
+	m_overview.addSamples(m_drainBuf, numSamples);
+	m_readCount += numSamples;
+	return true;
+}
+
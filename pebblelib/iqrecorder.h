@@ -0,0 +1,95 @@
+#ifndef IQRECORDER_H
+#define IQRECORDER_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "cpx.h"
+#include "wavfile.h"
+#include "iqfile.h"
+#include "iqoverview.h"
+#include "spscring.h"
+#include "pollingworker.h"
+#include <QObject>
+#include <QAtomicInteger>
+
+/*
+	IQ recording with pre-trigger history ("time machine")
+
+	Recording used to start when REC was pressed and wrote to disk from the DSP thread, so the start of short
+	transmissions was always lost and a slow disk could stall the whole receiver.
+
+	History
+		Opt in (RecordHistorySecs), off by default.  When on, DSP thread writes every block into one ring whether
+		we are recording or not.  Ring holds m_historySecs of IQ plus slack for the disk writer, so when REC is
+		pressed the last m_historySecs are already in memory and are written to the file ahead of the live samples
+		When off, write() does nothing (no 16 bit conversion) until REC is pressed and the ring is only the slack
+
+	Ring
+		Samples are stored in the same 16 bit L/R format WavFile writes, 4 bytes per sample instead of 16 for CPX
+		One arena, aligned and sized in 2mb units so Linux can back it with huge pages
+		Allocated and prefaulted up front with history, on the first startRecording() without.  Kept until deleted
+		SpscStreamRing over the arena, no locks.  Producer publishes after each c_maxWriteChunk
+
+	Writer
+		PollingWorker thread copies from the ring to the file at its own pace
+		If the disk falls so far behind that the producer laps it, the lost samples are skipped and counted
+		Compressed (.piq, see iqfile.h) recordings are encoded here too, so compression costs the DSP thread nothing
+		Overview sidecar (see iqoverview.h) is built from the same samples as they are written and saved on stop
+*/
+
+class PEBBLELIBSHARED_EXPORT IQRecorder : public QObject
+{
+	Q_OBJECT
+public:
+	static const quint32 c_maxHistorySecs = 600;
+	static const quint32 c_maxWriteChunk = 65536; //Largest block producer writes before publishing count
+	static const quint32 c_maxDrain = 262144; //Samples per file write, 1mb
+	static const quint32 c_slackSecs = 2; //Disk stall we can absorb while recording
+	static const quint64 c_maxArenaBytes = 2147483648ULL; //2gb, limits history at high sample rates
+
+	IQRecorder(quint32 _sampleRate, quint32 _historySecs);
+	~IQRecorder();
+
+	//DSP thread, every block.  Converts to 16 bit and copies if keeping history or recording, never blocks
+	void write(const CPX *_in, quint32 _numSamples);
+
+	//UI thread.  File starts with up to historySecs() of samples from before the call
+	//_compressed writes a .piq file instead of wav
+	bool startRecording(QString _fileName, quint32 _loFreq, quint8 _mode, bool _compressed = false);
+	//UI thread.  Writes everything received up to now, then closes the file
+	void stopRecording();
+	bool isRecording() {return m_isRecording;}
+
+	//Actual history, may be less than requested if arena was limited
+	quint32 historySecs() {return m_historySamples / m_sampleRate;}
+	//Samples lost because the writer was lapped
+	quint64 droppedSamples() {return m_droppedSamples.load();}
+
+private:
+	quint32 m_sampleRate;
+	quint64 m_historySamples;
+
+	PCM_DATA_2CH *m_arena;
+	quint64 m_arenaBytes;
+	SpscStreamRing<PCM_DATA_2CH> m_ring; //Over m_arena
+	QAtomicInt m_isWriting; //Producer fills the ring.  Released after m_arena is set
+
+	//Writer state, only touched by worker while it is running
+	quint64 m_readCount;
+	PCM_DATA_2CH *m_drainBuf;
+	WavFile m_wavFile;
+	IQFile m_iqFile;
+	bool m_isCompressed;
+	IQOverview m_overview;
+	QString m_overviewFileName;
+	QAtomicInteger<quint64> m_droppedSamples;
+
+	bool m_isRecording;
+	PollingWorker *m_worker;
+
+	bool allocateArena();
+	//Worker, returns false if nothing was written
+	bool drain();
+	bool drainTo(quint64 _end);
+};
+
+#endif // IQRECORDER_H
@@ -0,0 +1,364 @@
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "largespectrum.h"
+#include "db.h"
+#include "fastmath.h"
+#include <QRunnable>
+#include <QDebug>
+
+//Runs one slice of rows on the pool
+class LargeSpectrumJob : public QRunnable
+{
+public:
+	LargeSpectrumJob(std::function<void()> _job) {m_job = _job;}
+	void run() {m_job();}
+private:
+	std::function<void()> m_job;
+};
+
+LargeSpectrum::LargeSpectrum(quint32 _sampleRate, quint32 _fftSize, quint32 _numAverages, quint32 _updateMs)
+{
+	m_sampleRate = _sampleRate;
+
+	m_fftSize = c_minFFTSize;
+	m_log2Size = 16;
+	while (m_fftSize * 2 <= _fftSize && m_fftSize * 2 <= c_maxFFTSize) {
+		m_fftSize *= 2;
+		m_log2Size++;
+	}
+	if (m_fftSize != _fftSize)
+		qDebug()<<"LargeSpectrum: fft size "<<_fftSize<<" not supported, using "<<m_fftSize;
+	m_hop = m_fftSize / 2;
+
+	//Ring holds all the segments for one update plus one more segment of slack for the producer
+	m_numAverages = qBound((quint32)1, _numAverages, c_maxAverages);
+	m_numAverages = qMin(m_numAverages, (c_maxRingSize - 2 * m_fftSize) / m_hop + 1);
+	quint32 needed = m_fftSize + (m_numAverages - 1) * m_hop + m_fftSize;
+	m_ringSize = m_fftSize;
+	while (m_ringSize < needed)
+		m_ringSize *= 2;
+	CPX *ring = memalign(m_ringSize);
+	clearCPX(ring, m_ringSize);
+	m_ring.setBuffer(ring, m_ringSize, c_maxWriteChunk);
+	m_lastEnd = 0;
+
+	//Square (or 2:1) split so rows are as short as possible
+	m_n1 = 1 << (m_log2Size / 2);
+	m_n2 = m_fftSize / m_n1;
+	initRowFFT(m_rowN1, m_n1);
+	initRowFFT(m_rowN2, m_n2);
+	m_twiddleLo = memalign(m_n1);
+	for (quint32 i = 0; i < m_n1; i++)
+		m_twiddleLo[i] = CPX(cos(TWOPI * i / m_fftSize), -sin(TWOPI * i / m_fftSize));
+	m_twiddleHi = memalign(m_n2);
+	for (quint32 i = 0; i < m_n2; i++)
+		m_twiddleHi[i] = CPX(cos(TWOPI * i * m_n1 / m_fftSize), -sin(TWOPI * i * m_n1 / m_fftSize));
+	m_work = memalign(m_fftSize);
+
+	//4 term Blackman-Harris, same coefficients as WindowFunction::BLACKMANHARRIS
+	m_window = new double[m_fftSize];
+	double sumCoeff = 0;
+	double sumSquares = 0;
+	for (quint32 i = 0; i < m_fftSize; i++) {
+		double x = TWOPI * i / (m_fftSize - 1);
+		m_window[i] = 0.35875 - 0.48829 * cos(x) + 0.14128 * cos(2 * x) - 0.01168 * cos(3 * x);
+		sumCoeff += m_window[i];
+		sumSquares += m_window[i] * m_window[i];
+	}
+	m_coherentGain = sumCoeff / m_fftSize;
+	//In bins, ~2.0 for 4 term Blackman-Harris
+	m_equivalentNoiseBW = m_fftSize * sumSquares / (sumCoeff * sumCoeff);
+	m_power = new double[m_fftSize];
+
+	m_result = new double[m_fftSize];
+	m_resultBack = new double[m_fftSize];
+	m_hasResult = false;
+	m_isOverload.store(0);
+	m_overruns.store(0);
+
+	//Leave a core for the DSP thread
+	m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+	m_numJobs = m_pool.maxThreadCount();
+	m_cols = memalign(m_n2 * c_rowBlock * m_numJobs);
+
+	m_updateMs = 0;
+	setUpdateMs(_updateMs);
+	m_isRunning = false;
+	m_worker = new PollingWorker("PebbleLargeSpectrum", [this]() {return computeSpectrum();}, 5);
+}
+
+LargeSpectrum::~LargeSpectrum()
+{
+	//No timeout, worker may be in the middle of a large FFT and we are about to free its buffers
+	delete m_worker;
+	freeRowFFT(m_rowN1);
+	freeRowFFT(m_rowN2);
+	free(m_ring.buffer());
+	free(m_twiddleLo);
+	free(m_twiddleHi);
+	free(m_work);
+	free(m_cols);
+	delete[] m_window;
+	delete[] m_power;
+	delete[] m_result;
+	delete[] m_resultBack;
+}
+
+void LargeSpectrum::setUpdateMs(quint32 _updateMs)
+{
+	m_updateMs = qBound((quint32)10, _updateMs, (quint32)60000);
+}
+
+void LargeSpectrum::start()
+{
+	if (m_isRunning)
+		return;
+	m_isRunning = true;
+	//Display only, DSP and audio threads come first
+	m_worker->start(QThread::LowPriority);
+}
+
+void LargeSpectrum::stop()
+{
+	if (!m_isRunning)
+		return;
+	//No timeout, worker may be in the middle of a large FFT
+	m_worker->stop();
+	m_isRunning = false;
+}
+
+void LargeSpectrum::write(const CPX *_in, quint32 _numSamples)
+{
+	m_ring.write(_in, _numSamples);
+}
+
+void LargeSpectrum::initRowFFT(RowFFT &_row, quint32 _size)
+{
+	_row.size = _size;
+	_row.log2Size = 0;
+	while ((1u << _row.log2Size) < _size)
+		_row.log2Size++;
+	_row.twiddle = memalign(_size / 2);
+	for (quint32 i = 0; i < _size / 2; i++)
+		_row.twiddle[i] = CPX(cos(TWOPI * i / _size), -sin(TWOPI * i / _size));
+	_row.bitReverse = new quint32[_size];
+	for (quint32 i = 0; i < _size; i++) {
+		quint32 r = 0;
+		for (quint32 b = 0; b < _row.log2Size; b++)
+			r |= ((i >> b) & 1) << (_row.log2Size - 1 - b);
+		_row.bitReverse[i] = r;
+	}
+}
+
+void LargeSpectrum::freeRowFFT(RowFFT &_row)
+{
+	free(_row.twiddle);
+	delete[] _row.bitReverse;
+}
+
+//In place forward DFT, standard sign.  Complex multiplies are written out so compiler doesn't call __muldc3
+void LargeSpectrum::rowFFT(const RowFFT &_row, CPX *_buf)
+{
+	quint32 n = _row.size;
+	double *buf = reinterpret_cast<double *>(_buf);
+	const double *tw = reinterpret_cast<const double *>(_row.twiddle);
+	double tr, ti, wr, wi;
+	quint32 a, b;
+
+	for (quint32 i = 0; i < n; i++) {
+		quint32 j = _row.bitReverse[i];
+		if (j > i)
+			std::swap(_buf[i], _buf[j]);
+	}
+	for (quint32 size = 2, step = n / 2; size <= n; size *= 2, step /= 2) {
+		quint32 half = size / 2;
+		for (quint32 i = 0; i < n; i += size) {
+			for (quint32 j = 0; j < half; j++) {
+				wr = tw[2 * j * step];
+				wi = tw[2 * j * step + 1];
+				a = 2 * (i + j);
+				b = 2 * (i + j + half);
+				tr = buf[b] * wr - buf[b + 1] * wi;
+				ti = buf[b] * wi + buf[b + 1] * wr;
+				buf[b] = buf[a] - tr;
+				buf[b + 1] = buf[a + 1] - ti;
+				buf[a] += tr;
+				buf[a + 1] += ti;
+			}
+		}
+	}
+}
+
+//Splits _numRows into one slice per pool thread and waits for all of them
+//Slices are a multiple of c_rowBlock, _numRows always is.  _job is 0..m_numJobs-1, unique among running slices
+void LargeSpectrum::parallelRows(quint32 _numRows, std::function<void(quint32 _job, quint32 _first, quint32 _last)> _rows)
+{
+	quint32 perJob = (_numRows + m_numJobs - 1) / m_numJobs;
+	perJob = (perJob + c_rowBlock - 1) & ~(c_rowBlock - 1);
+	quint32 job = 0;
+	for (quint32 first = 0; first < _numRows; first += perJob, job++) {
+		quint32 last = qMin(first + perJob, _numRows);
+		m_pool.start(new LargeSpectrumJob([=]() {_rows(job, first, last);}));
+	}
+	m_pool.waitForDone();
+}
+
+//Windowed FFT of N samples starting at _segStart, power is added to m_power
+//Returns false if producer overwrote part of the segment while we were reading it
+bool LargeSpectrum::fftSegment(quint64 _segStart)
+{
+	const quint32 n1 = m_n1;
+	const quint32 n2 = m_n2;
+	const quint32 log2N1 = m_rowN1.log2Size;
+
+	//Step 1: row n2 = x[n1 * N2 + n2], n1 = 0..N1-1
+	//Gathers c_rowBlock rows at a time so each input cache line is used for more than one sample
+	parallelRows(n2, [&](quint32 _job, quint32 _first, quint32 _last) {
+		Q_UNUSED(_job);
+		bool isOver = false;
+		for (quint32 row0 = _first; row0 < _last; row0 += c_rowBlock) {
+			for (quint32 i = 0; i < n1; i++) {
+				for (quint32 r = 0; r < c_rowBlock; r++) {
+					quint32 n = i * n2 + row0 + r;
+					CPX s = m_ring.at(_segStart + n);
+					if (fabs(s.real()) >= 1.0 || fabs(s.imag()) >= 1.0)
+						isOver = true;
+					m_work[(row0 + r) * n1 + i] = s * m_window[n];
+				}
+			}
+			for (quint32 row = row0; row < row0 + c_rowBlock; row++) {
+				CPX *out = &m_work[row * n1];
+				rowFFT(m_rowN1, out);
+				//Twiddle W(N)^(row * k1), exponent is < N so split into hi * N1 + lo for two small tables
+				for (quint32 k1 = 1; k1 < n1; k1++) {
+					quint32 m = row * k1;
+					CPX w = m_twiddleHi[m >> log2N1] * m_twiddleLo[m & (n1 - 1)];
+					out[k1] *= w;
+				}
+			}
+		}
+		if (isOver)
+			m_isOverload.store(1);
+	});
+
+	if (m_ring.isLapped(_segStart))
+		return false;
+
+	//Step 2: column k1 of step 1 is a row of length N2, output bin k = k1 + N1 * k2
+	//Same blocking, c_rowBlock adjacent columns in and c_rowBlock adjacent bins out
+	parallelRows(n1, [&](quint32 _job, quint32 _first, quint32 _last) {
+		CPX *cols = &m_cols[_job * n2 * c_rowBlock];
+		for (quint32 k0 = _first; k0 < _last; k0 += c_rowBlock) {
+			for (quint32 i = 0; i < n2; i++) {
+				for (quint32 c = 0; c < c_rowBlock; c++)
+					cols[c * n2 + i] = m_work[i * n1 + k0 + c];
+			}
+			for (quint32 c = 0; c < c_rowBlock; c++)
+				rowFFT(m_rowN2, &cols[c * n2]);
+			//Unfold to -f..0..+f as we go
+			for (quint32 k2 = 0; k2 < n2; k2++) {
+				for (quint32 c = 0; c < c_rowBlock; c++) {
+					quint32 bin = (k0 + c + n1 * k2 + m_hop) & (m_fftSize - 1);
+					CPX x = cols[c * n2 + k2];
+					m_power[bin] += x.real() * x.real() + x.imag() * x.imag();
+				}
+			}
+		}
+	});
+	return true;
+}
+
+bool LargeSpectrum::computeSpectrum()
+{
+	if (m_updateTimer.isValid() && m_updateTimer.elapsed() < m_updateMs)
+		return false;
+
+	quint64 end = m_ring.writeCount();
+	if (end < m_fftSize || end == m_lastEnd)
+		return false;
+
+	//As many segments as we have, up to numAverages, ending at the newest sample
+	quint64 avail = qMin(end, (quint64)(m_ringSize - 2 * c_maxWriteChunk));
+	quint32 numSegments = qMin((quint64)m_numAverages, 1 + (avail - m_fftSize) / m_hop);
+	quint64 start = end - m_fftSize - (quint64)(numSegments - 1) * m_hop;
+
+	memset(m_power, 0, m_fftSize * sizeof(double));
+	m_isOverload.store(0);
+	for (quint32 s = 0; s < numSegments; s++) {
+		if (!fftSegment(start + (quint64)s * m_hop)) {
+			//We were too slow, try again with newer samples
+			m_overruns.fetchAndAddRelaxed(1);
+			return false;
+		}
+	}
+
+	//Same normalization as FFT::calcPowerAverages(), full scale sine is 0db
+	double norm = 1.0 / (numSegments * m_coherentGain * m_coherentGain * (double)m_fftSize * (double)m_fftSize);
+	for (quint32 i = 0; i < m_fftSize; i++)
+		m_resultBack[i] = m_power[i] * norm;
+	FastMath::powerToDbArray(m_resultBack, m_resultBack, m_fftSize, true);
+
+	m_resultMutex.lock();
+	std::swap(m_result, m_resultBack);
+	m_hasResult = true;
+	m_resultMutex.unlock();
+
+	m_lastEnd = end;
+	m_updateTimer.start();
+	emit newSpectrum();
+	return true;
+}
+
+bool LargeSpectrum::mapToScreen(qint32 _yPixels, qint32 _xPixels, double _maxdB, double _mindB,
+	qint32 _startFreq, qint32 _stopFreq, qint32 *_outBuf)
+{
+	if (!m_hasResult || _xPixels <= 0)
+		return false;
+
+	double binsPerHz = (double)m_fftSize / m_sampleRate;
+	qint64 binLow = (qint64)(_startFreq * binsPerHz) + m_fftSize / 2;
+	qint64 binHigh = (qint64)(_stopFreq * binsPerHz) + m_fftSize / 2;
+	double binsPerPixel = (double)(binHigh - binLow) / _xPixels;
+	double yScaleFactor = -_yPixels / (_maxdB - _mindB);
+	qint64 first;
+	qint64 last;
+	double powerdB;
+	qint32 yPixel;
+
+	m_resultMutex.lock();
+	for (qint32 i = 0; i < _xPixels; i++) {
+		first = binLow + (qint64)(i * binsPerPixel);
+		last = binLow + (qint64)((i + 1) * binsPerPixel);
+		if (last <= first)
+			last = first + 1; //More pixels than bins
+		first = qMax(first, (qint64)0);
+		last = qMin(last, (qint64)m_fftSize);
+		powerdB = DB::minDb;
+		for (qint64 bin = first; bin < last; bin++)
+			powerdB = qMax(powerdB, m_result[bin]);
+		yPixel = (yScaleFactor * (powerdB - _maxdB)) - 1;
+		_outBuf[i] = qBound(0, yPixel, _yPixels - 1);
+	}
+	m_resultMutex.unlock();
+	return true;
+}
+
+bool LargeSpectrum::reduce(double *_out, quint32 _numBins)
+{
+	if (!m_hasResult || _numBins == 0 || m_fftSize % _numBins != 0)
+		return false;
+
+	//Sum of the bins a carrier's main lobe falls in is ENBW times its power
+	quint32 combine = m_fftSize / _numBins;
+	double power;
+	m_resultMutex.lock();
+	for (quint32 i = 0; i < _numBins; i++) {
+		power = 0;
+		for (quint32 j = 0; j < combine; j++)
+			power += DB::dBToPower(m_result[i * combine + j]);
+		_out[i] = DB::clip(DB::powerTodB(power / m_equivalentNoiseBW));
+	}
+	m_resultMutex.unlock();
+	return true;
+}
+
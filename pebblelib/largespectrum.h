@@ -0,0 +1,147 @@
+#ifndef LARGESPECTRUM_H
+#define LARGESPECTRUM_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "cpx.h"
+#include "spscring.h"
+#include "pollingworker.h"
+#include <QObject>
+#include <QThreadPool>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QAtomicInteger>
+#include <functional>
+
+/*
+	High resolution spectrum for narrow signal hunting on wide captures, 64K to 4M point FFTs with Welch averaging
+
+	FFT is capped at 65535 and SignalSpectrum does one FFT per update on the DSP thread.  A 4M point FFT takes
+	longer than a buffer at any useful sample rate, so here the DSP thread only copies samples into a ring and
+	everything else happens on a worker thread at its own pace.
+
+	Ring
+		SpscStreamRing, DSP thread writes in chunks of at most c_maxWriteChunk.  No locks, if the worker falls behind
+		it just reads more recent samples.  Worker checks after reading a segment that the producer didn't lap it,
+		and discards the update if it did
+
+	Welch
+		Up to m_numAverages segments of N samples, 50% overlap, Blackman-Harris window, power averaged
+		Segments are the most recent samples in the ring when the update is due
+
+	FFT
+		Four step (Bailey) N = N1 * N2, both powers of 2 and <= 2048 for N = 4M so rows fit in L1/L2 cache
+		1. N2 row FFTs of length N1 on the input gathered with stride N2, times twiddle W(N)^(n2*k1)
+		2. N1 row FFTs of length N2 on the columns of step 1, output bin is k1 + N1 * k2
+		Rows are independent and are split across a private thread pool, so the worker scales with cores
+		Row FFTs are radix 2 in house, FFT backends differ in sign and I/Q order and have a size limit
+
+	Results
+		dB spectrum in -f..0..+f order, same amplitude scaling as FFT::calcPowerAverages() so levels match
+		Double buffered, worker fills the back buffer and swaps under m_resultMutex.  Readers hold the mutex
+		while mapping so the worker never writes a buffer that is being read.  DSP thread never takes the mutex.
+*/
+
+class PEBBLELIBSHARED_EXPORT LargeSpectrum : public QObject
+{
+	Q_OBJECT
+public:
+	static const quint32 c_minFFTSize = 65536;
+	static const quint32 c_maxFFTSize = 4194304; //2^22
+	static const quint32 c_maxAverages = 16;
+	static const quint32 c_maxWriteChunk = 65536; //Largest block producer writes before publishing count
+	static const quint32 c_maxRingSize = 16777216; //2^24 samples, 256mb.  Limits averages at 4M
+	static const quint32 c_rowBlock = 8; //Rows gathered together in four step, 8 CPX = 2 cache lines
+
+	//_fftSize is rounded down to a power of 2, _numAverages and _updateMs are limited to supported range
+	LargeSpectrum(quint32 _sampleRate, quint32 _fftSize, quint32 _numAverages, quint32 _updateMs);
+	~LargeSpectrum();
+
+	quint32 sampleRate() {return m_sampleRate;}
+	quint32 fftSize() {return m_fftSize;}
+	quint32 numAverages() {return m_numAverages;}
+	void setUpdateMs(quint32 _updateMs);
+
+	void start();
+	void stop();
+
+	//DSP thread, copies samples into ring and never blocks
+	void write(const CPX *_in, quint32 _numSamples);
+
+	//True once at least one spectrum has been published
+	bool hasResult() {return m_hasResult;}
+	//True if any sample in last published spectrum was >= 1.0
+	bool isOverload() {return m_isOverload.load() != 0;}
+	//Updates discarded because producer lapped the worker
+	quint32 overruns() {return m_overruns.load();}
+
+	//Same arguments and output as FFT::mapFFTToScreen()
+	//Bins are combined with peak hold, averaging thousands of 1hz bins per pixel would bury the carriers we're looking for
+	bool mapToScreen(qint32 _yPixels, qint32 _xPixels, double _maxdB, double _mindB,
+		qint32 _startFreq, qint32 _stopFreq, qint32 *_outBuf);
+	//Last result combined into _numBins in -f..0..+f order, for code that wants a normal size spectrum
+	//Carrier levels are preserved so signal strength reads the same as with the normal spectrum
+	//_numBins must divide fftSize
+	bool reduce(double *_out, quint32 _numBins);
+
+signals:
+	//Emitted from worker thread, connect queued
+	void newSpectrum();
+
+private:
+	//Radix 2 FFT for one row of the four step FFT
+	struct RowFFT {
+		quint32 size;
+		quint32 log2Size;
+		CPX *twiddle; //size/2, e^(-j*2*pi*k/size)
+		quint32 *bitReverse; //size
+	};
+
+	quint32 m_sampleRate;
+	quint32 m_fftSize; //N
+	quint32 m_log2Size;
+	quint32 m_numAverages;
+	quint32 m_hop; //N/2, 50% overlap
+	quint32 m_updateMs;
+	bool m_isRunning;
+
+	SpscStreamRing<CPX> m_ring;
+	quint32 m_ringSize;
+	quint64 m_lastEnd; //Ring write count used for last published spectrum
+
+	//Four step
+	quint32 m_n1;
+	quint32 m_n2;
+	RowFFT m_rowN1;
+	RowFFT m_rowN2;
+	CPX *m_twiddleLo; //N1, W(N)^m for m < N1
+	CPX *m_twiddleHi; //N2, W(N)^(m*N1)
+	CPX *m_work; //N, row n2 of step 1 is m_work[n2 * N1 .. n2 * N1 + N1-1]
+	double *m_window; //N
+	double m_coherentGain;
+	double m_equivalentNoiseBW;
+	double *m_power; //N, Welch accumulator in -f..+f order
+
+	QThreadPool m_pool;
+	quint32 m_numJobs;
+	CPX *m_cols; //N2 * c_rowBlock per job, step 2 column gather.  Allocated once, not per segment
+
+	QMutex m_resultMutex;
+	double *m_result; //Front, readers
+	double *m_resultBack; //Back, worker
+	bool m_hasResult;
+	QAtomicInt m_isOverload;
+	QAtomicInteger<quint32> m_overruns;
+	QElapsedTimer m_updateTimer;
+
+	PollingWorker *m_worker;
+
+	//Worker, returns false if nothing was done
+	bool computeSpectrum();
+	void initRowFFT(RowFFT &_row, quint32 _size);
+	void freeRowFFT(RowFFT &_row);
+	static void rowFFT(const RowFFT &_row, CPX *_buf);
+	void parallelRows(quint32 _numRows, std::function<void(quint32 _job, quint32 _first, quint32 _last)> _rows);
+	bool fftSegment(quint64 _segStart);
+};
+
+#endif // LARGESPECTRUM_H
@@ -94,6 +94,11 @@ win32 {
     SOURCES += hid-win.c
 
 }
+
+unix:!macx {
+    #shm_open for shmiqbus on older glibc
+    LIBS += -lrt
+}
 SOURCES += pebblelib.cpp \
     cpx.cpp \
     fldigifilters.cpp \
@@ -103,18 +108,33 @@ SOURCES += pebblelib.cpp \
     fftooura.cpp \
     fftcute.cpp \
     fft.cpp \
+    fftregistry.cpp \
+    fastmath.cpp \
     iir.cpp \
     producerconsumer.cpp \
+    udpingest.cpp \
+    pollingworker.cpp \
+    cicdecimator.cpp \
+    freqdomainfrontend.cpp \
+    largespectrum.cpp \
     perform.cpp \
     usbutil.cpp \
     deviceinterfacebase.cpp \
     audio.cpp \
     audioqt.cpp \
+    audiooutputring.cpp \
     alawcompression.cpp \
     fftaccelerate.cpp \
     audiopa.cpp \
     pebblelib_global.cpp \
     wavfile.cpp \
+    iqrecorder.cpp \
+    iqfile.cpp \
+    iqoverview.cpp \
+    probe.cpp \
+    reblocker.cpp \
+    stagingring.cpp \
+    shmiqbus.cpp \
     delayline.cpp \
     firfilter.cpp \
     iirfilter.cpp \
@@ -123,8 +143,10 @@ SOURCES += pebblelib.cpp \
     butterworth.cpp \
     windowfunction.cpp \
     fastfir.cpp \
+    filterdesigncache.cpp \
     decimator.cpp \
     goertzel.cpp \
+    synthgen.cpp \
     movingavgfilter.cpp \
     nco.cpp \
     mixer.cpp \
@@ -144,20 +166,37 @@ HEADERS += pebblelib.h\
     fftooura.h \
     fftcute.h \
     fft.h \
+    fftregistry.h \
+    fastmath.h \
     iir.h \
     device_interfaces.h \
     producerconsumer.h \
+    udpingest.h \
+    pollingworker.h \
+    spscring.h \
+    cicdecimator.h \
+    freqdomainfrontend.h \
+    largespectrum.h \
     perform.h \
     usbutil.h \
     deviceinterfacebase.h \
     hidapi.h \
     audio.h \
     audioqt.h \
+    audiooutputring.h \
     alawcompression.h \
     fftaccelerate.h \
     medianfilter.h \
     audiopa.h \
     wavfile.h \
+    iqrecorder.h \
+    iqfile.h \
+    iqoverview.h \
+    probe.h \
+    reblocker.h \
+    stagingring.h \
+    shmiqbus.h \
+    triplebuffer.h \
     delayline.h \
     firfilter.h \
     iirfilter.h \
@@ -166,8 +205,10 @@ HEADERS += pebblelib.h\
     butterworth.h \
     windowfunction.h \
     fastfir.h \
+    filterdesigncache.h \
     decimator.h \
     goertzel.h \
+    synthgen.h \
     movingavgfilter.h \
     nco.h \
     mixer.h \
@@ -0,0 +1,55 @@
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "pollingworker.h"
+
+PollingWorker::PollingWorker(QString _name, Job _job, quint32 _idleMs)
+{
+	m_name = _name;
+	m_job = _job;
+	m_idleMs = _idleMs;
+	m_thread = NULL;
+	m_isRunning = false;
+}
+
+PollingWorker::~PollingWorker()
+{
+	stop();
+	//Not our child, we live in it
+	if (m_thread != NULL)
+		delete m_thread;
+}
+
+void PollingWorker::start(QThread::Priority _priority)
+{
+	if (m_thread == NULL) {
+		m_thread = new QThread();
+		m_thread->setObjectName(m_name);
+		connect(m_thread, &QThread::started, this, &PollingWorker::run);
+		//Only push once, worker stays with m_thread across stop/start
+		moveToThread(m_thread);
+	}
+	if (m_thread->isRunning())
+		return;
+	//Arm before the thread starts so a quick stop() can't be overwritten by the worker
+	m_isRunning = true;
+	m_thread->start();
+	if (_priority != QThread::InheritPriority)
+		m_thread->setPriority(_priority);
+}
+
+void PollingWorker::stop(unsigned long _waitMs)
+{
+	if (m_thread == NULL || !m_thread->isRunning())
+		return;
+	m_isRunning = false;
+	m_thread->quit();
+	m_thread->wait(_waitMs);
+}
+
+void PollingWorker::run()
+{
+	while (m_isRunning) {
+		if (!m_job())
+			QThread::msleep(m_idleMs);
+	}
+}
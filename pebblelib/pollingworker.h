@@ -0,0 +1,47 @@
+#ifndef POLLINGWORKER_H
+#define POLLINGWORKER_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "pebblelib_global.h"
+#include <QObject>
+#include <QThread>
+#include <functional>
+
+/*
+	Runs a job over and over on its own thread until stopped, for consumers of an SpscStreamRing or SpscSlotQueue
+	(see spscring.h) and other loops that can't use the producer's thread.
+
+	Job returns true if it did something and is called again right away, false if there was nothing to do and the
+	worker sleeps idleMs before trying again.  Jobs that block on their own (select() with a timeout) just return
+	true.  Job has to come back often enough for stop() to be honored, stop() waits for the job to return.
+
+	Same worker object / QThread::started pattern as ProducerWorker, the thread is created on first start() and
+	the worker stays with it across stop() and start()
+*/
+class PEBBLELIBSHARED_EXPORT PollingWorker : public QObject
+{
+	Q_OBJECT
+public:
+	typedef std::function<bool()> Job;
+
+	//_name is the thread name
+	PollingWorker(QString _name, Job _job, quint32 _idleMs);
+	~PollingWorker();
+
+	void start(QThread::Priority _priority = QThread::InheritPriority);
+	//Waits up to _waitMs for the job to return, default is until it does
+	void stop(unsigned long _waitMs = ULONG_MAX);
+	bool isRunning() {return m_thread != NULL && m_thread->isRunning();}
+
+private slots:
+	void run();
+
+private:
+	QString m_name;
+	Job m_job;
+	quint32 m_idleMs;
+	QThread *m_thread;
+	volatile bool m_isRunning;
+};
+
+#endif // POLLINGWORKER_H
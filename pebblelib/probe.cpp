@@ -0,0 +1,278 @@
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "probe.h"
+#include "db.h"
+#include <QDebug>
+
+ProbePoint::ProbePoint(int _id, QString _name)
+{
+	m_id = _id;
+	m_name = _name;
+	m_numSinks.store(0);
+	for (quint32 i = 0; i < c_numSlots; i++) {
+		Slot &slot = m_queue.slot(i);
+		slot.samples = new CPX[c_maxSamples];
+		slot.isCpx = true;
+		slot.profile = m_id;
+		slot.numSamples = 0;
+		slot.sampleRate = 0;
+		slot.blockNumber = 0;
+	}
+	m_nextBlock = 0;
+	m_droppedBlocks.store(0);
+}
+
+ProbePoint::~ProbePoint()
+{
+	for (quint32 i = 0; i < c_numSlots; i++)
+		delete[] m_queue.slot(i).samples;
+}
+
+void ProbePoint::publish(const CPX *_cpx, const double *_real, quint32 _numSamples, double _sampleRate, int _profile)
+{
+	if (_profile < 0)
+		_profile = m_id;
+	quint32 offset = 0;
+	quint32 numSamples;
+	Slot *slot;
+	do {
+		numSamples = qMin(_numSamples - offset, (quint32)c_maxSamples);
+		slot = m_queue.writeSlot();
+		if (slot == NULL) {
+			//Hub is a full ring behind, probe sees a gap in blockNumber
+			m_droppedBlocks.fetchAndAddRelaxed(1);
+		} else {
+			if (_cpx != NULL)
+				copyCPX(slot->samples, &_cpx[offset], numSamples);
+			else
+				memcpy(slot->samples, &_real[offset], numSamples * sizeof(double));
+			slot->isCpx = _cpx != NULL;
+			slot->profile = _profile;
+			slot->numSamples = numSamples;
+			slot->sampleRate = _sampleRate;
+			slot->blockNumber = m_nextBlock;
+			m_queue.commitWrite();
+		}
+		m_nextBlock++;
+		offset += numSamples;
+	} while (offset < _numSamples);
+}
+
+ProbeHub::ProbeHub()
+{
+	m_worker = new PollingWorker("PebbleProbe", [this]() {return process();}, c_idleMs);
+}
+
+ProbeHub::~ProbeHub()
+{
+	delete m_worker;
+	//Not qDeleteAll(), ~ProbePoint() is only visible to us
+	foreach (ProbePoint *p, m_points)
+		delete p;
+}
+
+ProbePoint *ProbeHub::addPoint(int _id, QString _name)
+{
+	ProbePoint *p = point(_id);
+	if (p != NULL)
+		return p;
+	p = new ProbePoint(_id, _name);
+	m_points.append(p);
+	return p;
+}
+
+ProbePoint *ProbeHub::point(int _id)
+{
+	foreach (ProbePoint *p, m_points) {
+		if (p->id() == _id)
+			return p;
+	}
+	return NULL;
+}
+
+ProbePoint *ProbeHub::findPoint(QString _name)
+{
+	foreach (ProbePoint *p, m_points) {
+		if (p->name().compare(_name, Qt::CaseInsensitive) == 0)
+			return p;
+	}
+	return NULL;
+}
+
+void ProbeHub::attach(ProbeSink *_sink, int _pointId)
+{
+	if (_sink == NULL)
+		return;
+	m_mutex.lock();
+	bool found;
+	foreach (ProbePoint *p, m_points) {
+		if (_pointId >= 0 && p->id() != _pointId)
+			continue;
+		found = false;
+		foreach (Attachment a, m_attachments) {
+			if (a.sink == _sink && a.point == p)
+				found = true;
+		}
+		if (found)
+			continue;
+		Attachment a;
+		a.sink = _sink;
+		a.point = p;
+		m_attachments.append(a);
+		p->m_numSinks.fetchAndAddOrdered(1);
+	}
+	bool hasSinks = !m_attachments.isEmpty();
+	m_mutex.unlock();
+	if (hasSinks)
+		m_worker->start();
+}
+
+void ProbeHub::detach(ProbeSink *_sink, int _pointId)
+{
+	//Worker holds the mutex while it calls sinks, so once we have it _sink isn't being called
+	m_mutex.lock();
+	for (int i = m_attachments.count() - 1; i >= 0; i--) {
+		Attachment a = m_attachments[i];
+		if (a.sink != _sink || (_pointId >= 0 && a.point->id() != _pointId))
+			continue;
+		m_attachments.removeAt(i);
+		if (a.point->m_numSinks.fetchAndAddOrdered(-1) == 1) {
+			//Last sink, anything still queued is for nobody
+			a.point->m_queue.clear();
+		}
+	}
+	bool hasSinks = !m_attachments.isEmpty();
+	m_mutex.unlock();
+	if (!hasSinks)
+		m_worker->stop();
+}
+
+bool ProbeHub::process()
+{
+	QMutexLocker locker(&m_mutex);
+	bool didWork = false;
+	ProbeBlock block;
+	ProbePoint::Slot *slot;
+	foreach (ProbePoint *p, m_points) {
+		while ((slot = p->m_queue.readSlot()) != NULL) {
+			block.pointId = p->id();
+			block.profile = slot->profile;
+			block.cpx = slot->isCpx ? slot->samples : NULL;
+			block.real = slot->isCpx ? NULL : (const double *)slot->samples;
+			block.numSamples = slot->numSamples;
+			block.sampleRate = slot->sampleRate;
+			block.blockNumber = slot->blockNumber;
+			foreach (Attachment a, m_attachments) {
+				if (a.point == p)
+					a.sink->probeBlock(block);
+			}
+			//Producer doesn't reuse the slot until every sink is done with it
+			p->m_queue.commitRead();
+			didWork = true;
+		}
+	}
+	return didWork;
+}
+
+ProbeFileSink::ProbeFileSink()
+{
+	m_buf = new float[ProbePoint::c_maxSamples * 2];
+}
+
+ProbeFileSink::~ProbeFileSink()
+{
+	close();
+	delete[] m_buf;
+}
+
+bool ProbeFileSink::open(QString _fileName)
+{
+	close();
+	m_file.setFileName(_fileName);
+	if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		qDebug()<<"ProbeFileSink: unable to open "<<_fileName;
+		return false;
+	}
+	return true;
+}
+
+void ProbeFileSink::close()
+{
+	if (m_file.isOpen())
+		m_file.close();
+}
+
+void ProbeFileSink::probeBlock(const ProbeBlock &_block)
+{
+	if (!m_file.isOpen())
+		return;
+	quint32 numFloats;
+	if (_block.cpx != NULL) {
+		for (quint32 i = 0, j = 0; i < _block.numSamples; i++, j += 2) {
+			m_buf[j] = _block.cpx[i].real();
+			m_buf[j + 1] = _block.cpx[i].imag();
+		}
+		numFloats = _block.numSamples * 2;
+	} else {
+		for (quint32 i = 0; i < _block.numSamples; i++)
+			m_buf[i] = _block.real[i];
+		numFloats = _block.numSamples;
+	}
+	m_file.write((const char *)m_buf, numFloats * sizeof(float));
+}
+
+ProbeStatsSink::ProbeStatsSink()
+{
+	reset();
+}
+
+void ProbeStatsSink::reset()
+{
+	QMutexLocker locker(&m_mutex);
+	m_numBlocks = 0;
+	m_numSamples = 0;
+	m_missedBlocks = 0;
+	m_nextBlock = 0;
+	m_sumSquares = 0;
+	m_peak = 0;
+	m_sampleRate = 0;
+}
+
+void ProbeStatsSink::probeBlock(const ProbeBlock &_block)
+{
+	double sumSquares = 0;
+	double peak = 0;
+	double mag;
+	if (_block.cpx != NULL) {
+		for (quint32 i = 0; i < _block.numSamples; i++) {
+			mag = DB::power(_block.cpx[i]);
+			sumSquares += mag;
+			peak = qMax(peak, mag);
+		}
+	} else {
+		for (quint32 i = 0; i < _block.numSamples; i++) {
+			mag = _block.real[i] * _block.real[i];
+			sumSquares += mag;
+			peak = qMax(peak, mag);
+		}
+	}
+
+	QMutexLocker locker(&m_mutex);
+	if (m_numBlocks > 0 && _block.blockNumber > m_nextBlock)
+		m_missedBlocks += _block.blockNumber - m_nextBlock;
+	m_nextBlock = _block.blockNumber + 1;
+	m_numBlocks++;
+	m_numSamples += _block.numSamples;
+	m_sumSquares += sumSquares;
+	m_peak = qMax(m_peak, peak);
+	m_sampleRate = _block.sampleRate;
+}
+
+QString ProbeStatsSink::summary()
+{
+	QMutexLocker locker(&m_mutex);
+	double rms = m_numSamples > 0 ? m_sumSquares / m_numSamples : 0;
+	return QString("%1 blocks %2 samples at %3, %4 blocks missed, rms %5dB peak %6dB")
+			.arg(m_numBlocks).arg(m_numSamples).arg(m_sampleRate).arg(m_missedBlocks)
+			.arg(DB::powerTodB(rms), 0, 'f', 1).arg(DB::powerTodB(m_peak), 0, 'f', 1);
+}
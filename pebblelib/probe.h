@@ -0,0 +1,176 @@
+#ifndef PROBE_H
+#define PROBE_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "cpx.h"
+#include "spscring.h"
+#include "pollingworker.h"
+#include <QObject>
+#include <QMutex>
+#include <QFile>
+#include <QList>
+#include <QAtomicInteger>
+
+/*
+	Probe points, taps on the DSP chain that cost nothing unless something is listening
+
+	The test bench used to be called inline at every step of processIQData(), taking its display mutex and
+	copying sample by sample whenever the bench was open, on the thread that can least afford it.
+
+	ProbePoint
+		Owned by a ProbeHub, one per place in the chain we might want to look at
+		tap() is a single branch on an atomic sink count when nothing is attached
+		When attached, the block is copied into an SpscSlotQueue of c_numSlots x c_maxSamples and tap() returns
+		Blocks larger than c_maxSamples use more than one slot.  If the ring is full the block is dropped and the
+		probe sees a gap in ProbeBlock::blockNumber, the DSP thread never waits
+		One producer thread per point
+
+	ProbeHub
+		Drains every point on its own PollingWorker thread and calls the sinks attached to it
+		Sinks are attached and detached from the UI thread.  Once detach() returns the sink won't be called again
+
+	ProbeSink
+		ProbeFileSink writes raw float32 samples to disk, ProbeStatsSink keeps level and loss stats
+		TestBench is a sink for the developer UI
+*/
+
+//One block from a probe point, only valid during ProbeSink::probeBlock()
+struct ProbeBlock
+{
+	int pointId;
+	int profile; //Test bench profile, pointId unless tap() was given one
+	const CPX *cpx; //NULL for real data
+	const double *real; //NULL for complex data
+	quint32 numSamples;
+	double sampleRate;
+	quint64 blockNumber; //Counts every tap() while attached, including dropped ones
+};
+
+class ProbeSink
+{
+public:
+	virtual ~ProbeSink() {}
+	//Probe thread
+	virtual void probeBlock(const ProbeBlock &_block) = 0;
+};
+
+class ProbeHub;
+
+class PEBBLELIBSHARED_EXPORT ProbePoint
+{
+	friend class ProbeHub;
+public:
+	static const quint32 c_numSlots = 32; //Power of 2
+	static const quint32 c_maxSamples = 4096;
+
+	int id() {return m_id;}
+	QString name() {return m_name;}
+	bool isAttached() {return m_numSinks.load() != 0;}
+
+	//Producer thread.  _profile < 0 uses point id
+	inline void tap(const CPX *_in, quint32 _numSamples, double _sampleRate, int _profile = -1) {
+		if (Q_UNLIKELY(m_numSinks.load() != 0))
+			publish(_in, NULL, _numSamples, _sampleRate, _profile);
+	}
+	inline void tap(const double *_in, quint32 _numSamples, double _sampleRate, int _profile = -1) {
+		if (Q_UNLIKELY(m_numSinks.load() != 0))
+			publish(NULL, _in, _numSamples, _sampleRate, _profile);
+	}
+
+	quint64 droppedBlocks() {return m_droppedBlocks.load();}
+
+private:
+	ProbePoint(int _id, QString _name);
+	~ProbePoint();
+
+	struct Slot {
+		CPX *samples; //Real data uses the same buffer as c_maxSamples doubles
+		bool isCpx;
+		int profile;
+		quint32 numSamples;
+		double sampleRate;
+		quint64 blockNumber;
+	};
+
+	int m_id;
+	QString m_name;
+	QAtomicInteger<int> m_numSinks; //Changed by hub, tested on every tap()
+
+	SpscSlotQueue<Slot, c_numSlots> m_queue; //Hub consumes
+	quint64 m_nextBlock; //Producer only
+	QAtomicInteger<quint64> m_droppedBlocks;
+
+	void publish(const CPX *_cpx, const double *_real, quint32 _numSamples, double _sampleRate, int _profile);
+};
+
+class PEBBLELIBSHARED_EXPORT ProbeHub : public QObject
+{
+	Q_OBJECT
+public:
+	static const quint32 c_idleMs = 10; //Worker sleep when every point is empty
+
+	ProbeHub();
+	~ProbeHub();
+
+	//Hub owns the points.  Create them all before samples start flowing
+	ProbePoint *addPoint(int _id, QString _name);
+	ProbePoint *point(int _id);
+	ProbePoint *findPoint(QString _name);
+	QList<ProbePoint *> points() {return m_points;}
+
+	//UI thread.  _pointId < 0 attaches or detaches every point
+	void attach(ProbeSink *_sink, int _pointId = -1);
+	void detach(ProbeSink *_sink, int _pointId = -1);
+
+private:
+	struct Attachment {
+		ProbeSink *sink;
+		ProbePoint *point;
+	};
+
+	QList<ProbePoint *> m_points;
+	QList<Attachment> m_attachments;
+	QMutex m_mutex; //Attachments, never taken on the producer side
+
+	PollingWorker *m_worker;
+
+	//Worker, returns false if there was nothing to do
+	bool process();
+};
+
+//Raw interleaved float32 I/Q, or float32 for real data, no header
+class PEBBLELIBSHARED_EXPORT ProbeFileSink : public ProbeSink
+{
+public:
+	ProbeFileSink();
+	~ProbeFileSink();
+	bool open(QString _fileName);
+	void close();
+	void probeBlock(const ProbeBlock &_block);
+
+private:
+	QFile m_file;
+	float *m_buf;
+};
+
+//Level and loss stats, summary() can be called from any thread
+class PEBBLELIBSHARED_EXPORT ProbeStatsSink : public ProbeSink
+{
+public:
+	ProbeStatsSink();
+	void reset();
+	void probeBlock(const ProbeBlock &_block);
+	QString summary();
+
+private:
+	QMutex m_mutex;
+	quint64 m_numBlocks;
+	quint64 m_numSamples;
+	quint64 m_missedBlocks;
+	quint64 m_nextBlock;
+	double m_sumSquares;
+	double m_peak;
+	double m_sampleRate;
+};
+
+#endif // PROBE_H
@@ -0,0 +1,51 @@
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "reblocker.h"
+#include <QDebug>
+
+Reblocker::Reblocker(quint32 _blockSize, quint32 _maxWrite)
+{
+	m_blockSize = qMax((quint32)1, _blockSize);
+	//Leftover is always less than one block
+	m_capacity = m_blockSize - 1 + _maxWrite;
+	m_buf = memalign(m_capacity);
+	reset();
+}
+
+Reblocker::~Reblocker()
+{
+	free (m_buf);
+}
+
+void Reblocker::reset()
+{
+	m_len = 0;
+	m_readPos = 0;
+}
+
+void Reblocker::write(const CPX *_in, quint32 _numSamples)
+{
+	if (m_readPos > 0) {
+		//Move leftover to the front, blocks already handed out are done
+		m_len -= m_readPos;
+		if (m_len > 0)
+			memmove(m_buf, &m_buf[m_readPos], m_len * sizeof(CPX));
+		m_readPos = 0;
+	}
+	if (m_len + _numSamples > m_capacity) {
+		//Caller didn't take every block or wrote more than _maxWrite
+		qDebug()<<"Reblocker overflow, dropping "<<m_len + _numSamples - m_capacity<<" samples";
+		_numSamples = m_capacity - m_len;
+	}
+	copyCPX(&m_buf[m_len], _in, _numSamples);
+	m_len += _numSamples;
+}
+
+CPX *Reblocker::next()
+{
+	if (m_len - m_readPos < m_blockSize)
+		return NULL;
+	CPX *block = &m_buf[m_readPos];
+	m_readPos += m_blockSize;
+	return block;
+}
@@ -0,0 +1,46 @@
+#ifndef REBLOCKER_H
+#define REBLOCKER_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "cpx.h"
+
+/*
+	Re-blocking adapter between DSP stages that want different block sizes
+
+	Producer writes whatever it has, consumer takes fixed _blockSize blocks until next() returns NULL
+	Leftover (< _blockSize) is kept for the next write, so nothing is lost or repeated
+
+	Used where the chain changes block size, ie decimator output to the demod chain, or demod blocks to the
+	zoomed spectrum which still wants full framesPerBuffer FFTs in the low latency profile
+
+		m_reblocker->write(m_workingBuf, numStepSamples);
+		while ((block = m_reblocker->next()) != NULL)
+			process(block, m_reblocker->blockSize());
+
+	Blocks returned by next() are only valid until the next write() or reset(), and can be modified in place
+	Single thread
+*/
+class PEBBLELIBSHARED_EXPORT Reblocker
+{
+public:
+	//_maxWrite is the largest single write()
+	Reblocker(quint32 _blockSize, quint32 _maxWrite);
+	~Reblocker();
+
+	void reset();
+	void write(const CPX *_in, quint32 _numSamples);
+	CPX *next();
+
+	quint32 blockSize() {return m_blockSize;}
+	//Samples waiting for a full block
+	quint32 pending() {return m_len - m_readPos;}
+
+private:
+	quint32 m_blockSize;
+	quint32 m_capacity;
+	CPX *m_buf;
+	quint32 m_len; //Valid samples in m_buf
+	quint32 m_readPos; //Start of the next block
+};
+
+#endif // REBLOCKER_H
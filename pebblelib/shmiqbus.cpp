@@ -0,0 +1,447 @@
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "shmiqbus.h"
+#include "deviceinterfacebase.h"
+#include <QDebug>
+#include <QMutex>
+#include <QSet>
+#include <string.h>
+
+#ifndef Q_OS_WIN
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#endif
+
+//Seqlock and lap checks.  Segment is shared between processes, so these have to be real atomics, not QMutex
+#define loadAcquire(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define loadRelaxed(x) __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define storeRelease(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#define storeRelaxed(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+#define fenceAcquire() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define fenceRelease() __atomic_thread_fence(__ATOMIC_RELEASE)
+
+//Segments our own publishers have open.  A segment with our pid that isn't in here was left by a process whose pid we reused
+static QMutex s_openNamesMutex;
+static QSet<QByteArray> s_openNames;
+
+//POSIX names are a single leading / and no others
+static QByteArray shmName(QString _name)
+{
+	return ("/pebble-iq-" + QString(_name).replace('/', '_')).toUtf8();
+}
+
+ShmIqPublisher::ShmIqPublisher()
+{
+	m_fd = -1;
+	m_segment = NULL;
+	m_segmentBytes = 0;
+	m_header = NULL;
+	m_descs = NULL;
+	m_ring = NULL;
+	m_maxBlockBytes = 0;
+}
+
+ShmIqPublisher::~ShmIqPublisher()
+{
+	close();
+}
+
+//Pid of another process that created segment _name if it's still running, 0 if there's none or it's gone
+//Our own publishers are checked in s_openNames
+qint64 ShmIqPublisher::livePublisher(const QByteArray &_name)
+{
+#ifdef Q_OS_WIN
+	Q_UNUSED(_name);
+	return 0;
+#else
+	int fd = shm_open(_name.constData(), O_RDONLY, 0);
+	if (fd < 0)
+		return 0;
+	qint64 pid = 0;
+	struct stat st;
+	void *segment = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && (quint64)st.st_size >= sizeof(ShmIqHeader))
+		segment = mmap(NULL, sizeof(ShmIqHeader), PROT_READ, MAP_SHARED, fd, 0);
+	if (segment != MAP_FAILED) {
+		const ShmIqHeader *header = (const ShmIqHeader *)segment;
+		if (loadAcquire(header->magic) == ShmIqHeader::c_magic)
+			pid = header->writerPid;
+		munmap(segment, sizeof(ShmIqHeader));
+	}
+	::close(fd);
+	//EPERM is alive, just not ours to signal
+	if (pid > 0 && pid != getpid() && (kill((pid_t)pid, 0) == 0 || errno == EPERM))
+		return pid;
+	return 0;
+#endif
+}
+
+bool ShmIqPublisher::open(QString _name, quint64 _ringBytes)
+{
+	close();
+#ifdef Q_OS_WIN
+	Q_UNUSED(_name);
+	Q_UNUSED(_ringBytes);
+	qDebug()<<"Shared memory IQ bus is not supported on Windows";
+	return false;
+#else
+	QByteArray name = shmName(_name);
+	//Held until the name is in s_openNames, so two opens in this process can't both unlink and create
+	QMutexLocker locker(&s_openNamesMutex);
+	if (s_openNames.contains(name)) {
+		qDebug()<<"ShmIqPublisher"<<name<<"is already published by this process";
+		return false;
+	}
+	qint64 pid = livePublisher(name);
+	if (pid != 0) {
+		qDebug()<<"ShmIqPublisher"<<name<<"is already published by pid"<<pid;
+		return false;
+	}
+	//Left behind by a writer that didn't close, its readers see no new blocks and reopen ours
+	shm_unlink(name.constData());
+	//Readers only need to read, nobody but us should be able to write samples or descriptors
+	m_fd = shm_open(name.constData(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (m_fd < 0) {
+		qDebug()<<"ShmIqPublisher can't create"<<name;
+		return false;
+	}
+
+	//Ring starts cache line aligned after the descriptors
+	quint32 headerBytes = (sizeof(ShmIqHeader) + c_numBlockDescs * sizeof(ShmIqBlockDesc) + 63) & ~63;
+	m_segmentBytes = headerBytes + _ringBytes;
+	void *segment = MAP_FAILED;
+	if (ftruncate(m_fd, m_segmentBytes) == 0)
+		segment = mmap(NULL, m_segmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+	if (segment == MAP_FAILED) {
+		qDebug()<<"ShmIqPublisher can't map"<<name<<m_segmentBytes<<"bytes";
+		::close(m_fd);
+		m_fd = -1;
+		shm_unlink(name.constData());
+		return false;
+	}
+	m_name = _name;
+	m_segment = (quint8 *)segment;
+	m_descs = (ShmIqBlockDesc *)(m_segment + sizeof(ShmIqHeader));
+	m_ring = m_segment + headerBytes;
+	//A whole block always fits in the half of the ring a lagging reader is allowed to be behind
+	m_maxBlockBytes = _ringBytes / 8;
+
+	//ftruncate zeroed everything, magic goes in last so readers never see a half built header
+	ShmIqHeader *header = (ShmIqHeader *)m_segment;
+	header->version = ShmIqHeader::c_version;
+	header->numBlockDescs = c_numBlockDescs;
+	header->headerBytes = headerBytes;
+	header->ringBytes = _ringBytes;
+	header->maxBlockBytes = m_maxBlockBytes;
+	header->writerPid = getpid();
+	storeRelease(header->magic, ShmIqHeader::c_magic);
+	m_header = header;
+	s_openNames.insert(name);
+	return true;
+#endif
+}
+
+void ShmIqPublisher::close()
+{
+	if (m_header == NULL)
+		return;
+#ifndef Q_OS_WIN
+	quint32 seq = m_header->seq;
+	storeRelaxed(m_header->seq, seq + 1);
+	fenceRelease();
+	m_header->closed = 1;
+	storeRelease(m_header->seq, seq + 2);
+
+	munmap(m_segment, m_segmentBytes);
+	::close(m_fd);
+	QByteArray name = shmName(m_name);
+	QMutexLocker locker(&s_openNamesMutex);
+	shm_unlink(name.constData());
+	s_openNames.remove(name);
+#endif
+	m_fd = -1;
+	m_segment = NULL;
+	m_header = NULL;
+	m_descs = NULL;
+	m_ring = NULL;
+}
+
+void ShmIqPublisher::publish(const IQBlock &_block, double _frequency)
+{
+	if (m_header == NULL || _block.numSamples == 0)
+		return;
+
+	quint32 bytesPerSample = DeviceInterfaceBase::bytesPerSample(_block.format);
+	if (bytesPerSample == 0)
+		return;
+	quint32 maxSamples = m_maxBlockBytes / bytesPerSample;
+	const quint8 *samples = (const quint8 *)_block.samples;
+	//We're the only writer, these only change here
+	quint64 blockSeq = m_header->blockSeq;
+	quint64 writeBytes = m_header->writeBytes;
+	quint64 ringBytes = m_header->ringBytes;
+	quint32 seq = m_header->seq;
+	quint32 numSamples;
+	quint32 bytes;
+	quint64 ringOffset;
+	ShmIqBlockDesc *desc;
+
+	for (quint32 offset = 0; offset < _block.numSamples; offset += numSamples) {
+		numSamples = qMin(maxSamples, _block.numSamples - offset);
+		bytes = numSamples * bytesPerSample;
+		ringOffset = writeBytes % ringBytes;
+		if (ringOffset + bytes > ringBytes) {
+			//Doesn't fit at the end, pad so readers can use every block in place
+			writeBytes += ringBytes - ringOffset;
+			ringOffset = 0;
+		}
+		memcpy(m_ring + ringOffset, samples + (quint64)offset * bytesPerSample, bytes);
+
+		desc = &m_descs[blockSeq % c_numBlockDescs];
+		desc->position = writeBytes;
+		desc->sampleCounter = _block.sampleCounter + offset;
+		desc->scale = _block.scale;
+		desc->numSamples = numSamples;
+		desc->format = _block.format;
+		desc->sampleRate = _block.sampleRate;
+		//Drops and discontinuity belong to the first piece, sample order to all of them
+		desc->droppedSamples = offset == 0 ? _block.droppedSamples : 0;
+		desc->flags = offset == 0 ? _block.flags : (_block.flags & IQB_SWAP_IQ);
+		desc->blockSeq = blockSeq;
+		blockSeq++;
+		writeBytes += bytes;
+
+		//Samples and descriptor are out before the state that points readers at them
+		storeRelaxed(m_header->seq, seq + 1);
+		fenceRelease();
+		storeRelaxed(m_header->blockSeq, blockSeq);
+		storeRelaxed(m_header->writeBytes, writeBytes);
+		m_header->frequency = _frequency;
+		storeRelease(m_header->seq, seq + 2);
+		seq += 2;
+	}
+}
+
+ShmIqSubscriber::ShmIqSubscriber()
+{
+	m_fd = -1;
+	m_segment = NULL;
+	m_segmentBytes = 0;
+	m_header = NULL;
+	m_descs = NULL;
+	m_ring = NULL;
+	m_numBlockDescs = 0;
+	m_ringBytes = 0;
+	m_maxBlockBytes = 0;
+	m_frequency = 0;
+	m_readSeq = 0;
+	m_first = true;
+	m_nextSampleCounter = 0;
+	m_lastPosition = 0;
+	m_laggedSamples = 0;
+	m_overrunBlocks = 0;
+}
+
+ShmIqSubscriber::~ShmIqSubscriber()
+{
+	close();
+}
+
+bool ShmIqSubscriber::open(QString _name)
+{
+	close();
+#ifdef Q_OS_WIN
+	Q_UNUSED(_name);
+	return false;
+#else
+	QByteArray name = shmName(_name);
+	m_fd = shm_open(name.constData(), O_RDONLY, 0);
+	if (m_fd < 0)
+		return false;
+
+	struct stat st;
+	void *segment = MAP_FAILED;
+	if (fstat(m_fd, &st) == 0 && (quint64)st.st_size > sizeof(ShmIqHeader))
+		segment = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, m_fd, 0);
+	if (segment == MAP_FAILED) {
+		::close(m_fd);
+		m_fd = -1;
+		return false;
+	}
+	m_segment = (quint8 *)segment;
+	m_segmentBytes = st.st_size;
+
+	//Writer may still be building it, or it's from a different version
+	ShmIqHeader *header = (ShmIqHeader *)m_segment;
+	if (loadAcquire(header->magic) != ShmIqHeader::c_magic || header->version != ShmIqHeader::c_version ||
+		header->headerBytes + header->ringBytes > m_segmentBytes || header->numBlockDescs == 0 ||
+		header->ringBytes == 0 || header->maxBlockBytes == 0 || header->maxBlockBytes > header->ringBytes / 2 ||
+		sizeof(ShmIqHeader) + header->numBlockDescs * sizeof(ShmIqBlockDesc) > header->headerBytes) {
+		munmap(m_segment, m_segmentBytes);
+		::close(m_fd);
+		m_fd = -1;
+		m_segment = NULL;
+		return false;
+	}
+	m_header = header;
+	m_descs = (ShmIqBlockDesc *)(m_segment + sizeof(ShmIqHeader));
+	m_ring = m_segment + header->headerBytes;
+	m_numBlockDescs = header->numBlockDescs;
+	m_ringBytes = header->ringBytes;
+	m_maxBlockBytes = header->maxBlockBytes;
+	m_first = true;
+	return true;
+#endif
+}
+
+void ShmIqSubscriber::close()
+{
+	if (m_segment == NULL)
+		return;
+#ifndef Q_OS_WIN
+	munmap(m_segment, m_segmentBytes);
+	::close(m_fd);
+#endif
+	m_fd = -1;
+	m_segment = NULL;
+	m_header = NULL;
+	m_descs = NULL;
+	m_ring = NULL;
+}
+
+bool ShmIqSubscriber::isClosed()
+{
+	return m_header == NULL || loadAcquire(m_header->closed) != 0;
+}
+
+qint64 ShmIqSubscriber::writerPid()
+{
+	return m_header != NULL ? m_header->writerPid : 0;
+}
+
+//Consistent blockSeq, writeBytes and frequency.  False if the writer died part way through an update
+bool ShmIqSubscriber::snapshot(quint64 &_blockSeq, quint64 &_writeBytes)
+{
+	quint32 seq;
+	double frequency;
+	for (int i = 0; i < 1000; i++) {
+		seq = loadAcquire(m_header->seq);
+		if (seq & 1)
+			continue;
+		_blockSeq = loadRelaxed(m_header->blockSeq);
+		_writeBytes = loadRelaxed(m_header->writeBytes);
+		frequency = m_header->frequency;
+		fenceAcquire();
+		if (loadRelaxed(m_header->seq) == seq) {
+			m_frequency = frequency;
+			return true;
+		}
+	}
+	return false;
+}
+
+//Writer has up to 2 max blocks (padding and the block) in flight past the writeBytes we saw
+bool ShmIqSubscriber::overwritten(quint64 _position, quint64 _writeBytes)
+{
+	return _writeBytes + 2 * m_maxBlockBytes > _position + m_ringBytes;
+}
+
+bool ShmIqSubscriber::next(IQBlock &_block)
+{
+	if (m_header == NULL)
+		return false;
+
+	quint64 blockSeq;
+	quint64 writeBytes;
+	ShmIqBlockDesc desc;
+	quint64 bytes;
+	bool caughtUp = false;
+
+	while (true) {
+		if (!snapshot(blockSeq, writeBytes) || blockSeq == 0)
+			return false;
+		if (m_first || blockSeq < m_readSeq) {
+			//Start live with the newest block, or the writer started over in the same segment
+			m_readSeq = blockSeq - 1;
+		}
+		if (m_readSeq >= blockSeq)
+			return false;
+		if (blockSeq - m_readSeq > m_numBlockDescs / 2) {
+			//Too far behind in blocks, writer is about to reuse the descriptor
+			m_readSeq = blockSeq - 1;
+			caughtUp = true;
+		}
+
+		desc = m_descs[m_readSeq % m_numBlockDescs];
+		fenceAcquire();
+		//Descriptor could have been rewritten while we copied it
+		if (loadRelaxed(m_header->blockSeq) - m_readSeq >= m_numBlockDescs || desc.blockSeq != m_readSeq) {
+			if (caughtUp)
+				return false;
+			m_readSeq = blockSeq - 1;
+			caughtUp = true;
+			continue;
+		}
+		if (writeBytes - desc.position > m_ringBytes / 2 && !caughtUp) {
+			//Too far behind in samples, jump to the newest block so the host has time to use it in place
+			m_readSeq = blockSeq - 1;
+			caughtUp = true;
+			continue;
+		}
+		if (overwritten(desc.position, writeBytes))
+			return false;
+		//Don't hand the host anything that would read past the block or the ring, skip it like a lost block
+		bytes = desc.format <= IQF_CPXU8 ?
+			(quint64)desc.numSamples * DeviceInterfaceBase::bytesPerSample((IQSampleFormat)desc.format) : 0;
+		if (bytes == 0 || bytes > m_maxBlockBytes || desc.position % m_ringBytes + bytes > m_ringBytes) {
+			m_readSeq++;
+			return false;
+		}
+		break;
+	}
+
+	_block.samples = m_ring + desc.position % m_ringBytes;
+	_block.numSamples = desc.numSamples;
+	_block.format = (IQSampleFormat)desc.format;
+	_block.scale = desc.scale;
+	_block.sampleRate = desc.sampleRate;
+	_block.sampleCounter = desc.sampleCounter;
+	_block.flags = desc.flags;
+	_block.droppedSamples = desc.droppedSamples;
+	//Ours only until the next call, we never hold the writer back
+	_block.release = NULL;
+	_block.owner = NULL;
+	_block.handle = 0;
+
+	if (m_first) {
+		_block.flags |= IQB_DISCONTINUITY;
+		m_first = false;
+	} else if (!(desc.flags & IQB_DISCONTINUITY) && desc.sampleCounter > m_nextSampleCounter) {
+		//Gap is the device's drops plus anything we skipped
+		quint64 gap = desc.sampleCounter - m_nextSampleCounter;
+		if (gap > desc.droppedSamples)
+			m_laggedSamples += gap - desc.droppedSamples;
+		_block.flags |= IQB_DROPPED;
+		_block.droppedSamples = gap;
+	}
+	m_nextSampleCounter = desc.sampleCounter + desc.numSamples;
+	m_lastPosition = desc.position;
+	m_readSeq++;
+	return true;
+}
+
+bool ShmIqSubscriber::overrun()
+{
+	if (m_header == NULL)
+		return false;
+	fenceAcquire();
+	if (overwritten(m_lastPosition, loadAcquire(m_header->writeBytes))) {
+		m_overrunBlocks++;
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,157 @@
+#ifndef SHMIQBUS_H
+#define SHMIQBUS_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "pebblelib_global.h"
+#include "device_interfaces.h"
+#include <QString>
+
+/*
+	Shared memory IQ bus, one device's stream fanned out to any number of local processes
+
+	A device publishes every IQBlock it delivers (see DeviceInterfaceBase, "ShmIqBus" setting) into a POSIX shared
+	memory segment.  Readers (ShmIqDevice plugin, other Pebble instances, tools) map the same segment and see the
+	blocks in device format, with the device's sample counter, drop flags and scale.  No sockets, no per reader cost
+	to the device, a reader that falls behind only hurts itself.
+
+	Segment layout, all little endian native types
+		ShmIqHeader			Fixed fields, then the seqlock protected stream state
+		ShmIqBlockDesc[]	c_numBlockDescs descriptors, one per published block, indexed by blockSeq % c_numBlockDescs
+		Sample ring			ringBytes of samples.  A block never wraps, if it won't fit at the end it starts at 0
+
+	Seqlock
+		Writer copies samples into the ring and fills the block's descriptor, then bumps seq to odd, updates the stream
+		state, and bumps seq to even.  Readers snapshot the state and retry while seq is odd or changed under them.
+		Descriptors and samples are not covered by seq, a reader checks writeBytes and blockSeq after using them to
+		know they weren't overwritten (lapped) while it was looking.
+
+	Lag
+		A reader more than half the ring or half the descriptors behind jumps to the newest block and reports the
+		samples it skipped as IQB_DROPPED, same as a device overrun.  Blocks are handed to the reader's host in place,
+		the half ring margin is what keeps the writer off them during the callback.
+
+	Trust
+		Segment is 0644, only the writer's user can write it.  Readers still check every descriptor stays inside the
+		ring before handing it out, a bad one is skipped like a lost block.  A writer won't take over a name while the
+		process that created the segment is still alive.
+
+	POSIX only (shm_open, mmap), publish and subscribe fail quietly on Windows
+*/
+
+//Shared memory layout, version it if anything here changes
+struct ShmIqBlockDesc
+{
+	quint64 position;		//writeBytes where the samples start, % ringBytes for their offset in the ring
+	quint64 sampleCounter;	//IQBlock::sampleCounter
+	quint64 droppedSamples;	//IQBlock::droppedSamples
+	quint64 blockSeq;		//Which block this descriptor was last written for
+	double scale;			//IQBlock::scale
+	quint32 numSamples;
+	quint32 format;			//IQSampleFormat
+	quint32 sampleRate;
+	quint32 flags;			//IQBlockFlags
+};
+
+struct ShmIqHeader
+{
+	static const quint32 c_magic = 0x42514950; //"PIQB"
+	static const quint32 c_version = 1;
+
+	//Fixed once the writer creates the segment
+	quint32 magic;
+	quint32 version;
+	quint32 numBlockDescs;
+	quint32 headerBytes;	//Offset of the sample ring
+	quint64 ringBytes;
+	quint64 maxBlockBytes;	//Writer splits larger blocks, so it never has more than 2x this in flight past writeBytes
+	qint64 writerPid;
+
+	//Seqlock protected
+	quint32 seq;			//Odd while the writer is updating the fields below
+	quint32 closed;			//Writer stopped, readers should reopen by name
+	quint64 blockSeq;		//Blocks published, next descriptor is blockSeq % numBlockDescs
+	quint64 writeBytes;		//Bytes ever written to the ring, including padding at the end.  Ring position is % ringBytes
+	double frequency;		//Device frequency when the last block was published
+};
+
+class PEBBLELIBSHARED_EXPORT ShmIqPublisher
+{
+public:
+	ShmIqPublisher();
+	~ShmIqPublisher();
+
+	//Creates (or re-creates) segment _name, _ringBytes of samples.  Readers find it by the same name
+	//False if another live process, or another publisher in this process, is publishing _name
+	bool open(QString _name, quint64 _ringBytes = c_defaultRingBytes);
+	//Marks the segment closed for readers and removes the name
+	void close();
+	bool isOpen() {return m_header != NULL;}
+
+	//Device thread, every block.  Copies the samples, never waits for readers
+	void publish(const IQBlock &_block, double _frequency);
+
+	static const quint64 c_defaultRingBytes = 64 * 1024 * 1024; //About 0.8 sec of CPX16 at 20msps
+	static const quint32 c_numBlockDescs = 4096;
+
+private:
+	static qint64 livePublisher(const QByteArray &_name);
+
+	QString m_name;
+	int m_fd;
+	quint8 *m_segment;
+	quint64 m_segmentBytes;
+	ShmIqHeader *m_header;
+	ShmIqBlockDesc *m_descs;
+	quint8 *m_ring;
+	quint64 m_maxBlockBytes; //Larger blocks are published in pieces
+};
+
+class PEBBLELIBSHARED_EXPORT ShmIqSubscriber
+{
+public:
+	ShmIqSubscriber();
+	~ShmIqSubscriber();
+
+	//Maps an existing segment, false if no writer has created it yet
+	bool open(QString _name);
+	void close();
+	bool isOpen() {return m_header != NULL;}
+	//Writer closed the segment, reopen by name to follow a new writer
+	bool isClosed();
+	qint64 writerPid();
+
+	//Next block, false if there isn't one yet.  _block.samples points into the shared ring, valid until the next call
+	//Starts with the newest block, later skips ahead if we lag, see IQB_DROPPED
+	bool next(IQBlock &_block);
+	//True if the block returned by next() was overwritten while it was in use, count it as lost
+	bool overrun();
+	double frequency() {return m_frequency;}
+
+	//Samples skipped because we lagged, blocks overrun while in use
+	quint64 laggedSamples() {return m_laggedSamples;}
+	quint64 overrunBlocks() {return m_overrunBlocks;}
+
+private:
+	bool snapshot(quint64 &_blockSeq, quint64 &_writeBytes);
+	bool overwritten(quint64 _position, quint64 _writeBytes);
+
+	int m_fd;
+	quint8 *m_segment;
+	quint64 m_segmentBytes;
+	ShmIqHeader *m_header;
+	ShmIqBlockDesc *m_descs;
+	quint8 *m_ring;
+	quint32 m_numBlockDescs;
+	quint64 m_ringBytes;
+	quint64 m_maxBlockBytes;
+	double m_frequency;
+
+	quint64 m_readSeq; //Next block we want
+	bool m_first;
+	quint64 m_nextSampleCounter; //Where the last block we handed out ended
+	quint64 m_lastPosition; //Block handed out by next(), checked by overrun()
+	quint64 m_laggedSamples;
+	quint64 m_overrunBlocks;
+};
+
+#endif // SHMIQBUS_H
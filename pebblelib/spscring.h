@@ -0,0 +1,162 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include <QtGlobal>
+#include <QAtomicInteger>
+#include <string.h>
+
+/*
+	Lock free single producer single consumer rings, shared by everything that hands samples from the DSP (or a
+	device) thread to a worker.  Producer never waits and never takes a lock.
+
+	SpscStreamRing
+		Continuous stream of samples with a free running write count, for consumers that want recent history
+		(LargeSpectrum, StagingRing, IQRecorder).  Producer writes in chunks of at most maxWrite and publishes the
+		count after each chunk.  Nothing stops the producer from lapping a slow consumer, so the consumer copies
+		or uses what it wants and then checks isLapped() to know whether it can trust what it read.
+		Ring memory belongs to the caller (some want huge page arenas, some memalign()), see setBuffer()
+		Capacity doesn't have to be a power of 2, but index math is a mask instead of a divide if it is
+
+		producer: ring.write(in, n);
+		consumer: end = ring.writeCount(); ring.read(end - n, out, n); if (!ring.isLapped(end - n)) use(out);
+
+	SpscSlotQueue
+		numSlots fixed slots (power of 2) with free running write and read counts, for whole blocks that every
+		one has to be handed to the consumer in order (ModemRunner, ProbePoint).  If the consumer is a full queue
+		behind writeSlot() returns NULL and the producer drops the block, it never waits.
+
+		producer: if ((slot = queue.writeSlot()) != NULL) {fill(slot); queue.commitWrite();} else dropped++;
+		consumer: while ((slot = queue.readSlot()) != NULL) {use(slot); queue.commitRead();}
+*/
+template <class templateType> class SpscStreamRing
+{
+public:
+	SpscStreamRing() {
+		m_ring = NULL;
+		m_capacity = 0;
+		m_mask = 0;
+		m_maxWrite = 1;
+		m_writeCount.store(0);
+	}
+
+	//Not running.  _capacity is in samples, _maxWrite is the largest chunk written before the count is published
+	void setBuffer(templateType *_ring, quint64 _capacity, quint32 _maxWrite) {
+		m_ring = _ring;
+		m_capacity = _capacity;
+		m_mask = (_capacity & (_capacity - 1)) == 0 ? _capacity - 1 : 0;
+		m_maxWrite = qMax((quint32)1, _maxWrite);
+		m_writeCount.store(0);
+	}
+	templateType *buffer() {return m_ring;}
+	quint64 capacity() {return m_capacity;}
+	quint32 maxWrite() {return m_maxWrite;}
+
+	//Ring position of stream sample _count
+	inline quint64 index(quint64 _count) const {return m_mask != 0 ? _count & m_mask : _count % m_capacity;}
+	//Consumer, stream sample _count.  Check isLapped() once done with it
+	inline const templateType &at(quint64 _count) const {return m_ring[index(_count)];}
+
+	//Producer, copies _numSamples
+	void write(const templateType *_in, quint32 _numSamples) {
+		write(_in, _numSamples, [](const templateType *_from, templateType *_to, quint32 _num) {
+			memcpy(_to, _from, _num * sizeof(templateType));
+		});
+	}
+	//Producer, _convert(const inType *_from, templateType *_to, quint32 _num) fills the ring from another format
+	template <class inType, class convertType>
+	void write(const inType *_in, quint32 _numSamples, convertType _convert) {
+		quint64 count = m_writeCount.load(); //Only we write it
+		quint32 chunk;
+		quint64 pos;
+		quint32 first;
+		while (_numSamples > 0) {
+			chunk = qMin(_numSamples, m_maxWrite);
+			pos = index(count);
+			first = qMin((quint64)chunk, m_capacity - pos);
+			_convert(_in, &m_ring[pos], first);
+			if (first < chunk)
+				_convert(&_in[first], m_ring, chunk - first);
+			count += chunk;
+			//Release so consumer sees the samples before the count
+			m_writeCount.storeRelease(count);
+			_in += chunk;
+			_numSamples -= chunk;
+		}
+	}
+
+	//Consumer, samples ever written
+	quint64 writeCount() {return m_writeCount.loadAcquire();}
+	//Consumer, copies _numSamples starting at stream sample _start.  Check isLapped() before using them
+	void read(quint64 _start, templateType *_out, quint32 _numSamples) const {
+		quint64 pos = index(_start);
+		quint64 first = qMin((quint64)_numSamples, m_capacity - pos);
+		memcpy(_out, &m_ring[pos], first * sizeof(templateType));
+		if (first < _numSamples)
+			memcpy(&_out[first], m_ring, (_numSamples - first) * sizeof(templateType));
+	}
+	//Consumer, oldest stream sample the producer can't be overwriting right now
+	//Producer may be part way through a chunk past writeCount()
+	quint64 oldestSafe() {
+		quint64 end = m_writeCount.loadAcquire() + m_maxWrite;
+		return end > m_capacity ? end - m_capacity : 0;
+	}
+	//Consumer, true if anything from stream sample _start on may have been overwritten
+	bool isLapped(quint64 _start) {return _start < oldestSafe();}
+
+private:
+	templateType *m_ring;
+	quint64 m_capacity;
+	quint64 m_mask; //0 if capacity isn't a power of 2
+	quint32 m_maxWrite;
+	QAtomicInteger<quint64> m_writeCount; //Total samples written, producer only
+};
+
+template <class templateType, quint32 numSlots> class SpscSlotQueue
+{
+	Q_STATIC_ASSERT((numSlots & (numSlots - 1)) == 0);
+public:
+	SpscSlotQueue() {
+		m_writeCount.store(0);
+		m_readCount.store(0);
+	}
+
+	//Either side while the other isn't running, ie setting up or freeing slots
+	templateType &slot(quint32 _index) {return m_slots[_index];}
+	static quint32 size() {return numSlots;}
+
+	//Producer, next free slot or NULL if consumer is numSlots behind
+	templateType *writeSlot() {
+		quint32 write = m_writeCount.load(); //Only we write it
+		if (write - m_readCount.loadAcquire() >= numSlots)
+			return NULL;
+		return &m_slots[write & (numSlots - 1)];
+	}
+	//Producer, hands the slot from writeSlot() to the consumer
+	void commitWrite() {
+		//Release so consumer sees the slot before the count
+		m_writeCount.storeRelease(m_writeCount.load() + 1);
+	}
+
+	//Consumer, oldest filled slot or NULL if empty
+	templateType *readSlot() {
+		quint32 read = m_readCount.load(); //Only we write it
+		if (read == m_writeCount.loadAcquire())
+			return NULL;
+		return &m_slots[read & (numSlots - 1)];
+	}
+	//Consumer, gives the slot from readSlot() back to the producer
+	void commitRead() {
+		//Release so producer doesn't reuse the slot until we're done with it
+		m_readCount.storeRelease(m_readCount.load() + 1);
+	}
+	//Consumer (or with consumer stopped), throws away everything queued
+	void clear() {m_readCount.storeRelease(m_writeCount.loadAcquire());}
+
+private:
+	templateType m_slots[numSlots];
+	QAtomicInteger<quint32> m_writeCount; //Producer only
+	QAtomicInteger<quint32> m_readCount; //Consumer only
+};
+
+#endif // SPSCRING_H
@@ -0,0 +1,49 @@
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "stagingring.h"
+#include <QDebug>
+
+StagingRing::StagingRing(quint32 _maxWrite, quint32 _maxRead)
+{
+	quint32 maxWrite = qMax((quint32)1, _maxWrite);
+	m_maxRead = qMax((quint32)1, _maxRead);
+	//Room for what we read plus a write in progress, and the same again so a slow reader isn't always lapped
+	quint32 ringSize = 1;
+	while (ringSize < 2 * (m_maxRead + maxWrite))
+		ringSize *= 2;
+	CPX *ring = memalign(ringSize);
+	clearCPX(ring, ringSize);
+	m_ring.setBuffer(ring, ringSize, maxWrite);
+	m_lastRead = 0;
+	m_overruns.store(0);
+}
+
+StagingRing::~StagingRing()
+{
+	free (m_ring.buffer());
+}
+
+void StagingRing::write(const CPX *_in, quint32 _numSamples)
+{
+	m_ring.write(_in, _numSamples);
+}
+
+bool StagingRing::readLatest(CPX *_out, quint32 _numSamples)
+{
+	if (_numSamples > m_maxRead) {
+		qDebug()<<"StagingRing: read of "<<_numSamples<<" is larger than "<<m_maxRead;
+		return false;
+	}
+	quint64 end = m_ring.writeCount();
+	if (end < _numSamples || end == m_lastRead)
+		return false;
+
+	quint64 start = end - _numSamples;
+	m_ring.read(start, _out, _numSamples);
+	if (m_ring.isLapped(start)) {
+		m_overruns.fetchAndAddRelaxed(1);
+		return false;
+	}
+	m_lastRead = end;
+	return true;
+}
@@ -0,0 +1,44 @@
+#ifndef STAGINGRING_H
+#define STAGINGRING_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "cpx.h"
+#include "spscring.h"
+#include <QAtomicInteger>
+
+/*
+	Lock free ring for handing the most recent samples from a DSP thread to a slower worker
+
+	Producer copies each block in and publishes a running sample count, it never waits and never fails
+	Consumer only ever wants the newest _numSamples, ie a display FFT, so anything older is simply overwritten
+	readLatest() checks after copying that the producer didn't lap it, and returns false if it did
+
+	SpscStreamRing sized for a few normal DSP blocks, same as the LargeSpectrum ring
+	One producer thread and one consumer thread
+*/
+class PEBBLELIBSHARED_EXPORT StagingRing
+{
+public:
+	//_maxWrite is the largest single write(), _maxRead the largest readLatest()
+	StagingRing(quint32 _maxWrite, quint32 _maxRead);
+	~StagingRing();
+
+	//Producer
+	void write(const CPX *_in, quint32 _numSamples);
+
+	//Consumer, copies the newest _numSamples to _out
+	//False if there is nothing new since the last readLatest(), not enough samples yet, or we were lapped
+	bool readLatest(CPX *_out, quint32 _numSamples);
+	//Next readLatest() returns the current samples again, even if nothing new was written
+	void rewind() {m_lastRead = 0;}
+
+	quint32 overruns() {return m_overruns.load();}
+
+private:
+	SpscStreamRing<CPX> m_ring;
+	quint32 m_maxRead;
+	quint64 m_lastRead; //Ring write count at last readLatest(), consumer only
+	QAtomicInteger<quint32> m_overruns;
+};
+
+#endif // STAGINGRING_H
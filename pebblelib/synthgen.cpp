@@ -0,0 +1,482 @@
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "synthgen.h"
+#include "deviceinterfacebase.h"
+#include "fastmath.h"
+#include "db.h"
+#include <limits>
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#define SYNTHGEN_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+//c_lanes (8) phasors, each a sample apart, step is exp(j w 8).  Amplitude ramps by _ampStep per sample
+//_numSamples is a multiple of 8.  Lanes are updated so the next call continues where this one left off
+void addTone(float *_re, float *_im, float *_lanesRe, float *_lanesIm, float _stepRe, float _stepIm,
+	float _amp, float _ampStep, quint32 _numSamples)
+{
+#ifdef SYNTHGEN_SSE2
+	__m128 lr0 = _mm_loadu_ps(&_lanesRe[0]);
+	__m128 lr1 = _mm_loadu_ps(&_lanesRe[4]);
+	__m128 li0 = _mm_loadu_ps(&_lanesIm[0]);
+	__m128 li1 = _mm_loadu_ps(&_lanesIm[4]);
+	const __m128 sr = _mm_set1_ps(_stepRe);
+	const __m128 si = _mm_set1_ps(_stepIm);
+	__m128 a0 = _mm_add_ps(_mm_set1_ps(_amp), _mm_mul_ps(_mm_set1_ps(_ampStep), _mm_setr_ps(0, 1, 2, 3)));
+	__m128 a1 = _mm_add_ps(_mm_set1_ps(_amp), _mm_mul_ps(_mm_set1_ps(_ampStep), _mm_setr_ps(4, 5, 6, 7)));
+	const __m128 da = _mm_set1_ps(_ampStep * 8);
+	__m128 t;
+	for (quint32 i = 0; i < _numSamples; i += 8) {
+		_mm_storeu_ps(&_re[i], _mm_add_ps(_mm_loadu_ps(&_re[i]), _mm_mul_ps(a0, lr0)));
+		_mm_storeu_ps(&_im[i], _mm_add_ps(_mm_loadu_ps(&_im[i]), _mm_mul_ps(a0, li0)));
+		_mm_storeu_ps(&_re[i + 4], _mm_add_ps(_mm_loadu_ps(&_re[i + 4]), _mm_mul_ps(a1, lr1)));
+		_mm_storeu_ps(&_im[i + 4], _mm_add_ps(_mm_loadu_ps(&_im[i + 4]), _mm_mul_ps(a1, li1)));
+		t = _mm_sub_ps(_mm_mul_ps(lr0, sr), _mm_mul_ps(li0, si));
+		li0 = _mm_add_ps(_mm_mul_ps(lr0, si), _mm_mul_ps(li0, sr));
+		lr0 = t;
+		t = _mm_sub_ps(_mm_mul_ps(lr1, sr), _mm_mul_ps(li1, si));
+		li1 = _mm_add_ps(_mm_mul_ps(lr1, si), _mm_mul_ps(li1, sr));
+		lr1 = t;
+		a0 = _mm_add_ps(a0, da);
+		a1 = _mm_add_ps(a1, da);
+	}
+	_mm_storeu_ps(&_lanesRe[0], lr0);
+	_mm_storeu_ps(&_lanesRe[4], lr1);
+	_mm_storeu_ps(&_lanesIm[0], li0);
+	_mm_storeu_ps(&_lanesIm[4], li1);
+#else
+	float t;
+	for (quint32 i = 0; i < _numSamples; i += 8) {
+		for (quint32 k = 0; k < 8; k++) {
+			float a = _amp + _ampStep * (i + k);
+			_re[i + k] += a * _lanesRe[k];
+			_im[i + k] += a * _lanesIm[k];
+			t = _lanesRe[k] * _stepRe - _lanesIm[k] * _stepIm;
+			_lanesIm[k] = _lanesRe[k] * _stepIm + _lanesIm[k] * _stepRe;
+			_lanesRe[k] = t;
+		}
+	}
+#endif
+}
+
+//_out += _gain * _in
+void addScaled(float *_out, const float *_in, float _gain, quint32 _numSamples)
+{
+	quint32 i = 0;
+#ifdef SYNTHGEN_SSE2
+	const __m128 g = _mm_set1_ps(_gain);
+	for (; i + 4 <= _numSamples; i += 4)
+		_mm_storeu_ps(&_out[i], _mm_add_ps(_mm_loadu_ps(&_out[i]), _mm_mul_ps(g, _mm_loadu_ps(&_in[i]))));
+#endif
+	for (; i < _numSamples; i++)
+		_out[i] += _gain * _in[i];
+}
+
+#ifdef SYNTHGEN_SSE2
+//4 samples clipped to +/-1, scaled and rounded, interleaved as I,Q,I,Q,... 16 bit
+inline __m128i toInt16_ps(const float *_re, const float *_im, float _scale)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 minusOne = _mm_set1_ps(-1.0f);
+	const __m128 s = _mm_set1_ps(_scale);
+	__m128i r = _mm_cvtps_epi32(_mm_mul_ps(_mm_max_ps(_mm_min_ps(_mm_loadu_ps(_re), one), minusOne), s));
+	__m128i i = _mm_cvtps_epi32(_mm_mul_ps(_mm_max_ps(_mm_min_ps(_mm_loadu_ps(_im), one), minusOne), s));
+	return _mm_packs_epi32(_mm_unpacklo_epi32(r, i), _mm_unpackhi_epi32(r, i));
+}
+#endif
+
+} //namespace
+
+SynthGen::SynthGen(quint32 _sampleRate, quint64 _seed)
+{
+	m_sampleRate = _sampleRate;
+	//Longest power of 2 segment that's 4us or less
+	m_segmentSamples = c_lanes;
+	while (m_segmentSamples < c_maxSegmentSamples && m_segmentSamples * 2 <= m_sampleRate * 4e-6)
+		m_segmentSamples *= 2;
+	m_segmentSecs = (double)m_segmentSamples / m_sampleRate;
+
+	m_re = new float[c_chunkSamples];
+	m_im = new float[c_chunkSamples];
+	m_noiseRe = new float[c_noiseTableSize];
+	m_noiseIm = new float[c_noiseTableSize];
+	m_awgnAmp = 0;
+	m_impulseAmp = 0;
+	m_impulsesPerSec = 0;
+
+	reset(_seed);
+}
+
+SynthGen::~SynthGen()
+{
+	delete[] m_re;
+	delete[] m_im;
+	delete[] m_noiseRe;
+	delete[] m_noiseIm;
+}
+
+void SynthGen::setCarriers(const QVector<SynthCarrier> &_carriers)
+{
+	m_carriers.resize(_carriers.count());
+	for (int i = 0; i < _carriers.count(); i++) {
+		m_carriers[i].carrier = _carriers[i];
+		initCarrier(m_carriers[i]);
+	}
+}
+
+void SynthGen::setNoise(double _awgnDb, double _impulseDb, double _impulsesPerSec)
+{
+	//Table is unit power, split between I and Q
+	m_awgnAmp = _awgnDb <= c_offDb ? 0 : DB::dBToAmplitude(_awgnDb);
+	m_impulseAmp = _impulseDb <= c_offDb ? 0 : DB::dBToAmplitude(_impulseDb);
+	m_impulsesPerSec = _impulsesPerSec;
+	m_nextImpulse = impulseInterval();
+}
+
+void SynthGen::reset(quint64 _seed)
+{
+	m_seed = _seed;
+	//xorshift state can't be 0
+	m_rng = (_seed * 0x9E3779B97F4A7C15ULL) | 1;
+
+	//Polar Box-Muller, see MorseGenDevice::nextNoiseSample().  Variance .5 per component for unit power
+	double u1, u2, s, rad;
+	for (quint32 i = 0; i < c_noiseTableSize; i++) {
+		do {
+			u1 = 2.0 * nextUniform() - 1.0;
+			u2 = 2.0 * nextUniform() - 1.0;
+			s = u1 * u1 + u2 * u2;
+		} while (s >= 1.0 || s == 0.0);
+		rad = sqrt(-log(s) / s);
+		m_noiseRe[i] = u1 * rad;
+		m_noiseIm[i] = u2 * rad;
+	}
+
+	for (int i = 0; i < m_carriers.count(); i++)
+		initCarrier(m_carriers[i]);
+	m_nextImpulse = impulseInterval();
+}
+
+double SynthGen::scale(IQSampleFormat _format)
+{
+	switch (_format) {
+		case IQF_CPX16: return 1.0 / 32767;
+		case IQF_CPX8: return 1.0 / 127;
+		case IQF_CPXU8: return 1.0 / 127;
+		default: return 1.0;
+	}
+}
+
+//xorshift64*
+quint64 SynthGen::nextRandom()
+{
+	m_rng ^= m_rng >> 12;
+	m_rng ^= m_rng << 25;
+	m_rng ^= m_rng >> 27;
+	return m_rng * 2685821657736338717ULL;
+}
+
+double SynthGen::nextUniform()
+{
+	return ((nextRandom() >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+void SynthGen::initCarrier(CarrierState &_state)
+{
+	const SynthCarrier &c = _state.carrier;
+	_state.amp = DB::dBToAmplitude(c.db);
+	//Random start phase so carriers don't all line up at sample 0
+	FastMath::sinCos(TWOPI * nextUniform(), _state.phaseIm, _state.phaseRe);
+	_state.w = -1; //Force setStep()
+	_state.modRe = 1;
+	_state.modIm = 0;
+	FastMath::sinCos(TWOPI * c.rate * m_segmentSecs, _state.modStepIm, _state.modStepRe);
+	_state.keyDown = false;
+	_state.env = 0;
+	_state.secsLeft = 0;
+	_state.symbol = 0;
+	_state.sweepPos = 0;
+}
+
+void SynthGen::setStep(CarrierState &_state, double _w)
+{
+	if (_w == _state.w)
+		return;
+	_state.w = _w;
+	FastMath::sinCos(_w, _state.stepIm, _state.stepRe);
+	//Powers of 2 by squaring
+	double re = _state.stepRe;
+	double im = _state.stepIm;
+	double t;
+	for (quint32 n = 1; n < c_lanes; n *= 2) {
+		t = re * re - im * im;
+		im = 2 * re * im;
+		re = t;
+	}
+	_state.laneStepRe = re;
+	_state.laneStepIm = im;
+	for (quint32 n = c_lanes; n < m_segmentSamples; n *= 2) {
+		t = re * re - im * im;
+		im = 2 * re * im;
+		re = t;
+	}
+	_state.segStepRe = re;
+	_state.segStepIm = im;
+}
+
+void SynthGen::nextSegment(CarrierState &_state, float *_re, float *_im)
+{
+	const SynthCarrier &c = _state.carrier;
+	double w = TWOPI * c.freq / m_sampleRate;
+	double a0 = _state.amp;
+	double a1 = _state.amp;
+	double t;
+
+	switch (c.modulation) {
+		case SynthCarrier::MOD_CARRIER:
+			break;
+		case SynthCarrier::MOD_AM:
+		case SynthCarrier::MOD_FM: {
+			double mod0 = c.modulation == SynthCarrier::MOD_AM ? _state.modRe : _state.modIm;
+			t = _state.modRe * _state.modStepRe - _state.modIm * _state.modStepIm;
+			_state.modIm = _state.modRe * _state.modStepIm + _state.modIm * _state.modStepRe;
+			_state.modRe = t;
+			//Keep modulating tone on the unit circle
+			t = 1.5 - 0.5 * (_state.modRe * _state.modRe + _state.modIm * _state.modIm);
+			_state.modRe *= t;
+			_state.modIm *= t;
+			double mod1 = c.modulation == SynthCarrier::MOD_AM ? _state.modRe : _state.modIm;
+			if (c.modulation == SynthCarrier::MOD_AM) {
+				//Peak envelope is amp
+				a0 = _state.amp * (1 + c.depth * mod0) / (1 + c.depth);
+				a1 = _state.amp * (1 + c.depth * mod1) / (1 + c.depth);
+			} else if (c.rate > 0) {
+				//Phase is beta sin(), segment frequency takes it from start to end of segment
+				double beta = c.depth / c.rate;
+				w += beta * (mod1 - mod0) / m_segmentSamples;
+			}
+			break;
+		}
+		case SynthCarrier::MOD_CW: {
+			a0 = _state.amp * _state.env;
+			_state.env += (_state.keyDown ? 1 : -1) * m_segmentSecs / c_cwRiseSecs;
+			_state.env = qBound(0.0, _state.env, 1.0);
+			a1 = _state.amp * _state.env;
+			_state.secsLeft -= m_segmentSecs;
+			if (_state.secsLeft <= 0) {
+				//Paris standard dit
+				double dit = 1.2 / qMax(c.rate, 1.0);
+				double u = nextUniform();
+				if (_state.keyDown) {
+					//Element, character or word space
+					_state.secsLeft += dit * (u < .7 ? 1 : u < .95 ? 3 : 7);
+				} else {
+					//Dit or dah
+					_state.secsLeft += dit * (u < .5 ? 1 : 3);
+				}
+				_state.keyDown = !_state.keyDown;
+			}
+			break;
+		}
+		case SynthCarrier::MOD_FSK:
+			if (_state.secsLeft <= 0) {
+				_state.symbol = nextRandom() & 1;
+				_state.secsLeft += 1.0 / qMax(c.rate, 1.0);
+			}
+			_state.secsLeft -= m_segmentSecs;
+			w += TWOPI * (_state.symbol ? c.depth / 2 : -c.depth / 2) / m_sampleRate;
+			break;
+		case SynthCarrier::MOD_SWEEP: {
+			//Frequency at middle of segment
+			double step = c.rate * m_segmentSecs;
+			w += TWOPI * c.depth * (_state.sweepPos + step / 2 - 0.5) / m_sampleRate;
+			_state.sweepPos += step;
+			_state.sweepPos -= floor(_state.sweepPos);
+			break;
+		}
+	}
+
+	setStep(_state, w);
+
+	//Lanes start at the current phase, one sample apart
+	float lanesRe[c_lanes];
+	float lanesIm[c_lanes];
+	double re = _state.phaseRe;
+	double im = _state.phaseIm;
+	for (quint32 k = 0; k < c_lanes; k++) {
+		lanesRe[k] = re;
+		lanesIm[k] = im;
+		t = re * _state.stepRe - im * _state.stepIm;
+		im = re * _state.stepIm + im * _state.stepRe;
+		re = t;
+	}
+	addTone(_re, _im, lanesRe, lanesIm, _state.laneStepRe, _state.laneStepIm, a0, (a1 - a0) / m_segmentSamples,
+		m_segmentSamples);
+
+	//Phase for next segment is kept in double so it doesn't drift over long runs
+	t = _state.phaseRe * _state.segStepRe - _state.phaseIm * _state.segStepIm;
+	_state.phaseIm = _state.phaseRe * _state.segStepIm + _state.phaseIm * _state.segStepRe;
+	_state.phaseRe = t;
+	t = 1.5 - 0.5 * (_state.phaseRe * _state.phaseRe + _state.phaseIm * _state.phaseIm);
+	_state.phaseRe *= t;
+	_state.phaseIm *= t;
+}
+
+qint64 SynthGen::impulseInterval()
+{
+	if (m_impulseAmp == 0 || m_impulsesPerSec <= 0)
+		return std::numeric_limits<qint64>::max();
+	//Poisson arrivals
+	return qMax((qint64)1, (qint64)(-log(nextUniform()) * m_sampleRate / m_impulsesPerSec));
+}
+
+void SynthGen::addNoise(quint32 _numSamples)
+{
+	if (m_awgnAmp > 0) {
+		quint32 len;
+		quint32 start;
+		quint64 r;
+		float gain;
+		for (quint32 i = 0; i < _numSamples; i += len) {
+			len = qMin(c_noiseRunSamples, _numSamples - i);
+			r = nextRandom();
+			start = (r >> 2) % (c_noiseTableSize - c_noiseRunSamples);
+			gain = (r & 1) ? m_awgnAmp : -m_awgnAmp;
+			//Swapping I and Q makes repeats even less likely
+			if (r & 2) {
+				addScaled(&m_re[i], &m_noiseRe[start], gain, len);
+				addScaled(&m_im[i], &m_noiseIm[start], gain, len);
+			} else {
+				addScaled(&m_re[i], &m_noiseIm[start], gain, len);
+				addScaled(&m_im[i], &m_noiseRe[start], gain, len);
+			}
+		}
+	}
+
+	//Burst may be cut short at the end of a chunk
+	while (m_nextImpulse < _numSamples) {
+		quint64 r = nextRandom();
+		double re = (r & 1) ? m_impulseAmp : -m_impulseAmp;
+		double im = (r & 2) ? m_impulseAmp : -m_impulseAmp;
+		for (quint32 i = m_nextImpulse; i < m_nextImpulse + c_impulseSamples && i < _numSamples; i++) {
+			m_re[i] += re;
+			m_im[i] += im;
+			re *= 0.5;
+			im *= 0.5;
+		}
+		m_nextImpulse += impulseInterval();
+	}
+	if (m_nextImpulse != std::numeric_limits<qint64>::max())
+		m_nextImpulse -= _numSamples;
+}
+
+void SynthGen::generate(void *_out, IQSampleFormat _format, quint32 _numSamples)
+{
+	quint8 *out = (quint8 *)_out;
+	quint32 bytes = DeviceInterfaceBase::bytesPerSample(_format);
+	quint32 len;
+	quint32 segmentLen;
+	for (quint32 done = 0; done < _numSamples; done += len) {
+		len = qMin(c_chunkSamples, _numSamples - done);
+		//Whole segments, anything past len is lost
+		segmentLen = (len + m_segmentSamples - 1) / m_segmentSamples * m_segmentSamples;
+		memset(m_re, 0, segmentLen * sizeof(float));
+		memset(m_im, 0, segmentLen * sizeof(float));
+		for (int c = 0; c < m_carriers.count(); c++) {
+			for (quint32 i = 0; i < segmentLen; i += m_segmentSamples)
+				nextSegment(m_carriers[c], &m_re[i], &m_im[i]);
+		}
+		addNoise(len);
+		convert(out + done * bytes, _format, len);
+	}
+}
+
+//Work buffers to device format, clipped at full scale
+void SynthGen::convert(void *_out, IQSampleFormat _format, quint32 _numSamples)
+{
+	quint32 i = 0;
+	switch (_format) {
+		case IQF_CPX: {
+			double *out = (double *)_out;
+#ifdef SYNTHGEN_SSE2
+			for (; i + 4 <= _numSamples; i += 4) {
+				__m128 re = _mm_loadu_ps(&m_re[i]);
+				__m128 im = _mm_loadu_ps(&m_im[i]);
+				__m128 lo = _mm_unpacklo_ps(re, im);
+				__m128 hi = _mm_unpackhi_ps(re, im);
+				_mm_storeu_pd(&out[2 * i], _mm_cvtps_pd(lo));
+				_mm_storeu_pd(&out[2 * i + 2], _mm_cvtps_pd(_mm_movehl_ps(lo, lo)));
+				_mm_storeu_pd(&out[2 * i + 4], _mm_cvtps_pd(hi));
+				_mm_storeu_pd(&out[2 * i + 6], _mm_cvtps_pd(_mm_movehl_ps(hi, hi)));
+			}
+#endif
+			for (; i < _numSamples; i++) {
+				out[2 * i] = m_re[i];
+				out[2 * i + 1] = m_im[i];
+			}
+			break;
+		}
+		case IQF_CPXFLOAT: {
+			float *out = (float *)_out;
+#ifdef SYNTHGEN_SSE2
+			for (; i + 4 <= _numSamples; i += 4) {
+				__m128 re = _mm_loadu_ps(&m_re[i]);
+				__m128 im = _mm_loadu_ps(&m_im[i]);
+				_mm_storeu_ps(&out[2 * i], _mm_unpacklo_ps(re, im));
+				_mm_storeu_ps(&out[2 * i + 4], _mm_unpackhi_ps(re, im));
+			}
+#endif
+			for (; i < _numSamples; i++) {
+				out[2 * i] = m_re[i];
+				out[2 * i + 1] = m_im[i];
+			}
+			break;
+		}
+		case IQF_CPX16: {
+			CPX16 *out = (CPX16 *)_out;
+#ifdef SYNTHGEN_SSE2
+			for (; i + 4 <= _numSamples; i += 4)
+				_mm_storeu_si128((__m128i *)&out[i], toInt16_ps(&m_re[i], &m_im[i], 32767.0f));
+#endif
+			for (; i < _numSamples; i++) {
+				out[i].real(qRound(qBound(-1.0f, m_re[i], 1.0f) * 32767.0f));
+				out[i].imag(qRound(qBound(-1.0f, m_im[i], 1.0f) * 32767.0f));
+			}
+			break;
+		}
+		case IQF_CPX8: {
+			CPX8 *out = (CPX8 *)_out;
+#ifdef SYNTHGEN_SSE2
+			for (; i + 8 <= _numSamples; i += 8) {
+				__m128i lo = toInt16_ps(&m_re[i], &m_im[i], 127.0f);
+				__m128i hi = toInt16_ps(&m_re[i + 4], &m_im[i + 4], 127.0f);
+				_mm_storeu_si128((__m128i *)&out[i], _mm_packs_epi16(lo, hi));
+			}
+#endif
+			for (; i < _numSamples; i++) {
+				out[i].real(qRound(qBound(-1.0f, m_re[i], 1.0f) * 127.0f));
+				out[i].imag(qRound(qBound(-1.0f, m_im[i], 1.0f) * 127.0f));
+			}
+			break;
+		}
+		case IQF_CPXU8: {
+			CPXU8 *out = (CPXU8 *)_out;
+#ifdef SYNTHGEN_SSE2
+			const __m128i zero = _mm_set1_epi16(128);
+			for (; i + 8 <= _numSamples; i += 8) {
+				__m128i lo = _mm_add_epi16(toInt16_ps(&m_re[i], &m_im[i], 127.0f), zero);
+				__m128i hi = _mm_add_epi16(toInt16_ps(&m_re[i + 4], &m_im[i + 4], 127.0f), zero);
+				_mm_storeu_si128((__m128i *)&out[i], _mm_packus_epi16(lo, hi));
+			}
+#endif
+			for (; i < _numSamples; i++) {
+				out[i].real(qRound(qBound(-1.0f, m_re[i], 1.0f) * 127.0f) + 128);
+				out[i].imag(qRound(qBound(-1.0f, m_im[i], 1.0f) * 127.0f) + 128);
+			}
+			break;
+		}
+	}
+}
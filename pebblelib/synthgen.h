@@ -0,0 +1,122 @@
+#ifndef SYNTHGEN_H
+#define SYNTHGEN_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "pebblelib_global.h"
+#include "device_interfaces.h"
+#include <QVector>
+
+/*
+	Synthetic IQ for load and soak tests, fast enough to run at 20msps without being the bottleneck
+
+	Carriers are generated with a bank of c_lanes complex phasors that each advance c_lanes samples at a time,
+	so the inner loop is a complex multiply and a multiply-add per sample with no sin/cos (SSE2 when available).
+	Modulation is applied per segment: frequency is constant and amplitude is a linear ramp within each
+	segment, both updated at segment boundaries.  Segments are 8 to 64 samples, 4us or less when the sample
+	rate allows, which is indistinguishable from per-sample modulation at the rates this is meant for.
+	At sound card rates FM and sweeps are piecewise linear in phase, fine for load tests, not for audio quality.
+
+	AWGN is read from a table of gaussian samples at random offsets with random sign, impulse noise is a short
+	decaying burst at exponentially distributed intervals.  Everything random comes from one seeded generator,
+	so the same seed and settings always produce the same samples.
+
+	Not thread safe, caller locks if settings change while another thread is generating
+*/
+struct SynthCarrier
+{
+	enum Modulation {
+		MOD_CARRIER,	//Unmodulated
+		MOD_AM,			//Tone modulated AM
+		MOD_FM,			//Tone modulated FM
+		MOD_CW,			//Random morse elements with shaped keying
+		MOD_FSK,		//Random bits, continuous phase
+		MOD_SWEEP		//Sawtooth sweep centered on freq
+	};
+	Modulation modulation;
+	double freq;	//Hz from center, +/- sampleRate/2
+	double db;		//dBFS, 0 is full scale
+	double rate;	//Modulating tone Hz (AM, FM), wpm (CW), baud (FSK), sweeps per second (SWEEP)
+	double depth;	//AM index 0 to 1, FM deviation Hz, FSK shift Hz, sweep width Hz
+};
+
+class PEBBLELIBSHARED_EXPORT SynthGen
+{
+public:
+	//Noise levels at or below this are off
+	static constexpr double c_offDb = -200.0;
+	//_numSamples that are a multiple of this are always continuous
+	static const quint32 c_maxSegmentSamples = 64;
+
+	SynthGen(quint32 _sampleRate, quint64 _seed = 1);
+	~SynthGen();
+
+	void setCarriers(const QVector<SynthCarrier> &_carriers);
+	//Total AWGN power in dBFS over the whole sample rate, impulse peak in dBFS
+	void setNoise(double _awgnDb, double _impulseDb, double _impulsesPerSec);
+	//Back to sample 0 for _seed
+	void reset(quint64 _seed);
+
+	//_numSamples interleaved I/Q of _format.  IQF_CPX is normalized doubles, same as IQF_CPXFLOAT
+	void generate(void *_out, IQSampleFormat _format, quint32 _numSamples);
+
+	//IQBlock scale for full scale +/-1, IQF_CPXU8 is centered on 128
+	static double scale(IQSampleFormat _format);
+
+private:
+	static const quint32 c_lanes = 8;
+	static const quint32 c_chunkSamples = 4096; //Work buffer, multiple of c_maxSegmentSamples
+	static const quint32 c_noiseTableSize = 65536;
+	static const quint32 c_noiseRunSamples = 256; //Contiguous samples read from noise table
+	static const quint32 c_impulseSamples = 8;
+	static constexpr double c_cwRiseSecs = .005;
+
+	struct CarrierState {
+		SynthCarrier carrier;
+		double amp;
+		//Phase of next sample
+		double phaseRe;
+		double phaseIm;
+		//exp(j w), exp(j w c_lanes) and exp(j w segment) for the last w used
+		double w;
+		double stepRe, stepIm;
+		double laneStepRe, laneStepIm;
+		double segStepRe, segStepIm;
+		//Modulating tone, advanced once per segment
+		double modRe, modIm;
+		double modStepRe, modStepIm;
+		//CW key and FSK symbol state, envelope is 0 to 1
+		bool keyDown;
+		double env;
+		double secsLeft;
+		int symbol;
+		double sweepPos; //0 to 1
+	};
+
+	quint32 m_sampleRate;
+	quint32 m_segmentSamples;
+	double m_segmentSecs;
+	QVector<CarrierState> m_carriers;
+
+	quint64 m_rng;
+	quint64 m_seed;
+
+	float *m_re;
+	float *m_im;
+	float *m_noiseRe;
+	float *m_noiseIm;
+	double m_awgnAmp;
+	double m_impulseAmp;
+	double m_impulsesPerSec;
+	qint64 m_nextImpulse; //Samples from start of next chunk
+
+	quint64 nextRandom();
+	double nextUniform(); //(0,1]
+	void initCarrier(CarrierState &_state);
+	void setStep(CarrierState &_state, double _w);
+	void nextSegment(CarrierState &_state, float *_re, float *_im);
+	void addNoise(quint32 _numSamples);
+	qint64 impulseInterval();
+	void convert(void *_out, IQSampleFormat _format, quint32 _numSamples);
+};
+
+#endif // SYNTHGEN_H
@@ -0,0 +1,69 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include <QtGlobal>
+#include <QAtomicInteger>
+
+/*
+	Lock free hand off of the latest frame from one producer thread to one consumer thread
+
+	Three buffers of _size elements.  Producer owns back, consumer owns front, middle is the last published
+	frame.  publish() swaps back and middle, update() swaps middle and front if there is something new.
+	Neither side ever waits for the other, if the consumer is slow it just skips to the newest frame.
+
+		producer: fill(writeBuffer()); publish();
+		consumer: if (update()) use(readBuffer());
+
+	readBuffer() stays valid and unchanged until the consumer calls update() again
+	One producer thread and one consumer thread per instance, use two instances for two consumers
+*/
+template <class templateType> class TripleBuffer
+{
+public:
+	TripleBuffer(quint32 _size) {
+		m_size = _size;
+		for (int i = 0; i < 3; i++) {
+			m_buffers[i] = new templateType[_size];
+			for (quint32 j = 0; j < _size; j++)
+				m_buffers[i][j] = templateType();
+		}
+		m_back = 0;
+		m_middle.store(1);
+		m_front = 2;
+	}
+	~TripleBuffer() {
+		for (int i = 0; i < 3; i++)
+			delete[] m_buffers[i];
+	}
+
+	quint32 size() {return m_size;}
+
+	//Producer
+	templateType *writeBuffer() {return m_buffers[m_back];}
+	void publish() {
+		//Release so consumer sees the frame before the index
+		m_back = m_middle.fetchAndStoreOrdered(m_back | c_newFrame) & c_indexMask;
+	}
+
+	//Consumer, true if readBuffer() changed
+	bool update() {
+		if ((m_middle.loadAcquire() & c_newFrame) == 0)
+			return false;
+		m_front = m_middle.fetchAndStoreOrdered(m_front) & c_indexMask;
+		return true;
+	}
+	templateType *readBuffer() {return m_buffers[m_front];}
+
+private:
+	static const int c_indexMask = 0x03;
+	static const int c_newFrame = 0x04; //Set in m_middle when producer has published since last update()
+
+	quint32 m_size;
+	templateType *m_buffers[3];
+	int m_back; //Producer only
+	QAtomicInteger<int> m_middle; //Index | c_newFrame
+	int m_front; //Consumer only
+};
+
+#endif // TRIPLEBUFFER_H
@@ -0,0 +1,319 @@
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "udpingest.h"
+#include <QDebug>
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#define UDPINGEST_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef Q_OS_WIN
+#include <winsock2.h>
+#define closeSocket closesocket
+typedef int socklen_t;
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#define closeSocket ::close
+#endif
+
+/*
+ Timing at max rates
+	HPSDR Metis 384ksps: 126 samples per 1032 byte datagram, ~3050 datagrams/sec
+	SDR-IP 1.8msps: 256 samples per 1028 byte datagram, ~7000 datagrams/sec
+ At these rates one signal/slot per datagram was costing more than the unpacking.
+ A 4mb receive buffer holds about half a second of SDR-IP data, plenty for any consumer hiccup
+*/
+
+//Single arena for all datagrams in a batch, allocated once
+struct UdpIngestBatch
+{
+	quint8 arena[UdpIngest::c_maxBatch * UdpIngest::c_maxDatagramSize];
+	quint8 *datagrams[UdpIngest::c_maxBatch];
+	quint32 lengths[UdpIngest::c_maxBatch];
+#ifdef Q_OS_LINUX
+	mmsghdr msgs[UdpIngest::c_maxBatch];
+	iovec iovecs[UdpIngest::c_maxBatch];
+#endif
+};
+
+UdpIngest::UdpIngest()
+{
+	m_socket = -1;
+	m_localPort = 0;
+	m_isRunning = false;
+	m_batch = new UdpIngestBatch;
+	for (quint32 i = 0; i < c_maxBatch; i++) {
+		m_batch->datagrams[i] = &m_batch->arena[i * c_maxDatagramSize];
+		m_batch->lengths[i] = 0;
+	}
+#ifdef Q_OS_LINUX
+	memset(m_batch->msgs, 0, sizeof(m_batch->msgs));
+	for (quint32 i = 0; i < c_maxBatch; i++) {
+		m_batch->iovecs[i].iov_base = m_batch->datagrams[i];
+		m_batch->iovecs[i].iov_len = c_maxDatagramSize;
+		m_batch->msgs[i].msg_hdr.msg_iov = &m_batch->iovecs[i];
+		m_batch->msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+#endif
+	//select() in receiveBatch() is the wait, never idle
+	m_worker = new PollingWorker("PebbleUdpIngest", [this]() {return receiveBatch();}, 0);
+	m_cbDatagram = NULL;
+	m_cbSequence = NULL;
+	m_sequenceModulo = 0;
+	m_haveSequence = false;
+	m_nextSequence = 0;
+	resetStats();
+}
+
+UdpIngest::~UdpIngest()
+{
+	stop();
+	close();
+	delete m_worker;
+	delete m_batch;
+}
+
+bool UdpIngest::open(quint16 _port, quint32 _rcvBufBytes)
+{
+	if (m_socket >= 0)
+		close();
+
+	m_socket = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (m_socket < 0) {
+		qDebug()<<"UdpIngest: socket() failed";
+		return false;
+	}
+
+	//OS may clamp this (net.core.rmem_max on Linux, kern.ipc.maxsockbuf on Mac), we report what we got
+	int v = _rcvBufBytes;
+	::setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, (char *)&v, sizeof(v));
+	socklen_t vLen = sizeof(v);
+	if (::getsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, (char *)&v, &vLen) == 0)
+		qDebug()<<"UdpIngest: SO_RCVBUF requested "<<_rcvBufBytes<<" actual "<<v;
+
+	//Allow quick restart on same port after stop
+	int reuse = 1;
+	::setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, (char *)&reuse, sizeof(reuse));
+	//Needed for discovery style broadcasts on same socket
+	int broadcast = 1;
+	::setsockopt(m_socket, SOL_SOCKET, SO_BROADCAST, (char *)&broadcast, sizeof(broadcast));
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(_port);
+	if (::bind(m_socket, (sockaddr *)&addr, sizeof(addr)) < 0) {
+		qDebug()<<"UdpIngest: bind() failed on port "<<_port;
+		closeSocket(m_socket);
+		m_socket = -1;
+		return false;
+	}
+	socklen_t addrLen = sizeof(addr);
+	::getsockname(m_socket, (sockaddr *)&addr, &addrLen);
+	m_localPort = ntohs(addr.sin_port);
+	return true;
+}
+
+void UdpIngest::close()
+{
+	if (m_isRunning)
+		stop();
+	if (m_socket >= 0) {
+		closeSocket(m_socket);
+		m_socket = -1;
+	}
+	m_localPort = 0;
+}
+
+void UdpIngest::setSequenceCheck(cbUdpIngestSequence _cbSequence, quint32 _sequenceModulo)
+{
+	m_cbSequence = _cbSequence;
+	m_sequenceModulo = _sequenceModulo;
+	m_haveSequence = false;
+}
+
+bool UdpIngest::start(cbUdpIngestDatagram _cbDatagram)
+{
+	if (m_socket < 0 || m_isRunning)
+		return false;
+
+	m_cbDatagram = _cbDatagram;
+	m_haveSequence = false;
+
+	m_isRunning = true;
+	//Same priority logic as ProducerConsumer, ingest has to keep up with the wire
+	m_worker->start(QThread::TimeCriticalPriority);
+	return true;
+}
+
+void UdpIngest::stop()
+{
+	if (!m_isRunning)
+		return;
+	//Worker wakes up at least every 100ms to check if it's still running
+	m_worker->stop(1000);
+	m_isRunning = false;
+}
+
+qint64 UdpIngest::sendDatagram(const void *_data, quint32 _length, quint32 _address, quint16 _port)
+{
+	if (m_socket < 0)
+		return -1;
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(_address);
+	addr.sin_port = htons(_port);
+	return ::sendto(m_socket, (const char *)_data, _length, 0, (sockaddr *)&addr, sizeof(addr));
+}
+
+void UdpIngest::resetStats()
+{
+	m_datagramsReceived.store(0);
+	m_bytesReceived.store(0);
+	m_datagramsLost.store(0);
+	m_datagramsOutOfOrder.store(0);
+	m_batchesReceived.store(0);
+}
+
+QString UdpIngest::statsString()
+{
+	quint64 batches = batchesReceived();
+	double perBatch = batches == 0 ? 0 : datagramsReceived() / (double)batches;
+	return QString("UDP datagrams %1, lost %2, out of order %3, avg batch %4")
+		.arg(datagramsReceived()).arg(datagramsLost()).arg(datagramsOutOfOrder()).arg(perBatch, 0, 'f', 1);
+}
+
+//Ingest thread
+void UdpIngest::processBatch(quint8 **_datagrams, quint32 *_lengths, quint32 _count)
+{
+	m_batchesReceived.fetchAndAddRelaxed(1);
+	quint32 sequence;
+	quint32 delta;
+	for (quint32 i = 0; i < _count; i++) {
+		m_datagramsReceived.fetchAndAddRelaxed(1);
+		m_bytesReceived.fetchAndAddRelaxed(_lengths[i]);
+
+		if (m_cbSequence != NULL && m_cbSequence(_datagrams[i], _lengths[i], sequence)) {
+			if (m_haveSequence) {
+				//Unsigned math handles wrap for full 32 bit sequences
+				if (m_sequenceModulo == 0)
+					delta = sequence - m_nextSequence;
+				else
+					delta = (sequence + m_sequenceModulo - m_nextSequence) % m_sequenceModulo;
+				quint32 window = m_sequenceModulo == 0 ? 0x80000000 : m_sequenceModulo / 2;
+				if (delta >= window) {
+					//Behind where we are, it's late and we've already moved on.  Counted as lost when we skipped it
+					m_datagramsOutOfOrder.fetchAndAddRelaxed(1);
+					if (m_datagramsLost.load() > 0)
+						m_datagramsLost.fetchAndAddRelaxed(-1);
+					continue;
+				}
+				if (delta > 0)
+					m_datagramsLost.fetchAndAddRelaxed(delta);
+			}
+			m_nextSequence = sequence + 1;
+			if (m_sequenceModulo != 0)
+				m_nextSequence %= m_sequenceModulo;
+			m_haveSequence = true;
+		}
+		m_cbDatagram(_datagrams[i], _lengths[i]);
+	}
+}
+
+//std::complex<double> is guaranteed to be layout compatible with double[2]
+//Compilers don't vectorize the byte gather, so SSE2 does 2 samples per loop (same guard as fastmath.cpp)
+void UdpIngest::unpack24BitIQ(CPX *_out, const quint8 *_in, quint32 _numSamples, quint32 _stride, double _scale)
+{
+	double *out = reinterpret_cast<double *>(_out);
+	const double scale = _scale / 8388607.0;
+	qint32 i24;
+	qint32 q24;
+	quint32 i = 0;
+
+#ifdef UDPINGEST_SSE2
+	//Each sample is loaded as 8 bytes into its own 64bit lane, so only when a sample is at least that long
+	if (_stride >= 8) {
+		const __m128d scaleV = _mm_set1_pd(scale);
+		__m128i v, q, x;
+		for (; i + 2 <= _numSamples; i += 2) {
+			v = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)_in),
+				_mm_loadl_epi64((const __m128i *)(_in + _stride)));
+			//Q starts at byte 3 of the lane
+			q = _mm_srli_epi64(v, 24);
+			//Dwords are I0, Q0, I1, Q1, still big endian with a spare low byte
+			x = _mm_unpacklo_epi32(_mm_shuffle_epi32(v, _MM_SHUFFLE(3, 1, 2, 0)),
+				_mm_shuffle_epi32(q, _MM_SHUFFLE(3, 1, 2, 0)));
+			//No pshufb in SSE2.  Byte swap each dword by swapping bytes in words, then words in dwords
+			x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+			x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+			//Same as scalar, MSB is at the top of 32 bits and the arithmetic shift drops the spare byte
+			x = _mm_srai_epi32(x, 8);
+			_mm_storeu_pd(out, _mm_mul_pd(_mm_cvtepi32_pd(x), scaleV));
+			_mm_storeu_pd(out + 2, _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(x, 8)), scaleV));
+			out += 4;
+			_in += 2 * _stride;
+		}
+	}
+#endif
+
+	for (; i < _numSamples; i++) {
+		//Shift MSB into the top of 32 bits, then arithmetic shift back down to get sign extension
+		i24 = (qint32)(((quint32)_in[0] << 24) | ((quint32)_in[1] << 16) | ((quint32)_in[2] << 8)) >> 8;
+		q24 = (qint32)(((quint32)_in[3] << 24) | ((quint32)_in[4] << 16) | ((quint32)_in[5] << 8)) >> 8;
+		out[0] = i24 * scale;
+		out[1] = q24 * scale;
+		out += 2;
+		_in += _stride;
+	}
+}
+
+//Ingest thread
+bool UdpIngest::receiveBatch()
+{
+	fd_set readSet;
+	timeval timeout;
+	int count;
+	//Wait for data, but wake up periodically so stop() is honored
+	FD_ZERO(&readSet);
+	FD_SET(m_socket, &readSet);
+	timeout.tv_sec = 0;
+	timeout.tv_usec = 100000;
+	if (::select(m_socket + 1, &readSet, NULL, NULL, &timeout) <= 0)
+		return true;
+
+#ifdef Q_OS_LINUX
+	//Everything that's queued, up to c_maxBatch, in one system call
+	count = ::recvmmsg(m_socket, m_batch->msgs, c_maxBatch, MSG_DONTWAIT, NULL);
+	if (count <= 0)
+		return true;
+	for (int i = 0; i < count; i++)
+		m_batch->lengths[i] = m_batch->msgs[i].msg_len;
+#else
+	count = 0;
+	while (count < (int)c_maxBatch) {
+#ifdef Q_OS_WIN
+		//Windows doesn't support MSG_DONTWAIT, select() told us at least one is waiting
+		if (count > 0)
+			break;
+		int actual = ::recv(m_socket, (char *)m_batch->datagrams[count], c_maxDatagramSize, 0);
+#else
+		int actual = ::recv(m_socket, (char *)m_batch->datagrams[count], c_maxDatagramSize, MSG_DONTWAIT);
+#endif
+		if (actual <= 0)
+			break;
+		m_batch->lengths[count++] = actual;
+	}
+	if (count == 0)
+		return true;
+#endif
+	processBatch(m_batch->datagrams, m_batch->lengths, count);
+	return true;
+}
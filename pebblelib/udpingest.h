@@ -0,0 +1,96 @@
+#ifndef UDPINGEST_H
+#define UDPINGEST_H
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include "cpx.h"
+#include "pollingworker.h"
+#include <QObject>
+#include <QAtomicInteger>
+
+/*
+ Batched UDP receive engine for network devices that stream IQ in datagrams (HPSDR Metis, SDR-IP, AFEDRI-Net)
+
+ Replaces the one datagram per readyRead() model, which runs every datagram through the Qt event loop.
+ We own a native socket and read it from a dedicated PollingWorker thread
+	- Linux uses recvmmsg() to pull up to c_maxBatch datagrams with a single system call
+	- Mac and Win drain the socket with non-blocking recvfrom() into the same batch arena
+	- SO_RCVBUF is set large enough to ride out several ms of consumer stalls at max device rate
+	- Optional sequence number check counts lost and out of order datagrams
+
+ The device gets a callback in the ingest thread for every valid datagram and unpacks directly into
+ its producer buffers.  Commands to the device should be sent through sendDatagram() so replies and IQ
+ data come back to the port we are listening on.
+*/
+
+//Called from ingest thread with each datagram in arrival order
+typedef std::function<void(quint8 *_datagram, quint32 _length)> cbUdpIngestDatagram;
+//Returns true and fills _sequence if datagram carries a sequence number, false to skip gap detection
+typedef std::function<bool(const quint8 *_datagram, quint32 _length, quint32 &_sequence)> cbUdpIngestSequence;
+
+struct UdpIngestBatch;
+
+class UdpIngest : public QObject
+{
+	Q_OBJECT
+public:
+	static const quint32 c_maxBatch = 64; //Max datagrams per recvmmsg()
+	static const quint32 c_maxDatagramSize = 2048; //Larger than any device datagram we support
+
+	UdpIngest();
+	~UdpIngest();
+
+	//Binds to _port (0 = any) on all interfaces and sets receive buffer size
+	bool open(quint16 _port = 0, quint32 _rcvBufBytes = 4000000);
+	void close();
+	bool isOpen() {return m_socket >= 0;}
+	quint16 localPort() {return m_localPort;}
+
+	//_sequenceModulo is the number of distinct sequence numbers before wrap, 0 for full 32 bit
+	void setSequenceCheck(cbUdpIngestSequence _cbSequence, quint32 _sequenceModulo = 0);
+
+	bool start(cbUdpIngestDatagram _cbDatagram);
+	void stop();
+	bool isRunning() {return m_isRunning;}
+
+	//_address is IPv4 in host byte order, see QHostAddress::toIPv4Address()
+	qint64 sendDatagram(const void *_data, quint32 _length, quint32 _address, quint16 _port);
+
+	//Stats, safe to read from any thread
+	quint64 datagramsReceived() {return m_datagramsReceived.load();}
+	quint64 bytesReceived() {return m_bytesReceived.load();}
+	quint64 datagramsLost() {return m_datagramsLost.load();}
+	quint64 datagramsOutOfOrder() {return m_datagramsOutOfOrder.load();}
+	quint64 batchesReceived() {return m_batchesReceived.load();}
+	void resetStats();
+	QString statsString();
+
+	//Unpacks big endian 24bit I and Q into CPX (+/- 1.0 * _scale).  _stride is bytes between sample pairs
+	//HPSDR is I(3) Q(3) Mic(2) = 8 byte stride
+	static void unpack24BitIQ(CPX *_out, const quint8 *_in, quint32 _numSamples, quint32 _stride, double _scale);
+
+private:
+	int m_socket;
+	quint16 m_localPort;
+	bool m_isRunning;
+
+	PollingWorker *m_worker;
+	UdpIngestBatch *m_batch; //Ingest thread only
+
+	cbUdpIngestDatagram m_cbDatagram;
+	cbUdpIngestSequence m_cbSequence;
+	quint32 m_sequenceModulo;
+	bool m_haveSequence;
+	quint32 m_nextSequence;
+
+	QAtomicInteger<quint64> m_datagramsReceived;
+	QAtomicInteger<quint64> m_bytesReceived;
+	QAtomicInteger<quint64> m_datagramsLost;
+	QAtomicInteger<quint64> m_datagramsOutOfOrder;
+	QAtomicInteger<quint64> m_batchesReceived;
+
+	//Worker, waits up to 100ms for a batch
+	bool receiveBatch();
+	void processBatch(quint8 **_datagrams, quint32 *_lengths, quint32 _count);
+};
+
+#endif // UDPINGEST_H
@@ -337,6 +337,30 @@ int WavFile::ReadSamples(CPX *buf, int numSamples)
 
 }
 
+//Data chunk size isn't kept when reading and is 0 in files that were never closed, so use file size
+quint64 WavFile::GetNumSamples()
+{
+    if (writeMode || wavFile == NULL || fmtSubChunk.blockAlign == 0)
+        return 0;
+    return (wavFile->size() - dataStart) / fmtSubChunk.blockAlign;
+}
+
+quint64 WavFile::GetPosition()
+{
+    if (writeMode || wavFile == NULL || fmtSubChunk.blockAlign == 0)
+        return 0;
+    return (wavFile->pos() - dataStart) / fmtSubChunk.blockAlign;
+}
+
+bool WavFile::Seek(quint64 sample)
+{
+    if (writeMode || wavFile == NULL)
+        return false;
+    if (sample >= GetNumSamples())
+        return false;
+    return wavFile->seek(dataStart + sample * fmtSubChunk.blockAlign);
+}
+
 CPX WavFile::ReadSample()
 {
     CPX sample;
@@ -395,6 +419,18 @@ bool WavFile::WriteSamples(CPX* buf, int numSamples)
     return true;
 }
 
+bool WavFile::WriteSamples(const PCM_DATA_2CH *buf, int numSamples)
+{
+    if (!writeMode || wavFile == NULL)
+        return false;
+
+    qint64 bufLen = sizeof(PCM_DATA_2CH) * numSamples;
+    if (wavFile->write((const char*) buf, bufLen) != bufLen)
+        return false;
+    dataSubChunkPre.size += bufLen;
+    return true;
+}
+
 bool WavFile::Close()
 {
     //If open for writing, update length fields
@@ -170,11 +170,17 @@ public:
     CPX ReadSample();
     int ReadSamples(CPX *buf, int numSamples);
     bool WriteSamples(CPX *buf, int numSamples);
+    //Already converted 16 bit L/R, one write for the whole block
+    bool WriteSamples(const PCM_DATA_2CH *buf, int numSamples);
     bool Close();
 
     int GetSampleRate();
     quint32 GetLoFreq() {return loFreq;}
     quint8 GetMode() {return mode;}
+    //Read only, in samples from start of data so long recordings can be played from any point
+    quint64 GetNumSamples();
+    quint64 GetPosition();
+    bool Seek(quint64 sample);
 
 protected:
     //SDR tag/values read and written to wav
@@ -36,6 +36,13 @@ CPX *DigitalModemExample::processBlock(CPX *in)
     return in;
 }
 
+void DigitalModemExample::processModemBlock(const ModemBlock &_block)
+{
+    //Decoders can take as long as they need here, audio doesn't wait for us
+    //_block.droppedSamples > 0 means we fell behind and should resync
+    Q_UNUSED(_block);
+}
+
 void DigitalModemExample::setupDataUi(QWidget *parent)
 {
     if (parent == NULL) {
@@ -6,7 +6,7 @@
 #include "../pebblelib/digital_modem_interfaces.h"
 #include "ui_data-example.h"
 
-class DigitalModemExample  : public QObject, public DigitalModemInterface
+class DigitalModemExample  : public QObject, public DigitalModemInterface2
 {
     Q_OBJECT
 
@@ -14,7 +14,8 @@ class DigitalModemExample  : public QObject, public DigitalModemInterface
     //IID must be same that caller is looking for, defined in interfaces file
     Q_PLUGIN_METADATA(IID DigitalModemInterface_iid)
     //Let Qt meta-object know about our interface
-    Q_INTERFACES(DigitalModemInterface)
+    //V2 modems list both so Plugins can find us with the V1 cast
+    Q_INTERFACES(DigitalModemInterface DigitalModemInterface2)
 
 public:
 
@@ -26,8 +27,10 @@ public:
     //Setup demod mode etc
     void setDemodMode(DeviceInterface::DemodMode _demodMode);
 
-    //Process samples
+    //Process samples, V1.  Not called for V2 modems
     CPX * processBlock(CPX * in);
+    //V2, on the modem thread with count and time stamp
+    void processModemBlock(const ModemBlock &_block);
 
     //Setup UI in context of parent
     void setupDataUi(QWidget *parent);
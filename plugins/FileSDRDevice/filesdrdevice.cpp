@@ -10,6 +10,10 @@ FileSDRDevice::FileSDRDevice():DeviceInterfaceBase()
 {
 	initSettings("WavFileSDR");
 	m_copyTest = false; //Write what we read
+	m_isIQFile = false;
+	m_overviewThread = NULL;
+	m_overviewBuilder = NULL;
+	m_pendingSeek.store(-1);
 	m_fileName = "";
 	m_recordingPath = "";
 	pebbleLibGlobal = new PebbleLibGlobal();
@@ -45,7 +49,8 @@ bool FileSDRDevice::connectDevice()
 #if 1
     //Passing NULL for dir shows current/last directory, which may be inside the mac application bundle
     //Mavericks native file open dialog doesn't respect passed directory arg, QT (Non-native) version works, but is ugly
-	m_fileName = QFileDialog::getOpenFileName(NULL,tr("Open Wave File"), m_recordingPath, tr("Wave Files (*.wav)"));
+	m_fileName = QFileDialog::getOpenFileName(NULL,tr("Open Wave File"), m_recordingPath,
+		tr("IQ Files (*.wav *.piq);;Wave Files (*.wav);;Compressed IQ Files (*.piq)"));
     //fileName = QFileDialog::getOpenFileName(NULL,tr("Open Wave File"), recordingPath, tr("Wave Files (*.wav)"),0,QFileDialog::DontUseNativeDialog);
 
 #else
@@ -70,11 +75,19 @@ bool FileSDRDevice::connectDevice()
 	QFileInfo fi(m_fileName);
 	m_recordingPath = fi.path()+"/*";
 
-	bool res = m_wavFileRead.OpenRead(m_fileName, m_framesPerBuffer);
-    if (!res)
-        return false;
-
-	m_deviceSampleRate = m_wavFileRead.GetSampleRate();
+	bool res;
+	m_isIQFile = fi.suffix().compare("piq", Qt::CaseInsensitive) == 0;
+	if (m_isIQFile) {
+		res = m_iqFileRead.openRead(m_fileName);
+		if (!res)
+			return false;
+		m_deviceSampleRate = m_iqFileRead.sampleRate();
+	} else {
+		res = m_wavFileRead.OpenRead(m_fileName, m_framesPerBuffer);
+		if (!res)
+			return false;
+		m_deviceSampleRate = m_wavFileRead.GetSampleRate();
+	}
 	//We have sample rate for file, set polling interval
 	//We don't use producer thread, sampleRateTimer and producerSlot() instead
 	m_producerConsumer.SetProducerInterval(m_deviceSampleRate, m_framesPerBuffer);
@@ -83,18 +96,65 @@ bool FileSDRDevice::connectDevice()
 	if (m_copyTest) {
 		res = m_wavFileWrite.OpenWrite(m_fileName + "2", m_deviceSampleRate,0,0,0);
     }
+	m_pendingSeek.store(-1);
+	startOverview();
     return true;
 }
 
 bool FileSDRDevice::disconnectDevice()
 {
+	stopOverview();
 	m_wavFileRead.Close();
+	m_iqFileRead.close();
 	m_wavFileWrite.Close();
     return true;
 }
 
+quint32 FileSDRDevice::fileLoFreq()
+{
+	return m_isIQFile ? m_iqFileRead.loFreq() : m_wavFileRead.GetLoFreq();
+}
+
+quint8 FileSDRDevice::fileMode()
+{
+	return m_isIQFile ? m_iqFileRead.mode() : m_wavFileRead.GetMode();
+}
+
+void FileSDRDevice::startOverview()
+{
+	stopOverview();
+	m_overviewFileName = IQOverview::fileNameFor(m_fileName);
+	quint64 numSamples = m_isIQFile ? m_iqFileRead.numSamples() : m_wavFileRead.GetNumSamples();
+	IQOverview overview;
+	if (overview.load(m_overviewFileName, numSamples))
+		return; //Recorded with overview, or built last time
+
+	//Playback can start now, overview shows up when it's done
+	m_overviewThread = new QThread();
+	m_overviewThread->setObjectName("PebbleOverviewBuilder");
+	m_overviewBuilder = new IQOverviewBuilder(m_fileName);
+	connect(m_overviewThread, &QThread::started, m_overviewBuilder, &IQOverviewBuilder::start);
+	m_overviewBuilder->moveToThread(m_overviewThread);
+	m_overviewBuilder->arm();
+	m_overviewThread->start();
+}
+
+void FileSDRDevice::stopOverview()
+{
+	if (m_overviewThread == NULL)
+		return;
+	m_overviewBuilder->stop();
+	m_overviewThread->quit();
+	m_overviewThread->wait();
+	delete m_overviewBuilder;
+	delete m_overviewThread;
+	m_overviewBuilder = NULL;
+	m_overviewThread = NULL;
+}
+
 void FileSDRDevice::startDevice()
 {
+	DeviceInterfaceBase::startDevice();
 	//How often do we need to read samples from files to get framesPerBuffer at sampleRate
 	m_nsPerBuffer = (1000000000.0 / m_deviceSampleRate) * m_framesPerBuffer;
 	//qDebug()<<"nsPerBuffer"<<nsPerBuffer;
@@ -135,7 +195,7 @@ QVariant FileSDRDevice::get(DeviceInterface::StandardKeys _key, QVariant _option
 			return "WAV File SDR";
 			break;
 		case Key_PluginDescription:
-			return "Plays back I/Q WAV file";
+			return "Plays back I/Q WAV or compressed PIQ file";
 			break;
 		case Key_DeviceName:
 			return "SDRFile: " + QFileInfo(m_fileName).fileName() + "-" + QString::number(m_deviceSampleRate);
@@ -144,14 +204,14 @@ QVariant FileSDRDevice::get(DeviceInterface::StandardKeys _key, QVariant _option
 		case Key_StartupType:
 			return DeviceInterface::ST_DEFAULTFREQ; //Fixed, can't change freq
 		case Key_HighFrequency: {
-			quint32 loFreq = m_wavFileRead.GetLoFreq();
+			quint32 loFreq = fileLoFreq();
 			if (loFreq == 0)
 				return m_deviceSampleRate;
 			else
 				return loFreq + m_deviceSampleRate / 2.0;
 		}
 		case Key_LowFrequency: {
-			quint32 loFreq = m_wavFileRead.GetLoFreq();
+			quint32 loFreq = fileLoFreq();
 			if (loFreq == 0)
 				return 0;
 			else
@@ -159,7 +219,7 @@ QVariant FileSDRDevice::get(DeviceInterface::StandardKeys _key, QVariant _option
 		}
 		case Key_StartupFrequency: {
 			//If it's a pebble wav file, we should have LO freq
-			quint32 loFreq = m_wavFileRead.GetLoFreq();
+			quint32 loFreq = fileLoFreq();
 			if (loFreq == 0)
 				return m_deviceSampleRate / 2.0; //Default
 			else
@@ -167,7 +227,7 @@ QVariant FileSDRDevice::get(DeviceInterface::StandardKeys _key, QVariant _option
 			break;
 		}
 		case Key_StartupDemodMode: {
-			int startupMode =  m_wavFileRead.GetMode();
+			int startupMode =  fileMode();
 			if (startupMode < 255)
 				return startupMode;
 			else
@@ -175,6 +235,13 @@ QVariant FileSDRDevice::get(DeviceInterface::StandardKeys _key, QVariant _option
 
 			break;
 		}
+		case Key_RecordingOverview:
+			//Still building, or stale file from before the recording changed
+			if (m_overviewBuilder != NULL && !m_overviewBuilder->isDone())
+				return "";
+			return QFile::exists(m_overviewFileName) ? m_overviewFileName : "";
+		case Key_PlaybackPosition:
+			return m_isIQFile ? m_iqFileRead.position() : m_wavFileRead.GetPosition();
 		default:
 			//If we don't handle it, let default grab it
 			return DeviceInterfaceBase::get(_key, _option);
@@ -192,6 +259,11 @@ bool FileSDRDevice::set(StandardKeys _key, QVariant _value, QVariant _option)
 			//Fixed, so return false so it won't change in UI.  Only mixer should work
 			return false;
 
+		case Key_PlaybackPosition:
+			//Producer is reading from another thread, it will seek before its next read
+			m_pendingSeek.storeRelease(_value.toLongLong());
+			return true;
+
 		default:
 			return DeviceInterfaceBase::set(_key, _value, _option);
 
@@ -250,7 +322,18 @@ void FileSDRDevice::producerSlot()
 	if ((m_producerBuf = (CPX*)m_producerConsumer.AcquireFreeBuffer()) == NULL)
 		return;
 
-	samplesRead = m_wavFileRead.ReadSamples(m_producerBuf,m_framesPerBuffer);
+	qint64 seekTo = m_pendingSeek.fetchAndStoreAcquire(-1);
+	if (seekTo >= 0) {
+		if (m_isIQFile)
+			m_iqFileRead.seek(seekTo);
+		else
+			m_wavFileRead.Seek(seekTo);
+	}
+
+	if (m_isIQFile)
+		samplesRead = m_iqFileRead.readSamples(m_producerBuf,m_framesPerBuffer);
+	else
+		samplesRead = m_wavFileRead.ReadSamples(m_producerBuf,m_framesPerBuffer);
 	normalizeIQ(m_producerBuf, m_producerBuf,m_framesPerBuffer,false);
 
 	//ProcessIQData(producerBuf,framesPerBuffer);
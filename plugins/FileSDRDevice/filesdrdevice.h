@@ -6,6 +6,10 @@
 #include <QObject>
 #include "deviceinterfacebase.h"
 #include "wavfile.h"
+#include "iqfile.h"
+#include "iqoverview.h"
+#include <QThread>
+#include <QAtomicInteger>
 
 class FileSDRDevice : public QObject, public DeviceInterfaceBase
 {
@@ -15,7 +19,7 @@ class FileSDRDevice : public QObject, public DeviceInterfaceBase
     //IID must be same that caller is looking for, defined in interfaces file
     Q_PLUGIN_METADATA(IID DeviceInterface_iid)
     //Let Qt meta-object know about our interface
-    Q_INTERFACES(DeviceInterface)
+    Q_INTERFACES(DeviceInterface DeviceInterface2)
 
 public:
     FileSDRDevice();
@@ -42,14 +46,27 @@ private:
 	void setupOptionUi(QWidget *parent);
 	void producerWorker(cbProducerConsumerEvents _event);
 	void consumerWorker(cbProducerConsumerEvents _event);
+	quint32 fileLoFreq();
+	quint8 fileMode();
+	void startOverview();
+	void stopOverview();
 
 	QString m_fileName;
 	QString m_recordingPath;
 
 	WavFile m_wavFileRead;
+	IQFile m_iqFileRead; //Compressed .piq recordings
+	bool m_isIQFile; //True if we're playing m_iqFileRead instead of m_wavFileRead
 	WavFile m_wavFileWrite;
 	bool m_copyTest; //True if we're reading from one file and writing to another file for testing
 
+	//Recordings made before overviews existed get one built in the background the first time they're opened
+	QString m_overviewFileName;
+	QThread *m_overviewThread;
+	IQOverviewBuilder *m_overviewBuilder;
+	//Set from UI thread, applied by producer between reads.  -1 if none
+	QAtomicInteger<qint64> m_pendingSeek;
+
 	QElapsedTimer m_elapsedTimer;
 	qint64 m_nsPerBuffer; //How fast do we have to output a buffer of data to match recorded sample rate
 	CPX *m_producerBuf;
@@ -16,7 +16,7 @@ class FunCubeSDRDevice : public QObject, public DeviceInterfaceBase
 	//IID must be same that caller is looking for, defined in interfaces file
 	Q_PLUGIN_METADATA(IID DeviceInterface_iid)
 	//Let Qt meta-object know about our interface
-	Q_INTERFACES(DeviceInterface)
+	Q_INTERFACES(DeviceInterface DeviceInterface2)
 
 public:
 	enum SDRDEVICE {FUNCUBE_PRO, FUNCUBE_PRO_PLUS};
@@ -239,7 +239,7 @@ class Ghpsdr3Device : public QObject, public DeviceInterfaceBase
 	//IID must be same that caller is looking for, defined in interfaces file
 	Q_PLUGIN_METADATA(IID DeviceInterface_iid)
 	//Let Qt meta-object know about our interface
-	Q_INTERFACES(DeviceInterface)
+	Q_INTERFACES(DeviceInterface DeviceInterface2)
 
 public:
 	friend class Servers;
@@ -254,6 +254,7 @@ bool HPSDRDevice::disconnectDevice()
 
 void HPSDRDevice::startDevice()
 {
+	DeviceInterfaceBase::startDevice();
 	sampleCount = 0;
 	if (connectionType == METIS) {
 		if (!hpsdrNetwork.SendStart())
@@ -384,6 +385,10 @@ QVariant HPSDRDevice::get(DeviceInterface::StandardKeys _key, QVariant _option)
 				return sGainPreampOn;
 			else
 				return sGainPreampOff;
+		case Key_DeviceHealthString:
+			if (connectionType == METIS)
+				return hpsdrNetwork.IngestStats();
+			return DeviceInterfaceBase::get(_key, _option);
 
 		default:
 			return DeviceInterfaceBase::get(_key, _option);
@@ -516,36 +521,22 @@ bool HPSDRDevice::ProcessInputFrame(unsigned char *buf, int len)
 			break;
 		}
 		//Extract I/Q and add to buffer
-		CPX cpx;
-		double mic;
-		while (b < len) {
+		//Each sample is 24bit I, 24bit Q, 16bit mic (skipped for now)
+		quint32 numSamples;
+		while (b + 8 <= len) {
 			if (sampleCount == 0) {
 				//Get a new buffer
 				producerFreeBufPtr = (CPX*)m_producerConsumer.AcquireFreeBuffer();
 				if (producerFreeBufPtr == NULL)
 					return false;
 			}
+			//Unpack as many samples as fit in both the frame and the current producer buffer
+			numSamples = qMin((quint32)(len - b) / 8, (quint32)(m_framesPerBuffer - sampleCount));
+			UdpIngest::unpack24BitIQ(&producerFreeBufPtr[sampleCount], &buf[b], numSamples, 8, 1.0);
+			b += numSamples * 8;
+			sampleCount += numSamples;
 
-			//24bit samples
-			//NOTE: The (signed char) and (unsigned char) casts are critical in order for the bit shift to work correctly
-			//Otherwise the MSB won't have the sign set correctly
-			cpx.real((signed char)buf[b++]<<16);
-			cpx.real(cpx.real() + ((unsigned char)buf[b++]<<8));
-			cpx.real(cpx.real() + (unsigned char)buf[b++]);
-			cpx.real(cpx.real() / 8388607.0); //Convert to +/- float from 24bit int
-
-			cpx.imag((signed char)buf[b++]<<16);
-			cpx.imag(cpx.imag() + ((unsigned char)buf[b++]<<8));
-			cpx.imag(cpx.imag() + (unsigned char)buf[b++]);
-			cpx.imag(cpx.imag() / 8388607.0); //Convert to +/- float
-
-			//Skip mic-line sample for now
-			mic = (signed char)buf[b++]<<8;
-			mic += (unsigned char)buf[b++];
-			mic /= 32767.0;
-
-			//Add to dataBuf and see if we have enough samples
-			producerFreeBufPtr[sampleCount++] = cpx;
+			//See if we have enough samples
 			if (sampleCount == m_framesPerBuffer) {
 				sampleCount = 0;
 				producerFreeBufPtr = NULL;
@@ -45,6 +45,17 @@ bool HPSDRNetwork::Init(HPSDRDevice *_hpsdrDevice, QString _metisAddress, quint1
 	}
 	//If we don't have fixed IP/Port for Metis, trigger discovery
 	//if (metisHostAddress.isNull()) {
+	if (!ingest.isOpen()) {
+		if (!ingest.open())
+			return false;
+		//Metis sequence number is big endian quint32 at bytes 4-7, full 32 bit wrap
+		ingest.setSequenceCheck([](const quint8 *_datagram, quint32 _length, quint32 &_sequence) {
+			if (_length < 8 || _datagram[2] != 0x01 || _datagram[3] != 0x06)
+				return false;
+			_sequence = ((quint32)_datagram[4]<<24) | ((quint32)_datagram[5]<<16) | ((quint32)_datagram[6]<<8) | _datagram[7];
+			return true;
+		});
+	}
 	if (!_metisAddress.isNull()) {
 		metisHostAddress = QHostAddress(_metisAddress);
 		metisPort = _metisPort;
@@ -94,11 +105,17 @@ bool HPSDRNetwork::SendStart()
 	if (metisHostAddress.isNull())
 		return false;
 
+	ingest.resetStats();
+	if (!ingest.start([this](quint8 *_datagram, quint32 _length) {IngestDatagram(_datagram, _length);}))
+		return false;
+
 	PcToMetisStart payload;
 	payload.command = 0x01; //0x01 for IQ data only, 0x02 for Bandscope only, 0x03 for both
-	qint64 actual = udpSocket->writeDatagram((char*)&payload,sizeof(payload),metisHostAddress, metisPort);
-	if (actual != sizeof(payload))
+	qint64 actual = ingest.sendDatagram(&payload,sizeof(payload),metisHostAddress.toIPv4Address(), metisPort);
+	if (actual != sizeof(payload)) {
+		ingest.stop();
 		return false;
+	}
 
 	udpSequenceNumberOut = 0;
 	isRunning = true;
@@ -112,7 +129,9 @@ bool HPSDRNetwork::SendStop()
 
 	PcToMetisStart payload;
 	payload.command = 0x00; //0x02 to stop IQ only, 0x01 to stop Bandscope only, 0x00 to stop both
-	qint64 actual = udpSocket->writeDatagram((char*)&payload,sizeof(payload),metisHostAddress, metisPort);
+	qint64 actual = ingest.sendDatagram(&payload,sizeof(payload),metisHostAddress.toIPv4Address(), metisPort);
+	ingest.stop();
+	qDebug()<<"HPSDR-IP "<<ingest.statsString();
 	metisHostAddress.clear();
 	metisPort = 0;
 	if (actual != sizeof(payload))
@@ -154,15 +173,27 @@ bool HPSDRNetwork::SendCommand(char *cmd1, char *cmd2)
 		payload.frame2[7] = cmd2[4];
 	}
 
-	qint64 actual = udpSocket->writeDatagram((char*)&payload,sizeof(payload),metisHostAddress, metisPort);
+	qint64 actual = ingest.sendDatagram(&payload,sizeof(payload),metisHostAddress.toIPv4Address(), metisPort);
 	if (actual != sizeof(payload)) {
-		qDebug()<<"Error sending command datagram: "<<udpSocket->errorString();
+		qDebug()<<"Error sending command datagram";
 		return false;
 	} else {
 		return true;
 	}
 }
 
+//Ingest thread, called for every datagram Metis sends to the ingest socket
+void HPSDRNetwork::IngestDatagram(quint8 *_datagram, quint32 _length)
+{
+	if (_length < sizeof(MetisToPcIQData) || _datagram[0] != 0xEF || _datagram[1] != 0xFE)
+		return;
+	MetisToPcIQData *payload = (MetisToPcIQData *)_datagram;
+	if (payload->info != 0x01 || payload->endPoint != 0x06)
+		return; //Bandscope data (not used yet)
+	hpsdrDevice->ProcessInputFrame(payload->iqData.radio.IQframe1, 512);
+	hpsdrDevice->ProcessInputFrame(payload->iqData.radio.IQframe2, 512);
+}
+
 void HPSDRNetwork::NewUDPData()
 {
 	QHostAddress sender;
@@ -2,6 +2,7 @@
 #define HPSDRNETWORK_H
 #include <QThread>
 #include <QUdpSocket>
+#include "udpingest.h"
 
 class HPSDRDevice;
 
@@ -98,10 +99,14 @@ public:
 	bool SendStart();
 	bool SendStop();
 	bool SendCommand(char *cmd1, char *cmd2 = NULL);
+	QString IngestStats() {return ingest.statsString();}
 public slots:
 	void NewUDPData();
 private:
-	QUdpSocket *udpSocket;
+	QUdpSocket *udpSocket; //Discovery only
+	//Start, Stop and Commands go out through ingest so Metis streams IQ back to the ingest socket
+	UdpIngest ingest;
+	void IngestDatagram(quint8 *_datagram, quint32 _length);
 	quint32 udpSequenceNumberIn;
 	quint32 udpSequenceNumberOut;
 
@@ -8,9 +8,7 @@ HackRFDevice::HackRFDevice():DeviceInterfaceBase()
 	useSynchronousAPI = true; //Testing
 	useSignals = false;
 	producerBuf = NULL;
-	decimatorBuf = NULL;
 	hackrfDevice = NULL;
-	decimator = NULL;
 	hackrfVersion[0] = '\0';
 	hackrfBoardId = 0;
 }
@@ -18,11 +16,7 @@ HackRFDevice::HackRFDevice():DeviceInterfaceBase()
 HackRFDevice::~HackRFDevice()
 {
 	if (producerBuf != NULL)
-		free (producerBuf);
-	if (decimatorBuf != NULL)
-		free (decimatorBuf);
-	if (decimator != NULL)
-		delete decimator;
+		delete [] producerBuf;
 }
 
 //Sample rate must be set before this is called
@@ -33,11 +27,11 @@ bool HackRFDevice::initialize(CB_ProcessIQData _callback,
 	DeviceInterfaceBase::initialize(_callback, _callbackBandscope, _callbackAudio, _framesPerBuffer);
 	//If we are decimating, we need to collect more samples
 	deviceSamplesPerBuffer = m_framesPerBuffer * m_decimateFactor;
-	producerBuf = (CPX8*)new qint8[deviceSamplesPerBuffer * sizeof(CPX8)];
-	decimatorBuf = memalign(deviceSamplesPerBuffer);
+	if (producerBuf != NULL)
+		delete [] producerBuf;
+	producerBuf = new CPX8[deviceSamplesPerBuffer];
 
-	decimator = new Decimator(m_deviceSampleRate, deviceSamplesPerBuffer);
-	setSampleRate(m_deviceSampleRate); //Builds decimation chain
+	setSampleRate(m_deviceSampleRate);
 
 	if (useSynchronousAPI)
 		m_numProducerBuffers = 50;
@@ -96,11 +90,8 @@ void HackRFDevice::setSampleRate(quint32 _sampleRate)
 {
 	m_deviceSampleRate = _sampleRate;
 
-	if (m_decimateFactor == 1) {
-		m_sampleRate = m_deviceSampleRate;
-	} else {
-		m_sampleRate = decimator->buildDecimationChain(m_deviceSampleRate,200000,m_deviceSampleRate / m_decimateFactor);
-	}
+	//Integer CIC pre-decimation in DeviceInterfaceBase, factor is always a power of 2
+	m_sampleRate = m_deviceSampleRate / m_decimateFactor;
 }
 
 bool HackRFDevice::apiCheck(int result, const char* api)
@@ -274,6 +265,8 @@ bool HackRFDevice::command(DeviceInterface::StandardCommands _cmd, QVariant _arg
 			optionUi->decimationBox->addItem("16",16);
 			int item = optionUi->decimationBox->findData(m_decimateFactor);
 			optionUi->decimationBox->setCurrentIndex(item);
+			//Read buffers are sized for the factor in initialize(), only change it while off
+			optionUi->decimationBox->setEnabled(!m_connected && !m_running);
 			connect(optionUi->decimationBox,SIGNAL(currentIndexChanged(int)),this,SLOT(
 						decimationChanged(int)));
 
@@ -459,7 +452,13 @@ void HackRFDevice::vgaGainChanged(int _value)
 void HackRFDevice::decimationChanged(int _index)
 {
 	Q_UNUSED(_index);
-	m_decimateFactor = optionUi->decimationBox->currentData().toUInt();
+	//Dialog may have been opened before power on, DeviceInterfaceBase refuses the change while connected
+	if (!set(Key_DecimateFactor, optionUi->decimationBox->currentData())) {
+		optionUi->decimationBox->blockSignals(true);
+		optionUi->decimationBox->setCurrentIndex(optionUi->decimationBox->findData(m_decimateFactor));
+		optionUi->decimationBox->blockSignals(false);
+		return;
+	}
 	m_settings->sync();
 }
 
@@ -509,8 +508,6 @@ int HackRFDevice::rx_callback(hackrf_transfer*transfer)
 //Producer is used for testing synchronous API, see callback() for asynchronous API
 void HackRFDevice::producerWorker(cbProducerConsumerEvents _event)
 {
-	quint32 numDecimatedSamples = 0;
-
 	switch (_event) {
 		case cbProducerConsumerEvents::Start:
 			break;
@@ -530,13 +527,9 @@ void HackRFDevice::producerWorker(cbProducerConsumerEvents _event)
 					return;
 				}
 
-				if (m_decimateFactor > 1) {
-					normalizeIQ(decimatorBuf, producerBuf, deviceSamplesPerBuffer);
-					numDecimatedSamples = decimator->process(decimatorBuf, producerFreeBufPtr, deviceSamplesPerBuffer);
-				} else {
-					//No decimation, direct to producer/consumer buffer
-					normalizeIQ(producerFreeBufPtr, producerBuf, m_framesPerBuffer);
-				}
+				//Decimates in integer domain before converting to CPX, m_framesPerBuffer samples out
+				//Same as normalizeIQ() if we're not decimating
+				normalizeIQDecimated(producerFreeBufPtr, producerBuf, deviceSamplesPerBuffer);
 
 				m_producerConsumer.ReleaseFilledBuffer();
 				if (useSignals)
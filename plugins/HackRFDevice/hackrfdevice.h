@@ -8,7 +8,6 @@
 #include "ui_hackrfoptions.h"
 #include "hackrf.h"
 #include "../d2xx/libusb/libusb/libusb.h"
-#include "decimator.h"
 
 //From hackrf.c
 struct hackrf_device {
@@ -62,7 +61,7 @@ class HackRFDevice : public QObject, public DeviceInterfaceBase
 	//IID must be same that caller is looking for, defined in interfaces file
 	Q_PLUGIN_METADATA(IID DeviceInterface_iid)
 	//Let Qt meta-object know about our interface
-	Q_INTERFACES(DeviceInterface)
+	Q_INTERFACES(DeviceInterface DeviceInterface2)
 
 public:
 	HackRFDevice();
@@ -98,7 +97,6 @@ private:
 
 	//Work buffer for producer to convert device format data to CPX Pebble format data
 	CPX8 *producerBuf;
-	CPX *decimatorBuf;
 
 	Ui::HackRFOptions *optionUi;
 	hackrf_device* hackrfDevice;
@@ -123,7 +121,6 @@ private:
 	bool synchronousStopRx();
 	bool synchronousRead(CPX8 *_buf, int _bufLen);
 
-	Decimator *decimator;  //Decimator with lp filter
 	quint32 deviceSamplesPerBuffer;
 };
 #endif // HACKRFDEVICE_H
@@ -2,10 +2,6 @@
 #include "rfsfilters.h"
 #include <QMessageBox>
 #include "db.h"
-//Mac native socket API, needed for UDP buffer
-#ifndef Q_OS_WIN
-#include <sys/socket.h>
-#endif
 
 RFSpaceDevice::RFSpaceDevice():DeviceInterfaceBase()
 {
@@ -24,7 +20,6 @@ RFSpaceDevice::RFSpaceDevice():DeviceInterfaceBase()
 	udpReadBuf = new unsigned char[dataBlockSize];
 	tcpReadBuf = new unsigned char[dataBlockSize];
 	tcpSocket = NULL;
-	udpSocket = NULL;
 	deviceDiscoveredAddress.clear();
 	deviceDiscoveredPort = 0;
 }
@@ -41,8 +36,6 @@ RFSpaceDevice::~RFSpaceDevice()
 		delete [] tcpReadBuf;
 	if (tcpSocket != NULL)
 		delete tcpSocket;
-	if (udpSocket != NULL)
-		delete udpSocket;
 	if (afedri != NULL)
 		delete afedri;
 }
@@ -88,14 +81,10 @@ bool RFSpaceDevice::initialize(CB_ProcessIQData _callback,
 
 	} else if(m_deviceNumber == SDR_IP) {
 		DeviceInterfaceBase::initialize(_callback, _callbackBandscope, _callbackAudio, _framesPerBuffer);
-		//Run Producer in NOTIFY mode which only calls worker when we have new UDP datagrams
-		//More efficient and robust compared with POLL, but either one works
+		//No producer thread, udpIngest thread fills producer buffers directly from batched datagrams
 		m_producerConsumer.Initialize(std::bind(&RFSpaceDevice::producerWorker, this, std::placeholders::_1),
 			std::bind(&RFSpaceDevice::consumerWorker, this, std::placeholders::_1),
 			m_numProducerBuffers, m_framesPerBuffer * sizeof(CPX), ProducerConsumer::PRODUCER_MODE::NOTIFY);
-		//Get get UDP datagrams of 1024 bytes, 4bytes per CPX or 256 CPX samples
-		//Not needed if producer is running in NOTIFY mode
-		m_producerConsumer.SetProducerInterval(m_deviceSampleRate,udpBlockSize / sizeof(CPX16));
 
 		//Consumer only has to run once every 2048 CPX samples
 		m_producerConsumer.SetConsumerInterval(m_deviceSampleRate,m_framesPerBuffer);
@@ -235,15 +224,38 @@ bool RFSpaceDevice::disconnectDevice()
 void RFSpaceDevice::startDevice()
 {
 	if (m_deviceNumber == SDR_IP) {
-		//Fastest is no threads, just signals from NewUDPData to ConsumerWorker via ProducerConsumer
-		m_producerConsumer.Start(true,true);
+		//SDR-IP sends UPD datagrams to same port it uses for TCP
+		//So this binds our socket to accept datagrams from any IP, as long as port matches
+		//We could add an explicit setup where we tell SDR-IP what IP/Port to use for datagrams, but not needed I think
+		// ie SetUDPAddressAndPort(QHostAddress("192.168.0.255"),1234);
+		//Datagrams are 1028 bytes, CuteSDR sets buffer to 2,000,000.  Ingest default is larger still
+		if (!udpIngest.isOpen() && !udpIngest.open(devicePort)) {
+			qDebug()<<"SDR-IP unable to bind UDP port "<<devicePort;
+			return;
+		}
+		//16bit little endian sequence number.  0 is only sent on first datagram, after that wraps from 65535 to 1
+		udpIngest.setSequenceCheck([](const quint8 *_datagram, quint32 _length, quint32 &_sequence) {
+			if (_length < 4)
+				return false;
+			quint16 seq = _datagram[2] | (_datagram[3] << 8);
+			if (seq == 0)
+				return false;
+			_sequence = seq - 1;
+			return true;
+		}, 65535);
+		udpIngest.resetStats();
+		readBufferIndex = 0;
+		m_producerConsumer.Start(false,true);
+		udpIngest.start([this](quint8 *_datagram, quint32 _length) {UDPIngestDatagram(_datagram, _length);});
 	} else if (m_deviceNumber == SDR_IQ){
 		m_producerConsumer.Start(true,true);
 	} else if (m_deviceNumber == AFEDRI_USB) {
-		DeviceInterfaceBase::startDevice(); //Audio Input
+		//Audio input is started by DeviceInterfaceBase below
 	} else {
 		return;
 	}
+	//Restarts the adapted sample count, and audio input for AFEDRI.  No data until start capture below
+	DeviceInterfaceBase::startDevice();
 	SetIQSampleRate();
 	//SetADSampleRate(); //Don't need to do this unless we are correcting frequency
 
@@ -279,7 +291,12 @@ void RFSpaceDevice::stopDevice()
 {
 	if (!m_running)
 		return;
-	if (m_deviceNumber == SDR_IP || m_deviceNumber == SDR_IQ) {
+	if (m_deviceNumber == SDR_IP) {
+		StopCapture();
+		udpIngest.stop();
+		qDebug()<<"SDR-IP "<<udpIngest.statsString();
+		m_producerConsumer.Stop();
+	} else if (m_deviceNumber == SDR_IQ) {
 		StopCapture();
 		m_producerConsumer.Stop();
 	} else if (m_deviceNumber == AFEDRI_USB) {
@@ -434,6 +451,8 @@ QVariant RFSpaceDevice::get(DeviceInterface::StandardKeys _key, QVariant _option
 		case Key_DeviceHealthValue:
 			return m_producerConsumer.GetPercentageFree();
 		case Key_DeviceHealthString:
+			if (m_deviceNumber == SDR_IP && udpIngest.datagramsLost() > 0)
+				return udpIngest.statsString();
 			if (m_producerConsumer.GetPercentageFree() > 50)
 				return "Device running normally";
 			else
@@ -630,65 +649,21 @@ void RFSpaceDevice::processControlItem(ControlHeader header, unsigned char *buf)
 
 void RFSpaceDevice::producerWorker(cbProducerConsumerEvents _event)
 {
-	bool result;
 	switch (_event) {
-		//Thread local constuction.  All tcp and udp port access must be kept within thread
+		//SDR-IP UDP data is handled by udpIngest, nothing to construct here
 		case cbProducerConsumerEvents::Start:
-			if (m_deviceNumber == SDR_IQ || m_deviceNumber == AFEDRI_USB)
-				return;
-			//Construct UDP sockets in thread local
-			if (udpSocket == NULL) {
-				udpSocket = new QUdpSocket();
-			}
-			//Set up UDP Socket to listen for datagrams addressed to whatever IP/Port we set
-			//bool result = udpSocket->bind(); //Binds to QHostAddress:Any on port which is randomly chosen
-			//Alternative if we need to set a specific HostAddress and port
-			//result = udpSocket->bind(QHostAddress(), SomePort);
-
-
-			//SDR-IP sends UPD datagrams to same port it uses for TCP
-			//So this binds our socket to accept datagrams from any IP, as long as port matches
-			//We could add an explicit setup where we tell SDR-IP what IP/Port to use for datagrams, but not needed I think
-			// ie SetUDPAddressAndPort(QHostAddress("192.168.0.255"),1234);
-			result = udpSocket->bind(devicePort);
-			if (result) {
-				//Note: QUdpSocket uses native buffering per Qt documentation and ignores this.  Use native mac api
-				//udpSocket->setReadBufferSize(1028000);
-				//CuteSDR sets buffer size using native Mac UI after bind
-				//Datagrams are 1028 bytes, so set buffer to a large enough mutiple
-				//Works on dev box from 102800, make larger just to be sure
-				int v = 102800; //CuteSDR sets to 2,000,000
-				//socket descriptor, level, option, option value, length
-				//SOL_SOCKET, SO_RCVBUF defined in socket.h
-				::setsockopt(udpSocket->socketDescriptor(), SOL_SOCKET, SO_RCVBUF, (char *)&v, sizeof(v));
-				//Remember we're being called from thread and signal needs to go to something in our thread
-				//In this case, we translate the udpSocket signal to a producerConsumer signal
-				connect(udpSocket, SIGNAL(readyRead()), &m_producerConsumer, SIGNAL(newDataNotification()));
-			}
 			break;
 		case cbProducerConsumerEvents::Stop:
-			if (m_deviceNumber == SDR_IQ || m_deviceNumber == AFEDRI_USB)
-				return;
-			//Destruct UDP sockets in thread local
-			udpSocket->disconnectFromHost();
-			disconnect(udpSocket,0,0,0);
 			break;
 		case cbProducerConsumerEvents::Run:
 			if (m_deviceNumber == SDR_IQ) {
 				DoUSBProducer();
-			} else if (m_deviceNumber == SDR_IP) {
-				DoUDPProducer();
 			} else if (m_deviceNumber == AFEDRI_USB) {
 				//Audio producer
 			}
 			break;
 	}
 }
-void RFSpaceDevice::DoUDPProducer()
-{
-	UDPSocketNewData();
-}
-
 void RFSpaceDevice::DoUSBProducer()
 {
 	//USB Reads block until requested #bytes are availble.  We never want this to happen, since it burns CPU
@@ -846,64 +821,30 @@ void RFSpaceDevice::TCPSocketNewData()
 }
 
 //UDP is all IQ data
-//Can be called by Signal on udpSocket ReadyRead in notify mode, or producer worker in poll mode
-void RFSpaceDevice::UDPSocketNewData()
+//Called from udpIngest thread for every datagram, in arrival order
+void RFSpaceDevice::UDPIngestDatagram(quint8 *_datagram, quint32 _length)
 {
-	QHostAddress sender;
-	quint16 senderPort;
-	qint16 actual;
-	qint64 dataGramSize;
-	quint16 sequenceNumer;
-
-	mutex.lock();
-	//We have to process all the data we have, won't get a second signal for same data
-	while (udpSocket->hasPendingDatagrams()) {
-		dataGramSize = udpSocket->pendingDatagramSize();
-		//qDebug()<<"UDP datagram count: "<<++dataGramCount<<" size: "<<dataGramSize;
-		actual = udpSocket->readDatagram((char*)udpReadBuf,dataGramSize, &sender, &senderPort);
-		if (actual != dataGramSize) {
-			qDebug()<<"ReadDatagram size error";
-			mutex.unlock();
+	//The only datagrams we handle are IQ
+	if (_length != 1028 || _datagram[0] != TargetDataItem0 || _datagram[1] != 0x84)
+		return; //Invalid
+
+	//1024 data bytes follow or 256 I/Q samples
+	if (readBufferIndex == 0) {
+		//Starting a new producer buffer
+		if ((producerFreeBufPtr = (CPX *)m_producerConsumer.AcquireFreeBuffer()) == NULL)
 			return;
-		}
-		//The only datagrams we handle are IQ
-		if (dataGramSize != 1028 || udpReadBuf[0] != TargetDataItem0 || udpReadBuf[1] != 0x84) {
-			mutex.unlock();
-			return; //Invalid
-		}
-
-
-		//Ignore sequence nubmer for now and assume we get in correct order
-		//Eventually we can get fancy and buffer datagrams that arrive out of sequence and re-assemble in right order
-		//Or we can determine how many packets we missed by comparing with last sequence number
-		sequenceNumer = udpReadBuf[2];
-		Q_UNUSED(sequenceNumer);
-		//1024 data bytes follow or 512 2 byte samples
+	}
 
-		if (readBufferIndex == 0) {
-			//qDebug()<<producerConsumer.GetNumFreeBufs();
-			//Starting a new producer buffer
-			if ((producerFreeBufPtr = (CPX *)m_producerConsumer.AcquireFreeBuffer()) == NULL) {
-				mutex.unlock();
-				return;
-			}
-		}
+	//USB gets 2048 I and 2048 Q samples at a time, or 8192 bytes
+	//We build over 8 datagrams, normalizing each one straight into the producer buffer.  Reverse IQ order
+	normalizeIQ(&producerFreeBufPtr[readBufferIndex], (CPX16 *)&_datagram[4], udpBlockSize / sizeof(CPX16), true);
+	readBufferIndex += udpBlockSize / sizeof(CPX16);
 
-		//USB gets 2048 I and 2048 Q samples at a time, or 8192 bytes
-		//We need to build over 8 datagrams
-		memcpy(&readBuf[readBufferIndex], &udpReadBuf[4], udpBlockSize); //256 I/Q samples
-		readBufferIndex += udpBlockSize / sizeof(CPX16);
-
-		if (readBufferIndex == m_framesPerBuffer) {
-			readBufferIndex = 0;
-			//Reverse IQ order
-			normalizeIQ(producerFreeBufPtr, readBuf, m_framesPerBuffer, true);
-			//Increment the number of data buffers that are filled so consumer thread can access
-			m_producerConsumer.ReleaseFilledBuffer();
-		}
+	if (readBufferIndex == m_framesPerBuffer) {
+		readBufferIndex = 0;
+		//Increment the number of data buffers that are filled so consumer thread can access
+		m_producerConsumer.ReleaseFilledBuffer();
 	}
-	mutex.unlock();
-	return;
 }
 
 bool RFSpaceDevice::SendTcpCommand(void *buf, qint64 len)
@@ -13,6 +13,7 @@
 #include "ui_sdriqoptions.h"
 #include <QTcpSocket>
 #include <QUdpSocket>
+#include "udpingest.h"
 
 //Host to Target(Device)
 enum HostHeaderTypes {
@@ -114,7 +115,7 @@ class RFSpaceDevice : public QObject, public DeviceInterfaceBase
 	//IID must be same that caller is looking for, defined in interfaces file
 	Q_PLUGIN_METADATA(IID DeviceInterface_iid)
 	//Let Qt meta-object know about our interface
-	Q_INTERFACES(DeviceInterface)
+	Q_INTERFACES(DeviceInterface DeviceInterface2)
 
 public:
 	//Data blocks are fixed at 8192 bytes by SDR-IQ
@@ -149,7 +150,6 @@ private slots:
 	void TCPSocketConnected();
 	void TCPSocketDisconnected();
 	void TCPSocketNewData();
-	void UDPSocketNewData();
 
 
 private:
@@ -230,7 +230,8 @@ private:
 
 	//SDR-IP Specific
 	QTcpSocket *tcpSocket;
-	QUdpSocket *udpSocket;
+	UdpIngest udpIngest; //IQ datagrams, replaces producer thread QUdpSocket
+	void UDPIngestDatagram(quint8 *_datagram, quint32 _length);
 	QHostAddress deviceAddress;
 	quint16 devicePort;
 	bool autoDiscover;
@@ -250,7 +251,6 @@ private:
 	bool SetUDPAddressAndPort(QHostAddress address, quint16 port);
 	bool SendAck();
 	void DoUSBProducer();
-	void DoUDPProducer();
 	bool SetADSampleRate();
 	bool SendUDPDiscovery();
 	AD6620::BANDWIDTH MapIQSampleRateToBandwidth(quint32 iqSampleRate);
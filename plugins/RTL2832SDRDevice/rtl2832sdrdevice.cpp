@@ -1,7 +1,25 @@
 //GPL license and attributions are in gpl.h and terms are included in this file by reference
 #include "gpl.h"
 #include "rtl2832sdrdevice.h"
+#include <QThread>
+#ifdef Q_OS_WIN
+#include <winsock2.h>
+#define closeSocket closesocket
+#define SHUT_RDWR SD_BOTH
+#define ioctl ioctlsocket
+typedef int socklen_t;
+#else
 #include "arpa/inet.h" //For ntohl()
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#define closeSocket ::close
+#endif
 /*
   rtl_tcp info
 */
@@ -12,8 +30,8 @@ RTL2832SDRDevice::RTL2832SDRDevice():DeviceInterfaceBase()
     inBuffer = NULL;
 	m_running = false;
     optionUi = NULL;
-    rtlTcpSocket = NULL;
-    tcpThreadSocket = NULL;
+    rtlTcpSocket = -1;
+	tcpReaderActive.store(0);
     producerFreeBufPtr = NULL;
     readBufferIndex = 0;
     rtlTunerGainCount = 0;
@@ -88,6 +106,8 @@ bool RTL2832SDRDevice::initialize(CB_ProcessIQData _callback,
 	//1 byte per I + 1 byte per Q
 	//This is set so we always get framesPerBuffer samples after decimating to lower sampleRate
 	m_readBufferSize = m_framesPerBuffer * sizeof(CPXU8);
+	if (inBuffer != NULL)
+		free(inBuffer);
 	inBuffer = (CPXU8 *)malloc(m_readBufferSize);
 
     haveDongleInfo = false; //Look for first bytes
@@ -110,33 +130,19 @@ bool RTL2832SDRDevice::initialize(CB_ProcessIQData _callback,
 
     readBufferIndex = 0;
 
-	if (m_deviceNumber == RTL_TCP) {
-        //Start consumer thread so it's ready to get data which starts as soon as we are connected
-		m_producerConsumer.Start(false,true);
-        if (rtlTcpSocket == NULL) {
-            rtlTcpSocket = new QTcpSocket();
-
-            //QTcpSocket can have strange behavior if shared between threads
-            //We use the signals emitted by QTcpSocket to get new data, instead of polling in a separate thread
-            //As a result, there is no producer thread in the TCP case.
-            //Set up state change connections
-            connect(rtlTcpSocket,&QTcpSocket::connected, this, &RTL2832SDRDevice::TCPSocketConnected);
-            connect(rtlTcpSocket,&QTcpSocket::disconnected, this, &RTL2832SDRDevice::TCPSocketDisconnected);
-            connect(rtlTcpSocket,SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(TCPSocketError(QAbstractSocket::SocketError)));
-            //QT TCP classes are implemented as non blocking using signals/slots
-            //Recommended usage is to use these instead of separate threads whereever possible because QTcpSockets have
-            //to be managed carefully across threads
-            //We'll support both modes so we have an example of socket use across threads, but default to signal/slot
-
-            connect(rtlTcpSocket,&QTcpSocket::readyRead, this, &RTL2832SDRDevice::TCPSocketNewData);
-            //test
-            connect(this,&RTL2832SDRDevice::reset,this,&RTL2832SDRDevice::Reset);
-        }
-	} else if (m_deviceNumber == RTL_USB) {
-        //Start this immediately, before connect, so we don't miss any data
-		m_producerConsumer.Start(true,true);
+	tcpBytesReceived.store(0);
+	tcpBuffersDropped.store(0);
+	tcpLagMs.store(0);
+	tcpMaxLagMs.store(0);
 
-    }
+	if (m_deviceNumber == RTL_TCP) {
+		//Producer thread is a dedicated blocking reader, see TcpReader()
+		//Previously readyRead() was handled in the main thread and any UI delay backed up the socket
+		//reset() is emitted from producer thread if server goes away, queued to main thread
+		connect(this,&RTL2832SDRDevice::reset,this,&RTL2832SDRDevice::Reset,Qt::UniqueConnection);
+	}
+	//Start this immediately, before connect, so we don't miss any data
+	m_producerConsumer.Start(true,true);
 
     producerFreeBufPtr = NULL;
 
@@ -181,133 +187,209 @@ bool RTL2832SDRDevice::connectDevice()
 		m_connected = true;
         return true;
 	} else if (m_deviceNumber == RTL_TCP) {
-
-        //The socket buffer is infinite by default, it will keep growing if we're not able to fetch data fast enough
-        //So we set it to a fixed size, which is the maximum amount of data that can be fetched in one read call
-        //We can try differnt buffer sizes here to keep up with higher sample rates
-        //If too large, we may have problems processing all the data before the next batch comes in.
-        //Setting to 1 framesPerBuffer seems to work best
-        //If problems, try setting to some multiple that less than numProducerBuffers
-		rtlTcpSocket->setReadBufferSize(m_readBufferSize);
-
-        //rtl_tcp server starts to dump data as soon as there is a connection, there is no start/stop command
-        rtlTcpSocket->connectToHost(rtlServerIP,rtlServerPort,QTcpSocket::ReadWrite);
-        if (!rtlTcpSocket->waitForConnected(3000)) {
-            //Socket was closed or error
-            qDebug()<<"RTL Server error "<<rtlTcpSocket->errorString();
-            return false;
-        }
-        qDebug()<<"RTL Server connected";
+		//rtl_tcp server starts to dump data as soon as there is a connection, there is no start/stop command
+		if (!TcpConnect())
+			return false;
+		qDebug()<<"RTL Server connected";
 		m_connected = true;
-
-        return true;
-    }
+		return true;
+	}
     return false;
 }
 
-void RTL2832SDRDevice::TCPSocketError(QAbstractSocket::SocketError socketError)
+//Connects to rtl_tcp server and reads dongle information
+bool RTL2832SDRDevice::TcpConnect()
 {
-    qDebug()<<"TCP Socket Error "<<socketError;
-}
+	TcpDisconnect();
+	rtlTcpSocket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (rtlTcpSocket < 0) {
+		qDebug()<<"RTL Server socket() failed";
+		return false;
+	}
 
-void RTL2832SDRDevice::TCPSocketConnected()
-{
-    //Nothing to do, we waiting for connection in Connect()
-    qDebug()<<"TCP connected signal received";
+	//Receive buffer has to be set before connect() so TCP window scaling is negotiated for it
+	//At 2.4msps rtl_tcp sends 4.8mb/sec, default 8mb is over a second of slack if we get behind
+	int v = rtlTcpRcvBufSize;
+	::setsockopt(rtlTcpSocket, SOL_SOCKET, SO_RCVBUF, (char *)&v, sizeof(v));
+	socklen_t vLen = sizeof(v);
+	if (::getsockopt(rtlTcpSocket, SOL_SOCKET, SO_RCVBUF, (char *)&v, &vLen) == 0)
+		qDebug()<<"RTL Server SO_RCVBUF requested "<<rtlTcpRcvBufSize<<" actual "<<v;
+	//Commands are 5 bytes, don't let Nagle hold them waiting for more
+	int noDelay = 1;
+	::setsockopt(rtlTcpSocket, IPPROTO_TCP, TCP_NODELAY, (char *)&noDelay, sizeof(noDelay));
+#ifdef SO_NOSIGPIPE
+	//Mac: no SIGPIPE if server goes away while we're sending a command
+	int noSigPipe = 1;
+	::setsockopt(rtlTcpSocket, SOL_SOCKET, SO_NOSIGPIPE, (char *)&noSigPipe, sizeof(noSigPipe));
+#endif
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(rtlServerIP.toIPv4Address());
+	addr.sin_port = htons(rtlServerPort);
+
+	//Non blocking connect so we can time out after 3 seconds instead of OS default
+#ifdef Q_OS_WIN
+	u_long nonBlocking = 1;
+	ioctlsocket(rtlTcpSocket, FIONBIO, &nonBlocking);
+#else
+	int flags = fcntl(rtlTcpSocket, F_GETFL, 0);
+	fcntl(rtlTcpSocket, F_SETFL, flags | O_NONBLOCK);
+#endif
+	::connect(rtlTcpSocket, (sockaddr *)&addr, sizeof(addr));
+
+	fd_set writeSet;
+	FD_ZERO(&writeSet);
+	FD_SET(rtlTcpSocket, &writeSet);
+	timeval timeout;
+	timeout.tv_sec = 3;
+	timeout.tv_usec = 0;
+	int error = -1;
+	socklen_t errorLen = sizeof(error);
+	if (::select(rtlTcpSocket + 1, NULL, &writeSet, NULL, &timeout) > 0)
+		::getsockopt(rtlTcpSocket, SOL_SOCKET, SO_ERROR, (char *)&error, &errorLen);
+	if (error != 0) {
+		qDebug()<<"RTL Server error connecting to "<<rtlServerIP.toString()<<":"<<rtlServerPort;
+		TcpDisconnect();
+		return false;
+	}
+
+	//Back to blocking, reader thread uses select() to wait for data
+#ifdef Q_OS_WIN
+	nonBlocking = 0;
+	ioctlsocket(rtlTcpSocket, FIONBIO, &nonBlocking);
+#else
+	fcntl(rtlTcpSocket, F_SETFL, flags);
+#endif
+
+	//The first bytes we get from rtl_tcp are dongle information
+	//This comes immediately after connect, before any IQ data
+	rtlTunerType = RTLSDR_TUNER_UNKNOWN; //Default if we don't get valid data
+	haveDongleInfo = false;
+	quint32 bytesRead = 0;
+	int actual;
+	fd_set readSet;
+	while (bytesRead < sizeof(DongleInfo)) {
+		FD_ZERO(&readSet);
+		FD_SET(rtlTcpSocket, &readSet);
+		timeout.tv_sec = 1;
+		timeout.tv_usec = 0;
+		if (::select(rtlTcpSocket + 1, &readSet, NULL, NULL, &timeout) <= 0)
+			break;
+		actual = ::recv(rtlTcpSocket, (char *)&tcpDongleInfo + bytesRead, sizeof(DongleInfo) - bytesRead, 0);
+		if (actual <= 0)
+			break;
+		bytesRead += actual;
+	}
+	if (bytesRead == sizeof(DongleInfo)) {
+		haveDongleInfo = true;
+		//If we got valid data, then use internally
+		if (tcpDongleInfo.magic[0] == 'R' &&
+				tcpDongleInfo.magic[1] == 'T' &&
+				tcpDongleInfo.magic[2] == 'L' &&
+				tcpDongleInfo.magic[3] == '0') {
+			//We have valid data
+			rtlTunerType = (RTLSDR_TUNERS)ntohl(tcpDongleInfo.tunerType);
+			rtlTunerGainCount = ntohl(tcpDongleInfo.tunerGainCount);
+			qDebug()<<"Dongle type "<<rtlTunerType;
+			qDebug()<<"Dongle gain count "<< rtlTunerGainCount;
+		}
+	}
+	readBufferIndex = 0;
+	return true;
 }
 
-void RTL2832SDRDevice::TCPSocketDisconnected()
+//Producer thread may still be in TcpReader(), stopDevice() doesn't wait for it
+//shutdown() wakes it up with recv() == 0, then we wait for it to leave before the fd can be closed and reused
+void RTL2832SDRDevice::TcpDisconnect()
 {
-    //Get get this signal in 2 cases
-    // -When we turn off device
-    // -When device is disconnected due to network or other failure
-    //If device is running, try to reset
-	if (m_running) {
-        emit reset();
-    }
-    qDebug()<<"TCP disconnected signal received";
+	int socket;
+	rtlTcpSocketMutex.lock();
+	socket = rtlTcpSocket;
+	rtlTcpSocket = -1;
+	if (socket >= 0)
+		::shutdown(socket, SHUT_RDWR);
+	rtlTcpSocketMutex.unlock();
+	if (socket < 0)
+		return;
+
+	while (tcpReaderActive.load())
+		QThread::msleep(1);
+	closeSocket(socket);
 }
 
-//This can be called by connecting to readyRead signal, or from Producer thread
-//When this is called, we know we have data
-void RTL2832SDRDevice::TCPSocketNewData()
+//Producer thread
+//Blocks on socket and converts each full block straight into a producer buffer
+//If consumer can't keep up we throw away blocks, but always keep reading so rtl_tcp never backs up
+void RTL2832SDRDevice::TcpReader()
 {
-    //Do we really need to protect the socket?
-    rtlTcpSocketMutex.lock();
-
-    qint64 bytesRead;
-    //We have to process all the data we have because we limit buffer size
-    //We only get one readRead() signal for each block of data that's ready
-
-    qint64 bytesAvailable = rtlTcpSocket->bytesAvailable();
-    if (bytesAvailable == 0) {
-        rtlTcpSocketMutex.unlock();
-        return;
-    }
-
-    //qDebug()<<"Bytes available "<<bytesAvailable;
-
-    //  Even though we keep up with incoming at 2msps in USB mode, and rtl-tcp server says we're keeping up in TCP mode
-    //  FreeBufs goes right to zero and mostly stays there.
-    //  Could be a problem with QT network threads interfering with ProducerConsumer consumer thread?
-    //  Tried all sorts of yeilds, etc, but no joy as of 1/19/14
-	//qDebug()<<producerConsumer.GetNumFreeBufs();
-
-
-    //The first bytes we get from rtl_tcp are dongle information
-    //This comes immediately after connect, before we start running
-    if (!haveDongleInfo && bytesAvailable >= (qint64)sizeof(DongleInfo)) {
-        rtlTunerType = RTLSDR_TUNER_UNKNOWN; //Default if we don't get valid data
-        bytesRead = rtlTcpSocket->peek((char *)&tcpDongleInfo,sizeof(DongleInfo));
-        haveDongleInfo = true; //We only try once for this after we read some bytes
-
-        if (bytesRead == sizeof(DongleInfo)) {
-            //If we got valid data, then use internally
-            if (tcpDongleInfo.magic[0] == 'R' &&
-                    tcpDongleInfo.magic[1] == 'T' &&
-                    tcpDongleInfo.magic[2] == 'L' &&
-                    tcpDongleInfo.magic[3] == '0') {
-                //We have valid data
-                rtlTunerType = (RTLSDR_TUNERS)ntohl(tcpDongleInfo.tunerType);
-                rtlTunerGainCount = ntohl(tcpDongleInfo.tunerGainCount);
-                qDebug()<<"Dongle type "<<rtlTunerType;
-                qDebug()<<"Dongle gain count "<< rtlTunerGainCount;
-            }
-        }
-
-    }
-
-    quint16 bytesToFillBuffer;
-    while (bytesAvailable > 0) {
-        if (producerFreeBufPtr == NULL) {
-            //Starting a new buffer
-            //We wait for a free buffer for 100ms before giving up.  May need to adjust this
-			if ((producerFreeBufPtr = (CPX *)m_producerConsumer.AcquireFreeBuffer(1000)) == NULL) {
-                rtlTcpSocketMutex.unlock();
-                //We're sol in this situation because we won't get another readReady() signal
-                //emit reset(); //Start over
-                return;
-            }
-            //qDebug()<<"Acquired free buffer";
-            //qDebug()<<producerConsumer.IsFreeBufferOverflow();
-        }
-		bytesToFillBuffer = m_readBufferSize - readBufferIndex;
-        bytesToFillBuffer = (bytesToFillBuffer <= bytesAvailable) ? bytesToFillBuffer : bytesAvailable;
-		bytesRead = rtlTcpSocket->read((char *)inBuffer + readBufferIndex, bytesToFillBuffer);
-        bytesAvailable -= bytesRead;
-        readBufferIndex += bytesRead;
-		readBufferIndex %= m_readBufferSize;
-        if (readBufferIndex == 0) {
-			//IQ normally reversed
-			normalizeIQ(producerFreeBufPtr, inBuffer, m_framesPerBuffer, true);
-			m_producerConsumer.ReleaseFilledBuffer();
-            producerFreeBufPtr = NULL; //Trigger new Acquire next loop
+	fd_set readSet;
+	timeval timeout;
+	int bytesRead;
+#ifdef Q_OS_WIN
+	u_long bytesQueued;
+#else
+	int bytesQueued;
+#endif
+	quint32 lagMs;
+	//2 bytes (I/Q) per sample
+	double bytesPerMs = m_deviceSampleRate * sizeof(CPXU8) / 1000.0;
+	int socket;
+
+	//TcpDisconnect() won't close the socket while we're using it
+	rtlTcpSocketMutex.lock();
+	socket = rtlTcpSocket;
+	if (socket >= 0)
+		tcpReaderActive.store(1);
+	rtlTcpSocketMutex.unlock();
+	if (socket < 0)
+		return;
+
+	while (m_running) {
+		//Wake up periodically so stopDevice() is honored
+		FD_ZERO(&readSet);
+		FD_SET(socket, &readSet);
+		timeout.tv_sec = 0;
+		timeout.tv_usec = 100000;
+		if (::select(socket + 1, &readSet, NULL, NULL, &timeout) <= 0)
+			continue;
+
+		bytesRead = ::recv(socket, (char *)inBuffer + readBufferIndex, m_readBufferSize - readBufferIndex, 0);
+		if (bytesRead <= 0) {
+			//Server closed connection or network failure, try to reset
+			qDebug()<<"RTL Server disconnected";
+			if (m_running) {
+				//Only signal once, Reset() will start us running again
+				m_running = false;
+				emit reset();
+			}
+			break;
+		}
+		tcpBytesReceived.fetchAndAddRelaxed(bytesRead);
+		readBufferIndex += bytesRead;
+		if (readBufferIndex < (quint32)m_readBufferSize)
+			continue;
+		readBufferIndex = 0;
+
+		//Anything still queued in the socket is how far behind real time we are
+		if (::ioctl(socket, FIONREAD, &bytesQueued) == 0 && bytesPerMs > 0) {
+			lagMs = bytesQueued / bytesPerMs;
+			tcpLagMs.store(lagMs);
+			if (lagMs > tcpMaxLagMs.load())
+				tcpMaxLagMs.store(lagMs);
 		}
 
-    }
-
-    rtlTcpSocketMutex.unlock();
-
+		if ((producerFreeBufPtr = (CPX *)m_producerConsumer.AcquireFreeBuffer()) == NULL) {
+			tcpBuffersDropped.fetchAndAddRelaxed(1);
+			continue;
+		}
+		//IQ normally reversed
+		normalizeIQ(producerFreeBufPtr, inBuffer, m_framesPerBuffer, true);
+		m_producerConsumer.ReleaseFilledBuffer();
+		producerFreeBufPtr = NULL;
+	}
+	tcpReaderActive.store(0);
 }
 
 bool RTL2832SDRDevice::disconnectDevice()
@@ -318,11 +400,7 @@ bool RTL2832SDRDevice::disconnectDevice()
 	if (m_deviceNumber == RTL_USB) {
         rtlsdr_close(dev);
 	} else if (m_deviceNumber == RTL_TCP) {
-        rtlTcpSocket->disconnectFromHost();
-        //Wait for disconnect
-        //if (!rtlTcpSocket->waitForDisconnected(500)) {
-        //    qDebug()<<"rtlTcpSocket didn't disconnect within timeout";
-        //}
+		TcpDisconnect();
     }
 	m_connected = false;
     dev = NULL;
@@ -331,6 +409,7 @@ bool RTL2832SDRDevice::disconnectDevice()
 
 void RTL2832SDRDevice::startDevice()
 {
+	DeviceInterfaceBase::startDevice();
     //producerConsumer.
 	if (m_deviceNumber == RTL_USB) {
         rtlTunerType = (RTLSDR_TUNERS) rtlsdr_get_tuner_type(dev);
@@ -370,7 +449,8 @@ void RTL2832SDRDevice::stopDevice()
 	if (m_deviceNumber == RTL_USB) {
 
 	} else if (m_deviceNumber == RTL_TCP) {
-
+		qDebug()<<"RTL Server bytes "<<tcpBytesReceived.load()<<" dropped buffers "<<tcpBuffersDropped.load()
+			<<" max lag ms "<<tcpMaxLagMs.load();
     }
 	m_producerConsumer.Stop();
 }
@@ -555,6 +635,7 @@ void RTL2832SDRDevice::readSettings()
 	rtlSampleMode = (SAMPLING_MODES)m_settings->value("RtlSampleMode",NORMAL).toInt();
 	rtlAgcMode = m_settings->value("RtlAgcMode",false).toBool();
 	rtlOffsetMode = m_settings->value("RtlOffsetMode",false).toBool();
+	rtlTcpRcvBufSize = m_settings->value("TcpRcvBufSize",8000000).toUInt();
 }
 
 void RTL2832SDRDevice::writeSettings()
@@ -574,6 +655,7 @@ void RTL2832SDRDevice::writeSettings()
 	m_settings->setValue("RtlSampleMode",rtlSampleMode);
 	m_settings->setValue("RtlAgcMode",rtlAgcMode);
 	m_settings->setValue("RtlOffsetMode",rtlOffsetMode);
+	m_settings->setValue("TcpRcvBufSize",rtlTcpRcvBufSize);
 
 	m_settings->sync();
 
@@ -737,6 +819,13 @@ QVariant RTL2832SDRDevice::get(DeviceInterface::StandardKeys _key, QVariant _opt
 			return rtlSampleMode;
 		case K_RTLOffsetMode:
 			return rtlOffsetMode;
+		case Key_DeviceHealthValue:
+			return m_producerConsumer.GetPercentageFree();
+		case Key_DeviceHealthString:
+			if (m_deviceNumber == RTL_TCP)
+				return QString("Lag %1ms (max %2ms), dropped buffers %3")
+					.arg(tcpLagMs.load()).arg(tcpMaxLagMs.load()).arg(tcpBuffersDropped.load());
+			return DeviceInterfaceBase::get(_key, _option);
 		default:
 			//If we don't handle it, let default grab it
 			return DeviceInterfaceBase::get(_key, _option);
@@ -957,20 +1046,21 @@ bool RTL2832SDRDevice::SendTcpCmd(quint8 _cmd, quint32 _data)
         return false;
 
     rtlTcpSocketMutex.lock();
+	if (rtlTcpSocket < 0) {
+		rtlTcpSocketMutex.unlock();
+		return false;
+	}
     RTL_CMD cmd;
     cmd.cmd = _cmd;
     //ntohl() is what rtl-tcp uses to convert to network byte order
     //So we use inverse htonl (hardware to network long)
     cmd.data = htonl(_data);
-    quint16 bytesWritten = rtlTcpSocket->write((const char *)&cmd, sizeof(cmd));
-    //QTcpSocket is always buffered, no choice.
-    //So we need to either call an explicit flush() or waitForBytesWritten() to make sure data gets sent
-    //Not sure which one is better or if it makes a difference
-    rtlTcpSocket->flush();
-
-    //Can't use waitForBytesWritten because it runs event loop while waiting which can trigger signals
-    //The readyRead() signal handler also locks the mutex, so we get in a deadlock state
-    //rtlTcpSocket->waitForBytesWritten(1000);
+	//TCP_NODELAY is set, so this goes out immediately.  Reader thread never writes, so no deadlock with mutex
+#ifdef MSG_NOSIGNAL
+	int bytesWritten = ::send(rtlTcpSocket, (const char *)&cmd, sizeof(cmd), MSG_NOSIGNAL);
+#else
+	int bytesWritten = ::send(rtlTcpSocket, (const char *)&cmd, sizeof(cmd), 0);
+#endif
 
     bool res = (bytesWritten == sizeof(cmd));
     rtlTcpSocketMutex.unlock();
@@ -1012,16 +1102,6 @@ void RTL2832SDRDevice::producerWorker(cbProducerConsumerEvents _event)
 {
     switch (_event) {
         case cbProducerConsumerEvents::Start:
-			if (m_deviceNumber == RTL_TCP) {
-                if (tcpThreadSocket == NULL) {
-                    //First time, construct any thread local objects like QTcpSockets
-                    tcpThreadSocket = new QTcpSocket();
-                    tcpThreadSocket->setSocketDescriptor(rtlTcpSocket->socketDescriptor()); //Has same connection as rtlTpSocket
-                    //Local socket will only get thread specific event, not UI events
-					tcpThreadSocket->setReadBufferSize(m_readBufferSize); //Not sure if this is necessary
-                }
-
-            }
             break;
 
         case cbProducerConsumerEvents::Run:
@@ -1080,18 +1160,14 @@ void RTL2832SDRDevice::producerWorker(cbProducerConsumerEvents _event)
                 return;
 
 			} else if (m_deviceNumber == RTL_TCP) {
-                //Moved to TcpNewData
+				if (!m_running)
+					return;
+				TcpReader();
+				return;
             }
             break;
 
         case cbProducerConsumerEvents::Stop:
-			if (m_deviceNumber == RTL_TCP) {
-                rtlTcpSocketMutex.unlock();
-                if (tcpThreadSocket != NULL)
-                    tcpThreadSocket->disconnectFromHost();
-                tcpThreadSocket = NULL;
-            }
-
             break;
     }
 }
@@ -4,9 +4,8 @@
 //GPL license and attributions are in gpl.h and terms are included in this file by reference
 #include "gpl.h"
 #include "rtl-sdr.h"
-#include <QTcpSocket>
-#include <QUdpSocket>
 #include <QHostAddress>
+#include <QAtomicInteger>
 #include "ui_rtl2832sdrdevice.h"
 
 /*
@@ -40,7 +39,7 @@ class RTL2832SDRDevice: public QObject, public DeviceInterfaceBase
     //IID must be same that caller is looking for, defined in interfaces file
     Q_PLUGIN_METADATA(IID DeviceInterface_iid)
     //Let Qt meta-object know about our interface
-    Q_INTERFACES(DeviceInterface)
+    Q_INTERFACES(DeviceInterface DeviceInterface2)
 
 public:
 #define K_RTLSampleRate DeviceInterface::Key_CustomKey1
@@ -68,11 +67,6 @@ signals:
 private slots:
     void Reset();
 
-    void TCPSocketError(QAbstractSocket::SocketError socketError);
-    void TCPSocketConnected();
-    void TCPSocketDisconnected();
-    void TCPSocketNewData();
-
     void IPAddressChanged();
     void IPPortChanged();
     void SampleRateChanged(int _index);
@@ -152,6 +146,9 @@ private:
     } DongleInfo;
 
     bool SendTcpCmd(quint8 _cmd, quint32 _data);
+    bool TcpConnect();
+    void TcpDisconnect();
+    void TcpReader();
     bool SetRtlSampleRate(quint64 _sampleRate);
     bool GetRtlValidTunerGains(); //Tuner type must be known before this is called
     bool SetRtlTunerGain(quint16 _gain);
@@ -177,8 +174,17 @@ private:
     qint16 rtlTunerGain; //in 10ths of a db
     //qint16 rtlIfGain; //Not used
 
-    QTcpSocket *rtlTcpSocket;
-    QMutex rtlTcpSocketMutex; //Control access to rtltcpSocket across thread
+    //Native socket so the producer thread can block on it without any Qt event loop involvement
+    //rtl_tcp uses the same connection for commands and IQ data
+    int rtlTcpSocket; //-1 if not connected
+    QMutex rtlTcpSocketMutex; //Serializes command writes from UI thread
+	QAtomicInt tcpReaderActive; //Producer thread is in TcpReader(), see TcpDisconnect()
+    quint32 rtlTcpRcvBufSize; //SO_RCVBUF in bytes, set in ini
+    //Reader stats, updated in producer thread
+    QAtomicInteger<quint64> tcpBytesReceived;
+    QAtomicInteger<quint32> tcpBuffersDropped; //No free producer buffer, block thrown away
+    QAtomicInteger<quint32> tcpLagMs; //Data queued in socket when we finished last block
+    QAtomicInteger<quint32> tcpMaxLagMs;
 
     Ui::RTL2832UI *optionUi;
     QHostAddress rtlServerIP;
@@ -196,10 +202,8 @@ private:
     DongleInfo tcpDongleInfo;
 
 
-    quint16 readBufferIndex; //Used to track whether we have full buffer or not, 0 to readBufferSize-1
+    quint32 readBufferIndex; //Used to track whether we have full buffer or not, 0 to readBufferSize-1
 
-    //These are used in the TCP worker thread and created in that thread to prevent QTcpSocket errors
-    QTcpSocket *tcpThreadSocket;
 	CPX *producerFreeBufPtr;
 	CPX *consumerFilledBufferPtr;
 };
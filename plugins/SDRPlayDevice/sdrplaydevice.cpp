@@ -6,6 +6,7 @@ SDRPlayDevice::SDRPlayDevice():DeviceInterfaceBase()
 	initSettings("SDRPlay");
 	optionUi = NULL;
 	packetIBuf = packetQBuf = NULL;
+	packetBuf = NULL;
 	samplesPerPacket = 0;
 	apiVersion = 0; //Not set
 
@@ -18,6 +19,8 @@ SDRPlayDevice::~SDRPlayDevice()
 		delete[] packetIBuf;
 	if (packetQBuf != NULL)
 		delete[] packetQBuf;
+	if (packetBuf != NULL)
+		delete[] packetBuf;
 }
 
 bool SDRPlayDevice::initialize(CB_ProcessIQData _callback,
@@ -33,15 +36,26 @@ bool SDRPlayDevice::initialize(CB_ProcessIQData _callback,
 	quint16 sampleDataSize = sizeof(CPX);
 	m_readBufferSize = m_framesPerBuffer * sampleDataSize;
 
+	//Integer CIC pre-decimation in DeviceInterfaceBase, factor is always a power of 2
+	m_sampleRate = m_deviceSampleRate / m_decimateFactor;
+
+	if (packetIBuf != NULL)
+		delete[] packetIBuf;
+	if (packetQBuf != NULL)
+		delete[] packetQBuf;
+	if (packetBuf != NULL)
+		delete[] packetBuf;
 	packetIBuf = new short[m_framesPerBuffer * 2]; //2X what we need so we have overflow space
 	packetQBuf = new short[m_framesPerBuffer * 2];
+	packetBuf = new CPX[m_framesPerBuffer * 2]; //Decimated packet, never more samples than packetIBuf
 	producerIndex = 0;
 
 	m_producerConsumer.Initialize(std::bind(&SDRPlayDevice::producerWorker, this, std::placeholders::_1),
 		std::bind(&SDRPlayDevice::consumerWorker, this, std::placeholders::_1),m_numProducerBuffers, m_readBufferSize);
 	//Must be called after Initialize
 	m_producerConsumer.SetProducerInterval(m_deviceSampleRate,m_framesPerBuffer);
-	m_producerConsumer.SetConsumerInterval(m_deviceSampleRate,m_framesPerBuffer);
+	//Consumer buffers are filled at the decimated rate
+	m_producerConsumer.SetConsumerInterval(m_sampleRate,m_framesPerBuffer);
 
 #endif
 
@@ -177,6 +191,10 @@ QVariant SDRPlayDevice::get(DeviceInterface::StandardKeys _key, QVariant _option
 			return "SDRPlay";
 		case Key_DeviceType:
 			return DT_IQ_DEVICE;
+		case Key_SampleRate:
+			//Default in deviceInterfaceBase is to return deviceSampleRate
+			//We may be decimated and over-ride default to return post-decimated sample rate
+			return m_sampleRate;
 		case Key_DeviceSampleRates:
 			//Don't return any sample rates to sdrOptions UI, we handle it all in device UI
 			return sl;
@@ -673,74 +691,63 @@ void SDRPlayDevice::producerWorker(cbProducerConsumerEvents _event)
 					continue;
 				}
 #endif
-				if (producerFreeBufPtr == NULL) {
-					if ((producerFreeBufPtr = (CPX *)m_producerConsumer.AcquireFreeBuffer()) == NULL) {
-						qDebug()<<"No free buffers available.  producerIndex = "<<producerIndex <<
-								  "samplesPerPacket = "<<samplesPerPacket;
-						return;
+				//Decimates the whole packet in integer domain before converting to CPX
+				//Same as normalizeIQ() if we're not decimating.  CIC carries partial blocks over, so numOut varies
+				quint32 numOut = normalizeIQDecimated(packetBuf, packetIBuf, packetQBuf, samplesPerPacket, reverseIQ);
+				quint32 outIndex = 0;
+				while (outIndex < numOut) {
+					if (producerFreeBufPtr == NULL) {
+						if ((producerFreeBufPtr = (CPX *)m_producerConsumer.AcquireFreeBuffer()) == NULL) {
+							qDebug()<<"No free buffers available.  producerIndex = "<<producerIndex <<
+									  "samplesPerPacket = "<<samplesPerPacket;
+							return;
+						}
+						producerIndex = 0;
+						totalPwrInPacket = 0;
 					}
-					producerIndex = 0;
-					totalPwrInPacket = 0;
-				}
-				//Save in producerBuffer (sized to handle overflow
-				//Make sure samplesPerPacket is initialized before producer starts
+					//Split packet across producer buffers as needed
+					quint32 samplesNeeded = qMin((quint32)(m_framesPerBuffer - producerIndex), numOut - outIndex);
+					memcpy(&producerFreeBufPtr[producerIndex], &packetBuf[outIndex], samplesNeeded * sizeof(CPX));
+					producerIndex += samplesNeeded;
+					outIndex += samplesNeeded;
 
-				qint32 samplesNeeded = m_framesPerBuffer - producerIndex;
-				samplesNeeded = samplesPerPacket <= samplesNeeded ? samplesPerPacket : samplesNeeded;
-				qint32 samplesExtra = samplesPerPacket - samplesNeeded;
-
-				normalizeIQ(&producerFreeBufPtr[producerIndex], packetIBuf, packetQBuf, samplesNeeded, reverseIQ);
-				producerIndex += samplesNeeded;
-
-				if (producerIndex >= m_framesPerBuffer) {
+					if (producerIndex >= m_framesPerBuffer) {
 #if 0
-					double avgPwrInPacket = 0;
-					//AGC Logic
-					//Todo: AGC not working, review logic
-					if (agcEnabled && !pendingGainReduction) {
-						totalPwrInPacket = 0;
-						for (int i=0; i<framesPerBuffer; i++) {
-							//I^2 + Q^2
-							totalPwrInPacket += producerFreeBufPtr[i].sqrMag();
-						}
-						avgPwrInPacket = totalPwrInPacket / framesPerBuffer;
-						if (avgPwrInPacket < agcPwrSetpointLow || avgPwrInPacket > agcPwrSetpointHigh) {
-							//Adjust gain reduction to get measured power into setpoint range
-							double pwrDelta = agcPwrSetpoint - avgPwrInPacket;
-							double dbDelta;
-							if (pwrDelta < 0)
-								//less power = more gain reduction
-								dbDelta = DB::powerToDb(fabs(pwrDelta));
-							else
-								//More power = less gain reduction
-								dbDelta = -DB::powerToDb(pwrDelta);
+						double avgPwrInPacket = 0;
+						//AGC Logic
+						//Todo: AGC not working, review logic
+						if (agcEnabled && !pendingGainReduction) {
+							totalPwrInPacket = 0;
+							for (int i=0; i<framesPerBuffer; i++) {
+								//I^2 + Q^2
+								totalPwrInPacket += producerFreeBufPtr[i].sqrMag();
+							}
+							avgPwrInPacket = totalPwrInPacket / framesPerBuffer;
+							if (avgPwrInPacket < agcPwrSetpointLow || avgPwrInPacket > agcPwrSetpointHigh) {
+								//Adjust gain reduction to get measured power into setpoint range
+								double pwrDelta = agcPwrSetpoint - avgPwrInPacket;
+								double dbDelta;
+								if (pwrDelta < 0)
+									//less power = more gain reduction
+									dbDelta = DB::powerToDb(fabs(pwrDelta));
+								else
+									//More power = less gain reduction
+									dbDelta = -DB::powerToDb(pwrDelta);
 
 #if 0
-							qDebug()<<"AGC low: "<<agcPwrSetpointLow<<
-									  "AGC high: "<<agcPwrSetpointHigh<<
-									  "AGC Avg: "<<avgPwrInPacket<<
-									  "AGC GR: "<<newGainReduction;
+								qDebug()<<"AGC low: "<<agcPwrSetpointLow<<
+										  "AGC high: "<<agcPwrSetpointHigh<<
+										  "AGC Avg: "<<avgPwrInPacket<<
+										  "AGC GR: "<<newGainReduction;
 #endif
-							//Set in offset mode, driver keeps track of what prev setting was and will reduce GR accordingly
-							setGainReduction(dbDelta,0,0);
+								//Set in offset mode, driver keeps track of what prev setting was and will reduce GR accordingly
+								setGainReduction(dbDelta,0,0);
+							}
 						}
-					}
 #endif
-					//Process any remaining samples in packet if any
-					producerIndex = 0;
-					producerFreeBufPtr = NULL;
-					m_producerConsumer.ReleaseFilledBuffer();
-
-					if (samplesExtra > 0) {
-						//Start a new producer buffer
-						if ((producerFreeBufPtr = (CPX *)m_producerConsumer.AcquireFreeBuffer()) == NULL) {
-							qDebug()<<"No free buffers available.  producerIndex = "<<producerIndex <<
-									  "samplesPerPacket = "<<samplesPerPacket;
-							return;
-						}
-						normalizeIQ(&producerFreeBufPtr[producerIndex], &packetIBuf[samplesNeeded],
-									&packetQBuf[samplesNeeded], samplesExtra, reverseIQ);
-						producerIndex += samplesExtra;
+						producerIndex = 0;
+						producerFreeBufPtr = NULL;
+						m_producerConsumer.ReleaseFilledBuffer();
 					}
 				}
 
@@ -25,7 +25,7 @@ class SDRPlayDevice : public QObject, public DeviceInterfaceBase
 	//IID must be same that caller is looking for, defined in interfaces file
 	Q_PLUGIN_METADATA(IID DeviceInterface_iid)
 	//Let Qt meta-object know about our interface
-	Q_INTERFACES(DeviceInterface)
+	Q_INTERFACES(DeviceInterface DeviceInterface2)
 
 public:
 	SDRPlayDevice();
@@ -74,6 +74,7 @@ private:
 
 	short *packetIBuf;
 	short *packetQBuf;
+	CPX *packetBuf; //Packet after normalizeIQDecimated()
 	quint16 producerIndex;
 	CPX *producerFreeBufPtr; //Treat as array of CPX
 	double totalPwrInPacket;
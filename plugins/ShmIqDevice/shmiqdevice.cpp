@@ -0,0 +1,312 @@
+#include "shmiqdevice.h"
+#include "db.h"
+#include <QThread>
+#include <time.h>
+
+//Plugin constructors are called indirectly when the plugin is loaded in Receiver
+//Be careful not to access objects that are not initialized yet, do that in Initialize()
+ShmIqDevice::ShmIqDevice():DeviceInterfaceBase()
+{
+	initSettings("ShmIq");
+	m_optionUi = NULL;
+	m_consumerBuffer = NULL;
+	m_consumerFill = 0;
+	m_cpxBuffer = NULL;
+	m_cpxBufferSize = 0;
+	m_running = false;
+	m_busFrequency = 0;
+	m_receivedSamples.store(0);
+	m_laggedSamples.store(0);
+	m_overrunBlocks.store(0);
+	m_reopens.store(0);
+}
+
+//Called when the plugins object is deleted in the ~Receiver()
+//Be careful not to access objects that may already be destroyed
+ShmIqDevice::~ShmIqDevice()
+{
+	if (m_consumerBuffer != NULL)
+		delete[] m_consumerBuffer;
+	if (m_cpxBuffer != NULL)
+		delete[] m_cpxBuffer;
+}
+
+bool ShmIqDevice::initialize(CB_ProcessIQData _callback,
+							 CB_ProcessBandscopeData _callbackBandscope,
+							 CB_ProcessAudioData _callbackAudio, quint16 _framesPerBuffer)
+{
+	DeviceInterfaceBase::initialize(_callback, _callbackBandscope, _callbackAudio, _framesPerBuffer);
+
+	if (m_consumerBuffer != NULL)
+		delete[] m_consumerBuffer;
+	m_consumerBuffer = new CPX[m_framesPerBuffer];
+	m_consumerFill = 0;
+
+	//Bus is our producer, we only need the consumer thread to poll it
+	m_producerConsumer.Initialize(NULL, std::bind(&ShmIqDevice::consumerWorker, this, std::placeholders::_1),
+		1, sizeof(CPX));
+
+	return true;
+}
+
+bool ShmIqDevice::initialize2(CB_ProcessIQBlock _callback,
+							  CB_ProcessBandscopeData _callbackBandscope,
+							  CB_ProcessAudioData _callbackAudio,
+							  quint32 _framesPerBuffer)
+{
+	//No adapter, blocks go to the receiver straight from the shared ring
+	processIQBlock = _callback;
+	return initialize(NULL, _callbackBandscope, _callbackAudio, qMin(_framesPerBuffer, (quint32)65535));
+}
+
+void ShmIqDevice::readSettings()
+{
+	m_normalizeIQGain = DB::dBToAmplitude(0);
+	m_startupDemodMode = DemodMode::dmAM;
+	//Set defaults before calling DeviceInterfaceBase
+	DeviceInterfaceBase::readSettings();
+
+	m_busName = m_settings->value("BusName", "pebble").toString();
+}
+
+void ShmIqDevice::writeSettings()
+{
+	DeviceInterfaceBase::writeSettings();
+
+	m_settings->setValue("BusName", m_busName);
+}
+
+//Publisher has to be running, its first block tells us the sample rate and frequency
+bool ShmIqDevice::connectDevice()
+{
+	DeviceInterfaceBase::connectDevice();
+
+	if (!m_subscriber.open(m_busName)) {
+		qDebug()<<"No shared memory IQ bus named"<<m_busName;
+		return false;
+	}
+	IQBlock block;
+	QElapsedTimer timer;
+	timer.start();
+	while (!m_subscriber.next(block)) {
+		if (timer.elapsed() > c_connectWaitMs || m_subscriber.isClosed()) {
+			qDebug()<<"Shared memory IQ bus"<<m_busName<<"isn't streaming";
+			m_subscriber.close();
+			return false;
+		}
+		QThread::usleep(c_pollUs);
+	}
+	m_sampleRate = block.sampleRate;
+	m_deviceSampleRate = block.sampleRate;
+	m_busFrequency = m_subscriber.frequency();
+	m_deviceFrequency = m_busFrequency;
+	//Cmd_Start reopens so we start with the newest block
+	m_subscriber.close();
+	return true;
+}
+
+bool ShmIqDevice::command(DeviceInterface::StandardCommands _cmd, QVariant _arg)
+{
+	switch (_cmd) {
+		case Cmd_Connect:
+			return connectDevice();
+
+		case Cmd_Disconnect:
+			DeviceInterfaceBase::disconnectDevice();
+			//Device specific code follows
+			m_subscriber.close();
+			return true;
+
+		case Cmd_Start:
+			DeviceInterfaceBase::startDevice();
+			//Device specific code follows
+			//Publisher may have gone away since connect, consumer keeps trying to reopen
+			m_subscriber.open(m_busName);
+			m_consumerFill = 0;
+			m_receivedSamples.store(0);
+			m_laggedSamples.store(0);
+			m_overrunBlocks.store(0);
+			m_reopens.store(0);
+			m_staleTimer.start();
+			m_elapsedTimer.start();
+			m_running = true;
+			m_producerConsumer.Start(false,true);
+			return true;
+
+		case Cmd_Stop:
+			DeviceInterfaceBase::stopDevice();
+			m_running = false;
+			//Device specific code follows
+			m_producerConsumer.Stop();
+			m_subscriber.close();
+			return true;
+
+		case Cmd_ReadSettings:
+			DeviceInterfaceBase::readSettings();
+			//Device specific settings follow
+			readSettings();
+			return true;
+
+		case Cmd_WriteSettings:
+			DeviceInterfaceBase::writeSettings();
+			//Device specific settings follow
+			writeSettings();
+			return true;
+
+		case Cmd_DisplayOptionUi: {
+			//Use QVariant::fromValue() to pass, and value<type passed>() to get back
+			this->setupOptionUi(_arg.value<QWidget*>());
+			return true;
+		}
+		default:
+			return false;
+	}
+}
+
+QVariant ShmIqDevice::get(DeviceInterface::StandardKeys _key, QVariant _option)
+{
+	Q_UNUSED(_option);
+
+	switch (_key) {
+		case Key_PluginName:
+			return "SHM IQ";
+			break;
+		case Key_PluginDescription:
+			return "Another device's stream from the shared memory IQ bus";
+			break;
+		case Key_DeviceName:
+			return "ShmIqDevice";
+		case Key_DeviceType:
+			return DeviceInterfaceBase::DT_IQ_DEVICE;
+		case Key_DeviceSampleRates:
+			//Whatever the publisher is running at
+			return QStringList()<<QString::number(m_deviceSampleRate);
+
+		case Key_HighFrequency:
+			return m_busFrequency + m_sampleRate/2;
+		case Key_LowFrequency:
+			return qMax(0.0, m_busFrequency - m_sampleRate/2);
+		case Key_StartupFrequency:
+			return m_busFrequency;
+
+		case Key_DeviceHealthValue:
+			//Lagging means this receiver can't keep up with the publisher
+			return m_laggedSamples.load() > 0 || m_overrunBlocks.load() > 0 ? 50 : 100;
+		case Key_DeviceHealthString: {
+			if (!m_running)
+				return "Not running";
+			double secs = m_elapsedTimer.nsecsElapsed() / 1000000000.0;
+			double msps = secs > 0 ? m_receivedSamples.load() / secs / 1000000.0 : 0;
+			return QString("%1 %2 Msps, %3 lagged, %4 overrun blocks, %5 reopens").arg(m_busName)
+				.arg(msps, 0, 'f', 2).arg(m_laggedSamples.load()).arg(m_overrunBlocks.load()).arg(m_reopens.load());
+		}
+		default:
+			return DeviceInterfaceBase::get(_key, _option);
+	}
+}
+
+bool ShmIqDevice::set(DeviceInterface::StandardKeys _key, QVariant _value, QVariant _option)
+{
+	Q_UNUSED(_option);
+
+	switch (_key) {
+		case Key_DeviceFrequency:
+			//Publisher owns the frequency, return false so it won't change in UI.  Only mixer should work
+			return false;
+
+		default:
+			return DeviceInterfaceBase::set(_key, _value, _option);
+	}
+}
+
+//V1 host, any block size and format to m_framesPerBuffer CPX buffers
+void ShmIqDevice::deliverCPX(const IQBlock &_block)
+{
+	quint32 numSamples;
+	for (quint32 offset = 0; offset < _block.numSamples; offset += numSamples) {
+		numSamples = qMin(m_framesPerBuffer - m_consumerFill, _block.numSamples - offset);
+		DeviceInterfaceBase::iqBlockToCPX(_block, offset, numSamples, m_consumerBuffer + m_consumerFill);
+		m_consumerFill += numSamples;
+		if (m_consumerFill == m_framesPerBuffer) {
+			processIQData(m_consumerBuffer, m_framesPerBuffer);
+			m_consumerFill = 0;
+		}
+	}
+}
+
+void ShmIqDevice::consumerWorker(cbProducerConsumerEvents _event)
+{
+	IQBlock block;
+	bool gotBlock = false;
+	timespec req, rem;
+
+	switch (_event) {
+		case cbProducerConsumerEvents::Start:
+			break;
+		case cbProducerConsumerEvents::Run:
+			while (m_running && m_subscriber.next(block)) {
+				gotBlock = true;
+				if (block.format != IQF_CPX)
+					block.scale *= m_userIQGain;
+
+				if (processIQBlock != NULL) {
+					if (block.format == IQF_CPX) {
+						//Only V1 publishers send CPX, the ring is read only and the receiver works on CPX in place
+						if (block.numSamples > m_cpxBufferSize) {
+							if (m_cpxBuffer != NULL)
+								delete[] m_cpxBuffer;
+							m_cpxBuffer = new CPX[block.numSamples];
+							m_cpxBufferSize = block.numSamples;
+						}
+						memcpy(m_cpxBuffer, block.samples, block.numSamples * sizeof(CPX));
+						block.samples = m_cpxBuffer;
+					}
+					processIQBlock(block);
+				} else {
+					deliverCPX(block);
+				}
+				//Publisher lapped us while the receiver had it, what it saw may be torn
+				m_subscriber.overrun();
+				m_receivedSamples.fetchAndAddRelaxed(block.numSamples);
+			}
+			m_laggedSamples.store(m_subscriber.laggedSamples());
+			m_overrunBlocks.store(m_subscriber.overrunBlocks());
+
+			if (gotBlock) {
+				m_staleTimer.restart();
+				return;
+			}
+			if (m_subscriber.isClosed() || m_staleTimer.elapsed() > c_staleMs) {
+				//Publisher stopped or restarted with a new segment
+				if (m_subscriber.open(m_busName))
+					m_reopens.fetchAndAddRelaxed(1);
+				m_staleTimer.restart();
+			}
+			req.tv_sec = 0;
+			req.tv_nsec = c_pollUs * 1000;
+			if (nanosleep(&req,&rem) < 0) {
+				qDebug()<<"nanosleep failed";
+			}
+			break;
+		case cbProducerConsumerEvents::Stop:
+			break;
+	}
+}
+
+void ShmIqDevice::setupOptionUi(QWidget *parent)
+{
+	if (m_optionUi != NULL)
+		delete m_optionUi;
+
+	m_optionUi = new Ui::ShmIqOptions();
+	m_optionUi->setupUi(parent);
+	parent->setVisible(true);
+
+	m_optionUi->busNameEdit->setText(m_busName);
+	connect(m_optionUi->busNameEdit,SIGNAL(editingFinished()),this,SLOT(busNameChanged()));
+}
+
+void ShmIqDevice::busNameChanged()
+{
+	m_busName = m_optionUi->busNameEdit->text().trimmed();
+}
@@ -0,0 +1,90 @@
+#ifndef SHMIQDEVICE_H
+#define SHMIQDEVICE_H
+
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include <QObject>
+#include <QElapsedTimer>
+#include <QAtomicInteger>
+#include "deviceinterfacebase.h"
+#include "shmiqbus.h"
+#include "ui_shmiqoptions.h"
+
+/*
+	Reads another device's stream from the shared memory IQ bus, see pebblelib/shmiqbus.h
+
+	Publishing device has "ShmIqBus=name" in its settings file, this device reads the same name.  Any number of
+	Pebble instances and tools can read one bus, none of them cost the publisher anything.
+	Blocks are passed to V2 hosts in place in the publisher's format, sample counter and drop flags intact.
+	Falling behind skips to the newest block and is reported as IQB_DROPPED, the publisher never waits for us.
+
+	Sample rate and frequency are the publisher's, read from the bus at connect.  Tune with the mixer,
+	retune the publisher and power cycle to follow it.
+*/
+class ShmIqDevice : public QObject, public DeviceInterfaceBase
+{
+	Q_OBJECT
+
+	//Exports, FILE is optional
+	//IID must be same that caller is looking for, defined in interfaces file
+	Q_PLUGIN_METADATA(IID DeviceInterface_iid)
+	//Let Qt meta-object know about our interface
+	Q_INTERFACES(DeviceInterface DeviceInterface2)
+
+public:
+	ShmIqDevice();
+	~ShmIqDevice();
+
+	//Required
+	bool initialize(CB_ProcessIQData _callback,
+					CB_ProcessBandscopeData _callbackBandscope,
+					CB_ProcessAudioData _callbackAudio,
+					quint16 _framesPerBuffer);
+	//Native IQBlocks instead of the DeviceInterfaceBase adapter
+	bool initialize2(CB_ProcessIQBlock _callback,
+					 CB_ProcessBandscopeData _callbackBandscope,
+					 CB_ProcessAudioData _callbackAudio,
+					 quint32 _framesPerBuffer);
+	bool command(StandardCommands _cmd, QVariant _arg);
+	QVariant get(StandardKeys _key, QVariant _option = 0);
+	bool set(StandardKeys _key, QVariant _value, QVariant _option = 0);
+
+private slots:
+	void busNameChanged();
+
+private:
+	static const int c_connectWaitMs = 1000; //For the first block, so we know the sample rate
+	static const int c_pollUs = 500; //Sleep when the bus has nothing for us
+	static const int c_staleMs = 1000; //No blocks this long, publisher may have restarted, reopen by name
+
+	bool connectDevice();
+	void readSettings();
+	void writeSettings();
+	void consumerWorker(cbProducerConsumerEvents _event);
+	void setupOptionUi(QWidget *parent);
+	void deliverCPX(const IQBlock &_block);
+
+	Ui::ShmIqOptions *m_optionUi;
+
+	//Settings
+	QString m_busName;
+
+	ShmIqSubscriber m_subscriber; //Consumer thread once started
+	double m_busFrequency; //Publisher's frequency at connect
+	QElapsedTimer m_staleTimer;
+
+	//V1 host, blocks are re-cut into m_framesPerBuffer CPX buffers
+	CPX *m_consumerBuffer;
+	quint32 m_consumerFill;
+	//IQF_CPX blocks are copied out of the read only ring, hosts may process them in place
+	CPX *m_cpxBuffer;
+	quint32 m_cpxBufferSize;
+
+	//Read in get(Key_DeviceHealthString)
+	QAtomicInteger<qint64> m_receivedSamples;
+	QAtomicInteger<qint64> m_laggedSamples;
+	QAtomicInteger<qint64> m_overrunBlocks;
+	QAtomicInteger<qint64> m_reopens;
+	QElapsedTimer m_elapsedTimer;
+};
+#endif // SHMIQDEVICE_H
@@ -0,0 +1,40 @@
+#-------------------------------------------------
+#
+# Synthetic signal source for load and soak tests
+#
+#-------------------------------------------------
+
+#Project common
+include(../../application/pebbleqt.pri)
+#DESTDIR is set in pebbleqt.pri, save it
+INSTALL_DIR = $${DESTDIR}
+DESTDIR = $${DESTDIR}/plugins
+
+#Common library dependency code for all Pebble plugins
+include (../DigitalModemExample/fix_plugin_libraries.pri)
+
+#Required for options UI
+QT += widgets
+
+#Help plugin not worry about include paths
+INCLUDEPATH += ../../application
+DEPENDPATH += ../../application
+INCLUDEPATH += ../../pebblelib
+DEPENDPATH += ../../pebblelib
+
+TARGET = SynthSDRDevice
+VERSION = 1.0.0
+TEMPLATE = lib
+CONFIG += plugin
+
+SOURCES += synthsdrdevice.cpp
+
+HEADERS += synthsdrdevice.h
+
+LIBS += -L$${PWD}/../../pebblelib/$${LIB_DIR} -lpebblelib
+
+OTHER_FILES += \
+        fix_plugin_libraries.pri
+
+FORMS += \
+    synthoptions.ui
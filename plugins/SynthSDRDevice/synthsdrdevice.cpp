@@ -0,0 +1,481 @@
+#include "synthsdrdevice.h"
+#include "db.h"
+#include <time.h>
+
+//Plugin constructors are called indirectly when the plugin is loaded in Receiver
+//Be careful not to access objects that are not initialized yet, do that in Initialize()
+SynthSDRDevice::SynthSDRDevice():DeviceInterfaceBase()
+{
+	initSettings("SynthSDR");
+	m_optionUi = NULL;
+	m_synthGen = NULL;
+	m_consumerBuffer = NULL;
+	m_running = false;
+	m_blockFormat = IQF_CPX16;
+	m_realTime = true;
+	m_blockSamples = 0;
+	m_sampleCounter = 0;
+	m_pendingDropped = 0;
+	m_firstBlock = true;
+	m_generatedSamples.store(0);
+	m_droppedSamples.store(0);
+}
+
+//Called when the plugins object is deleted in the ~Receiver()
+//Be careful not to access objects that may already be destroyed
+SynthSDRDevice::~SynthSDRDevice()
+{
+	if (m_synthGen != NULL)
+		delete m_synthGen;
+	if (m_consumerBuffer != NULL)
+		delete[] m_consumerBuffer;
+}
+
+bool SynthSDRDevice::initialize(CB_ProcessIQData _callback,
+								CB_ProcessBandscopeData _callbackBandscope,
+								CB_ProcessAudioData _callbackAudio, quint16 _framesPerBuffer)
+{
+	DeviceInterfaceBase::initialize(_callback, _callbackBandscope, _callbackAudio, _framesPerBuffer);
+
+	if (m_consumerBuffer != NULL)
+		delete[] m_consumerBuffer;
+	m_consumerBuffer = new CPX[m_framesPerBuffer];
+
+	//Buffers are allocated once for the largest block in any format, sample rate can change between starts
+	m_producerConsumer.Initialize(std::bind(&SynthSDRDevice::producerWorker, this, std::placeholders::_1),
+		std::bind(&SynthSDRDevice::consumerWorker, this, std::placeholders::_1), c_numProducerBuffers,
+		sizeof(BlockHeader) + c_maxBlockSamples * sizeof(CPXFLOAT));
+
+	return true;
+}
+
+bool SynthSDRDevice::initialize2(CB_ProcessIQBlock _callback,
+								 CB_ProcessBandscopeData _callbackBandscope,
+								 CB_ProcessAudioData _callbackAudio,
+								 quint32 _framesPerBuffer)
+{
+	//No adapter, blocks go to the receiver in device format with no copy
+	processIQBlock = _callback;
+	return initialize(NULL, _callbackBandscope, _callbackAudio, qMin(_framesPerBuffer, (quint32)65535));
+}
+
+void SynthSDRDevice::readSettings()
+{
+	m_normalizeIQGain = DB::dBToAmplitude(0);
+	m_startupDemodMode = DemodMode::dmAM;
+	m_deviceSampleRate = 2048000;
+	//Set defaults before calling DeviceInterfaceBase
+	DeviceInterfaceBase::readSettings();
+
+	m_format = (IQSampleFormat)m_settings->value("Format", IQF_CPX16).toInt();
+	m_runMode = (RunMode)m_settings->value("RunMode", RM_REALTIME).toInt();
+	m_numCarriers = m_settings->value("NumCarriers", 8).toUInt();
+	m_modulation = m_settings->value("Modulation", c_mixedModulation).toInt();
+	m_carrierDb = m_settings->value("CarrierDb", -40).toDouble();
+	m_sweep = m_settings->value("Sweep", false).toBool();
+	m_awgnDb = m_settings->value("AwgnDb", -60).toDouble();
+	m_impulseDb = m_settings->value("ImpulseDb", SynthGen::c_offDb).toDouble();
+	m_impulsesPerSec = m_settings->value("ImpulsesPerSec", 100).toDouble();
+	m_seed = m_settings->value("Seed", 1).toUInt();
+}
+
+void SynthSDRDevice::writeSettings()
+{
+	DeviceInterfaceBase::writeSettings();
+
+	m_settings->setValue("Format", m_format);
+	m_settings->setValue("RunMode", m_runMode);
+	m_settings->setValue("NumCarriers", m_numCarriers);
+	m_settings->setValue("Modulation", m_modulation);
+	m_settings->setValue("CarrierDb", m_carrierDb);
+	m_settings->setValue("Sweep", m_sweep);
+	m_settings->setValue("AwgnDb", m_awgnDb);
+	m_settings->setValue("ImpulseDb", m_impulseDb);
+	m_settings->setValue("ImpulsesPerSec", m_impulsesPerSec);
+	m_settings->setValue("Seed", m_seed);
+}
+
+bool SynthSDRDevice::command(DeviceInterface::StandardCommands _cmd, QVariant _arg)
+{
+	unsigned char *buf;
+
+	switch (_cmd) {
+		case Cmd_Connect:
+			DeviceInterfaceBase::connectDevice();
+			//Device specific code follows
+			return true;
+
+		case Cmd_Disconnect:
+			DeviceInterfaceBase::disconnectDevice();
+			//Device specific code follows
+			return true;
+
+		case Cmd_Start:
+			DeviceInterfaceBase::startDevice();
+			//Device specific code follows
+			//Anything left from the last run is from the old stream
+			while ((buf = m_producerConsumer.AcquireFilledBuffer(0)) != NULL)
+				m_producerConsumer.ReleaseFreeBuffer();
+
+			m_mutex.lock();
+			if (m_synthGen != NULL)
+				delete m_synthGen;
+			//Same seed and settings, same samples every start
+			m_synthGen = new SynthGen(m_deviceSampleRate, m_seed);
+			m_mutex.unlock();
+			updateGenerator();
+
+			//Producer buffers are sized for CPXFLOAT, IQF_CPX from a hand edited ini would overrun them
+			m_blockFormat = DeviceInterfaceBase::bytesPerSample(m_format) <= sizeof(CPXFLOAT) ? m_format : IQF_CPXFLOAT;
+			m_realTime = m_runMode == RM_REALTIME;
+			//About 1ms per block so real time pacing is smooth, always whole receiver blocks
+			m_blockSamples = m_framesPerBuffer * qBound((quint32)1, m_deviceSampleRate / 1000 / m_framesPerBuffer,
+				c_maxBlockSamples / m_framesPerBuffer);
+			m_sampleCounter = 0;
+			m_pendingDropped = 0;
+			m_firstBlock = true;
+			m_generatedSamples.store(0);
+			m_droppedSamples.store(0);
+
+			m_running = true;
+			m_elapsedTimer.start();
+			m_producerConsumer.Start(true,true);
+			return true;
+
+		case Cmd_Stop:
+			DeviceInterfaceBase::stopDevice();
+			m_running = false;
+			//Device specific code follows
+			m_producerConsumer.Stop();
+			return true;
+
+		case Cmd_ReadSettings:
+			DeviceInterfaceBase::readSettings();
+			//Device specific settings follow
+			readSettings();
+			return true;
+
+		case Cmd_WriteSettings:
+			DeviceInterfaceBase::writeSettings();
+			//Device specific settings follow
+			writeSettings();
+			return true;
+
+		case Cmd_DisplayOptionUi: {
+			//Use QVariant::fromValue() to pass, and value<type passed>() to get back
+			this->setupOptionUi(_arg.value<QWidget*>());
+			return true;
+		}
+		default:
+			return false;
+	}
+}
+
+QVariant SynthSDRDevice::get(DeviceInterface::StandardKeys _key, QVariant _option)
+{
+	Q_UNUSED(_option);
+
+	switch (_key) {
+		case Key_PluginName:
+			return "Synthetic Signals";
+			break;
+		case Key_PluginDescription:
+			return "Carriers and noise at up to 20msps for load and soak tests";
+			break;
+		case Key_DeviceName:
+			return "SynthSDRDevice";
+		case Key_DeviceType:
+			return DeviceInterfaceBase::DT_IQ_DEVICE;
+		case Key_DeviceSampleRates:
+			return QStringList()<<"48000"<<"96000"<<"192000"<<"2048000"<<"8000000"<<"10000000"<<"16000000"<<"20000000";
+
+		case Key_HighFrequency:
+			return m_sampleRate;
+		case Key_LowFrequency:
+			return 0;
+		case Key_StartupFrequency:
+			return m_sampleRate/2;
+
+		case Key_DeviceHealthValue:
+			//Dropped samples in real time mode means the receiver can't keep up at this rate
+			return m_droppedSamples.load() > 0 ? 50 : 100;
+		case Key_DeviceHealthString: {
+			if (!m_running)
+				return "Not running";
+			double secs = m_elapsedTimer.nsecsElapsed() / 1000000000.0;
+			double msps = secs > 0 ? m_generatedSamples.load() / secs / 1000000.0 : 0;
+			return QString("%1 %2 Msps, %3 dropped").arg(m_realTime ? "Real time" : "Free running")
+				.arg(msps, 0, 'f', 2).arg(m_droppedSamples.load());
+		}
+		default:
+			return DeviceInterfaceBase::get(_key, _option);
+	}
+}
+
+bool SynthSDRDevice::set(DeviceInterface::StandardKeys _key, QVariant _value, QVariant _option)
+{
+	Q_UNUSED(_option);
+
+	switch (_key) {
+		case Key_DeviceFrequency:
+			//Fixed, so return false so it won't change in UI.  Only mixer should work
+			return false;
+
+		default:
+			return DeviceInterfaceBase::set(_key, _value, _option);
+	}
+}
+
+//Carriers in equal slots across the middle 80% of the band, levels stepping down 0, -10, -20db
+QVector<SynthCarrier> SynthSDRDevice::buildScenario()
+{
+	static const SynthCarrier::Modulation mixed[] = {SynthCarrier::MOD_AM, SynthCarrier::MOD_FM,
+		SynthCarrier::MOD_CW, SynthCarrier::MOD_FSK, SynthCarrier::MOD_CARRIER};
+
+	QVector<SynthCarrier> carriers;
+	SynthCarrier carrier;
+	double span = 0.8 * m_deviceSampleRate;
+	double slot = m_numCarriers > 0 ? span / m_numCarriers : span;
+
+	for (quint32 i = 0; i < m_numCarriers; i++) {
+		if (m_modulation == c_mixedModulation)
+			carrier.modulation = mixed[i % 5];
+		else
+			carrier.modulation = (SynthCarrier::Modulation)m_modulation;
+		carrier.freq = -span / 2 + slot * (i + 0.5);
+		carrier.db = m_carrierDb - 10 * (i % 3);
+		switch (carrier.modulation) {
+			case SynthCarrier::MOD_AM:
+				carrier.rate = 1000;
+				carrier.depth = 0.8;
+				break;
+			case SynthCarrier::MOD_FM:
+				carrier.rate = 1000;
+				carrier.depth = qMin(5000.0, slot / 4);
+				break;
+			case SynthCarrier::MOD_CW:
+				carrier.rate = 20;
+				carrier.depth = 0;
+				break;
+			case SynthCarrier::MOD_FSK:
+				carrier.rate = 45.45;
+				carrier.depth = 170;
+				break;
+			case SynthCarrier::MOD_SWEEP:
+				//Stays in its own slot
+				carrier.rate = 10;
+				carrier.depth = slot * 0.8;
+				break;
+			default:
+				carrier.rate = 0;
+				carrier.depth = 0;
+				break;
+		}
+		carriers.append(carrier);
+	}
+
+	if (m_sweep) {
+		//Slow full band sweep through everything else
+		carrier.modulation = SynthCarrier::MOD_SWEEP;
+		carrier.freq = 0;
+		carrier.db = m_carrierDb;
+		carrier.rate = 1;
+		carrier.depth = 0.9 * m_deviceSampleRate;
+		carriers.append(carrier);
+	}
+	return carriers;
+}
+
+//Scenario changes apply immediately, sample rate, format, run mode and seed on the next start
+void SynthSDRDevice::updateGenerator()
+{
+	m_mutex.lock();
+	if (m_synthGen != NULL) {
+		m_synthGen->setCarriers(buildScenario());
+		m_synthGen->setNoise(m_awgnDb, m_impulseDb, m_impulsesPerSec);
+	}
+	m_mutex.unlock();
+}
+
+void SynthSDRDevice::producerWorker(cbProducerConsumerEvents _event)
+{
+	timespec req, rem;
+	qint64 nsRemaining;
+	unsigned char *buf;
+	BlockHeader *header;
+
+	switch (_event) {
+		case cbProducerConsumerEvents::Start:
+			break;
+		case cbProducerConsumerEvents::Run:
+			if (m_realTime) {
+				//Block is due when its last sample would have come from hardware
+				//Scheduled from Cmd_Start, not the last block, so sleep jitter doesn't accumulate
+				nsRemaining = (qint64)((m_sampleCounter + m_blockSamples) * (1000000000.0 / m_deviceSampleRate))
+					- m_elapsedTimer.nsecsElapsed();
+				if (nsRemaining > 0) {
+					req.tv_sec = nsRemaining / 1000000000;
+					req.tv_nsec = nsRemaining % 1000000000;
+					if (nanosleep(&req,&rem) < 0) {
+						qDebug()<<"nanosleep failed";
+					}
+				}
+				//Hardware doesn't wait for the receiver
+				buf = m_producerConsumer.AcquireFreeBuffer(0);
+				if (buf == NULL) {
+					//Every buffer is waiting for the receiver, lose this block like a device overrun would
+					m_sampleCounter += m_blockSamples;
+					m_pendingDropped += m_blockSamples;
+					m_droppedSamples.fetchAndAddRelaxed(m_blockSamples);
+					return;
+				}
+			} else {
+				//Free running, wait for the receiver but not so long that Stop isn't seen
+				buf = m_producerConsumer.AcquireFreeBuffer(c_waitMs);
+				if (buf == NULL)
+					return;
+			}
+
+			header = (BlockHeader *)buf;
+			header->sampleCounter = m_sampleCounter;
+			header->droppedSamples = m_pendingDropped;
+			header->numSamples = m_blockSamples;
+			header->flags = 0;
+			if (m_firstBlock)
+				header->flags |= IQB_DISCONTINUITY;
+			if (m_pendingDropped > 0)
+				header->flags |= IQB_DROPPED;
+
+			m_mutex.lock();
+			m_synthGen->generate(buf + sizeof(BlockHeader), m_blockFormat, m_blockSamples);
+			m_mutex.unlock();
+
+			m_sampleCounter += m_blockSamples;
+			m_pendingDropped = 0;
+			m_firstBlock = false;
+			m_generatedSamples.fetchAndAddRelaxed(m_blockSamples);
+			m_producerConsumer.ReleaseFilledBuffer();
+			return;
+
+		case cbProducerConsumerEvents::Stop:
+			break;
+	}
+}
+
+void SynthSDRDevice::consumerWorker(cbProducerConsumerEvents _event)
+{
+	unsigned char *buf;
+	BlockHeader *header;
+	IQBlock block;
+
+	switch (_event) {
+		case cbProducerConsumerEvents::Start:
+			break;
+		case cbProducerConsumerEvents::Run:
+			//Wait for the first buffer instead of polling, then take everything that's ready
+			buf = m_producerConsumer.AcquireFilledBuffer(c_waitMs);
+			while (buf != NULL) {
+				header = (BlockHeader *)buf;
+				block.samples = buf + sizeof(BlockHeader);
+				block.numSamples = header->numSamples;
+				block.format = m_blockFormat;
+				//IQ gain can change while running
+				block.scale = SynthGen::scale(m_blockFormat) * m_normalizeIQGain * m_userIQGain;
+				block.sampleRate = m_deviceSampleRate;
+				block.sampleCounter = header->sampleCounter;
+				block.flags = header->flags;
+				if (m_iqOrder == IQO_QI)
+					block.flags |= IQB_SWAP_IQ;
+				block.droppedSamples = header->droppedSamples;
+				//Buffer isn't released until the callback returns
+				block.release = NULL;
+				block.owner = NULL;
+				block.handle = 0;
+
+				if (processIQBlock != NULL) {
+					processIQBlock(block);
+				} else {
+					//V1 host.  Blocks are always a multiple of m_framesPerBuffer
+					for (quint32 offset = 0; offset < block.numSamples; offset += m_framesPerBuffer) {
+						DeviceInterfaceBase::iqBlockToCPX(block, offset, m_framesPerBuffer, m_consumerBuffer);
+						processIQData(m_consumerBuffer, m_framesPerBuffer);
+					}
+				}
+				m_producerConsumer.ReleaseFreeBuffer();
+				buf = m_producerConsumer.AcquireFilledBuffer(0);
+			}
+			break;
+		case cbProducerConsumerEvents::Stop:
+			break;
+	}
+}
+
+void SynthSDRDevice::setupOptionUi(QWidget *parent)
+{
+	if (m_optionUi != NULL)
+		delete m_optionUi;
+
+	m_optionUi = new Ui::SynthOptions();
+	m_optionUi->setupUi(parent);
+	parent->setVisible(true);
+
+	m_optionUi->formatBox->addItem("Unsigned 8 bit", IQF_CPXU8);
+	m_optionUi->formatBox->addItem("Signed 8 bit", IQF_CPX8);
+	m_optionUi->formatBox->addItem("Signed 16 bit", IQF_CPX16);
+	m_optionUi->formatBox->addItem("Float", IQF_CPXFLOAT);
+	m_optionUi->formatBox->setCurrentIndex(m_optionUi->formatBox->findData(m_format));
+
+	m_optionUi->runModeBox->addItem("Real time", RM_REALTIME);
+	m_optionUi->runModeBox->addItem("Free running", RM_FREERUN);
+	m_optionUi->runModeBox->setCurrentIndex(m_optionUi->runModeBox->findData(m_runMode));
+
+	m_optionUi->seedBox->setValue(m_seed);
+
+	m_optionUi->modulationBox->addItem("Mixed", c_mixedModulation);
+	m_optionUi->modulationBox->addItem("Carrier", SynthCarrier::MOD_CARRIER);
+	m_optionUi->modulationBox->addItem("AM", SynthCarrier::MOD_AM);
+	m_optionUi->modulationBox->addItem("FM", SynthCarrier::MOD_FM);
+	m_optionUi->modulationBox->addItem("CW", SynthCarrier::MOD_CW);
+	m_optionUi->modulationBox->addItem("FSK", SynthCarrier::MOD_FSK);
+	m_optionUi->modulationBox->addItem("Sweep", SynthCarrier::MOD_SWEEP);
+	m_optionUi->modulationBox->setCurrentIndex(m_optionUi->modulationBox->findData(m_modulation));
+
+	m_optionUi->carriersBox->setValue(m_numCarriers);
+	m_optionUi->carrierDbBox->setValue(m_carrierDb);
+	m_optionUi->sweepBox->setChecked(m_sweep);
+	//Minimum is SynthGen::c_offDb, shown as Off
+	m_optionUi->awgnDbBox->setValue(m_awgnDb);
+	m_optionUi->impulseDbBox->setValue(m_impulseDb);
+	m_optionUi->impulseRateBox->setValue(m_impulsesPerSec);
+
+	connect(m_optionUi->formatBox,SIGNAL(currentIndexChanged(int)),this,SLOT(startupOptionsChanged()));
+	connect(m_optionUi->runModeBox,SIGNAL(currentIndexChanged(int)),this,SLOT(startupOptionsChanged()));
+	connect(m_optionUi->seedBox,SIGNAL(valueChanged(int)),this,SLOT(startupOptionsChanged()));
+
+	connect(m_optionUi->carriersBox,SIGNAL(valueChanged(int)),this,SLOT(scenarioChanged()));
+	connect(m_optionUi->modulationBox,SIGNAL(currentIndexChanged(int)),this,SLOT(scenarioChanged()));
+	connect(m_optionUi->carrierDbBox,SIGNAL(valueChanged(int)),this,SLOT(scenarioChanged()));
+	connect(m_optionUi->sweepBox,SIGNAL(clicked(bool)),this,SLOT(scenarioChanged()));
+	connect(m_optionUi->awgnDbBox,SIGNAL(valueChanged(int)),this,SLOT(scenarioChanged()));
+	connect(m_optionUi->impulseDbBox,SIGNAL(valueChanged(int)),this,SLOT(scenarioChanged()));
+	connect(m_optionUi->impulseRateBox,SIGNAL(valueChanged(double)),this,SLOT(scenarioChanged()));
+}
+
+void SynthSDRDevice::scenarioChanged()
+{
+	m_numCarriers = m_optionUi->carriersBox->value();
+	m_modulation = m_optionUi->modulationBox->currentData().toInt();
+	m_carrierDb = m_optionUi->carrierDbBox->value();
+	m_sweep = m_optionUi->sweepBox->isChecked();
+	m_awgnDb = m_optionUi->awgnDbBox->value();
+	m_impulseDb = m_optionUi->impulseDbBox->value();
+	m_impulsesPerSec = m_optionUi->impulseRateBox->value();
+	updateGenerator();
+}
+
+void SynthSDRDevice::startupOptionsChanged()
+{
+	m_format = (IQSampleFormat)m_optionUi->formatBox->currentData().toInt();
+	m_runMode = (RunMode)m_optionUi->runModeBox->currentData().toInt();
+	m_seed = m_optionUi->seedBox->value();
+}
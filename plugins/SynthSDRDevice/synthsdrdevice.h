@@ -0,0 +1,119 @@
+#ifndef SYNTHSDRDEVICE_H
+#define SYNTHSDRDEVICE_H
+
+//GPL license and attributions are in gpl.h and terms are included in this file by reference
+#include "gpl.h"
+#include <QObject>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QAtomicInteger>
+#include "deviceinterfacebase.h"
+#include "synthgen.h"
+#include "ui_synthoptions.h"
+
+/*
+	Synthetic signal source for hardware free load and soak tests of the whole receiver
+
+	Generates a scenario of carriers (see SynthGen) plus AWGN and impulse noise at any rate up to 20msps,
+	in the device format selected in options, and hands it to the receiver as native IQBlocks.
+	Real time mode paces blocks to the sample rate and drops blocks like real hardware if the receiver can't
+	keep up, so the receiver's lost sample count is the soak test result.
+	Free running mode never drops and runs as fast as the receiver takes samples, for max throughput tests.
+	Same seed and settings always generate the same samples.
+*/
+class SynthSDRDevice : public QObject, public DeviceInterfaceBase
+{
+	Q_OBJECT
+
+	//Exports, FILE is optional
+	//IID must be same that caller is looking for, defined in interfaces file
+	Q_PLUGIN_METADATA(IID DeviceInterface_iid)
+	//Let Qt meta-object know about our interface
+	Q_INTERFACES(DeviceInterface DeviceInterface2)
+
+public:
+	SynthSDRDevice();
+	~SynthSDRDevice();
+
+	//Required
+	bool initialize(CB_ProcessIQData _callback,
+					CB_ProcessBandscopeData _callbackBandscope,
+					CB_ProcessAudioData _callbackAudio,
+					quint16 _framesPerBuffer);
+	//Native IQBlocks instead of the DeviceInterfaceBase adapter
+	bool initialize2(CB_ProcessIQBlock _callback,
+					 CB_ProcessBandscopeData _callbackBandscope,
+					 CB_ProcessAudioData _callbackAudio,
+					 quint32 _framesPerBuffer);
+	bool command(StandardCommands _cmd, QVariant _arg);
+	QVariant get(StandardKeys _key, QVariant _option = 0);
+	bool set(StandardKeys _key, QVariant _value, QVariant _option = 0);
+
+private slots:
+	void scenarioChanged();
+	void startupOptionsChanged();
+
+private:
+	enum RunMode {
+		RM_REALTIME,	//Paced to sample rate, drops when receiver is behind
+		RM_FREERUN		//As fast as the receiver takes blocks, never drops
+	};
+	//Modulation box value for a different modulation on each carrier
+	static const int c_mixedModulation = -1;
+
+	//Producer buffers are a BlockHeader followed by the samples
+	struct BlockHeader {
+		quint64 sampleCounter;
+		quint64 droppedSamples;
+		quint32 numSamples;
+		quint32 flags;
+		quint64 reserved; //Samples start 16 byte aligned
+	};
+	static const int c_numProducerBuffers = 32;
+	static const quint32 c_maxBlockSamples = 32768; //Any format, sized for CPXFLOAT
+	static const int c_waitMs = 50; //Longest a worker blocks waiting for a buffer, so Stop is seen
+
+	void readSettings();
+	void writeSettings();
+	void producerWorker(cbProducerConsumerEvents _event);
+	void consumerWorker(cbProducerConsumerEvents _event);
+	void setupOptionUi(QWidget *parent);
+	QVector<SynthCarrier> buildScenario();
+	void updateGenerator();
+
+	Ui::SynthOptions *m_optionUi;
+
+	QMutex m_mutex; //Locks generator changes when producer thread is calling generate()
+	SynthGen *m_synthGen;
+
+	//Settings
+	IQSampleFormat m_format;
+	RunMode m_runMode;
+	quint32 m_numCarriers;
+	int m_modulation; //SynthCarrier::Modulation or c_mixedModulation
+	double m_carrierDb;
+	bool m_sweep;
+	double m_awgnDb;
+	double m_impulseDb;
+	double m_impulsesPerSec;
+	quint32 m_seed;
+
+	//Settings latched at Cmd_Start, format and run mode can't change under a running stream
+	IQSampleFormat m_blockFormat;
+	bool m_realTime;
+
+	//Producer thread
+	quint32 m_blockSamples;
+	quint64 m_sampleCounter;
+	quint64 m_pendingDropped; //Dropped since last block that made it
+	bool m_firstBlock;
+	QElapsedTimer m_elapsedTimer; //Since Cmd_Start, real time schedule and achieved rate
+
+	//V1 host, blocks are converted to m_framesPerBuffer CPX buffers
+	CPX *m_consumerBuffer;
+
+	//Read in get(Key_DeviceHealthString)
+	QAtomicInteger<qint64> m_generatedSamples;
+	QAtomicInteger<qint64> m_droppedSamples;
+};
+#endif // SYNTHSDRDEVICE_H